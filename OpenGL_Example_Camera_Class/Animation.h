@@ -0,0 +1,584 @@
+#ifndef ANIMATION_H_INCLUDED
+#define ANIMATION_H_INCLUDED
+
+///SSE2 when the compiler targets it, plain floats otherwise
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ThreadPool.h"
+
+using namespace glm;
+
+///Instances per job when the evaluation is split across the threads, fewer
+///than this in total and it runs on the calling thread
+const int ANIMATION_JOB_SIZE = 4096;
+
+///How the keys of a track are blended
+enum Interpolation
+{
+    INTERPOLATE_LINEAR,     ///lerp, nlerp for rotations
+    INTERPOLATE_SLERP,      ///Rotations at a constant angular speed
+    INTERPOLATE_CUBIC       ///Catmull-Rom through the keys
+};
+
+///A looping clip of translation, rotation and scale keys taken at a fixed
+///interval, the way a baked clip comes out of an exporter. The key after the
+///last one is the first again, the clip lasts keys * interval seconds.
+///The vector mode is for translation and scale, linear or cubic, the
+///rotation mode for the rotation, linear or slerp.
+struct AnimationClip
+{
+    float interval;
+    Interpolation vectorMode;
+    Interpolation rotationMode;
+
+    std::vector<vec3> translations;
+    std::vector<quat> rotations;
+    std::vector<vec3> scales;
+
+    void addKey(const vec3 &translation, const quat &rotation,
+                const vec3 &scale)
+    {
+        translations.push_back(translation);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+    }
+};
+
+///Plays a clip on every instance and writes their model matrices:
+///  model = translate(base + T(t)) * R(t) * scale(S(t)),
+///  t = time * speed + offset
+///The time is the same for every instance, sampled once per frame.
+///Keys and instances are kept as arrays of components so 4 instances are
+///evaluated at once with SSE2. Only fetching the keys is done per instance,
+///the modes are masks, not branches, so instances of different clips can
+///share a batch. Slerp is nlerp with Kapoulkine's correction of the blend
+///factor, well under 0.001 off for the angles between keys, which needs no
+///trigonometry. Big instance counts are split across the thread pool.
+class AnimationSystem
+{
+    private:
+
+        ///Keys of every clip one after another: translation xyz, rotation
+        ///xyzw, scale xyz
+        std::vector<float> keys[10];
+
+        ///Per clip
+        std::vector<int> clipFirstKey;
+        std::vector<int> clipKeyCount;
+        std::vector<float> clipDuration;
+        std::vector<float> clipKeysPerSecond;
+        std::vector<float> clipCubic;
+        std::vector<float> clipSlerp;
+
+        ///Per instance
+        std::vector<int> clip;
+        std::vector<float> offset;
+        std::vector<float> speed;
+        std::vector<float> baseX;
+        std::vector<float> baseY;
+        std::vector<float> baseZ;
+
+        ///What evaluate is doing, for the jobs of the thread pool
+        float fTime;
+        mat4 *output;
+        bool bSimd;
+
+        ///Private Functions
+        void evaluateRange(int first, int last);
+        void evaluateOne(int i);
+#ifdef __SSE2__
+        void evaluateFour(int i);
+#endif
+
+    public:
+
+        ///Constructor
+        AnimationSystem();
+
+        ///Returns the index instances refer to it with
+        int addClip(const AnimationClip &clip);
+
+        ///New instances play the first clip at the origin
+        void resize(int instanceCount);
+        void setInstance(int i, int clip, const vec3 &base, float offset,
+                         float speed);
+
+        ///The base of every instance at once, one array per axis
+        void setBases(const float *x, const float *y, const float *z);
+
+        ///Model matrices at time into out, one per instance. pool can be
+        ///NULL, bSimd false runs the reference path one instance at a time.
+        void evaluate(float time, mat4 *out, ThreadPool *pool,
+                      bool bSimd = true);
+
+        ///Getters
+        int getClipCount();
+        int getInstanceCount();
+        unsigned long long getInstanceBytes();
+};
+
+///Constructor
+AnimationSystem::AnimationSystem()
+{
+    fTime = 0.0f;
+    output = NULL;
+    bSimd = true;
+}
+
+int AnimationSystem::addClip(const AnimationClip &c)
+{
+    int count = c.rotations.size();
+
+    clipFirstKey.push_back(keys[0].size());
+    clipKeyCount.push_back(count);
+    clipDuration.push_back(count * c.interval);
+    clipKeysPerSecond.push_back(1.0f / c.interval);
+    clipCubic.push_back(c.vectorMode == INTERPOLATE_CUBIC ? 1.0f : 0.0f);
+    clipSlerp.push_back(c.rotationMode == INTERPOLATE_SLERP ? 1.0f : 0.0f);
+
+    quat previous;
+    for(int k=0; k<count; k++)
+    {
+        ///Every key on the same side of the rotation sphere as the last one,
+        ///so a blend takes the short way
+        quat r = c.rotations[k];
+        if(k > 0 && dot(r, previous) < 0.0f)
+        {
+            r = quat(-r.w, -r.x, -r.y, -r.z);
+        }
+        previous = r;
+
+        const float data[10] = {
+            c.translations[k].x, c.translations[k].y, c.translations[k].z,
+            r.x, r.y, r.z, r.w,
+            c.scales[k].x, c.scales[k].y, c.scales[k].z
+        };
+
+        for(int j=0; j<10; j++)
+        {
+            keys[j].push_back(data[j]);
+        }
+    }
+
+    return clipKeyCount.size() - 1;
+}
+
+void AnimationSystem::resize(int instanceCount)
+{
+    clip.resize(instanceCount, 0);
+    offset.resize(instanceCount, 0.0f);
+    speed.resize(instanceCount, 1.0f);
+    baseX.resize(instanceCount, 0.0f);
+    baseY.resize(instanceCount, 0.0f);
+    baseZ.resize(instanceCount, 0.0f);
+}
+
+void AnimationSystem::setInstance(int i, int c, const vec3 &base, float o,
+                                  float s)
+{
+    clip[i] = c;
+    offset[i] = o;
+    speed[i] = s;
+    baseX[i] = base.x;
+    baseY[i] = base.y;
+    baseZ[i] = base.z;
+}
+
+void AnimationSystem::setBases(const float *x, const float *y,
+                               const float *z)
+{
+    std::copy(x, x + baseX.size(), baseX.begin());
+    std::copy(y, y + baseY.size(), baseY.begin());
+    std::copy(z, z + baseZ.size(), baseZ.begin());
+}
+
+void AnimationSystem::evaluate(float time, mat4 *out, ThreadPool *pool,
+                               bool bSimd)
+{
+    fTime = time;
+    output = out;
+    this->bSimd = bSimd;
+
+    int n = getInstanceCount();
+    if(!pool || n < 2 * ANIMATION_JOB_SIZE)
+    {
+        evaluateRange(0, n);
+        return;
+    }
+
+    ///Only this is captured, so the function needs no heap
+    int jobs = (n + ANIMATION_JOB_SIZE - 1) / ANIMATION_JOB_SIZE;
+    pool->run(jobs, [this](int job)
+    {
+        int first = job * ANIMATION_JOB_SIZE;
+        int last = first + ANIMATION_JOB_SIZE;
+        evaluateRange(first, last < getInstanceCount() ? last :
+                                                         getInstanceCount());
+    });
+}
+
+void AnimationSystem::evaluateRange(int first, int last)
+{
+    int i = first;
+
+#ifdef __SSE2__
+    if(bSimd)
+    {
+        for(; i+4<=last; i+=4)
+        {
+            evaluateFour(i);
+        }
+    }
+#endif
+
+    for(; i<last; i++)
+    {
+        evaluateOne(i);
+    }
+}
+
+///Time in a clip of that duration, wrapping at the end. After millions of
+///loops the product loses the fraction and can land outside the clip, fmod
+///is exact but too slow to be the first choice.
+static inline float wrapClipTime(float t, float duration)
+{
+    float local = t - floorf(t / duration) * duration;
+    if(!(local >= 0.0f && local < duration))
+    {
+        local = fmodf(t, duration);
+        local = local < 0.0f ? local + duration : local;
+    }
+
+    return local;
+}
+
+///The steps every instance goes through, one at a time
+void AnimationSystem::evaluateOne(int i)
+{
+    int c = clip[i];
+    int n = clipKeyCount[c];
+
+    ///Time in the clip and the keys around it, wrapping at the end
+    float t = fTime * speed[i] + offset[i];
+    float local = wrapClipTime(t, clipDuration[c]);
+    float position = local * clipKeysPerSecond[c];
+    float whole = floorf(position);
+    float f = position - whole;
+
+    int k = (((int)whole % n) + n) % n;
+    int index[4];
+    for(int j=0; j<4; j++)
+    {
+        index[j] = clipFirstKey[c] + (k + j - 1 + n) % n;
+    }
+
+    ///Catmull-Rom weights of the 4 keys, or the linear ones
+    float f2 = f * f;
+    float f3 = f2 * f;
+    float cubic = clipCubic[c];
+    float w[4] = {
+        cubic * 0.5f * (-f3 + 2.0f * f2 - f),
+        1.0f - f + cubic * (0.5f * (3.0f * f3 - 5.0f * f2 + 2.0f) - 1.0f + f),
+        f + cubic * (0.5f * (-3.0f * f3 + 4.0f * f2 + f) - f),
+        cubic * 0.5f * (f3 - f2)
+    };
+
+    float v[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for(int j=0; j<4; j++)
+    {
+        v[0] += w[j] * keys[0][index[j]];
+        v[1] += w[j] * keys[1][index[j]];
+        v[2] += w[j] * keys[2][index[j]];
+        v[3] += w[j] * keys[7][index[j]];
+        v[4] += w[j] * keys[8][index[j]];
+        v[5] += w[j] * keys[9][index[j]];
+    }
+
+    ///Rotation between the middle two keys
+    float q0[4], q1[4];
+    for(int j=0; j<4; j++)
+    {
+        q0[j] = keys[3 + j][index[1]];
+        q1[j] = keys[3 + j][index[2]];
+    }
+
+    float d = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+    float sign = d < 0.0f ? -1.0f : 1.0f;
+    d = fabsf(d);
+
+    float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+    float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+    float h = f - 0.5f;
+    float s = f + clipSlerp[c] * f * h * (f - 1.0f) * (a * h * h + b);
+
+    float q[4];
+    for(int j=0; j<4; j++)
+    {
+        q[j] = q0[j] * (1.0f - s) + q1[j] * s * sign;
+    }
+
+    float scale = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] +
+                               q[3] * q[3]);
+    float x = q[0] * scale, y = q[1] * scale, z = q[2] * scale;
+    float qw = q[3] * scale;
+
+    float *m = value_ptr(output[i]);
+    m[0] = (1.0f - 2.0f * (y * y + z * z)) * v[3];
+    m[1] = 2.0f * (x * y + qw * z) * v[3];
+    m[2] = 2.0f * (x * z - qw * y) * v[3];
+    m[3] = 0.0f;
+    m[4] = 2.0f * (x * y - qw * z) * v[4];
+    m[5] = (1.0f - 2.0f * (x * x + z * z)) * v[4];
+    m[6] = 2.0f * (y * z + qw * x) * v[4];
+    m[7] = 0.0f;
+    m[8] = 2.0f * (x * z + qw * y) * v[5];
+    m[9] = 2.0f * (y * z - qw * x) * v[5];
+    m[10] = (1.0f - 2.0f * (x * x + y * y)) * v[5];
+    m[11] = 0.0f;
+    m[12] = baseX[i] + v[0];
+    m[13] = baseY[i] + v[1];
+    m[14] = baseZ[i] + v[2];
+    m[15] = 1.0f;
+}
+
+#ifdef __SSE2__
+///floor of every lane, SSE2 only truncates. From 2^23 up every float is
+///whole already, and past 2^31 the truncation overflows, so those lanes are
+///kept as they are.
+static inline __m128 floorFour(__m128 x)
+{
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    __m128 above = _mm_cmpgt_ps(truncated, x);
+    __m128 floored = _mm_sub_ps(truncated,
+                                _mm_and_ps(above, _mm_set1_ps(1.0f)));
+
+    __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 whole = _mm_cmpge_ps(magnitude, _mm_set1_ps(8388608.0f));
+    return _mm_or_ps(_mm_and_ps(whole, x), _mm_andnot_ps(whole, floored));
+}
+
+///The same steps as evaluateOne on instances i to i+3, one in every lane
+void AnimationSystem::evaluateFour(int i)
+{
+    ///What the lanes need of their clips
+    float duration[4], keysPerSecond[4], cubicMask[4], slerpMask[4];
+    for(int j=0; j<4; j++)
+    {
+        int c = clip[i + j];
+        duration[j] = clipDuration[c];
+        keysPerSecond[j] = clipKeysPerSecond[c];
+        cubicMask[j] = clipCubic[c];
+        slerpMask[j] = clipSlerp[c];
+    }
+
+    __m128 t = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fTime),
+                                     _mm_loadu_ps(&speed[i])),
+                          _mm_loadu_ps(&offset[i]));
+    __m128 d = _mm_loadu_ps(duration);
+    __m128 local = _mm_sub_ps(t, _mm_mul_ps(floorFour(_mm_div_ps(t, d)), d));
+
+    ///Lanes that fell outside their clip take the fmod of wrapClipTime
+    __m128 inside = _mm_and_ps(_mm_cmpge_ps(local, _mm_setzero_ps()),
+                               _mm_cmplt_ps(local, d));
+    if(_mm_movemask_ps(inside) != 15)
+    {
+        float times[4];
+        _mm_storeu_ps(times, t);
+        for(int j=0; j<4; j++)
+        {
+            times[j] = wrapClipTime(times[j], duration[j]);
+        }
+        local = _mm_loadu_ps(times);
+    }
+
+    __m128 position = _mm_mul_ps(local, _mm_loadu_ps(keysPerSecond));
+    __m128 whole = floorFour(position);
+    __m128 f = _mm_sub_ps(position, whole);
+
+    int k[4];
+    _mm_storeu_si128((__m128i*)k, _mm_cvttps_epi32(whole));
+
+    ///Fetch the keys, the only part done lane by lane:
+    ///[key][component][lane], translation and scale of the 4 keys and the
+    ///rotation of the middle two
+    float vectors[4][6][4];
+    float rotations[2][4][4];
+    for(int j=0; j<4; j++)
+    {
+        int c = clip[i + j];
+        int n = clipKeyCount[c];
+        int kk = ((k[j] % n) + n) % n;
+
+        for(int e=0; e<4; e++)
+        {
+            int index = clipFirstKey[c] + (kk + e - 1 + n) % n;
+            vectors[e][0][j] = keys[0][index];
+            vectors[e][1][j] = keys[1][index];
+            vectors[e][2][j] = keys[2][index];
+            vectors[e][3][j] = keys[7][index];
+            vectors[e][4][j] = keys[8][index];
+            vectors[e][5][j] = keys[9][index];
+
+            if(e == 1 || e == 2)
+            {
+                for(int q=0; q<4; q++)
+                {
+                    rotations[e - 1][q][j] = keys[3 + q][index];
+                }
+            }
+        }
+    }
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    ///Catmull-Rom weights, or the linear ones
+    __m128 cubic = _mm_loadu_ps(cubicMask);
+    __m128 f2 = _mm_mul_ps(f, f);
+    __m128 f3 = _mm_mul_ps(f2, f);
+    __m128 linear1 = _mm_sub_ps(one, f);
+
+    __m128 w[4];
+    w[0] = _mm_mul_ps(cubic, _mm_mul_ps(half,
+           _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(two, f2), f3), f)));
+    w[1] = _mm_add_ps(linear1, _mm_mul_ps(cubic, _mm_sub_ps(
+           _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(
+               _mm_mul_ps(_mm_set1_ps(3.0f), f3),
+               _mm_mul_ps(_mm_set1_ps(5.0f), f2)), two)), linear1)));
+    w[2] = _mm_add_ps(f, _mm_mul_ps(cubic, _mm_sub_ps(
+           _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(
+               _mm_mul_ps(_mm_set1_ps(4.0f), f2),
+               _mm_mul_ps(_mm_set1_ps(3.0f), f3)), f)), f)));
+    w[3] = _mm_mul_ps(cubic, _mm_mul_ps(half, _mm_sub_ps(f3, f2)));
+
+    __m128 v[6];
+    for(int c=0; c<6; c++)
+    {
+        v[c] = _mm_mul_ps(w[0], _mm_loadu_ps(vectors[0][c]));
+        for(int e=1; e<4; e++)
+        {
+            v[c] = _mm_add_ps(v[c], _mm_mul_ps(w[e],
+                                               _mm_loadu_ps(vectors[e][c])));
+        }
+    }
+
+    ///Rotation, the corrected nlerp
+    __m128 q0[4], q1[4];
+    for(int c=0; c<4; c++)
+    {
+        q0[c] = _mm_loadu_ps(rotations[0][c]);
+        q1[c] = _mm_loadu_ps(rotations[1][c]);
+    }
+
+    __m128 dq = _mm_mul_ps(q0[0], q1[0]);
+    for(int c=1; c<4; c++)
+    {
+        dq = _mm_add_ps(dq, _mm_mul_ps(q0[c], q1[c]));
+    }
+
+    ///The sign bit of the dot flips the second key, |dot| drives the fit
+    __m128 signBit = _mm_and_ps(dq, _mm_set1_ps(-0.0f));
+    dq = _mm_xor_ps(dq, signBit);
+
+    __m128 a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(dq,
+               _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(dq,
+               _mm_sub_ps(_mm_set1_ps(3.55645f),
+                          _mm_mul_ps(dq, _mm_set1_ps(1.43519f)))))));
+    __m128 b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(dq,
+               _mm_add_ps(_mm_set1_ps(-1.06021f),
+                          _mm_mul_ps(dq, _mm_set1_ps(0.215638f)))));
+    __m128 h = _mm_sub_ps(f, half);
+    __m128 correction = _mm_mul_ps(_mm_mul_ps(f, h), _mm_sub_ps(f, one));
+    correction = _mm_mul_ps(correction, _mm_add_ps(_mm_mul_ps(a,
+                                         _mm_mul_ps(h, h)), b));
+    __m128 s = _mm_add_ps(f, _mm_mul_ps(_mm_loadu_ps(slerpMask), correction));
+
+    __m128 s0 = _mm_sub_ps(one, s);
+    __m128 s1 = _mm_xor_ps(s, signBit);
+
+    __m128 q[4];
+    __m128 length = _mm_setzero_ps();
+    for(int c=0; c<4; c++)
+    {
+        q[c] = _mm_add_ps(_mm_mul_ps(q0[c], s0), _mm_mul_ps(q1[c], s1));
+        length = _mm_add_ps(length, _mm_mul_ps(q[c], q[c]));
+    }
+
+    __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(length));
+    __m128 x = _mm_mul_ps(q[0], scale);
+    __m128 y = _mm_mul_ps(q[1], scale);
+    __m128 z = _mm_mul_ps(q[2], scale);
+    __m128 qw = _mm_mul_ps(q[3], scale);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+    __m128 zz = _mm_mul_ps(z, z), xy = _mm_mul_ps(x, y);
+    __m128 xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(qw, x), wy = _mm_mul_ps(qw, y);
+    __m128 wz = _mm_mul_ps(qw, z);
+
+    ///The columns of the 4 matrices, component by component
+    __m128 columns[4][4];
+    columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two,
+                    _mm_add_ps(yy, zz))), v[3]);
+    columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), v[3]);
+    columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), v[3]);
+    columns[0][3] = _mm_setzero_ps();
+    columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), v[4]);
+    columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two,
+                    _mm_add_ps(xx, zz))), v[4]);
+    columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), v[4]);
+    columns[1][3] = _mm_setzero_ps();
+    columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), v[5]);
+    columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), v[5]);
+    columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two,
+                    _mm_add_ps(xx, yy))), v[5]);
+    columns[2][3] = _mm_setzero_ps();
+    columns[3][0] = _mm_add_ps(_mm_loadu_ps(&baseX[i]), v[0]);
+    columns[3][1] = _mm_add_ps(_mm_loadu_ps(&baseY[i]), v[1]);
+    columns[3][2] = _mm_add_ps(_mm_loadu_ps(&baseZ[i]), v[2]);
+    columns[3][3] = one;
+
+    ///A transpose turns a column of every lane into the column of a matrix
+    for(int c=0; c<4; c++)
+    {
+        _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2],
+                          columns[c][3]);
+        for(int j=0; j<4; j++)
+        {
+            _mm_storeu_ps(value_ptr(output[i + j]) + c * 4, columns[c][j]);
+        }
+    }
+}
+#endif
+
+int AnimationSystem::getClipCount()
+{
+    return clipKeyCount.size();
+}
+
+int AnimationSystem::getInstanceCount()
+{
+    return clip.size();
+}
+
+///Memory of the per instance arrays, not of the clips
+unsigned long long AnimationSystem::getInstanceBytes()
+{
+    return clip.capacity() * sizeof(int) +
+           (offset.capacity() + speed.capacity() + baseX.capacity() +
+            baseY.capacity() + baseZ.capacity()) * sizeof(float);
+}
+
+#endif // ANIMATION_H_INCLUDED
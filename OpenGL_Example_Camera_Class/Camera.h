@@ -1,6 +1,9 @@
 #ifndef CAMERA_H_INCLUDED
 #define CAMERA_H_INCLUDED
 
+#include <new>
+#include <algorithm>
+
 ///GLEW
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -39,112 +42,244 @@ enum Camera_Target_Type
     ANCHORED
 };
 
-/// Default camera values
-const float YAW        = 270.0f;
-const float PITCH      =   0.0f;
-const float SPEED      =   2.5f;
-const float SENSITIVTY =  20.0f;
-const float FOV        =  45.0f;
-const float NEARCP     =   0.1f;
-const float FARCP      =  100.0f;
-const float WIDTH      = 800.0f;
-const float HEIGHT     = 600.0f;
+/// Default camera values, known at compile time
+constexpr float YAW        = 270.0f;
+constexpr float PITCH      =   0.0f;
+constexpr float SPEED      =   2.5f;
+constexpr float SENSITIVTY =  20.0f;
+constexpr float FOV        =  45.0f;
+constexpr float NEARCP     =   0.1f;
+constexpr float FARCP      =  100.0f;
+constexpr float WIDTH      = 800.0f;
+constexpr float HEIGHT     = 600.0f;
 const vec3 WORLD_UP    = vec3(0.0f,1.0f,0.0f);
 
-class Camera
+///radians() of GLM, at compile time. The same float multiplication, so the
+///same bits.
+constexpr float toRadians(float degrees)
+{
+    return degrees * static_cast<float>(0.01745329251994329576923690768489);
+}
+
+constexpr float FOV_RADIANS = toRadians(FOV);
+
+///Where the camera is and where it looks, what the target policies update
+struct CameraFrame
+{
+    vec3 Position;
+    vec3 Front;
+    vec3 Up;
+    vec3 Right;
+    vec3 WorldUp;
+    vec3 Target;
+
+    ///Angles
+    float fYaw;
+    float fPitch;
+};
+
+///\//////////////////////////////////Policies//////////////////////////////////
+
+///What the projection of a BasicCamera is, chosen at compile time
+struct PerspectiveProjection
+{
+    static const Camera_Type TYPE = PERSPECTIVE;
+
+    static mat4 getMatrix(float width, float height, float fNear, float fFar)
+    {
+        return perspective(FOV_RADIANS, width / height, fNear, fFar);
+    }
+
+    ///The half angles of the view grow by the margin and the far plane
+    ///moves out to the far corners, whatever the turn the far side stays
+    ///inside
+    static mat4 getMatrix(float width, float height, float fNear, float fFar,
+                          float fMargin)
+    {
+        float fTanY = tan(FOV_RADIANS * 0.5f);
+        float fTanX = fTanY * width / height;
+        float fFarCorner = fFar * sqrt(1.0f + fTanX * fTanX + fTanY * fTanY);
+
+        ///Short of 90 degrees, the projection breaks down there
+        float fHalfY = std::min(atan(fTanY) + radians(fMargin), 1.5f);
+        float fHalfX = std::min(atan(fTanX) + radians(fMargin), 1.5f);
+
+        return perspective(2.0f * fHalfY, tan(fHalfX) / tan(fHalfY),
+                           fNear * 0.5f, fFarCorner);
+    }
+};
+
+struct OrthographicProjection
+{
+    static const Camera_Type TYPE = ORTHOGRAPHIC;
+
+    static mat4 getMatrix(float width, float height, float fNear, float fFar)
+    {
+        return ortho(0.0f, width, 0.0f, height, fNear, fFar);
+    }
+
+    ///Turning doesn't change what a box holds
+    static mat4 getMatrix(float width, float height, float fNear, float fFar,
+                          float fMargin)
+    {
+        return getMatrix(width, height, fNear, fFar);
+    }
+};
+
+///How the camera aims, chosen at compile time. A free camera turns with the
+///yaw and pitch and its target stays in front of it, an anchored one always
+///looks at its target.
+struct FreeRoamTarget
+{
+    static const Camera_Target_Type TYPE = FREE_ROAM;
+
+    static void create(CameraFrame &f, vec3 pos, vec3 dir)
+    {
+        f.Position = pos;
+        f.Target = pos + dir;
+        f.Front = dir;
+    }
+
+    static void updateVectors(CameraFrame &f)
+    {
+        ///Calculate the new Front vector
+        vec3 newFront;
+        newFront.x = cos(radians(f.fYaw)) * cos(radians(f.fPitch));
+        newFront.y = sin(radians(f.fPitch));
+        newFront.z = sin(radians(f.fYaw)) * cos(radians(f.fPitch));
+
+        f.Front = normalize(newFront);
+
+        ///Also re-calculate the Right and Up vector
+        f.Right = normalize(cross(f.Front, f.WorldUp));
+        f.Up    = normalize(cross(f.Right, f.Front));
+    }
+
+    ///Moving doesn't turn it, the target comes along
+    static void moved(CameraFrame &f)
+    {
+        f.Target = f.Position + f.Front;
+    }
+
+    static void turned(CameraFrame &f)
+    {
+        updateVectors(f);
+        f.Target = f.Position + f.Front;
+    }
+};
+
+struct AnchoredTarget
+{
+    static const Camera_Target_Type TYPE = ANCHORED;
+
+    static void create(CameraFrame &f, vec3 pos, vec3 tar)
+    {
+        f.Position = pos;
+        f.Target = tar;
+    }
+
+    static void updateVectors(CameraFrame &f)
+    {
+        ///Calculate the new Front Vector
+        f.Front = normalize(f.Target - f.Position);
+
+        ///Also re-calculate the Right and Up vector
+        f.Right = normalize(cross(f.Front, f.WorldUp));
+        f.Up    = normalize(cross(f.Right, f.Front));
+    }
+
+    ///Moving turns it towards the target, the angles don't
+    static void moved(CameraFrame &f)
+    {
+        updateVectors(f);
+    }
+
+    static void turned(CameraFrame &f)
+    {
+        updateVectors(f);
+    }
+};
+
+///\/////////////////////////////////BasicCamera////////////////////////////////
+
+///A camera whose projection and aim are resolved at compile time: none of
+///its functions asks what kind of camera it is, they all inline down to the
+///math of its policies.
+template<class ProjectionPolicy, class TargetPolicy>
+class BasicCamera
 {
     private:
 
-        /// Camera Attributes
-        vec3 Position;
-        vec3 Front;
-        vec3 Up;
-        vec3 Right;
-        vec3 WorldUp;
-        vec3 Target;
+        CameraFrame frame;
 
         ///Field of vision
         float fZoom;
 
         ///Camera Settings
-        Camera_Type type;
-        Camera_Target_Type t_type;
         float fNearClippingPlane;
         float fFarClippingPlane;
         float fWidth;
         float fHeight;
 
-        ///Angles
-        float fYaw;
-        float fPitch;
-
         ///Movement and Rotation Speed
         float MovementSpeed;
         float RotationSensitivity;
 
-        ///Private Functions
-        void updateCameraVectors();
+        ///Calls to MoveCamera so far, tells others the camera changed
+        unsigned int iMoves;
 
     public:
 
-        ///Constructor
-        Camera(vec3 pos, vec3 dir, vec3 up, Camera_Type t);
-        Camera(vec3 pos, vec3 tar, vec3 up, Camera_Type t,int);
+        ///Constructor, aim is the direction of a free camera and the target
+        ///of an anchored one
+        BasicCamera(vec3 pos, vec3 aim, vec3 up);
 
         ///Public Functions
         mat4 GetViewMatrix();
         mat4 GetProjectionMatrix();
 
-        ///Function to get keyboard input and move the camera
-        void MoveCamera(Camera_Movement direction, float deltaTime);
-
-};
-
-///Constructor for Roaming Camera
-Camera::Camera(vec3 pos, vec3 dir, vec3 up, Camera_Type t)
-{
-    Position = pos;
-    Up = up;
-    Target =  pos + dir;
-    Front = dir;
-
-    type = t;
+        ///A projection that holds every view the camera has after turning
+        ///up to fMargin degrees, for what is culled before it is final
+        mat4 GetProjectionMatrix(float fMargin);
 
-    fYaw = YAW;
-    fPitch = PITCH;
-    fZoom = FOV;
-
-    MovementSpeed = SPEED;
-    RotationSensitivity = SENSITIVTY;
-    WorldUp = WORLD_UP;
+        ///How far the camera can move and turn (in degrees) in deltaTime
+        float GetMaxMovement(float deltaTime);
+        float GetMaxRotation(float deltaTime);
 
-    fNearClippingPlane = NEARCP;
-    fFarClippingPlane = FARCP;
+        ///Size of the viewport the projection is made for
+        void SetViewportSize(float width, float height);
 
-    fWidth = WIDTH;
-    fHeight = HEIGHT;
+        ///Moves the camera without turning it
+        void SetPosition(vec3 pos);
 
-    t_type = FREE_ROAM;
+        ///Getters
+        vec3 GetPosition();
+        vec3 GetFront();
+        float GetWidth();
+        float GetHeight();
+        float GetNearPlane();
+        float GetFarPlane();
+        unsigned int GetMoveCount();
 
-    updateCameraVectors();
-}
+        ///Function to get keyboard input and move the camera
+        void MoveCamera(Camera_Movement direction, float deltaTime);
+};
 
-///Constructor for Anchored Camera
-Camera::Camera(vec3 pos, vec3 tar, vec3 up, Camera_Type t,int i)
+///Constructor
+template<class ProjectionPolicy, class TargetPolicy>
+BasicCamera<ProjectionPolicy, TargetPolicy>::BasicCamera(vec3 pos, vec3 aim,
+                                                         vec3 up)
 {
-    Position = pos;
-    Up = up;
-    Target =  tar;
-
-    type = t;
+    TargetPolicy::create(frame, pos, aim);
+    frame.Up = up;
 
-    fYaw = YAW;
-    fPitch = PITCH;
+    frame.fYaw = YAW;
+    frame.fPitch = PITCH;
     fZoom = FOV;
 
     MovementSpeed = SPEED;
     RotationSensitivity = SENSITIVTY;
-    WorldUp = WORLD_UP;
+    frame.WorldUp = WORLD_UP;
 
     fNearClippingPlane = NEARCP;
     fFarClippingPlane = FARCP;
@@ -152,159 +287,381 @@ Camera::Camera(vec3 pos, vec3 tar, vec3 up, Camera_Type t,int i)
     fWidth = WIDTH;
     fHeight = HEIGHT;
 
-    t_type = ANCHORED;
-
-    updateCameraVectors();
-}
-
-///Whenever the camera's position
-///changes we must update the corresponding
-///vectors
-void Camera::updateCameraVectors()
-{
-    if(t_type == FREE_ROAM)
-    {
-       ///Calculate the new Front vector
-        vec3 newFront;
-        newFront.x = cos(radians(fYaw)) * cos(radians(fPitch));
-        newFront.y = sin(radians(fPitch));
-        newFront.z = sin(radians(fYaw)) * cos(radians(fPitch));
-
-        Front = normalize(newFront);
-
-        ///Also re-calculate the Right and Up vector
-        Right = normalize(cross(Front, WorldUp));
-        Up    = normalize(cross(Right, Front));
-    }
-    else if (t_type == ANCHORED)
-    {
-        ///Calculate the new Front Vector
-        vec3 newFront = normalize(Target - Position);
-
-        Front = newFront;
-
-        ///Also re-calculate the Right and Up vector
-        Right = normalize(cross(Front, WorldUp));
-        Up    = normalize(cross(Right, Front));
-
-    }
+    iMoves = 0;
 
+    TargetPolicy::updateVectors(frame);
 }
 
 ///This function handles the camera movement
-void Camera::MoveCamera(Camera_Movement direction, float deltaTime)
+template<class ProjectionPolicy, class TargetPolicy>
+inline void BasicCamera<ProjectionPolicy, TargetPolicy>::MoveCamera(
+    Camera_Movement direction, float deltaTime)
 {
     float fCameraSpeed = MovementSpeed * deltaTime;
     float fCameraRotationSpeed = fCameraSpeed * RotationSensitivity;
 
+    iMoves++;
+
     switch(direction)
     {
         case FORWARD:
-            {
-                Position += Front * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position += frame.Front * fCameraSpeed;
+            break;
         case BACKWARD:
-            {
-                Position -= Front * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position -= frame.Front * fCameraSpeed;
+            break;
         case LEFT:
-            {
-                Position -= Right * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position -= frame.Right * fCameraSpeed;
+            break;
         case RIGHT:
-            {
-                Position += Right * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position += frame.Right * fCameraSpeed;
+            break;
         case UP:
-            {
-                Position += WorldUp * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position += frame.WorldUp * fCameraSpeed;
+            break;
         case DOWN:
-            {
-                Position -= WorldUp * fCameraSpeed;
-                if(t_type == ANCHORED)
-                {
-                    updateCameraVectors();
-                }
-                break;
-            }
+            frame.Position -= frame.WorldUp * fCameraSpeed;
+            break;
         case LEFT_SPIN:
-            fYaw -= fCameraRotationSpeed;
-            updateCameraVectors();
+            frame.fYaw -= fCameraRotationSpeed;
             break;
-
         case RIGHT_SPIN:
-            fYaw += fCameraRotationSpeed;
-            updateCameraVectors();
+            frame.fYaw += fCameraRotationSpeed;
             break;
-
         case UP_SPIN:
-            fPitch += fCameraRotationSpeed;
-            updateCameraVectors();
+            frame.fPitch += fCameraRotationSpeed;
             break;
-
         case DOWN_SPIN:
-            fPitch -= fCameraRotationSpeed;
-            updateCameraVectors();
+            frame.fPitch -= fCameraRotationSpeed;
             break;
     }
 
-    if(t_type == FREE_ROAM)
+    if(direction < LEFT_SPIN)
     {
-        ///Recalculate the target of the camera
-        Target = Position + Front;
+        TargetPolicy::moved(frame);
+    }
+    else
+    {
+        TargetPolicy::turned(frame);
     }
 }
 
 ///This function returns the corresponding lookAt
 ///matrix of this camera for the vertex shader
-mat4 Camera::GetViewMatrix()
+template<class ProjectionPolicy, class TargetPolicy>
+inline mat4 BasicCamera<ProjectionPolicy, TargetPolicy>::GetViewMatrix()
 {
-    return lookAt(Position, Target, Up);
+    return lookAt(frame.Position, frame.Target, frame.Up);
 }
 
 ///This function returns the corresponding Projection
 ///matrix of this camera for the vertex shader
-mat4 Camera::GetProjectionMatrix()
+template<class ProjectionPolicy, class TargetPolicy>
+inline mat4 BasicCamera<ProjectionPolicy, TargetPolicy>::GetProjectionMatrix()
+{
+    return ProjectionPolicy::getMatrix(fWidth, fHeight, fNearClippingPlane,
+                                       fFarClippingPlane);
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline mat4 BasicCamera<ProjectionPolicy, TargetPolicy>::GetProjectionMatrix(
+    float fMargin)
+{
+    return ProjectionPolicy::getMatrix(fWidth, fHeight, fNearClippingPlane,
+                                       fFarClippingPlane, fMargin);
+}
+
+///Every movement key at once, the diagonal of the three axes
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetMaxMovement(
+    float deltaTime)
+{
+    return MovementSpeed * deltaTime * 1.7320508f;
+}
+
+///Yaw and pitch at once
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetMaxRotation(
+    float deltaTime)
+{
+    return 2.0f * MovementSpeed * deltaTime * RotationSensitivity;
+}
+
+///The aspect ratio of the perspective projection and the size of the
+///orthographic one follow the viewport
+template<class ProjectionPolicy, class TargetPolicy>
+inline void BasicCamera<ProjectionPolicy, TargetPolicy>::SetViewportSize(
+    float width, float height)
+{
+    if(width > 0.0f && height > 0.0f)
+    {
+        fWidth = width;
+        fHeight = height;
+    }
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline void BasicCamera<ProjectionPolicy, TargetPolicy>::SetPosition(vec3 pos)
+{
+    frame.Position = pos;
+    TargetPolicy::moved(frame);
+}
+
+///\////////////////////////////////Getters////////////////////////////////////
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline vec3 BasicCamera<ProjectionPolicy, TargetPolicy>::GetPosition()
+{
+    return frame.Position;
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline vec3 BasicCamera<ProjectionPolicy, TargetPolicy>::GetFront()
+{
+    return frame.Front;
+}
+
+///Size of the viewport in pixels, used to measure projected sizes
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetWidth()
+{
+    return fWidth;
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetHeight()
+{
+    return fHeight;
+}
+
+///Distances to the clipping planes
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetNearPlane()
+{
+    return fNearClippingPlane;
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline float BasicCamera<ProjectionPolicy, TargetPolicy>::GetFarPlane()
+{
+    return fFarClippingPlane;
+}
+
+template<class ProjectionPolicy, class TargetPolicy>
+inline unsigned int BasicCamera<ProjectionPolicy, TargetPolicy>::GetMoveCount()
+{
+    return iMoves;
+}
+
+///\/////////////////////////////////Camera////////////////////////////////////
+
+///Every BasicCamera behind the same virtual functions
+class CameraConcept
+{
+    public:
+
+        virtual ~CameraConcept() {}
+
+        ///A copy of itself, built in storage
+        virtual CameraConcept *copyTo(void *storage) const = 0;
+
+        virtual mat4 GetViewMatrix() = 0;
+        virtual mat4 GetProjectionMatrix() = 0;
+        virtual mat4 GetProjectionMatrix(float fMargin) = 0;
+        virtual float GetMaxMovement(float deltaTime) = 0;
+        virtual float GetMaxRotation(float deltaTime) = 0;
+        virtual void SetViewportSize(float width, float height) = 0;
+        virtual void SetPosition(vec3 pos) = 0;
+        virtual vec3 GetPosition() = 0;
+        virtual vec3 GetFront() = 0;
+        virtual float GetWidth() = 0;
+        virtual float GetHeight() = 0;
+        virtual float GetNearPlane() = 0;
+        virtual float GetFarPlane() = 0;
+        virtual unsigned int GetMoveCount() = 0;
+        virtual void MoveCamera(Camera_Movement direction,
+                                float deltaTime) = 0;
+};
+
+template<class ProjectionPolicy, class TargetPolicy>
+class CameraModel : public CameraConcept
+{
+    private:
+
+        BasicCamera<ProjectionPolicy, TargetPolicy> camera;
+
+    public:
+
+        CameraModel(vec3 pos, vec3 aim, vec3 up) : camera(pos, aim, up) {}
+
+        CameraConcept *copyTo(void *storage) const
+        {
+            return new(storage) CameraModel(*this);
+        }
+
+        mat4 GetViewMatrix() { return camera.GetViewMatrix(); }
+        mat4 GetProjectionMatrix() { return camera.GetProjectionMatrix(); }
+        mat4 GetProjectionMatrix(float fMargin)
+        {
+            return camera.GetProjectionMatrix(fMargin);
+        }
+        float GetMaxMovement(float deltaTime)
+        {
+            return camera.GetMaxMovement(deltaTime);
+        }
+        float GetMaxRotation(float deltaTime)
+        {
+            return camera.GetMaxRotation(deltaTime);
+        }
+        void SetViewportSize(float width, float height)
+        {
+            camera.SetViewportSize(width, height);
+        }
+        void SetPosition(vec3 pos) { camera.SetPosition(pos); }
+        vec3 GetPosition() { return camera.GetPosition(); }
+        vec3 GetFront() { return camera.GetFront(); }
+        float GetWidth() { return camera.GetWidth(); }
+        float GetHeight() { return camera.GetHeight(); }
+        float GetNearPlane() { return camera.GetNearPlane(); }
+        float GetFarPlane() { return camera.GetFarPlane(); }
+        unsigned int GetMoveCount() { return camera.GetMoveCount(); }
+        void MoveCamera(Camera_Movement direction, float deltaTime)
+        {
+            camera.MoveCamera(direction, deltaTime);
+        }
+};
+
+///Room for any CameraModel, they all hold the same members
+const size_t CAMERA_STORAGE_SIZE =
+    sizeof(CameraModel<PerspectiveProjection, FreeRoamTarget>);
+
+///The kind of camera picked at run time, for the code that doesn't know it.
+///The BasicCamera lives inside the object, copying a Camera never touches
+///the heap.
+class Camera
+{
+    private:
+
+        alignas(16) unsigned char storage[CAMERA_STORAGE_SIZE];
+        CameraConcept *impl;
+
+        template<class ProjectionPolicy, class TargetPolicy>
+        void create(vec3 pos, vec3 aim, vec3 up);
+
+    public:
+
+        ///Constructor for Roaming Camera
+        Camera(vec3 pos, vec3 dir, vec3 up, Camera_Type t);
+        ///Constructor for Anchored Camera
+        Camera(vec3 pos, vec3 tar, vec3 up, Camera_Type t,int);
+
+        Camera(const Camera &other);
+        Camera &operator=(const Camera &other);
+        ~Camera();
+
+        ///Public Functions
+        mat4 GetViewMatrix() { return impl->GetViewMatrix(); }
+        mat4 GetProjectionMatrix() { return impl->GetProjectionMatrix(); }
+
+        ///A projection that holds every view the camera has after turning
+        ///up to fMargin degrees, for what is culled before it is final
+        mat4 GetProjectionMatrix(float fMargin)
+        {
+            return impl->GetProjectionMatrix(fMargin);
+        }
+
+        ///How far the camera can move and turn (in degrees) in deltaTime
+        float GetMaxMovement(float deltaTime)
+        {
+            return impl->GetMaxMovement(deltaTime);
+        }
+        float GetMaxRotation(float deltaTime)
+        {
+            return impl->GetMaxRotation(deltaTime);
+        }
+
+        ///Size of the viewport the projection is made for
+        void SetViewportSize(float width, float height)
+        {
+            impl->SetViewportSize(width, height);
+        }
+
+        ///Moves the camera without turning it
+        void SetPosition(vec3 pos) { impl->SetPosition(pos); }
+
+        ///Getters
+        vec3 GetPosition() { return impl->GetPosition(); }
+        vec3 GetFront() { return impl->GetFront(); }
+        float GetWidth() { return impl->GetWidth(); }
+        float GetHeight() { return impl->GetHeight(); }
+        float GetNearPlane() { return impl->GetNearPlane(); }
+        float GetFarPlane() { return impl->GetFarPlane(); }
+        unsigned int GetMoveCount() { return impl->GetMoveCount(); }
+
+        ///Function to get keyboard input and move the camera
+        void MoveCamera(Camera_Movement direction, float deltaTime)
+        {
+            impl->MoveCamera(direction, deltaTime);
+        }
+};
+
+template<class ProjectionPolicy, class TargetPolicy>
+void Camera::create(vec3 pos, vec3 aim, vec3 up)
+{
+    static_assert(sizeof(CameraModel<ProjectionPolicy, TargetPolicy>) <=
+                  CAMERA_STORAGE_SIZE, "The camera doesn't fit");
+
+    impl = new(storage) CameraModel<ProjectionPolicy, TargetPolicy>(pos, aim,
+                                                                    up);
+}
+
+///Constructor for Roaming Camera
+Camera::Camera(vec3 pos, vec3 dir, vec3 up, Camera_Type t)
+{
+    if(t == PERSPECTIVE)
+    {
+        create<PerspectiveProjection, FreeRoamTarget>(pos, dir, up);
+    }
+    else
+    {
+        create<OrthographicProjection, FreeRoamTarget>(pos, dir, up);
+    }
+}
+
+///Constructor for Anchored Camera
+Camera::Camera(vec3 pos, vec3 tar, vec3 up, Camera_Type t,int i)
 {
-    if(type == PERSPECTIVE)
+    if(t == PERSPECTIVE)
     {
-       return perspective(radians(FOV), (float)fWidth/(float)fHeight,
-                          fNearClippingPlane, fFarClippingPlane);
+        create<PerspectiveProjection, AnchoredTarget>(pos, tar, up);
     }
-    else if(type == ORTHOGRAPHIC)
+    else
+    {
+        create<OrthographicProjection, AnchoredTarget>(pos, tar, up);
+    }
+}
+
+Camera::Camera(const Camera &other)
+{
+    impl = other.impl->copyTo(storage);
+}
+
+Camera &Camera::operator=(const Camera &other)
+{
+    if(this != &other)
     {
-        return ortho(0.0f, fWidth, 0.0f, fHeight, fNearClippingPlane,
-              fFarClippingPlane);
+        impl->~CameraConcept();
+        impl = other.impl->copyTo(storage);
     }
 
-    return mat4();
+    return *this;
+}
 
+Camera::~Camera()
+{
+    impl->~CameraConcept();
 }
 
+///\////////////////////////////////////////////////////////////////////////////
+
 #endif // CAMERA_H_INCLUDED
@@ -0,0 +1,213 @@
+#ifndef CAMERALATCH_H_INCLUDED
+#define CAMERALATCH_H_INCLUDED
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+///GLM
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+///Uniform buffer binding point of the camera block, after the view block
+const int CAMERA_BLOCK_BINDING = 1;
+
+///The camera block of transform.glsl, std140
+struct CameraBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+};
+
+///Measures how old the input is when the frame that shows it is submitted,
+///and with a late latch takes that age down to the time the draws take.
+///The normal frame draws, reads the input, swaps and polls: what is polled
+///at the end of one frame moves the camera at the end of the next one and
+///is drawn in the one after that. Latched late the input is polled and
+///applied after everything that doesn't need the final camera (animation,
+///levels of detail, culling against a frustum grown by what the camera can
+///move in a frame), and the view and projection go to a uniform buffer the
+///vertex shader reads at draw time.
+class CameraLatch
+{
+    private:
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        bool bActive;
+
+        CameraBlock block;
+        unsigned int uniformBuffer;
+
+        ///When the input was polled, when the input the camera has now was
+        ///polled and the same for the camera of the draws
+        Clock::time_point polledAt;
+        Clock::time_point appliedAt;
+        Clock::time_point drawnAt;
+        bool bApplied;
+
+        ///Latency of the last frame in seconds, 0 before any input
+        double lastLatency;
+
+        ///Stats since the last print
+        double latencySum;
+        double maxLatency;
+        int frames;
+
+    public:
+
+        ///Constructor
+        CameraLatch();
+
+        ///Turns the late latch on, needs the context
+        void create();
+
+        ///The shader variant of the camera block
+        void addDefines(ShaderDefines &defines);
+        void setupShader(Shader &s);
+
+        ///Right after the window events are polled
+        void inputPolled();
+
+        ///Right after the polled input moved the camera
+        void inputApplied();
+
+        ///The draws take the camera as it is now. The late latch uploads
+        ///and binds the camera block.
+        void latch(Camera &camera);
+
+        ///Once the draws of the frame are submitted
+        void submitted();
+
+        ///Prints the input to submit latency since the last call
+        void printStats();
+
+        ///Getters
+        bool isActive();
+        double getLastLatency();
+};
+
+///Constructor
+CameraLatch::CameraLatch()
+{
+    bActive = false;
+    uniformBuffer = 0;
+
+    bApplied = false;
+    lastLatency = 0.0;
+
+    latencySum = 0.0;
+    maxLatency = 0.0;
+    frames = 0;
+}
+
+void CameraLatch::create()
+{
+    bActive = true;
+
+    if(uniformBuffer == 0)
+    {
+        uniformBuffer = getRenderBackend()->createUniformBuffer(
+            sizeof(CameraBlock));
+    }
+
+    std::cout << "Late latch: the camera moves right before the draws"
+    << std::endl;
+}
+
+void CameraLatch::addDefines(ShaderDefines &defines)
+{
+    if(bActive)
+    {
+        defines.push_back("LATE_LATCH");
+    }
+}
+
+void CameraLatch::setupShader(Shader &s)
+{
+    if(bActive &&
+       !getRenderBackend()->setUniformBlockBinding(s.getID(), "CameraBlock",
+                                                   CAMERA_BLOCK_BINDING))
+    {
+        std::cout << "Couldn't find uniform block CameraBlock" << std::endl;
+    }
+}
+
+void CameraLatch::inputPolled()
+{
+    polledAt = Clock::now();
+}
+
+void CameraLatch::inputApplied()
+{
+    appliedAt = polledAt;
+
+    ///The first frame moves the camera before anything was polled
+    bApplied = polledAt != Clock::time_point();
+}
+
+void CameraLatch::latch(Camera &camera)
+{
+    drawnAt = appliedAt;
+
+    if(!bActive)
+    {
+        return;
+    }
+
+    block.viewMat = camera.GetViewMatrix();
+    block.projMat = camera.GetProjectionMatrix();
+
+    getRenderBackend()->updateUniformBuffer(uniformBuffer,
+                                            sizeof(CameraBlock), &block);
+    getRenderBackend()->bindUniformBuffer(CAMERA_BLOCK_BINDING,
+                                          uniformBuffer);
+}
+
+void CameraLatch::submitted()
+{
+    ///The first frames are drawn before any input
+    if(!bApplied)
+    {
+        return;
+    }
+
+    std::chrono::duration<double> latency = Clock::now() - drawnAt;
+    lastLatency = latency.count();
+
+    latencySum += lastLatency;
+    maxLatency = std::max(maxLatency, lastLatency);
+    frames++;
+}
+
+void CameraLatch::printStats()
+{
+    if(frames == 0)
+    {
+        return;
+    }
+
+    std::cout << "Input to submit: " << latencySum / frames * 1000.0
+    << " ms, " << maxLatency * 1000.0 << " ms at most"
+    << (bActive ? " (late latch)" : "") << std::endl;
+
+    latencySum = 0.0;
+    maxLatency = 0.0;
+    frames = 0;
+}
+
+bool CameraLatch::isActive()
+{
+    return bActive;
+}
+
+double CameraLatch::getLastLatency()
+{
+    return lastLatency;
+}
+
+#endif // CAMERALATCH_H_INCLUDED
@@ -0,0 +1,440 @@
+#ifndef CLUSTEREDLIGHTING_H_INCLUDED
+#define CLUSTEREDLIGHTING_H_INCLUDED
+
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+///GLM
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Shader.h"
+#include "RenderBackend.h"
+#include "ThreadPool.h"
+
+using namespace glm;
+
+///Clusters across, down and in depth, the same as in lighting.glsl
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+///Lights a cluster holds, the rest are left out and counted
+const int CLUSTER_MAX_LIGHTS = 128;
+
+///First of the three texture units the buffers are bound to
+const int CLUSTER_TEXTURE_UNIT = 8;
+
+///Point lights shaded with clustered forward lighting. The view volume of
+///the camera is split into a grid of clusters, tiles of the screen times
+///slices of depth whose thickness grows with the distance:
+///  slice = log(depth / near) / log(far / near) * CLUSTER_Z
+///Every frame the lights are moved to view space and assigned to the
+///clusters they can touch, one thread pool job per slice, no locks since a
+///job only writes its own slice. The lists are packed and uploaded as texture
+///buffers, GL 3.3 has no storage buffers:
+///  lights  - view space position and radius, color, two texels per light
+///  grid    - offset and count of every cluster in the list below
+///  indices - the lights of every cluster one after another
+///The fragment shader finds its cluster and only loops over those lights.
+class ClusteredLighting
+{
+    private:
+
+        ///World space position and radius, and color of every light
+        std::vector<vec4> lights;
+        std::vector<vec4> colors;
+
+        ///What is uploaded
+        std::vector<vec4> viewLights;
+        std::vector<unsigned int> grid;
+        std::vector<unsigned int> indices;
+
+        ///Slices every light touches this frame, last < first if none
+        std::vector<int> firstSlice;
+        std::vector<int> lastSlice;
+
+        ///CLUSTER_MAX_LIGHTS entries per cluster, filled by the jobs
+        std::vector<unsigned int> clusterLights;
+        std::vector<int> clusterCounts;
+
+        ///Texture buffers: lights, grid, indices
+        unsigned int buffers[3];
+        unsigned int textures[3];
+
+        ///Camera of the frame
+        mat4 proj;
+        float fNear;
+        float fFar;
+        bool bPerspective;
+
+        ThreadPool *pool;
+
+        ///Stats since the last print
+        double assignTimeSum;
+        unsigned long long references;
+        int maxReferences;
+        unsigned long long dropped;
+        int frames;
+
+        ///Private Functions
+        void assignSlice(int slice);
+        void upload();
+
+    public:
+
+        ///Constructor
+        ClusteredLighting();
+        ~ClusteredLighting();
+
+        ///Needs the context, pool can be NULL
+        void create(ThreadPool *pool);
+
+        ///Returns the index of the light
+        int addLight(const vec3 &position, float radius, const vec3 &color);
+        void setLightPosition(int i, const vec3 &position);
+
+        ///Assigns the lights to the clusters of the camera and uploads them
+        void update(Camera &camera);
+
+        ///Texture units of the buffers, once per program
+        void setupShader(Shader &s);
+
+        ///Binds the buffers and sets the uniforms of the frame
+        void bind(Shader &s, Camera &camera);
+
+        ///Prints the assignment time and the lights per cluster since the
+        ///last call
+        void printStats();
+
+        ///Getters
+        int getLightCount();
+};
+
+///Constructor
+ClusteredLighting::ClusteredLighting()
+{
+    for(int i=0; i<3; i++)
+    {
+        buffers[i] = 0;
+        textures[i] = 0;
+    }
+
+    fNear = 0.1f;
+    fFar = 100.0f;
+    bPerspective = true;
+    pool = NULL;
+
+    assignTimeSum = 0.0;
+    references = 0;
+    maxReferences = 0;
+    dropped = 0;
+    frames = 0;
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+    if(buffers[0])
+    {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+}
+
+void ClusteredLighting::create(ThreadPool *pool)
+{
+    this->pool = pool;
+
+    clusterLights.resize(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS);
+    clusterCounts.resize(CLUSTER_COUNT);
+    grid.resize(CLUSTER_COUNT * 2);
+
+    RenderBackend *backend = getRenderBackend();
+
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    for(int i=0; i<3; i++)
+    {
+        ///Every buffer has some data, the shader may fetch before the
+        ///first update
+        unsigned int zero[4] = {0, 0, 0, 0};
+        backend->bindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STREAM_DRAW);
+
+        backend->bindTextureTarget(GL_TEXTURE_BUFFER, 0, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    backend->bindTextureTarget(GL_TEXTURE_BUFFER, 0, 0);
+    backend->bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    std::cout << "Clustered lighting: " << lights.size() << " lights, "
+    << CLUSTER_X << "x" << CLUSTER_Y << "x" << CLUSTER_Z << " clusters"
+    << std::endl;
+}
+
+int ClusteredLighting::addLight(const vec3 &position, float radius,
+                                const vec3 &color)
+{
+    lights.push_back(vec4(position, radius));
+    colors.push_back(vec4(color, 0.0f));
+
+    viewLights.resize(lights.size() * 2);
+    firstSlice.resize(lights.size());
+    lastSlice.resize(lights.size());
+
+    return lights.size() - 1;
+}
+
+void ClusteredLighting::setLightPosition(int i, const vec3 &position)
+{
+    lights[i] = vec4(position, lights[i].w);
+}
+
+void ClusteredLighting::update(Camera &camera)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    mat4 view = camera.GetViewMatrix();
+    proj = camera.GetProjectionMatrix();
+    fNear = camera.GetNearPlane();
+    fFar = camera.GetFarPlane();
+    bPerspective = proj[2][3] != 0.0f;
+
+    ///To view space, and the slices every light reaches
+    float sliceScale = CLUSTER_Z / log(fFar / fNear);
+    for(unsigned int i=0; i<lights.size(); i++)
+    {
+        vec4 p = view * vec4(vec3(lights[i]), 1.0f);
+        float r = lights[i].w;
+
+        viewLights[i * 2] = vec4(vec3(p), r);
+        viewLights[i * 2 + 1] = colors[i];
+
+        float nearest = -p.z - r;
+        float farthest = -p.z + r;
+        if(farthest < fNear || nearest > fFar)
+        {
+            firstSlice[i] = 1;
+            lastSlice[i] = 0;
+            continue;
+        }
+
+        nearest = nearest > fNear ? nearest : fNear;
+        farthest = farthest < fFar ? farthest : fFar;
+        firstSlice[i] = (int)(log(nearest / fNear) * sliceScale);
+        lastSlice[i] = (int)(log(farthest / fNear) * sliceScale);
+        lastSlice[i] = lastSlice[i] < CLUSTER_Z ? lastSlice[i] : CLUSTER_Z - 1;
+    }
+
+    ///Only this is captured, so the function needs no heap
+    if(pool)
+    {
+        pool->run(CLUSTER_Z, [this](int slice)
+        {
+            assignSlice(slice);
+        });
+    }
+    else
+    {
+        for(int s=0; s<CLUSTER_Z; s++)
+        {
+            assignSlice(s);
+        }
+    }
+
+    ///Pack the lists
+    indices.clear();
+    for(int c=0; c<CLUSTER_COUNT; c++)
+    {
+        int count = clusterCounts[c];
+        if(count > CLUSTER_MAX_LIGHTS)
+        {
+            dropped += count - CLUSTER_MAX_LIGHTS;
+            count = CLUSTER_MAX_LIGHTS;
+        }
+
+        grid[c * 2] = indices.size();
+        grid[c * 2 + 1] = count;
+
+        const unsigned int *list = &clusterLights[c * CLUSTER_MAX_LIGHTS];
+        indices.insert(indices.end(), list, list + count);
+
+        maxReferences = count > maxReferences ? count : maxReferences;
+    }
+    references += indices.size();
+
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    assignTimeSum += elapsed.count();
+    frames++;
+
+    upload();
+}
+
+///Every light that reaches the slice goes into the tiles its box covers
+///between the planes of the slice. The box is projected at both planes, the
+///tiles are the ones under the widest of the two.
+void ClusteredLighting::assignSlice(int slice)
+{
+    float sliceNear = fNear * pow(fFar / fNear, (float)slice / CLUSTER_Z);
+    float sliceFar = fNear * pow(fFar / fNear, (float)(slice + 1) /
+                                               CLUSTER_Z);
+
+    int *counts = &clusterCounts[slice * CLUSTER_X * CLUSTER_Y];
+    unsigned int *lists = &clusterLights[slice * CLUSTER_X * CLUSTER_Y *
+                                         CLUSTER_MAX_LIGHTS];
+    for(int c=0; c<CLUSTER_X * CLUSTER_Y; c++)
+    {
+        counts[c] = 0;
+    }
+
+    for(unsigned int i=0; i<lights.size(); i++)
+    {
+        if(slice < firstSlice[i] || slice > lastSlice[i])
+        {
+            continue;
+        }
+
+        vec4 light = viewLights[i * 2];
+        float r = light.w;
+
+        ///Depth of the part of the box inside the slice
+        float d0 = -light.z - r > sliceNear ? -light.z - r : sliceNear;
+        float d1 = -light.z + r < sliceFar ? -light.z + r : sliceFar;
+
+        ///NDC of the box sides at both depths, w is 1 for orthographic
+        float w0 = bPerspective ? d0 : 1.0f;
+        float w1 = bPerspective ? d1 : 1.0f;
+        float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+        for(int side=-1; side<=1; side+=2)
+        {
+            float x = proj[0][0] * (light.x + side * r) + proj[3][0];
+            float y = proj[1][1] * (light.y + side * r) + proj[3][1];
+
+            minX = fminf(minX, fminf(x / w0, x / w1));
+            maxX = fmaxf(maxX, fmaxf(x / w0, x / w1));
+            minY = fminf(minY, fminf(y / w0, y / w1));
+            maxY = fmaxf(maxY, fmaxf(y / w0, y / w1));
+        }
+
+        if(maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        {
+            continue;
+        }
+
+        int x0 = (int)((fmaxf(minX, -1.0f) + 1.0f) * 0.5f * CLUSTER_X);
+        int x1 = (int)((fminf(maxX, 1.0f) + 1.0f) * 0.5f * CLUSTER_X);
+        int y0 = (int)((fmaxf(minY, -1.0f) + 1.0f) * 0.5f * CLUSTER_Y);
+        int y1 = (int)((fminf(maxY, 1.0f) + 1.0f) * 0.5f * CLUSTER_Y);
+        x1 = x1 < CLUSTER_X ? x1 : CLUSTER_X - 1;
+        y1 = y1 < CLUSTER_Y ? y1 : CLUSTER_Y - 1;
+
+        for(int y=y0; y<=y1; y++)
+        {
+            for(int x=x0; x<=x1; x++)
+            {
+                int c = y * CLUSTER_X + x;
+                if(counts[c] < CLUSTER_MAX_LIGHTS)
+                {
+                    lists[c * CLUSTER_MAX_LIGHTS + counts[c]] = i;
+                }
+                counts[c]++;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::upload()
+{
+    ///The index list may be empty, a buffer can't
+    if(indices.empty())
+    {
+        indices.push_back(0);
+    }
+
+    const void *data[3] = {&viewLights[0], &grid[0], &indices[0]};
+    const size_t sizes[3] = {
+        viewLights.size() * sizeof(vec4),
+        grid.size() * sizeof(unsigned int),
+        indices.size() * sizeof(unsigned int)
+    };
+
+    ///Orphaned every frame, the driver hands out new memory while the last
+    ///frame may still be reading the old one
+    RenderBackend *backend = getRenderBackend();
+    for(int i=0; i<3; i++)
+    {
+        backend->bindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+    }
+    backend->bindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::setupShader(Shader &s)
+{
+    s.use();
+    s.setInt("clusterLights", CLUSTER_TEXTURE_UNIT);
+    s.setInt("clusterGrid", CLUSTER_TEXTURE_UNIT + 1);
+    s.setInt("clusterIndices", CLUSTER_TEXTURE_UNIT + 2);
+}
+
+void ClusteredLighting::bind(Shader &s, Camera &camera)
+{
+    for(int i=0; i<3; i++)
+    {
+        getRenderBackend()->bindTextureTarget(GL_TEXTURE_BUFFER,
+                                              CLUSTER_TEXTURE_UNIT + i,
+                                              textures[i]);
+    }
+
+    s.use();
+    s.setMatrix4fv("invProjMat", inverse(proj));
+    s.setFloat("viewportWidth", camera.GetWidth());
+    s.setFloat("viewportHeight", camera.GetHeight());
+
+    ///slice = log(depth) * scale + bias
+    float scale = CLUSTER_Z / log(fFar / fNear);
+    s.setFloat("clusterScale", scale);
+    s.setFloat("clusterBias", -log(fNear) * scale);
+}
+
+void ClusteredLighting::printStats()
+{
+    if(frames == 0)
+    {
+        return;
+    }
+
+    std::cout << "Clustered lighting: " << lights.size() << " lights in "
+    << assignTimeSum / frames << " ms, "
+    << (double)references / frames / CLUSTER_COUNT
+    << " lights per cluster, " << maxReferences << " at most";
+    if(dropped)
+    {
+        std::cout << ", " << dropped / frames << " left out per frame";
+    }
+    std::cout << std::endl;
+
+    assignTimeSum = 0.0;
+    references = 0;
+    maxReferences = 0;
+    dropped = 0;
+    frames = 0;
+}
+
+int ClusteredLighting::getLightCount()
+{
+    return lights.size();
+}
+
+#endif // CLUSTEREDLIGHTING_H_INCLUDED
@@ -0,0 +1,368 @@
+#ifndef DYNAMICRESOLUTION_H_INCLUDED
+#define DYNAMICRESOLUTION_H_INCLUDED
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Camera.h"
+#include "RenderBackend.h"
+
+///Timer queries in flight, a result is read this many frames late at most
+const int DYNAMIC_RES_QUERIES = 4;
+
+///Smallest and largest share of the window size the scene is drawn at
+const float DYNAMIC_RES_MIN_SCALE = 0.5f;
+const float DYNAMIC_RES_MAX_SCALE = 1.0f;
+
+///Gains of the controller, on the error as a share of the budget
+const float DYNAMIC_RES_KP = 0.15f;
+const float DYNAMIC_RES_KI = 0.05f;
+const float DYNAMIC_RES_KD = 0.05f;
+
+///Aim a bit under the budget so a spike doesn't miss it right away
+const float DYNAMIC_RES_HEADROOM = 0.9f;
+
+///Longer than this isn't a frame but a driver hiccup, ms
+const float DYNAMIC_RES_MAX_SAMPLE = 1000.0f;
+
+///Draws the scene into an offscreen target at a share of the window size and
+///stretches it over the window. The share (scale) follows the GPU time of the
+///frames, measured with timer queries, to keep it under a budget:
+///  error = (target - gpu time) / target
+///  scale += KP * (error - last error) + KI * error
+///           + KD * (error - 2 * last error + the one before)
+///The incremental form of a PID, clamping the scale can't wind it up. Time
+///goes with the pixels, the square of the scale, so a small step is enough.
+///The target is as big as the window, a smaller scale only uses a corner.
+///Without timer queries the whole frame time is used instead.
+class DynamicResolution
+{
+    private:
+
+        ///Render target
+        unsigned int framebuffer;
+        unsigned int colorBuffer;
+        unsigned int depthBuffer;
+        int iWindowWidth;
+        int iWindowHeight;
+
+        ///Scene size of the current frame
+        int iWidth;
+        int iHeight;
+
+        ///Timer queries, [oldest, oldest + inFlight) are waiting for results
+        bool bTimerQueries;
+        unsigned int queries[DYNAMIC_RES_QUERIES];
+        int oldest;
+        int inFlight;
+
+        float fBudget;
+        float fScale;
+        float fGpuTime;
+        float errors[2];
+
+        ///Per frame log and averages for the report
+        FILE *log;
+        unsigned long long frame;
+        float fScaleSum;
+        float fGpuTimeSum;
+        int iSamples;
+
+        ///Private Functions
+        void createTarget(int width, int height);
+        void deleteTarget();
+        void readQueries();
+        void control(float gpuTime);
+
+    public:
+
+        ///Constructor
+        DynamicResolution();
+        ~DynamicResolution();
+
+        ///budget is the GPU time of a frame in ms, logPath a CSV file of
+        ///every frame's scale and time, or NULL
+        void create(int width, int height, float budget, const char *logPath,
+                    bool bTimerQueries);
+
+        ///The window changed size
+        void resize(int width, int height);
+
+        ///Before the scene is drawn: picks the scale, binds the target and
+        ///gives the camera its size. frameTime is the last frame's, in
+        ///seconds, only used without timer queries.
+        void beginFrame(Camera &camera, float frameTime);
+
+        ///After the scene is drawn: stretches it over the window
+        void endFrame();
+
+        ///Prints the average scale and GPU time since the last call
+        void printStats();
+
+        ///Getters
+        int getWidth();
+        int getHeight();
+        float getScale();
+};
+
+///Constructor
+DynamicResolution::DynamicResolution()
+{
+    framebuffer = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+    iWindowWidth = 0;
+    iWindowHeight = 0;
+    iWidth = 0;
+    iHeight = 0;
+
+    bTimerQueries = false;
+    for(int i=0; i<DYNAMIC_RES_QUERIES; i++)
+    {
+        queries[i] = 0;
+    }
+    oldest = 0;
+    inFlight = 0;
+
+    fBudget = 16.6f;
+    fScale = DYNAMIC_RES_MAX_SCALE;
+    fGpuTime = 0.0f;
+    errors[0] = errors[1] = 0.0f;
+
+    log = NULL;
+    frame = 0;
+    fScaleSum = 0.0f;
+    fGpuTimeSum = 0.0f;
+    iSamples = 0;
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    deleteTarget();
+
+    if(queries[0])
+    {
+        glDeleteQueries(DYNAMIC_RES_QUERIES, queries);
+    }
+
+    if(log)
+    {
+        fclose(log);
+    }
+}
+
+void DynamicResolution::create(int width, int height, float budget,
+                               const char *logPath, bool bTimerQueries)
+{
+    fBudget = budget;
+    this->bTimerQueries = bTimerQueries;
+
+    if(bTimerQueries)
+    {
+        glGenQueries(DYNAMIC_RES_QUERIES, queries);
+    }
+    createTarget(width, height);
+
+    if(logPath)
+    {
+        log = fopen(logPath, "w");
+        if(log)
+        {
+            fprintf(log, "frame,gpu_ms,scale,width,height\n");
+        }
+        else
+        {
+            std::cout << "Couldn't open " << logPath << std::endl;
+        }
+    }
+
+    std::cout << "Dynamic resolution for " << budget << " ms of "
+    << (bTimerQueries ? "GPU time" : "frame time") << std::endl;
+}
+
+void DynamicResolution::createTarget(int width, int height)
+{
+    iWindowWidth = width;
+    iWindowHeight = height;
+
+    glGenFramebuffers(1, &framebuffer);
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    getRenderBackend()->bindRenderbuffer(colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, colorBuffer);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    getRenderBackend()->bindRenderbuffer(depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depthBuffer);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Dynamic resolution target of " << width << "x"
+        << height << " is incomplete" << std::endl;
+    }
+
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::deleteTarget()
+{
+    if(framebuffer)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = 0;
+    }
+}
+
+void DynamicResolution::resize(int width, int height)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    deleteTarget();
+    createTarget(width, height);
+}
+
+///Takes the results that are ready, the newest one drives the controller
+void DynamicResolution::readQueries()
+{
+    while(inFlight > 0)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if(!available)
+        {
+            return;
+        }
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+
+        oldest = (oldest + 1) % DYNAMIC_RES_QUERIES;
+        inFlight--;
+
+        float ms = nanoseconds / 1000000.0f;
+        if(ms < DYNAMIC_RES_MAX_SAMPLE)
+        {
+            control(ms);
+        }
+    }
+}
+
+void DynamicResolution::control(float gpuTime)
+{
+    float target = fBudget * DYNAMIC_RES_HEADROOM;
+    float error = (target - gpuTime) / target;
+
+    fScale += DYNAMIC_RES_KP * (error - errors[0]) + DYNAMIC_RES_KI * error +
+              DYNAMIC_RES_KD * (error - 2.0f * errors[0] + errors[1]);
+
+    fScale = fScale < DYNAMIC_RES_MIN_SCALE ? DYNAMIC_RES_MIN_SCALE :
+             fScale > DYNAMIC_RES_MAX_SCALE ? DYNAMIC_RES_MAX_SCALE : fScale;
+
+    errors[1] = errors[0];
+    errors[0] = error;
+    fGpuTime = gpuTime;
+
+    fScaleSum += fScale;
+    fGpuTimeSum += gpuTime;
+    iSamples++;
+}
+
+void DynamicResolution::beginFrame(Camera &camera, float frameTime)
+{
+    if(bTimerQueries)
+    {
+        readQueries();
+    }
+    else if(frameTime > 0.0f && frameTime * 1000.0f < DYNAMIC_RES_MAX_SAMPLE)
+    {
+        control(frameTime * 1000.0f);
+    }
+
+    iWidth = std::max(1, (int)(iWindowWidth * fScale + 0.5f));
+    iHeight = std::max(1, (int)(iWindowHeight * fScale + 0.5f));
+
+    if(log)
+    {
+        fprintf(log, "%llu,%.3f,%.4f,%d,%d\n", frame, fGpuTime, fScale,
+                iWidth, iHeight);
+    }
+    frame++;
+
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, iWidth, iHeight);
+
+    ///Projected sizes, like the LODs pick, are in the pixels drawn
+    camera.SetViewportSize(iWidth, iHeight);
+
+    ///Every query busy, this frame goes unmeasured
+    if(bTimerQueries && inFlight < DYNAMIC_RES_QUERIES)
+    {
+        glBeginQuery(GL_TIME_ELAPSED,
+                     queries[(oldest + inFlight) % DYNAMIC_RES_QUERIES]);
+    }
+}
+
+void DynamicResolution::endFrame()
+{
+    if(bTimerQueries && inFlight < DYNAMIC_RES_QUERIES)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        inFlight++;
+    }
+
+    getRenderBackend()->bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    getRenderBackend()->bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, iWidth, iHeight, 0, 0, iWindowWidth,
+                      iWindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+}
+
+void DynamicResolution::printStats()
+{
+    if(iSamples == 0)
+    {
+        return;
+    }
+
+    std::cout << "Dynamic resolution: scale " << fScaleSum / iSamples
+    << " (" << iWidth << "x" << iHeight << " now), "
+    << (bTimerQueries ? "GPU " : "frame ")
+    << fGpuTimeSum / iSamples << " ms of " << fBudget << " ms" << std::endl;
+
+    fScaleSum = 0.0f;
+    fGpuTimeSum = 0.0f;
+    iSamples = 0;
+}
+
+int DynamicResolution::getWidth()
+{
+    return iWidth;
+}
+
+int DynamicResolution::getHeight()
+{
+    return iHeight;
+}
+
+float DynamicResolution::getScale()
+{
+    return fScale;
+}
+
+#endif // DYNAMICRESOLUTION_H_INCLUDED
@@ -0,0 +1,226 @@
+#ifndef FILEWATCHER_H_INCLUDED
+#define FILEWATCHER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+///How often the files are checked when inotify is not available
+const float WATCH_POLL_INTERVAL = 0.5f;
+
+///Tells which of a set of files changed since the last call to poll().
+///Uses inotify on Linux and compares modification times everywhere else,
+///poll() never blocks.
+class FileWatcher
+{
+    private:
+
+        struct WatchedFile
+        {
+            std::string path;
+            std::string directory;
+            std::string name;
+            time_t modified;
+            int watch;
+            bool bChanged;
+        };
+
+        std::vector<WatchedFile> files;
+
+        int inotifyFd;
+        std::chrono::steady_clock::time_point lastPoll;
+
+        ///Private Functions
+        static time_t getModifiedTime(const std::string &path);
+        void readEvents();
+        void checkModifiedTimes();
+
+    public:
+
+        ///Constructor
+        FileWatcher();
+        ~FileWatcher();
+
+        ///Starts watching a file, returns its index. Adding the same path
+        ///twice only watches it once.
+        int addFile(const std::string &path);
+
+        ///Getters
+        bool usesInotify();
+
+        ///Fills changed with the files written since the last call, true if
+        ///there is any
+        bool poll(std::vector<std::string> &changed);
+};
+
+///Constructor
+FileWatcher::FileWatcher()
+{
+    inotifyFd = -1;
+    lastPoll = std::chrono::steady_clock::now();
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd < 0)
+    {
+        std::cout << "inotify not available, polling the files instead"
+        << std::endl;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if(inotifyFd >= 0)
+    {
+        close(inotifyFd);
+    }
+#endif
+}
+
+time_t FileWatcher::getModifiedTime(const std::string &path)
+{
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0)
+    {
+        return 0;
+    }
+    return info.st_mtime;
+}
+
+int FileWatcher::addFile(const std::string &path)
+{
+    for(unsigned int i=0; i<files.size(); i++)
+    {
+        if(files[i].path == path)
+        {
+            return i;
+        }
+    }
+
+    WatchedFile file;
+    file.path = path;
+    file.modified = getModifiedTime(path);
+    file.watch = -1;
+    file.bChanged = false;
+
+    size_t slash = path.find_last_of("/\\");
+    file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+#ifdef __linux__
+    ///Editors often save to a temporary file and rename it over the old one,
+    ///so the directory is watched rather than the file
+    if(inotifyFd >= 0)
+    {
+        file.watch = inotify_add_watch(inotifyFd, file.directory.c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO |
+                                       IN_CREATE);
+        if(file.watch < 0)
+        {
+            std::cout << "Couldn't watch " << file.directory << std::endl;
+        }
+    }
+#endif
+
+    files.push_back(file);
+    return (int)files.size() - 1;
+}
+
+bool FileWatcher::usesInotify()
+{
+    return inotifyFd >= 0;
+}
+
+void FileWatcher::readEvents()
+{
+#ifdef __linux__
+    char buffer[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    while(true)
+    {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0)
+        {
+            ///EAGAIN, nothing left to read
+            return;
+        }
+
+        for(char *p = buffer; p < buffer + length; )
+        {
+            const struct inotify_event *event = (struct inotify_event*)p;
+
+            for(unsigned int i=0; i<files.size(); i++)
+            {
+                if(files[i].watch == event->wd && event->len > 0 &&
+                   files[i].name == event->name)
+                {
+                    files[i].bChanged = true;
+                }
+            }
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+}
+
+void FileWatcher::checkModifiedTimes()
+{
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+
+    if(std::chrono::duration<float>(now - lastPoll).count() <
+       WATCH_POLL_INTERVAL)
+    {
+        return;
+    }
+    lastPoll = now;
+
+    for(unsigned int i=0; i<files.size(); i++)
+    {
+        time_t modified = getModifiedTime(files[i].path);
+        if(modified != files[i].modified)
+        {
+            files[i].modified = modified;
+            files[i].bChanged = true;
+        }
+    }
+}
+
+bool FileWatcher::poll(std::vector<std::string> &changed)
+{
+    changed.clear();
+
+    if(inotifyFd >= 0)
+    {
+        readEvents();
+    }
+    else
+    {
+        checkModifiedTimes();
+    }
+
+    for(unsigned int i=0; i<files.size(); i++)
+    {
+        if(files[i].bChanged)
+        {
+            files[i].bChanged = false;
+            changed.push_back(files[i].path);
+        }
+    }
+
+    return !changed.empty();
+}
+
+#endif // FILEWATCHER_H_INCLUDED
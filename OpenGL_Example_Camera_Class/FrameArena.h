@@ -0,0 +1,269 @@
+#ifndef FRAMEARENA_H_INCLUDED
+#define FRAMEARENA_H_INCLUDED
+
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+///Bytes of each of the two buffers of every thread's arena
+const size_t FRAME_ARENA_SIZE = 1 << 20;
+
+///Alignment of everything the arena hands out unless asked for more
+const size_t FRAME_ARENA_ALIGN = 16;
+
+///\////////////////////////////////HEAP COUNTER/////////////////////////////////
+
+///Every operator new of the program goes through here, so a frame can be
+///checked for heap allocations. The project is one translation unit, so
+///replacing the global operators in a header defines them once.
+std::atomic<unsigned long long> heapAllocations(0);
+
+void *operator new(size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(size > 0 ? size : 1);
+    if(!p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+///Heap allocations of every thread since the program started
+unsigned long long getHeapAllocations()
+{
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+///\/////////////////////////////////FRAME ARENA/////////////////////////////////
+
+///A bump allocator for data that only lives for a frame or two: allocating is
+///moving an offset, freeing is resetting it at the start of a frame. Every
+///thread has its own arena, so nothing is shared or locked.
+///There are two buffers and frames alternate between them, so what a frame
+///allocates stays valid until the frame after it ends. That is for data
+///still in flight, like a command list the next frame consumes.
+///Running out of room falls back to the heap, which the heap counter sees,
+///and the buffer grows by what didn't fit the next time it is recycled, so
+///only the first frames of a bigger load touch the heap.
+class FrameArena
+{
+    private:
+
+        std::vector<char> buffers[2];
+        std::vector<void*> overflow[2];
+
+        ///Bytes of each buffer that went to the heap, what it grows by
+        size_t overflowBytes[2];
+        size_t offset;
+        size_t peak;
+        unsigned long long frame;
+        int current;
+
+        ///Frame all the arenas are in, moved by the render thread
+        static std::atomic<unsigned long long> globalFrame;
+
+        ///Private Functions
+        void catchUp();
+
+    public:
+
+        ///Constructor
+        FrameArena(size_t size = FRAME_ARENA_SIZE);
+        ~FrameArena();
+
+        ///bytes with at least that alignment, a power of two
+        void *allocate(size_t bytes, size_t alignment = FRAME_ARENA_ALIGN);
+
+        template<class T>
+        T *allocateArray(size_t count);
+
+        ///Getters
+        size_t getUsed();
+        size_t getPeak();
+        size_t getCapacity();
+
+        ///The arena of the calling thread
+        static FrameArena &get();
+
+        ///Called by the render thread when a frame starts, every arena
+        ///recycles its older buffer the next time it allocates
+        static void nextFrame();
+};
+
+std::atomic<unsigned long long> FrameArena::globalFrame(0);
+
+///Constructor
+FrameArena::FrameArena(size_t size)
+{
+    buffers[0].resize(size);
+    buffers[1].resize(size);
+
+    overflowBytes[0] = 0;
+    overflowBytes[1] = 0;
+
+    offset = 0;
+    peak = 0;
+    frame = globalFrame.load(std::memory_order_relaxed);
+    current = frame & 1;
+}
+
+FrameArena::~FrameArena()
+{
+    for(int b=0; b<2; b++)
+    {
+        for(unsigned int i=0; i<overflow[b].size(); i++)
+        {
+            free(overflow[b][i]);
+        }
+    }
+}
+
+///Switches to the buffer of the current frame, what was allocated in it two
+///frames ago isn't in use anymore. A buffer that ran out grows now, nothing
+///in it is still used.
+void FrameArena::catchUp()
+{
+    unsigned long long now = globalFrame.load(std::memory_order_relaxed);
+    if(now == frame)
+    {
+        return;
+    }
+
+    frame = now;
+    current = now & 1;
+    offset = 0;
+
+    for(unsigned int i=0; i<overflow[current].size(); i++)
+    {
+        free(overflow[current][i]);
+    }
+    overflow[current].clear();
+
+    if(overflowBytes[current] > 0)
+    {
+        size_t size = buffers[current].size() + overflowBytes[current];
+        std::vector<char>(size).swap(buffers[current]);
+        overflowBytes[current] = 0;
+
+        std::cout << "Frame arena grown to " << size << " bytes" << std::endl;
+    }
+}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment)
+{
+    catchUp();
+
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+
+    if(start + bytes > buffers[current].size())
+    {
+        if(overflow[current].empty())
+        {
+            std::cout << "Frame arena full, " << bytes
+            << " bytes go to the heap" << std::endl;
+        }
+
+        ///malloc aligns to 16 on the platforms we build for
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        void *p = malloc(bytes > 0 ? bytes : 1);
+        overflow[current].push_back(p);
+        overflowBytes[current] += bytes + alignment;
+        return p;
+    }
+
+    offset = start + bytes;
+    peak = offset > peak ? offset : peak;
+
+    return &buffers[current][start];
+}
+
+template<class T>
+T *FrameArena::allocateArray(size_t count)
+{
+    size_t alignment = alignof(T) > FRAME_ARENA_ALIGN ? alignof(T) :
+                                                        FRAME_ARENA_ALIGN;
+    return static_cast<T*>(allocate(count * sizeof(T), alignment));
+}
+
+size_t FrameArena::getUsed()
+{
+    catchUp();
+    return offset;
+}
+
+size_t FrameArena::getPeak()
+{
+    return peak;
+}
+
+size_t FrameArena::getCapacity()
+{
+    return std::max(buffers[0].size(), buffers[1].size());
+}
+
+FrameArena &FrameArena::get()
+{
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+void FrameArena::nextFrame()
+{
+    globalFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+///\/////////////////////////////////STL ALLOCATOR///////////////////////////////
+
+///Lets STL containers live in the arena of the thread that fills them. Freeing
+///does nothing, the memory comes back when the frame ends, so the container
+///must not outlive the frame after the one it was filled in.
+template<class T>
+class FrameAllocator
+{
+    public:
+
+        typedef T value_type;
+
+        ///Constructor
+        FrameAllocator() {}
+
+        template<class U>
+        FrameAllocator(const FrameAllocator<U> &) {}
+
+        T *allocate(size_t count)
+        {
+            return FrameArena::get().allocateArray<T>(count);
+        }
+
+        void deallocate(T *, size_t) {}
+};
+
+template<class T, class U>
+bool operator==(const FrameAllocator<T> &, const FrameAllocator<U> &)
+{
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const FrameAllocator<T> &, const FrameAllocator<U> &)
+{
+    return false;
+}
+
+///A vector that lives in the frame arena
+template<class T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+#endif // FRAMEARENA_H_INCLUDED
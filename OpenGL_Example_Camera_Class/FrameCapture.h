@@ -0,0 +1,731 @@
+#ifndef FRAMECAPTURE_H_INCLUDED
+#define FRAMECAPTURE_H_INCLUDED
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "RenderBackend.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+///Pixel buffers the frames are read back into, a frame is mapped this many
+///frames after it was drawn
+const int CAPTURE_RING_SIZE = 3;
+
+///Frames read back and waiting for the encoder
+const int CAPTURE_QUEUE_SIZE = 4;
+
+///Frame rate written in Y4M headers, and of the fixed clock while capturing
+const int CAPTURE_FPS = 60;
+
+enum Capture_Format
+{
+    CAPTURE_RAW,
+    CAPTURE_Y4M,
+    CAPTURE_PPM
+};
+
+///Renders into an offscreen framebuffer and saves every frame without ever
+///waiting on glReadPixels. Each frame is read into the next pixel buffer of a
+///ring with a fence behind it, and is only mapped once the fence has
+///signaled, CAPTURE_RING_SIZE frames later at the most. Mapped frames are
+///copied into a queue a worker thread writes out:
+///  raw   RGB24 frames one after the other, top row first
+///  y4m   YUV 4:2:0 (BT.601) with a YUV4MPEG2 header, what ffmpeg and x264 read
+///  ppm   one P6 image per frame, a file per frame if the path has a %d
+///A path starting with | is run as a command and gets the frames on its stdin.
+///If the command exits early the rest of the frames are dropped.
+class FrameCapture
+{
+    private:
+
+        int iWidth;
+        int iHeight;
+        Capture_Format format;
+
+        ///Render target
+        unsigned int framebuffer;
+        unsigned int colorBuffer;
+        unsigned int depthBuffer;
+
+        ///Readback ring, slots [oldest, oldest + inFlight) are in use
+        unsigned int pixelBuffers[CAPTURE_RING_SIZE];
+        GLsync fences[CAPTURE_RING_SIZE];
+        int oldest;
+        int inFlight;
+
+        ///Encoder queue, frames [encoded, queued) are waiting
+        std::vector<unsigned char> frames[CAPTURE_QUEUE_SIZE];
+        std::vector<unsigned char> yuv;
+        unsigned long long queued;
+        unsigned long long encoded;
+        std::mutex mutex;
+        std::condition_variable frameQueued;
+        std::condition_variable frameEncoded;
+        std::thread worker;
+        bool bStop;
+
+        ///Output
+        std::string path;
+        FILE *file;
+        bool bPipe;
+        bool bSequence;
+
+        ///Set by the worker once a write failed, nothing more is written
+        bool bBroken;
+
+        ///Statistics
+        std::chrono::steady_clock::time_point start;
+        unsigned long long bytesWritten;
+        unsigned int readbackWaits;
+        unsigned int encoderWaits;
+        unsigned int skippedFrames;
+        double encodeSeconds;
+
+        ///Private Functions
+        bool collect(bool bWaitOldest);
+        void queueFrame(const unsigned char *pixels);
+        void workerLoop();
+        size_t writeFrame(const std::vector<unsigned char> &rgb,
+                          unsigned long long number);
+        void convertToYUV(const std::vector<unsigned char> &rgb);
+
+    public:
+
+        ///Constructor
+        FrameCapture();
+        ~FrameCapture();
+
+        ///Frames of width x height go to path, false if the framebuffer or
+        ///the output couldn't be created
+        bool create(int width, int height, const std::string &path,
+                    Capture_Format format);
+
+        ///Draw into the capture framebuffer from now on
+        void bind();
+
+        ///After the frame is drawn, starts reading it back
+        void capture();
+
+        ///Shows the frame in the window, scaled to its size
+        void blitToWindow(int width, int height);
+
+        ///Writes every frame still in flight and closes the output
+        void finish();
+
+        void printStats();
+
+        ///Getters
+        int getWidth();
+        int getHeight();
+        unsigned long long getFrameCount();
+
+        ///raw, y4m or ppm, from the name or else from the extension of path
+        static Capture_Format getFormat(const char *name,
+                                        const std::string &path);
+        static const char *getFormatName(Capture_Format f);
+
+        ///True if path has a single %d (flags and width allowed, like
+        ///%05d) and no other conversion, so it is safe to format
+        static bool isSequencePath(const std::string &path);
+};
+
+///Constructor
+FrameCapture::FrameCapture()
+{
+    iWidth = 0;
+    iHeight = 0;
+    format = CAPTURE_RAW;
+
+    framebuffer = 0;
+    colorBuffer = 0;
+    depthBuffer = 0;
+
+    for(int i=0; i<CAPTURE_RING_SIZE; i++)
+    {
+        pixelBuffers[i] = 0;
+        fences[i] = 0;
+    }
+    oldest = 0;
+    inFlight = 0;
+
+    queued = 0;
+    encoded = 0;
+    bStop = false;
+
+    file = NULL;
+    bPipe = false;
+    bSequence = false;
+    bBroken = false;
+
+    bytesWritten = 0;
+    readbackWaits = 0;
+    encoderWaits = 0;
+    skippedFrames = 0;
+    encodeSeconds = 0.0;
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+
+    if(framebuffer)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+    }
+}
+
+bool FrameCapture::create(int width, int height, const std::string &path,
+                          Capture_Format format)
+{
+    iWidth = width;
+    iHeight = height;
+    this->format = format;
+    this->path = path;
+
+    ///4:2:0 needs whole 2x2 blocks
+    if(format == CAPTURE_Y4M && (width % 2 || height % 2))
+    {
+        std::cout << "Y4M capture needs an even size, not " << width << "x"
+        << height << std::endl;
+        return false;
+    }
+
+    bPipe = !path.empty() && path[0] == '|';
+    bSequence = !bPipe && format == CAPTURE_PPM &&
+                path.find('%') != std::string::npos;
+
+    ///The path is the format string of the file names
+    if(bSequence && !isSequencePath(path))
+    {
+        std::cout << "A capture sequence needs a single %d in " << path
+        << std::endl;
+        return false;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    getRenderBackend()->bindRenderbuffer(colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, colorBuffer);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    getRenderBackend()->bindRenderbuffer(depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depthBuffer);
+
+    bool bComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+                     GL_FRAMEBUFFER_COMPLETE;
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(!bComplete)
+    {
+        std::cout << "Capture framebuffer of " << width << "x" << height
+        << " is incomplete" << std::endl;
+        return false;
+    }
+
+    unsigned int frameBytes = width * height * 3;
+
+    glGenBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+    for(int i=0; i<CAPTURE_RING_SIZE; i++)
+    {
+        getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+    }
+    getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    ///Everything the worker needs is allocated up front
+    for(int i=0; i<CAPTURE_QUEUE_SIZE; i++)
+    {
+        frames[i].resize(frameBytes);
+    }
+    if(format == CAPTURE_Y4M)
+    {
+        yuv.resize(width * height * 3 / 2);
+    }
+
+    if(bPipe)
+    {
+#ifndef _WIN32
+        ///A command that exits early would kill us on the next write, the
+        ///write fails with EPIPE instead
+        signal(SIGPIPE, SIG_IGN);
+#endif
+        file = popen(path.c_str() + 1, "w");
+    }
+    else if(!bSequence)
+    {
+        file = fopen(path.c_str(), "wb");
+    }
+
+    if(!bSequence && !file)
+    {
+        std::cout << "Couldn't open " << path << " for the capture"
+        << std::endl;
+        return false;
+    }
+
+    ///The stream header counts in the size like the FRAME of every frame
+    if(format == CAPTURE_Y4M)
+    {
+        int header = fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 "
+                             "C420jpeg\n", width, height, CAPTURE_FPS);
+        bytesWritten += header > 0 ? header : 0;
+    }
+
+    bStop = false;
+    worker = std::thread(&FrameCapture::workerLoop, this);
+
+    std::cout << "Capturing " << width << "x" << height << " "
+    << getFormatName(format) << " to " << path << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    return true;
+}
+
+void FrameCapture::bind()
+{
+    getRenderBackend()->bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, iWidth, iHeight);
+}
+
+void FrameCapture::capture()
+{
+    ///Hand over whatever the GPU has finished, without waiting
+    collect(false);
+
+    ///Every pixel buffer still in use, only now does a frame wait
+    if(inFlight == CAPTURE_RING_SIZE)
+    {
+        readbackWaits++;
+        collect(true);
+    }
+
+    ///The wait failed, the ring is still full: this frame isn't read back
+    if(inFlight == CAPTURE_RING_SIZE)
+    {
+        skippedFrames++;
+        return;
+    }
+
+    int slot = (oldest + inFlight) % CAPTURE_RING_SIZE;
+
+    getRenderBackend()->bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    ///Into the buffer, glReadPixels returns right away
+    glReadPixels(0, 0, iWidth, iHeight, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    inFlight++;
+}
+
+///Maps the frames whose fence has signaled, oldest first. With bWaitOldest
+///the oldest one is waited for, however long it takes. False if waiting
+///failed.
+bool FrameCapture::collect(bool bWaitOldest)
+{
+    while(inFlight > 0)
+    {
+        GLuint64 timeout = bWaitOldest ? 1000000000ull : 0;
+        GLenum result = glClientWaitSync(fences[oldest],
+                                         GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+
+        ///Big frames on a software rasterizer can take that long
+        if(result == GL_TIMEOUT_EXPIRED && bWaitOldest)
+        {
+            std::cout << "Capture readback is slow, still waiting"
+            << std::endl;
+            continue;
+        }
+
+        if(result == GL_WAIT_FAILED)
+        {
+            std::cout << "Capture readback failed" << std::endl;
+            return false;
+        }
+
+        if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        {
+            return true;
+        }
+        bWaitOldest = false;
+
+        glDeleteSync(fences[oldest]);
+        fences[oldest] = 0;
+
+        getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER,
+                                       pixelBuffers[oldest]);
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        iWidth * iHeight * 3,
+                                        GL_MAP_READ_BIT);
+        if(pixels)
+        {
+            queueFrame(static_cast<const unsigned char*>(pixels));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        getRenderBackend()->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        oldest = (oldest + 1) % CAPTURE_RING_SIZE;
+        inFlight--;
+    }
+
+    return true;
+}
+
+///Copies a frame into the encoder queue, waits if the encoder is behind
+void FrameCapture::queueFrame(const unsigned char *pixels)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if(queued - encoded == CAPTURE_QUEUE_SIZE)
+    {
+        encoderWaits++;
+        frameEncoded.wait(lock, [&]{
+            return queued - encoded < CAPTURE_QUEUE_SIZE; });
+    }
+
+    ///The encoder doesn't touch this frame until queued moves past it
+    std::vector<unsigned char> &frame = frames[queued % CAPTURE_QUEUE_SIZE];
+    lock.unlock();
+
+    memcpy(&frame[0], pixels, frame.size());
+
+    lock.lock();
+    queued++;
+    frameQueued.notify_one();
+}
+
+void FrameCapture::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true)
+    {
+        frameQueued.wait(lock, [&]{ return bStop || encoded < queued; });
+
+        if(encoded == queued)
+        {
+            return;
+        }
+
+        unsigned long long number = encoded;
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point t0 =
+            std::chrono::steady_clock::now();
+
+        size_t written = writeFrame(frames[number % CAPTURE_QUEUE_SIZE],
+                                    number);
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - t0;
+
+        lock.lock();
+        encodeSeconds += elapsed.count();
+        bytesWritten += written;
+        encoded++;
+        frameEncoded.notify_one();
+    }
+}
+
+///Writes one frame and returns the bytes written, OpenGL gives the bottom
+///row first
+size_t FrameCapture::writeFrame(const std::vector<unsigned char> &rgb,
+                                unsigned long long number)
+{
+    FILE *out = file;
+
+    if(bBroken)
+    {
+        return 0;
+    }
+
+    if(bSequence)
+    {
+        char name[1024];
+        snprintf(name, sizeof(name), path.c_str(), (int)number);
+        out = fopen(name, "wb");
+        if(!out)
+        {
+            std::cout << "Couldn't open " << name << std::endl;
+            return 0;
+        }
+    }
+
+    size_t expected = 0;
+    size_t written = 0;
+
+    if(format == CAPTURE_Y4M)
+    {
+        convertToYUV(rgb);
+
+        written += fwrite("FRAME\n", 1, 6, out);
+        written += fwrite(&yuv[0], 1, yuv.size(), out);
+        expected = 6 + yuv.size();
+    }
+    else
+    {
+        if(format == CAPTURE_PPM)
+        {
+            int header = fprintf(out, "P6\n%d %d\n255\n", iWidth, iHeight);
+            written += header > 0 ? header : 0;
+            expected += header;
+        }
+
+        size_t row = iWidth * 3;
+        for(int y=iHeight-1; y>=0; y--)
+        {
+            written += fwrite(&rgb[y * row], 1, row, out);
+        }
+        expected += row * iHeight;
+    }
+
+    if(bSequence)
+    {
+        fclose(out);
+    }
+
+    if(written != expected)
+    {
+        std::cout << "Couldn't write frame " << number << " to " << path
+        << std::endl;
+
+        ///A command that exited or a full disk, the next frame won't do
+        ///better. A file of the sequence only loses itself.
+        bBroken = !bSequence;
+        if(bBroken)
+        {
+            std::cout << "The rest of the frames are dropped" << std::endl;
+        }
+    }
+
+    return written;
+}
+
+///Full range BT.601, the chroma of every 2x2 block averaged
+void FrameCapture::convertToYUV(const std::vector<unsigned char> &rgb)
+{
+    unsigned char *planeY = &yuv[0];
+    unsigned char *planeU = planeY + iWidth * iHeight;
+    unsigned char *planeV = planeU + iWidth * iHeight / 4;
+
+    for(int y=0; y<iHeight; y+=2)
+    {
+        ///Rows of the block, top first
+        const unsigned char *rows[2] = {&rgb[(iHeight - 1 - y) * iWidth * 3],
+                                        &rgb[(iHeight - 2 - y) * iWidth * 3]};
+
+        for(int x=0; x<iWidth; x+=2)
+        {
+            int sumU = 0;
+            int sumV = 0;
+
+            for(int dy=0; dy<2; dy++)
+            {
+                for(int dx=0; dx<2; dx++)
+                {
+                    const unsigned char *p = rows[dy] + (x + dx) * 3;
+                    int r = p[0];
+                    int g = p[1];
+                    int b = p[2];
+
+                    ///Fixed point, weights times 256
+                    planeY[(y + dy) * iWidth + x + dx] =
+                        (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+                    sumU += -43 * r - 85 * g + 128 * b;
+                    sumV += 128 * r - 107 * g - 21 * b;
+                }
+            }
+
+            int i = (y / 2) * (iWidth / 2) + x / 2;
+            planeU[i] = (unsigned char)(128 + ((sumU + 512) >> 10));
+            planeV[i] = (unsigned char)(128 + ((sumV + 512) >> 10));
+        }
+    }
+}
+
+void FrameCapture::blitToWindow(int width, int height)
+{
+    getRenderBackend()->bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    getRenderBackend()->bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, iWidth, iHeight, 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+}
+
+void FrameCapture::finish()
+{
+    if(!worker.joinable())
+    {
+        return;
+    }
+
+    ///The last frames are waited for, those that can't be are dropped
+    while(inFlight > 0)
+    {
+        if(!collect(true))
+        {
+            skippedFrames += inFlight;
+            for(int i=0; i<inFlight; i++)
+            {
+                int slot = (oldest + i) % CAPTURE_RING_SIZE;
+                glDeleteSync(fences[slot]);
+                fences[slot] = 0;
+            }
+            inFlight = 0;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+    }
+    frameQueued.notify_one();
+    worker.join();
+
+    if(file)
+    {
+        if(bPipe)
+        {
+            pclose(file);
+        }
+        else
+        {
+            fclose(file);
+        }
+        file = NULL;
+    }
+
+    printStats();
+}
+
+void FrameCapture::printStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+
+    std::cout << "Capture: " << encoded << " frames of " << iWidth << "x"
+    << iHeight << " in " << seconds << " s, " << encoded / seconds
+    << " frames/s, " << bytesWritten / (1024.0 * 1024.0) << " MB at "
+    << bytesWritten / seconds / (1024.0 * 1024.0) << " MB/s, encoding " << (encoded ? encodeSeconds * 1000.0 / encoded : 0)
+    << " ms/frame, " << readbackWaits << " readback waits, "
+    << encoderWaits << " encoder waits, " << skippedFrames << " skipped"
+    << std::endl;
+}
+
+int FrameCapture::getWidth()
+{
+    return iWidth;
+}
+
+int FrameCapture::getHeight()
+{
+    return iHeight;
+}
+
+unsigned long long FrameCapture::getFrameCount()
+{
+    return queued + inFlight;
+}
+
+Capture_Format FrameCapture::getFormat(const char *name,
+                                       const std::string &path)
+{
+    std::string f = name ? name : "";
+
+    if(f.empty())
+    {
+        size_t dot = path.rfind('.');
+        f = dot == std::string::npos ? "" : path.substr(dot + 1);
+    }
+
+    if(f == "y4m")
+    {
+        return CAPTURE_Y4M;
+    }
+    if(f == "ppm")
+    {
+        return CAPTURE_PPM;
+    }
+
+    return CAPTURE_RAW;
+}
+
+bool FrameCapture::isSequencePath(const std::string &path)
+{
+    int numbers = 0;
+
+    for(size_t i=0; i<path.size(); i++)
+    {
+        if(path[i] != '%')
+        {
+            continue;
+        }
+
+        ///%% is a plain %
+        if(i + 1 < path.size() && path[i + 1] == '%')
+        {
+            i++;
+            continue;
+        }
+
+        ///Flags and width, then it has to be a d
+        size_t c = i + 1;
+        while(c < path.size() && (strchr("0-+ ", path[c]) ||
+                                  isdigit((unsigned char)path[c])))
+        {
+            c++;
+        }
+
+        if(c >= path.size() || path[c] != 'd')
+        {
+            return false;
+        }
+
+        numbers++;
+        i = c;
+    }
+
+    return numbers == 1;
+}
+
+const char *FrameCapture::getFormatName(Capture_Format f)
+{
+    switch(f)
+    {
+        case CAPTURE_Y4M: return "y4m";
+        case CAPTURE_PPM: return "ppm";
+        default: return "raw";
+    }
+}
+
+#endif // FRAMECAPTURE_H_INCLUDED
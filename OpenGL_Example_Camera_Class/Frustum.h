@@ -0,0 +1,138 @@
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace glm;
+
+enum Frustum_Plane
+{
+    PLANE_LEFT,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR
+};
+
+///The six planes of a camera's view volume, in world space.
+///Every plane is stored as (normal, distance) with the normal pointing inside.
+class Frustum
+{
+    private:
+
+        vec4 planes[6];
+
+    public:
+
+        ///Constructor
+        Frustum();
+        Frustum(const mat4 &viewProj);
+
+        ///Extracts the planes from a projection * view matrix
+        void update(const mat4 &viewProj);
+
+        ///Moves every plane out by distance, for a volume that may still
+        ///move that far
+        void grow(float distance);
+
+        ///Getters
+        vec4 getPlane(int i) const;
+
+        ///Visibility tests, true if the volume is at least partially inside
+        bool sphereVisible(vec3 center, float radius) const;
+        bool aabbVisible(vec3 bMin, vec3 bMax) const;
+};
+
+///Constructor
+Frustum::Frustum()
+{
+    update(mat4());
+}
+
+Frustum::Frustum(const mat4 &viewProj)
+{
+    update(viewProj);
+}
+
+///Gribb/Hartmann plane extraction, the planes are the sum or difference of
+///the last row of the matrix with the other rows
+void Frustum::update(const mat4 &viewProj)
+{
+    vec4 row[4];
+    for(int i=0; i<4; i++)
+    {
+        row[i] = vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i],
+                      viewProj[3][i]);
+    }
+
+    planes[PLANE_LEFT]   = row[3] + row[0];
+    planes[PLANE_RIGHT]  = row[3] - row[0];
+    planes[PLANE_BOTTOM] = row[3] + row[1];
+    planes[PLANE_TOP]    = row[3] - row[1];
+    planes[PLANE_NEAR]   = row[3] + row[2];
+    planes[PLANE_FAR]    = row[3] - row[2];
+
+    ///Normalize so the distances are in world units
+    for(int i=0; i<6; i++)
+    {
+        float fLength = length(vec3(planes[i].x, planes[i].y, planes[i].z));
+        if(fLength > 0.0f)
+        {
+            planes[i] = planes[i] / fLength;
+        }
+    }
+}
+
+void Frustum::grow(float distance)
+{
+    for(int i=0; i<6; i++)
+    {
+        planes[i].w += distance;
+    }
+}
+
+vec4 Frustum::getPlane(int i) const
+{
+    return planes[i];
+}
+
+bool Frustum::sphereVisible(vec3 center, float radius) const
+{
+    for(int i=0; i<6; i++)
+    {
+        float d = planes[i].x * center.x + planes[i].y * center.y +
+                  planes[i].z * center.z + planes[i].w;
+
+        if(d < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Frustum::aabbVisible(vec3 bMin, vec3 bMax) const
+{
+    for(int i=0; i<6; i++)
+    {
+        ///Corner of the box furthest along the plane normal
+        vec3 p = vec3(planes[i].x >= 0.0f ? bMax.x : bMin.x,
+                      planes[i].y >= 0.0f ? bMax.y : bMin.y,
+                      planes[i].z >= 0.0f ? bMax.z : bMin.z);
+
+        if(planes[i].x * p.x + planes[i].y * p.y + planes[i].z * p.z +
+           planes[i].w < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif // FRUSTUM_H_INCLUDED
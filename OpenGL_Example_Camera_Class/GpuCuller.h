@@ -0,0 +1,569 @@
+#ifndef GPUCULLER_H_INCLUDED
+#define GPUCULLER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+///GLM
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Frustum.h"
+#include "LOD.h"
+#include "Shader.h"
+#include "RenderBackend.h"
+#include "ShaderPreprocessor.h"
+
+using namespace glm;
+
+///Instances per work group, the same as in cull.comp
+const int GPU_CULL_GROUP_SIZE = 64;
+
+///Vertex attribute the index of the instance is read from, the same as in
+///transform.glsl
+const int GPU_CULL_INSTANCE_ATTRIBUTE = 3;
+
+///First of the two texture units the model matrices and the materials are
+///bound to, after the ones of the clustered lighting
+const int GPU_CULL_TEXTURE_UNIT = 11;
+
+///Storage buffer bindings of cull.comp
+enum Gpu_Cull_Binding
+{
+    GPU_CULL_MODELS,
+    GPU_CULL_COMMANDS,
+    GPU_CULL_VISIBLE,
+    GPU_CULL_LEVELS,
+    GPU_CULL_BUFFER_COUNT
+};
+
+///One draw of glMultiDrawElementsIndirect, laid out the way GL reads it
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+///Culls the instances and picks their level of detail in a compute shader,
+///then draws what is left with glMultiDrawElementsIndirect (GL 4.3). The CPU
+///only uploads the model matrices, the cost of the submission is the same
+///for ten cubes as for a million:
+///  1. One command per level is reset to zero instances.
+///  2. One thread per instance picks its level the same way LODSelector
+///     does, hysteresis included, then tests its bounding sphere against
+///     the frustum planes. A survivor adds itself to the command of its
+///     level with an atomic and writes its index to the slot it got.
+///  3. One multi-draw per primitive type. The index of every instance is an
+///     instanced attribute read from the compacted list, baseInstance
+///     points every command at its part of it.
+///The vertex shader fetches the model matrix and the materials by that
+///index from texture buffers, the same buffer the compute shader reads.
+class GpuCuller
+{
+    private:
+
+        unsigned int program;
+
+        ///Storage buffers, see Gpu_Cull_Binding
+        unsigned int buffers[GPU_CULL_BUFFER_COUNT];
+
+        ///Texture buffers of the vertex shader: models and materials
+        unsigned int materialBuffer;
+        unsigned int textures[2];
+
+        ///The reset value of the command of every level
+        std::vector<DrawElementsIndirectCommand> commands;
+
+        ///Runs of commands with the same primitive type, a multi-draw each
+        std::vector<GLenum> drawModes;
+        std::vector<int> drawFirst;
+        std::vector<int> drawCount;
+
+        int instanceCount;
+        int levelCount;
+
+        ///Uniform locations of the compute shader
+        int instanceCountLocation;
+        int radiusLocation;
+        int planesLocation;
+        int eyeLocation;
+        int sizeScaleLocation;
+        int perspectiveLocation;
+
+        ///Instances of every level the last time they were read back, and
+        ///the commands they are read back into
+        std::vector<unsigned int> visibleCounts;
+        std::vector<DrawElementsIndirectCommand> readBack;
+
+        ///Stats since the last print
+        double submitTimeSum;
+        int frames;
+        int checks;
+        int mismatches;
+
+        ///Private Functions
+        bool compile(const std::string &path);
+
+    public:
+
+        ///Constructor
+        GpuCuller();
+        ~GpuCuller();
+
+        ///Compute shaders, storage buffers and indirect multi-draws
+        static bool isSupported();
+
+        ///The model matrices of count instances fit a texture buffer
+        static bool canHold(int count);
+
+        ///Needs the context, false if the shader doesn't build
+        bool create(const std::string &computePath);
+
+        ///The levels of the mesh and the VAO they are drawn from
+        void setMesh(const LODMesh &mesh, unsigned int vao);
+
+        ///Allocates the buffers of count instances and uploads their base
+        ///and detail texture, false if there are too many of them
+        bool resize(int count, const ivec2 *materials);
+
+        ///Uploads the model matrices and culls them, the draws are ready
+        ///once it returns
+        void cull(const mat4 *models, const Frustum &frustum, Camera &camera,
+                  float radius);
+
+        ///Texture units of the buffers, once per program. The materials
+        ///only for the textured ones.
+        void setupShader(Shader &s);
+        void setupMaterials(Shader &s);
+
+        ///Draws the survivors of the last cull, the VAO of setMesh must be
+        ///bound
+        void draw();
+
+        ///Reads back how many instances every level got this frame, it
+        ///waits for the GPU. Compares the total with the CPU culling of the
+        ///same frame and returns it.
+        int checkParity(int cpuVisible);
+
+        ///Prints the submission time and the parity checks since the last
+        ///call
+        void printStats();
+
+        ///Getters, from the last checkParity
+        unsigned int getVisibleCount(int level);
+        int getInstanceCount();
+};
+
+///Constructor
+GpuCuller::GpuCuller()
+{
+    program = 0;
+    materialBuffer = 0;
+
+    for(int i=0; i<GPU_CULL_BUFFER_COUNT; i++)
+    {
+        buffers[i] = 0;
+    }
+    textures[0] = 0;
+    textures[1] = 0;
+
+    instanceCount = 0;
+    levelCount = 0;
+
+    instanceCountLocation = -1;
+    radiusLocation = -1;
+    planesLocation = -1;
+    eyeLocation = -1;
+    sizeScaleLocation = -1;
+    perspectiveLocation = -1;
+
+    submitTimeSum = 0.0;
+    frames = 0;
+    checks = 0;
+    mismatches = 0;
+}
+
+GpuCuller::~GpuCuller()
+{
+    if(buffers[0])
+    {
+        glDeleteTextures(2, textures);
+        glDeleteBuffers(1, &materialBuffer);
+        glDeleteBuffers(GPU_CULL_BUFFER_COUNT, buffers);
+    }
+
+    if(program)
+    {
+        glDeleteProgram(program);
+    }
+}
+
+bool GpuCuller::isSupported()
+{
+    return GLEW_VERSION_4_3;
+}
+
+bool GpuCuller::canHold(int count)
+{
+    ///A matrix is four texels
+    int maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    return (long long)count * 4 <= maxTexels;
+}
+
+bool GpuCuller::compile(const std::string &path)
+{
+    std::string source;
+    std::vector<std::string> dependencies;
+    if(!ShaderPreprocessor::process(path, ShaderDefines(), source,
+                                    dependencies))
+    {
+        return false;
+    }
+
+    const char *code = source.c_str();
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n"
+        << infoLog << std::endl;
+        glDeleteShader(shader);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog
+        << std::endl;
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    instanceCountLocation = glGetUniformLocation(program, "instanceCount");
+    radiusLocation = glGetUniformLocation(program, "radius");
+    planesLocation = glGetUniformLocation(program, "planes");
+    eyeLocation = glGetUniformLocation(program, "eye");
+    sizeScaleLocation = glGetUniformLocation(program, "sizeScale");
+    perspectiveLocation = glGetUniformLocation(program, "perspective");
+
+    return true;
+}
+
+bool GpuCuller::create(const std::string &computePath)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    if(!compile(computePath))
+    {
+        return false;
+    }
+
+    glGenBuffers(GPU_CULL_BUFFER_COUNT, buffers);
+    glGenBuffers(1, &materialBuffer);
+    glGenTextures(2, textures);
+
+    ///The shader fetches the matrix as four texels
+    backend->bindBuffer(GL_TEXTURE_BUFFER, buffers[GPU_CULL_MODELS]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(mat4), NULL, GL_STREAM_DRAW);
+    backend->bindTextureTarget(GL_TEXTURE_BUFFER, 0, textures[0]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffers[GPU_CULL_MODELS]);
+
+    backend->bindBuffer(GL_TEXTURE_BUFFER, materialBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(ivec2), NULL, GL_STATIC_DRAW);
+    backend->bindTextureTarget(GL_TEXTURE_BUFFER, 0, textures[1]);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, materialBuffer);
+
+    backend->bindTextureTarget(GL_TEXTURE_BUFFER, 0, 0);
+    backend->bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    std::cout << "GPU culling: compute shader and indirect multi-draws"
+    << std::endl;
+    return true;
+}
+
+void GpuCuller::setMesh(const LODMesh &mesh, unsigned int vao)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    levelCount = mesh.getLevelCount();
+
+    commands.resize(levelCount);
+    drawModes.clear();
+    drawFirst.clear();
+    drawCount.clear();
+
+    float thresholds[LOD_MAX_LEVELS];
+    for(int l=0; l<levelCount; l++)
+    {
+        const LODLevel &level = mesh.getLevel(l);
+
+        commands[l].count = level.indexCount;
+        commands[l].instanceCount = 0;
+        commands[l].firstIndex = level.firstIndex;
+        commands[l].baseVertex = level.baseVertex;
+        commands[l].baseInstance = 0;
+
+        thresholds[l] = level.minScreenSize;
+
+        if(drawModes.empty() || drawModes.back() != level.mode)
+        {
+            drawModes.push_back(level.mode);
+            drawFirst.push_back(l);
+            drawCount.push_back(0);
+        }
+        drawCount.back()++;
+    }
+
+    visibleCounts.assign(levelCount, 0);
+    readBack.resize(levelCount);
+
+    backend->useProgram(program);
+    glUniform1i(glGetUniformLocation(program, "levelCount"), levelCount);
+    glUniform1fv(glGetUniformLocation(program, "thresholds"), levelCount,
+                 thresholds);
+    glUniform1f(glGetUniformLocation(program, "hysteresis"),
+                LOD_HYSTERESIS);
+
+    ///Every instance reads its index from the compacted list
+    backend->bindVertexArray(vao);
+    backend->bindBuffer(GL_ARRAY_BUFFER, buffers[GPU_CULL_VISIBLE]);
+    glEnableVertexAttribArray(GPU_CULL_INSTANCE_ATTRIBUTE);
+    glVertexAttribIPointer(GPU_CULL_INSTANCE_ATTRIBUTE, 1, GL_UNSIGNED_INT,
+                           0, (void*)0);
+    glVertexAttribDivisor(GPU_CULL_INSTANCE_ATTRIBUTE, 1);
+    backend->bindVertexArray(0);
+    backend->bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool GpuCuller::resize(int count, const ivec2 *materials)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    if(!canHold(count))
+    {
+        std::cout << "ERROR::GPU_CULLING::TOO_MANY_INSTANCES " << count
+        << std::endl;
+        return false;
+    }
+
+    instanceCount = count;
+
+    ///Every level has room for all the instances, the command of a level
+    ///starts at its part of the list
+    for(int l=0; l<levelCount; l++)
+    {
+        commands[l].baseInstance = l * count;
+    }
+
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_COMMANDS]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 commands.size() * sizeof(DrawElementsIndirectCommand),
+                 &commands[0], GL_DYNAMIC_DRAW);
+
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_VISIBLE]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (size_t)levelCount * count * sizeof(unsigned int), NULL,
+                 GL_DYNAMIC_COPY);
+
+    ///Every instance starts at the finest level, as in LODSelector
+    std::vector<unsigned int> levels(count, 0);
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_LEVELS]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(unsigned int),
+                 count ? &levels[0] : NULL, GL_DYNAMIC_COPY);
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    backend->bindBuffer(GL_TEXTURE_BUFFER, materialBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, count * sizeof(ivec2), materials,
+                 GL_STATIC_DRAW);
+    backend->bindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    return true;
+}
+
+void GpuCuller::cull(const mat4 *models, const Frustum &frustum,
+                     Camera &camera, float radius)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    ///Orphaned every frame, the last frame may still be drawing from it
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_MODELS]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(mat4),
+                 models, GL_STREAM_DRAW);
+
+    ///No instances in any level yet
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_COMMANDS]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    commands.size() * sizeof(DrawElementsIndirectCommand),
+                    &commands[0]);
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    for(int i=0; i<GPU_CULL_BUFFER_COUNT; i++)
+    {
+        backend->bindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers[i]);
+    }
+
+    float planes[6 * 4];
+    for(int i=0; i<6; i++)
+    {
+        vec4 plane = frustum.getPlane(i);
+        planes[i * 4] = plane.x;
+        planes[i * 4 + 1] = plane.y;
+        planes[i * 4 + 2] = plane.z;
+        planes[i * 4 + 3] = plane.w;
+    }
+
+    ///The projected size the same way LODSelector measures it
+    mat4 proj = camera.GetProjectionMatrix();
+    vec3 eye = camera.GetPosition();
+
+    backend->useProgram(program);
+    glUniform1ui(instanceCountLocation, instanceCount);
+    glUniform1f(radiusLocation, radius);
+    glUniform4fv(planesLocation, 6, planes);
+    glUniform3f(eyeLocation, eye.x, eye.y, eye.z);
+    glUniform1f(sizeScaleLocation, proj[1][1] * camera.GetHeight());
+    glUniform1f(perspectiveLocation, proj[2][3] != 0.0f ? 1.0f : 0.0f);
+
+    glDispatchCompute((instanceCount + GPU_CULL_GROUP_SIZE - 1) /
+                      GPU_CULL_GROUP_SIZE, 1, 1);
+
+    ///The draws read the commands and the list the shader wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    submitTimeSum += elapsed.count();
+    frames++;
+}
+
+void GpuCuller::setupShader(Shader &s)
+{
+    s.use();
+    s.setInt("instanceModels", GPU_CULL_TEXTURE_UNIT);
+}
+
+void GpuCuller::setupMaterials(Shader &s)
+{
+    s.use();
+    s.setInt("instanceMaterials", GPU_CULL_TEXTURE_UNIT + 1);
+}
+
+void GpuCuller::draw()
+{
+    RenderBackend *backend = getRenderBackend();
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    for(int i=0; i<2; i++)
+    {
+        backend->bindTextureTarget(GL_TEXTURE_BUFFER,
+                                   GPU_CULL_TEXTURE_UNIT + i, textures[i]);
+    }
+
+    backend->bindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[GPU_CULL_COMMANDS]);
+
+    for(unsigned int i=0; i<drawModes.size(); i++)
+    {
+        glMultiDrawElementsIndirect(drawModes[i], GL_UNSIGNED_INT,
+            (void*)(drawFirst[i] * sizeof(DrawElementsIndirectCommand)),
+            drawCount[i], 0);
+    }
+
+    backend->bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    submitTimeSum += elapsed.count();
+}
+
+int GpuCuller::checkParity(int cpuVisible)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[GPU_CULL_COMMANDS]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                       levelCount * sizeof(DrawElementsIndirectCommand),
+                       &readBack[0]);
+    backend->bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    int gpuVisible = 0;
+    for(int l=0; l<levelCount; l++)
+    {
+        visibleCounts[l] = readBack[l].instanceCount;
+        gpuVisible += readBack[l].instanceCount;
+    }
+
+    checks++;
+    if(gpuVisible != cpuVisible)
+    {
+        mismatches++;
+        std::cout << "ERROR::GPU_CULLING::PARITY " << gpuVisible
+        << " visible on the GPU, " << cpuVisible << " on the CPU"
+        << std::endl;
+    }
+
+    return gpuVisible;
+}
+
+void GpuCuller::printStats()
+{
+    if(frames == 0)
+    {
+        return;
+    }
+
+    std::cout << "GPU culling: " << instanceCount << " instances submitted in "
+    << submitTimeSum / frames << " ms, visible per level";
+    for(int l=0; l<levelCount; l++)
+    {
+        std::cout << (l ? "/" : " ") << visibleCounts[l];
+    }
+    std::cout << ", " << checks - mismatches << " of " << checks
+    << " parity checks match" << std::endl;
+
+    submitTimeSum = 0.0;
+    frames = 0;
+    checks = 0;
+    mismatches = 0;
+}
+
+unsigned int GpuCuller::getVisibleCount(int level)
+{
+    return visibleCounts[level];
+}
+
+int GpuCuller::getInstanceCount()
+{
+    return instanceCount;
+}
+
+#endif // GPUCULLER_H_INCLUDED
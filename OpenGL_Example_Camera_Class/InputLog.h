@@ -0,0 +1,456 @@
+#ifndef INPUTLOG_H_INCLUDED
+#define INPUTLOG_H_INCLUDED
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Camera.h"
+
+///Magic number and version at the start of every input log
+const char INPUT_LOG_MAGIC[4] = {'I', 'L', 'O', 'G'};
+const unsigned int INPUT_LOG_VERSION = 1;
+
+///Bit of a Camera_Movement in InputFrame::keys
+#define INPUT_KEY(movement) (1u << (movement))
+
+///Bit of the key that turns the textures on and off
+const unsigned short INPUT_TEXTURE_KEY = 1u << 15;
+
+///Frame count that marks the end of the frames in the log
+const unsigned char INPUT_LOG_END = 0xFF;
+
+///A camera command with its own time step, the time sets how far it goes
+struct InputCommand
+{
+    Camera_Movement movement;
+    float deltaTime;
+};
+
+///The input of one frame: the keys held, each moving the camera for the
+///frame's deltaTime, then any number of commands
+struct InputFrame
+{
+    float deltaTime;
+    unsigned short keys;
+    std::vector<InputCommand> commands;
+};
+
+///What the camera looks like at the end of a run, compared bit by bit
+struct CameraSnapshot
+{
+    vec3 position;
+    vec3 front;
+    mat4 view;
+};
+
+///Moves the camera the way a frame says. Recording, replay and the live
+///keyboard all go through here, so they do the same float math in the same
+///order.
+void applyInputFrame(Camera &camera, const InputFrame &frame)
+{
+    for(int m=FORWARD; m<=DOWN_SPIN; m++)
+    {
+        if(frame.keys & INPUT_KEY(m))
+        {
+            camera.MoveCamera((Camera_Movement)m, frame.deltaTime);
+        }
+    }
+
+    for(unsigned int i=0; i<frame.commands.size(); i++)
+    {
+        camera.MoveCamera(frame.commands[i].movement,
+                          frame.commands[i].deltaTime);
+    }
+}
+
+CameraSnapshot takeCameraSnapshot(Camera &camera)
+{
+    CameraSnapshot snapshot;
+    snapshot.position = camera.GetPosition();
+    snapshot.front = camera.GetFront();
+    snapshot.view = camera.GetViewMatrix();
+    return snapshot;
+}
+
+///True only if every float has the same bits
+bool isSameCameraState(const CameraSnapshot &a, const CameraSnapshot &b)
+{
+    return memcmp(value_ptr(a.position), value_ptr(b.position),
+                  sizeof(float) * 3) == 0 &&
+           memcmp(value_ptr(a.front), value_ptr(b.front),
+                  sizeof(float) * 3) == 0 &&
+           memcmp(value_ptr(a.view), value_ptr(b.view),
+                  sizeof(float) * 16) == 0;
+}
+
+///\///////////////////////////////InputRecorder///////////////////////////////
+
+///Writes the input of every frame to a binary log, 32 bit values in the
+///machine's byte order:
+///  frame:  command count (8 bit), deltaTime, keys (16 bit), then every
+///          command as movement (8 bit) and deltaTime
+///  end:    INPUT_LOG_END, then the CameraSnapshot the replay must reach
+///A frame with only keys takes 7 bytes.
+class InputRecorder
+{
+    private:
+
+        FILE *file;
+        unsigned int frames;
+
+        void writeBytes(const void *data, unsigned int size);
+
+    public:
+
+        ///Constructor
+        InputRecorder(const char *path);
+        ~InputRecorder();
+
+        bool isOpen();
+
+        void writeFrame(const InputFrame &frame);
+
+        ///Ends the log with the state of the camera after the last frame
+        void finish(Camera &camera);
+};
+
+///Constructor
+InputRecorder::InputRecorder(const char *path)
+{
+    frames = 0;
+
+    file = fopen(path, "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::INPUT_LOG::COULD_NOT_OPEN " << path << std::endl;
+        return;
+    }
+
+    fwrite(INPUT_LOG_MAGIC, 1, 4, file);
+    writeBytes(&INPUT_LOG_VERSION, 4);
+}
+
+InputRecorder::~InputRecorder()
+{
+    if(file)
+    {
+        fclose(file);
+    }
+}
+
+bool InputRecorder::isOpen()
+{
+    return file != NULL;
+}
+
+void InputRecorder::writeBytes(const void *data, unsigned int size)
+{
+    if(file && size > 0)
+    {
+        fwrite(data, 1, size, file);
+    }
+}
+
+void InputRecorder::writeFrame(const InputFrame &frame)
+{
+    ///Anything past 254 commands is dropped, 0xFF ends the log
+    unsigned char count = (unsigned char)std::min<unsigned int>(
+        frame.commands.size(), INPUT_LOG_END - 1);
+
+    writeBytes(&count, 1);
+    writeBytes(&frame.deltaTime, 4);
+    writeBytes(&frame.keys, 2);
+
+    for(unsigned int i=0; i<count; i++)
+    {
+        unsigned char movement = (unsigned char)frame.commands[i].movement;
+        writeBytes(&movement, 1);
+        writeBytes(&frame.commands[i].deltaTime, 4);
+    }
+
+    frames++;
+}
+
+void InputRecorder::finish(Camera &camera)
+{
+    if(!file)
+    {
+        return;
+    }
+
+    CameraSnapshot snapshot = takeCameraSnapshot(camera);
+
+    writeBytes(&INPUT_LOG_END, 1);
+    writeBytes(value_ptr(snapshot.position), sizeof(float) * 3);
+    writeBytes(value_ptr(snapshot.front), sizeof(float) * 3);
+    writeBytes(value_ptr(snapshot.view), sizeof(float) * 16);
+
+    fclose(file);
+    file = NULL;
+
+    std::cout << "Recorded the input of " << frames << " frames" << std::endl;
+}
+
+///\////////////////////////////////InputPlayer////////////////////////////////
+
+///Reads a whole input log up front and hands its frames out one by one, so
+///the replay doesn't wait on the disk
+class InputPlayer
+{
+    private:
+
+        std::vector<InputFrame> frames;
+        unsigned int next;
+        CameraSnapshot expected;
+
+    public:
+
+        ///Constructor
+        InputPlayer();
+
+        ///False if the file is missing or broken
+        bool open(const char *path);
+
+        ///The next frame, false once they are all played
+        bool nextFrame(InputFrame &frame);
+
+        ///Getters
+        int getFrameCount();
+        const CameraSnapshot &getExpectedState();
+};
+
+///Constructor
+InputPlayer::InputPlayer()
+{
+    next = 0;
+}
+
+bool InputPlayer::open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        std::cout << "ERROR::INPUT_LOG::COULD_NOT_OPEN " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    unsigned int version = 0;
+    bool bOk = fread(magic, 1, 4, f) == 4 &&
+               memcmp(magic, INPUT_LOG_MAGIC, 4) == 0 &&
+               fread(&version, 4, 1, f) == 1 &&
+               version == INPUT_LOG_VERSION;
+
+    frames.clear();
+    next = 0;
+
+    bool bEnd = false;
+    while(bOk && !bEnd)
+    {
+        InputFrame frame;
+        unsigned char count = 0;
+
+        bOk = fread(&count, 1, 1, f) == 1;
+
+        if(bOk && count == INPUT_LOG_END)
+        {
+            bOk = fread(value_ptr(expected.position), sizeof(float), 3,
+                        f) == 3 &&
+                  fread(value_ptr(expected.front), sizeof(float), 3,
+                        f) == 3 &&
+                  fread(value_ptr(expected.view), sizeof(float), 16,
+                        f) == 16;
+            bEnd = true;
+            break;
+        }
+
+        bOk = bOk && fread(&frame.deltaTime, 4, 1, f) == 1 &&
+                     fread(&frame.keys, 2, 1, f) == 1;
+
+        for(unsigned int i=0; bOk && i<count; i++)
+        {
+            unsigned char movement = 0;
+            InputCommand command;
+            bOk = fread(&movement, 1, 1, f) == 1 &&
+                  fread(&command.deltaTime, 4, 1, f) == 1 &&
+                  movement <= DOWN_SPIN;
+            command.movement = (Camera_Movement)movement;
+            frame.commands.push_back(command);
+        }
+
+        if(bOk)
+        {
+            frames.push_back(frame);
+        }
+    }
+
+    fclose(f);
+
+    if(!bOk || !bEnd)
+    {
+        std::cout << "ERROR::INPUT_LOG::BROKEN " << path << std::endl;
+        frames.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool InputPlayer::nextFrame(InputFrame &frame)
+{
+    if(next >= frames.size())
+    {
+        return false;
+    }
+
+    frame = frames[next++];
+    return true;
+}
+
+int InputPlayer::getFrameCount()
+{
+    return frames.size();
+}
+
+const CameraSnapshot &InputPlayer::getExpectedState()
+{
+    return expected;
+}
+
+///\/////////////////////////////////Fly-through////////////////////////////////
+
+///Point of a closed Catmull-Rom spline through points, t in [0, count)
+vec3 getSplinePoint(const std::vector<vec3> &points, float t)
+{
+    int n = points.size();
+    int i = (int)floorf(t);
+    float f = t - i;
+
+    const vec3 &p0 = points[(i - 1 + n) % n];
+    const vec3 &p1 = points[i % n];
+    const vec3 &p2 = points[(i + 1) % n];
+    const vec3 &p3 = points[(i + 2) % n];
+
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * f +
+                   (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * f * f +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * f * f * f);
+}
+
+///Adds the command that moves or turns by amount, units or degrees, picking
+///the positive or negative movement by its sign
+void addCommand(InputFrame &frame, Camera_Movement positive,
+                Camera_Movement negative, float amount, float speed)
+{
+    if(amount == 0.0f)
+    {
+        return;
+    }
+
+    InputCommand command;
+    command.movement = amount > 0.0f ? positive : negative;
+    command.deltaTime = fabsf(amount) / speed;
+    frame.commands.push_back(command);
+}
+
+///Writes an input log that flies camera once around a closed spline through
+///points in the given seconds, one frame every step seconds, looking where
+///it goes. camera is a copy: the commands are played on it to get the state
+///the replay has to end in.
+bool writeFlyThrough(const char *path, const std::vector<vec3> &points,
+                     float seconds, float step, Camera camera)
+{
+    if(points.size() < 2 || seconds <= 0.0f || step <= 0.0f)
+    {
+        std::cout << "A fly-through needs two points and some time"
+        << std::endl;
+        return false;
+    }
+
+    InputRecorder recorder(path);
+    if(!recorder.isOpen())
+    {
+        return false;
+    }
+
+    ///The camera starts looking down -Z
+    float fYaw = YAW;
+    float fPitch = PITCH;
+
+    int frameCount = (int)ceilf(seconds / step);
+    float fSegments = points.size();
+
+    for(int f=1; f<=frameCount; f++)
+    {
+        float t = std::min(f * step / seconds, 1.0f) * fSegments;
+        vec3 target = getSplinePoint(points, t);
+        vec3 ahead = getSplinePoint(points, t + 0.01f) - target;
+
+        InputFrame frame;
+        frame.deltaTime = step;
+        frame.keys = 0;
+
+        ///Turn to look along the path, the short way round
+        if(length(ahead) > 0.0f)
+        {
+            ahead = normalize(ahead);
+            float fWantedYaw = degrees(atan2f(ahead.z, ahead.x));
+            float fWantedPitch = degrees(asinf(ahead.y));
+
+            float fTurn = fWantedYaw - fYaw;
+            fTurn -= 360.0f * floorf((fTurn + 180.0f) / 360.0f);
+
+            addCommand(frame, RIGHT_SPIN, LEFT_SPIN, fTurn,
+                       SPEED * SENSITIVTY);
+            addCommand(frame, UP_SPIN, DOWN_SPIN, fWantedPitch - fPitch,
+                       SPEED * SENSITIVTY);
+
+            fYaw += fTurn;
+            fPitch = fWantedPitch;
+        }
+
+        ///Turn first, the moves are along the new axes
+        applyInputFrame(camera, frame);
+        unsigned int turns = frame.commands.size();
+
+        ///Right is square to Front and WorldUp, which aren't square to each
+        ///other when pitched: the rest is a 2x2 system
+        vec3 front = camera.GetFront();
+        vec3 right = normalize(cross(front, WORLD_UP));
+        vec3 delta = target - camera.GetPosition();
+
+        float fSide = dot(delta, right);
+        vec3 rest = delta - right * fSide;
+
+        float s = dot(front, WORLD_UP);
+        float det = std::max(1.0f - s * s, 0.0001f);
+        float fAlong = (dot(rest, front) - s * dot(rest, WORLD_UP)) / det;
+        float fUp = (dot(rest, WORLD_UP) - s * dot(rest, front)) / det;
+
+        addCommand(frame, FORWARD, BACKWARD, fAlong, SPEED);
+        addCommand(frame, RIGHT, LEFT, fSide, SPEED);
+        addCommand(frame, UP, DOWN, fUp, SPEED);
+
+        InputFrame moves;
+        moves.deltaTime = step;
+        moves.keys = 0;
+        moves.commands.assign(frame.commands.begin() + turns,
+                              frame.commands.end());
+        applyInputFrame(camera, moves);
+
+        recorder.writeFrame(frame);
+    }
+
+    recorder.finish(camera);
+    return true;
+}
+
+#endif // INPUTLOG_H_INCLUDED
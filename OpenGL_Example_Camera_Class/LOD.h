@@ -0,0 +1,321 @@
+#ifndef LOD_H_INCLUDED
+#define LOD_H_INCLUDED
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Camera.h"
+
+using namespace glm;
+
+/// Default LOD values
+const float LOD_HYSTERESIS = 0.15f;
+const int   LOD_MAX_LEVELS = 8;
+
+///A single level of detail, it is a range inside the shared index buffer
+struct LODLevel
+{
+    ///Draw mode (GL_TRIANGLES, GL_TRIANGLE_STRIP...)
+    GLenum mode;
+
+    ///Range of the index buffer and the offset into the vertex buffer
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+
+    ///Number of triangles this level sends to the GPU
+    unsigned int triangleCount;
+
+    ///Smallest projected size (in pixels) this level is used for
+    float minScreenSize;
+};
+
+///A mesh with several levels of detail, level 0 is the finest one
+class LODMesh
+{
+    private:
+
+        std::vector<LODLevel> levels;
+
+    public:
+
+        ///Levels must be added from the finest to the coarsest
+        void addLevel(GLenum mode, unsigned int first, unsigned int count,
+                      int baseVertex, float minScreenSize);
+
+        ///Getters
+        int getLevelCount() const;
+        const LODLevel& getLevel(int i) const;
+};
+
+///Chooses the level of every instance from its projected size on screen.
+///The instance data is kept as a structure of arrays so the size pass runs
+///as a straight loop the compiler can vectorize.
+class LODSelector
+{
+    private:
+
+        ///Instance bounding spheres (SoA)
+        std::vector<float> posX;
+        std::vector<float> posY;
+        std::vector<float> posZ;
+        std::vector<float> radius;
+
+        ///Results of the last pass
+        std::vector<float> screenSize;
+        std::vector<int> level;
+
+        ///Fraction a size must cross a threshold by before switching levels
+        float fHysteresis;
+
+        ///Statistics of the last pass
+        unsigned long long trianglesBefore;
+        unsigned long long trianglesAfter;
+
+    public:
+
+        ///Constructor
+        LODSelector(float hysteresis = LOD_HYSTERESIS);
+
+        ///Instance management
+        void resize(int n);
+        void setInstance(int i, vec3 pos, float r);
+        int getInstanceCount() const;
+
+        ///Batch pass, computes the projected size and level of all instances
+        void selectLevels(const LODMesh &mesh, Camera &camera);
+
+        ///Getters
+        int getLevel(int i) const;
+        float getScreenSize(int i) const;
+        unsigned long long getTrianglesBeforeLOD() const;
+        unsigned long long getTrianglesAfterLOD() const;
+        unsigned long long getInstanceBytes() const;
+
+        ///Print the triangle savings of the last pass
+        void printStats() const;
+};
+
+///\/////////////////////////////////LODMesh////////////////////////////////////
+
+void LODMesh::addLevel(GLenum mode, unsigned int first, unsigned int count,
+                       int baseVertex, float minScreenSize)
+{
+    if((int)levels.size() >= LOD_MAX_LEVELS)
+    {
+        std::cout << "ERROR::LOD::TOO_MANY_LEVELS" << std::endl;
+        return;
+    }
+
+    LODLevel l;
+    l.mode = mode;
+    l.firstIndex = first;
+    l.indexCount = count;
+    l.baseVertex = baseVertex;
+    l.minScreenSize = minScreenSize;
+
+    ///Strips share two vertices between consecutive triangles
+    if(mode == GL_TRIANGLE_STRIP)
+    {
+        l.triangleCount = count >= 3 ? count - 2 : 0;
+    }
+    else
+    {
+        l.triangleCount = count / 3;
+    }
+
+    levels.push_back(l);
+}
+
+int LODMesh::getLevelCount() const
+{
+    return (int)levels.size();
+}
+
+const LODLevel& LODMesh::getLevel(int i) const
+{
+    return levels[i];
+}
+
+///\///////////////////////////////LODSelector//////////////////////////////////
+
+///Constructor
+LODSelector::LODSelector(float hysteresis)
+{
+    fHysteresis = hysteresis;
+    trianglesBefore = 0;
+    trianglesAfter = 0;
+}
+
+void LODSelector::resize(int n)
+{
+    posX.resize(n);
+    posY.resize(n);
+    posZ.resize(n);
+    radius.resize(n);
+    screenSize.resize(n);
+
+    ///New instances start at the finest level
+    level.resize(n, 0);
+}
+
+void LODSelector::setInstance(int i, vec3 pos, float r)
+{
+    posX[i] = pos.x;
+    posY[i] = pos.y;
+    posZ[i] = pos.z;
+    radius[i] = r;
+}
+
+int LODSelector::getInstanceCount() const
+{
+    return (int)radius.size();
+}
+
+///The projected diameter of a sphere of radius r at distance d is
+///r * proj[1][1] * height / d pixels. Orthographic cameras don't shrink with
+///distance, so d is taken as 1 for them.
+void LODSelector::selectLevels(const LODMesh &mesh, Camera &camera)
+{
+    int n = getInstanceCount();
+    int levelCount = mesh.getLevelCount();
+
+    trianglesBefore = 0;
+    trianglesAfter = 0;
+
+    if(n == 0 || levelCount == 0)
+    {
+        return;
+    }
+
+    mat4 proj = camera.GetProjectionMatrix();
+    vec3 eye = camera.GetPosition();
+
+    float fScale = proj[1][1] * camera.GetHeight();
+    float fPerspective = proj[2][3] != 0.0f ? 1.0f : 0.0f;
+
+    const float *px = &posX[0];
+    const float *py = &posY[0];
+    const float *pz = &posZ[0];
+    const float *pr = &radius[0];
+    float *size = &screenSize[0];
+
+    ///1. Projected size, no branches so it vectorizes
+    for(int i=0; i<n; i++)
+    {
+        float dx = px[i] - eye.x;
+        float dy = py[i] - eye.y;
+        float dz = pz[i] - eye.z;
+        float d = sqrtf(dx*dx + dy*dy + dz*dz);
+
+        ///Keep the camera from dividing by zero when inside the sphere
+        d = fPerspective * fmaxf(d, pr[i]) + (1.0f - fPerspective);
+
+        size[i] = pr[i] * fScale / d;
+    }
+
+    ///2. Level selection with hysteresis
+    float thresholds[LOD_MAX_LEVELS];
+    unsigned int triangles[LOD_MAX_LEVELS];
+    for(int l=0; l<levelCount; l++)
+    {
+        thresholds[l] = mesh.getLevel(l).minScreenSize;
+        triangles[l] = mesh.getLevel(l).triangleCount;
+    }
+
+    float fDown = 1.0f - fHysteresis;
+    float fUp = 1.0f + fHysteresis;
+
+    for(int i=0; i<n; i++)
+    {
+        ///Level with no hysteresis, the first one the size reaches
+        int target = 0;
+        for(int l=1; l<levelCount; l++)
+        {
+            target += size[i] < thresholds[l-1];
+        }
+
+        int current = level[i] < levelCount ? level[i] : levelCount - 1;
+
+        ///Only go coarser once the size is clearly below the current level,
+        ///and only go finer once it is clearly above the finer threshold
+        if(target > current)
+        {
+            if(size[i] < thresholds[current] * fDown)
+            {
+                current = target;
+            }
+        }
+        else
+        {
+            while(current > target && size[i] >= thresholds[current-1] * fUp)
+            {
+                current--;
+            }
+        }
+
+        level[i] = current;
+
+        trianglesBefore += triangles[0];
+        trianglesAfter += triangles[current];
+    }
+}
+
+///\/////////////////////////////////Getters////////////////////////////////////
+
+int LODSelector::getLevel(int i) const
+{
+    return level[i];
+}
+
+float LODSelector::getScreenSize(int i) const
+{
+    return screenSize[i];
+}
+
+unsigned long long LODSelector::getTrianglesBeforeLOD() const
+{
+    return trianglesBefore;
+}
+
+unsigned long long LODSelector::getTrianglesAfterLOD() const
+{
+    return trianglesAfter;
+}
+
+///Memory of the per instance arrays
+unsigned long long LODSelector::getInstanceBytes() const
+{
+    return (posX.capacity() + posY.capacity() + posZ.capacity() +
+            radius.capacity() + screenSize.capacity()) * sizeof(float) +
+           level.capacity() * sizeof(int);
+}
+
+///\////////////////////////////////////////////////////////////////////////////
+
+void LODSelector::printStats() const
+{
+    float fSaved = 0.0f;
+
+    if(trianglesBefore > 0)
+    {
+        fSaved = 100.0f * (1.0f - (float)trianglesAfter /
+                           (float)trianglesBefore);
+    }
+
+    std::cout << "LOD: " << getInstanceCount() << " instances, triangles "
+    << trianglesBefore << " -> " << trianglesAfter << " (" << fSaved
+    << "% saved)" << std::endl;
+}
+
+#endif // LOD_H_INCLUDED
@@ -0,0 +1,230 @@
+#ifndef LARGEWORLD_H_INCLUDED
+#define LARGEWORLD_H_INCLUDED
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+///SSE2 when the compiler targets it, a plain loop otherwise
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///GLM
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+using namespace glm;
+
+///Distance of the scene from the origin of the world with --large-world,
+///in the units of the scene (meters)
+const double LARGE_WORLD_DISTANCE = 20000.0;
+
+///Positions of the camera and the instances in double precision, drawn
+///relative to the camera. A float 20 km from the origin only has steps of
+///2 mm, 2 cm at 200 km: the vertices jitter as the camera moves. Here the
+///camera is put back at the origin every frame, what it moved since the last
+///frame goes to its position in doubles, and every instance is turned into
+///a float offset from the camera in one batched pass (SSE2: two subtractions
+///in doubles, converted and packed into four floats). Everything after that
+///(animation, culling, the matrices, the shaders) only sees small floats,
+///with their full precision where the camera is.
+class LargeWorld
+{
+    private:
+
+        ///World position of every instance (SoA)
+        std::vector<double> worldX;
+        std::vector<double> worldY;
+        std::vector<double> worldZ;
+
+        ///Offset of every instance from the camera, after update
+        std::vector<float> relativeX;
+        std::vector<float> relativeY;
+        std::vector<float> relativeZ;
+
+        ///World position of the camera. The position of the Camera object
+        ///is what it moved since the last update.
+        dvec3 cameraWorld;
+
+        bool bActive;
+
+        ///Private Functions
+        static void toRelative(const double *world, double camera,
+                               float *out, int count);
+
+    public:
+
+        ///Constructor
+        LargeWorld();
+
+        ///Turns camera relative drawing on, the camera starts at cameraStart
+        void create(const dvec3 &cameraStart);
+
+        ///Instance management
+        void resize(int count);
+        void setInstance(int i, const dvec3 &position);
+
+        ///Moves what the camera moved into its world position, puts it back
+        ///at the origin and updates the offsets of every instance
+        void update(Camera &camera);
+
+        ///Offset from the camera of the last update of a single position
+        vec3 toCameraRelative(const dvec3 &position) const;
+
+        ///Prints how far from the origin the instances are, and how much a
+        ///float loses there and camera relative
+        void printPrecision() const;
+
+        ///Getters
+        const float *getRelativeX() const;
+        const float *getRelativeY() const;
+        const float *getRelativeZ() const;
+        dvec3 getCameraPosition() const;
+        int getInstanceCount() const;
+        bool isActive() const;
+};
+
+///Constructor
+LargeWorld::LargeWorld()
+{
+    cameraWorld = dvec3(0.0);
+    bActive = false;
+}
+
+void LargeWorld::create(const dvec3 &cameraStart)
+{
+    cameraWorld = cameraStart;
+    bActive = true;
+}
+
+void LargeWorld::resize(int count)
+{
+    worldX.resize(count, 0.0);
+    worldY.resize(count, 0.0);
+    worldZ.resize(count, 0.0);
+
+    relativeX.resize(count, 0.0f);
+    relativeY.resize(count, 0.0f);
+    relativeZ.resize(count, 0.0f);
+}
+
+void LargeWorld::setInstance(int i, const dvec3 &position)
+{
+    worldX[i] = position.x;
+    worldY[i] = position.y;
+    worldZ[i] = position.z;
+}
+
+///out[i] = world[i] - camera, rounded once to float
+void LargeWorld::toRelative(const double *world, double camera, float *out,
+                            int count)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    __m128d cameraPair = _mm_set1_pd(camera);
+
+    for(; i+4<=count; i+=4)
+    {
+        __m128 low = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(world + i),
+                                             cameraPair));
+        __m128 high = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(world + i + 2),
+                                              cameraPair));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(low, high));
+    }
+#endif
+
+    for(; i<count; i++)
+    {
+        out[i] = (float)(world[i] - camera);
+    }
+}
+
+void LargeWorld::update(Camera &camera)
+{
+    cameraWorld += dvec3(camera.GetPosition());
+    camera.SetPosition(vec3(0.0f));
+
+    int count = getInstanceCount();
+    if(count == 0)
+    {
+        return;
+    }
+
+    toRelative(&worldX[0], cameraWorld.x, &relativeX[0], count);
+    toRelative(&worldY[0], cameraWorld.y, &relativeY[0], count);
+    toRelative(&worldZ[0], cameraWorld.z, &relativeZ[0], count);
+}
+
+vec3 LargeWorld::toCameraRelative(const dvec3 &position) const
+{
+    return vec3(position - cameraWorld);
+}
+
+void LargeWorld::printPrecision() const
+{
+    double farthest = 0.0;
+    double absoluteError = 0.0;
+    double relativeError = 0.0;
+
+    const std::vector<double> *world[3] = {&worldX, &worldY, &worldZ};
+    const std::vector<float> *relative[3] = {&relativeX, &relativeY,
+                                             &relativeZ};
+    const double camera[3] = {cameraWorld.x, cameraWorld.y, cameraWorld.z};
+
+    for(int axis=0; axis<3; axis++)
+    {
+        for(int i=0; i<getInstanceCount(); i++)
+        {
+            double w = (*world[axis])[i];
+            double r = (*relative[axis])[i];
+
+            farthest = std::max(farthest, std::fabs(w));
+            absoluteError = std::max(absoluteError,
+                                     std::fabs((double)(float)w - w));
+            relativeError = std::max(relativeError,
+                                     std::fabs(r - (w - camera[axis])));
+        }
+    }
+
+    std::cout << "Large world: " << getInstanceCount() << " instances up to "
+    << farthest << " from the origin, off by up to " << absoluteError
+    << " as floats, " << relativeError << " camera relative" << std::endl;
+}
+
+///\/////////////////////////////////Getters////////////////////////////////////
+
+const float *LargeWorld::getRelativeX() const
+{
+    return relativeX.empty() ? NULL : &relativeX[0];
+}
+
+const float *LargeWorld::getRelativeY() const
+{
+    return relativeY.empty() ? NULL : &relativeY[0];
+}
+
+const float *LargeWorld::getRelativeZ() const
+{
+    return relativeZ.empty() ? NULL : &relativeZ[0];
+}
+
+dvec3 LargeWorld::getCameraPosition() const
+{
+    return cameraWorld;
+}
+
+int LargeWorld::getInstanceCount() const
+{
+    return worldX.size();
+}
+
+bool LargeWorld::isActive() const
+{
+    return bActive;
+}
+
+#endif // LARGEWORLD_H_INCLUDED
@@ -0,0 +1,76 @@
+#ifndef MATRIXBATCH_H_INCLUDED
+#define MATRIXBATCH_H_INCLUDED
+
+///SSE2 when the compiler targets it, plain glm otherwise
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace glm;
+
+///out[k] = left * right[indices[k]] for count matrices, the way the MVP of
+///every drawn instance is made: view-projection * model. indices picks the
+///matrices, NULL takes the first count in order. The left matrix stays in
+///registers for the whole batch, every product is 16 broadcasts and
+///multiply-adds of whole columns.
+void multiplyMatrixBatch(const mat4 &left, const mat4 *right,
+                         const int *indices, mat4 *out, int count);
+
+#ifdef __SSE2__
+///The columns of a * b, with the columns of a in registers
+static inline void multiplyColumns(const __m128 a[4], const float *b,
+                                   __m128 result[4])
+{
+    for(int c=0; c<4; c++)
+    {
+        __m128 column = _mm_mul_ps(a[0], _mm_set1_ps(b[c * 4]));
+        for(int k=1; k<4; k++)
+        {
+            column = _mm_add_ps(column,
+                                _mm_mul_ps(a[k], _mm_set1_ps(b[c * 4 + k])));
+        }
+        result[c] = column;
+    }
+}
+#endif
+
+void multiplyMatrixBatch(const mat4 &left, const mat4 *right,
+                         const int *indices, mat4 *out, int count)
+{
+#ifdef __SSE2__
+    const float *l = value_ptr(left);
+
+    __m128 leftColumns[4];
+    for(int c=0; c<4; c++)
+    {
+        leftColumns[c] = _mm_loadu_ps(l + c * 4);
+    }
+
+    for(int k=0; k<count; k++)
+    {
+        const mat4 &m = right[indices ? indices[k] : k];
+
+        ///The right matrix as 4 columns of scalars
+        __m128 result[4];
+        multiplyColumns(leftColumns, value_ptr(m), result);
+
+        float *o = value_ptr(out[k]);
+        for(int c=0; c<4; c++)
+        {
+            _mm_storeu_ps(o + c * 4, result[c]);
+        }
+    }
+#else
+    for(int k=0; k<count; k++)
+    {
+        out[k] = left * right[indices ? indices[k] : k];
+    }
+#endif
+}
+
+#endif // MATRIXBATCH_H_INCLUDED
@@ -0,0 +1,563 @@
+#ifndef MESHOPTIMIZER_H_INCLUDED
+#define MESHOPTIMIZER_H_INCLUDED
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+///GLM
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+///Entries of the FIFO post-transform cache ACMR and ATVR are measured with
+const int MESH_SIMULATED_CACHE = 16;
+
+///Entries of the LRU cache the triangle order is optimized for
+const int MESH_OPTIMIZER_CACHE = 32;
+
+///Interleaved vertex data with the position in the first 3 floats, and the
+///indices that draw it as GL_TRIANGLES or GL_TRIANGLE_STRIP
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    int stride;
+    GLenum mode;
+};
+
+///Box and sphere around every vertex of a mesh
+struct MeshBounds
+{
+    vec3 min;
+    vec3 max;
+    vec3 center;
+    float radius;
+};
+
+///How well the indices of a mesh use the post-transform cache
+///  ACMR - vertices transformed per triangle, 0.5 at best, 3 at worst
+///  ATVR - vertices transformed per vertex of the mesh, 1 at best
+struct VertexCacheStats
+{
+    unsigned int triangles;
+    unsigned int transformed;
+    float acmr;
+    float atvr;
+};
+
+///Processes meshes before they are uploaded, at load time or offline:
+///  bakeTransform        - a static local matrix goes into the positions
+///  optimizeVertexCache  - triangles reordered the way Tom Forsyth's linear
+///                         speed algorithm does, the next triangle is the one
+///                         whose vertices score best by their position in a
+///                         simulated LRU cache and the triangles they have left
+///  chooseTopology       - the list, a strip stitched from it, or the strip
+///                         the mesh came as, whichever transforms the fewest
+///                         vertices and then takes the fewest indices
+///  optimizeVertexFetch  - vertices renumbered in the order they're first
+///                         drawn, so fetches walk the buffer forwards
+///  computeBounds        - box and sphere for culling and LODs
+///optimize runs all of them and prints the cache stats before and after.
+class MeshOptimizer
+{
+    private:
+
+        ///Private Functions
+        static float vertexScore(int cachePosition, int remaining);
+        static std::vector<unsigned int>
+            makeStrip(const std::vector<unsigned int> &list);
+
+    public:
+
+        static void bakeTransform(MeshData &mesh, const mat4 &transform);
+        static void toTriangleList(MeshData &mesh);
+        static void optimizeVertexCache(MeshData &mesh);
+        static void optimizeVertexFetch(MeshData &mesh);
+
+        ///mesh holds the optimized triangle list, strip the strip it came
+        ///as or nothing. Returns the mode that was picked.
+        static GLenum chooseTopology(MeshData &mesh,
+                                     const std::vector<unsigned int> &strip);
+
+        static MeshBounds computeBounds(const MeshData &mesh);
+
+        ///FIFO cache simulation over the indices, in the order the GPU
+        ///reads them
+        static VertexCacheStats analyze(const MeshData &mesh,
+                                        int cacheSize = MESH_SIMULATED_CACHE);
+
+        ///Every step above, name goes in the report
+        static MeshBounds optimize(MeshData &mesh, const mat4 &transform,
+                                   const char *name);
+};
+
+void MeshOptimizer::bakeTransform(MeshData &mesh, const mat4 &transform)
+{
+    for(unsigned int i=0; i<mesh.vertices.size(); i+=mesh.stride)
+    {
+        float *p = &mesh.vertices[i];
+        vec4 position = transform * vec4(p[0], p[1], p[2], 1.0f);
+
+        p[0] = position.x;
+        p[1] = position.y;
+        p[2] = position.z;
+    }
+}
+
+void MeshOptimizer::toTriangleList(MeshData &mesh)
+{
+    if(mesh.mode != GL_TRIANGLE_STRIP)
+    {
+        return;
+    }
+
+    std::vector<unsigned int> list;
+    for(unsigned int k=0; k+2<mesh.indices.size(); k++)
+    {
+        ///Every odd triangle of a strip has its first two vertices swapped,
+        ///or it would face the other way
+        unsigned int a = mesh.indices[k + (k & 1)];
+        unsigned int b = mesh.indices[k + 1 - (k & 1)];
+        unsigned int c = mesh.indices[k + 2];
+
+        ///Skip the degenerate triangles that stitch strips together
+        if(a == b || b == c || a == c)
+        {
+            continue;
+        }
+
+        list.push_back(a);
+        list.push_back(b);
+        list.push_back(c);
+    }
+
+    mesh.indices.swap(list);
+    mesh.mode = GL_TRIANGLES;
+}
+
+///Forsyth's score of a vertex: the three of the last triangle score the same
+///so it isn't favoured over its neighbours, then falling off through the
+///cache. Vertices with few triangles left get a boost so no lone triangles
+///are left behind to be drawn at the end.
+float MeshOptimizer::vertexScore(int cachePosition, int remaining)
+{
+    if(remaining == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cachePosition >= 0)
+    {
+        if(cachePosition < 3)
+        {
+            score = 0.75f;
+        }
+        else
+        {
+            float scale = 1.0f / (MESH_OPTIMIZER_CACHE - 3);
+            score = pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+
+    return score + 2.0f / sqrt((float)remaining);
+}
+
+void MeshOptimizer::optimizeVertexCache(MeshData &mesh)
+{
+    int triangleCount = mesh.indices.size() / 3;
+    int vertexCount = mesh.vertices.size() / mesh.stride;
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    ///Triangles of every vertex, the ones still to be drawn first
+    std::vector<int> remaining(vertexCount, 0);
+    for(unsigned int i=0; i<mesh.indices.size(); i++)
+    {
+        remaining[mesh.indices[i]]++;
+    }
+
+    std::vector<int> adjacencyStart(vertexCount + 1, 0);
+    for(int v=0; v<vertexCount; v++)
+    {
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    }
+
+    std::vector<int> adjacency(mesh.indices.size());
+    std::vector<int> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for(unsigned int i=0; i<mesh.indices.size(); i++)
+    {
+        adjacency[filled[mesh.indices[i]]++] = i / 3;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for(int v=0; v<vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<char> drawn(triangleCount, 0);
+
+    ///Most recent first, three more than the cache while a triangle is added
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(MESH_OPTIMIZER_CACHE + 3);
+    newCache.reserve(MESH_OPTIMIZER_CACHE + 3);
+
+    std::vector<unsigned int> result;
+    result.reserve(mesh.indices.size());
+
+    int best = 0;
+    int nextUndrawn = 0;
+
+    for(int n=0; n<triangleCount; n++)
+    {
+        ///Nothing in the cache has triangles left, start anywhere
+        if(best < 0)
+        {
+            while(drawn[nextUndrawn])
+            {
+                nextUndrawn++;
+            }
+            best = nextUndrawn;
+        }
+
+        const unsigned int *tri = &mesh.indices[best * 3];
+        drawn[best] = 1;
+        result.insert(result.end(), tri, tri + 3);
+
+        ///The triangle leaves the lists of its vertices, which go to the
+        ///front of the cache
+        newCache.clear();
+        for(int k=0; k<3; k++)
+        {
+            unsigned int v = tri[k];
+            int *list = &adjacency[adjacencyStart[v]];
+            for(int i=0; i<remaining[v]; i++)
+            {
+                if(list[i] == best)
+                {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+            newCache.push_back(v);
+        }
+
+        for(unsigned int i=0; i<cache.size(); i++)
+        {
+            unsigned int v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        ///New scores for every vertex that moved, evicted ones included,
+        ///and for the triangles they have left. The best of those is next.
+        for(unsigned int i=0; i<newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = (int)i < MESH_OPTIMIZER_CACHE ? i : -1;
+            vertexScores[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for(unsigned int i=0; i<newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            const int *list = &adjacency[adjacencyStart[v]];
+            for(int j=0; j<remaining[v]; j++)
+            {
+                const unsigned int *other = &mesh.indices[list[j] * 3];
+                float score = vertexScores[other[0]] +
+                              vertexScores[other[1]] +
+                              vertexScores[other[2]];
+
+                if(score > bestScore)
+                {
+                    best = list[j];
+                    bestScore = score;
+                }
+            }
+        }
+
+        if(newCache.size() > (unsigned int)MESH_OPTIMIZER_CACHE)
+        {
+            newCache.resize(MESH_OPTIMIZER_CACHE);
+        }
+        cache.swap(newCache);
+    }
+
+    mesh.indices.swap(result);
+}
+
+///Greedy: a triangle continues the strip when it shares the strip's last
+///edge with the winding the strip expects there, anything else starts a new
+///strip joined to the last one by degenerate triangles.
+std::vector<unsigned int>
+    MeshOptimizer::makeStrip(const std::vector<unsigned int> &list)
+{
+    std::vector<unsigned int> strip;
+    unsigned int triangleCount = list.size() / 3;
+
+    for(unsigned int t=0; t<triangleCount; t++)
+    {
+        const unsigned int *tri = &list[t * 3];
+
+        ///Triangle k of a strip is (k, k+1, k+2), (k+1, k, k+2) when odd
+        if(strip.size() >= 3)
+        {
+            unsigned int k = strip.size() - 2;
+            unsigned int first = strip[k + (k & 1)];
+            unsigned int second = strip[k + 1 - (k & 1)];
+
+            bool bContinued = false;
+            for(int r=0; r<3 && !bContinued; r++)
+            {
+                if(tri[r] == first && tri[(r + 1) % 3] == second)
+                {
+                    strip.push_back(tri[(r + 2) % 3]);
+                    bContinued = true;
+                }
+            }
+
+            if(bContinued)
+            {
+                continue;
+            }
+        }
+
+        ///A new strip starts on an even triangle, the next one (odd) goes
+        ///on if it has the edge (third, second). Pick the rotation for that.
+        int rotation = 0;
+        if(t + 1 < triangleCount)
+        {
+            const unsigned int *next = &list[(t + 1) * 3];
+            for(int r=0; r<3; r++)
+            {
+                unsigned int second = tri[(r + 1) % 3];
+                unsigned int third = tri[(r + 2) % 3];
+                for(int e=0; e<3; e++)
+                {
+                    if(next[e] == third && next[(e + 1) % 3] == second)
+                    {
+                        rotation = r;
+                    }
+                }
+            }
+        }
+
+        if(!strip.empty())
+        {
+            unsigned int last = strip.back();
+            bool bOdd = strip.size() & 1;
+
+            strip.push_back(last);
+            strip.push_back(tri[rotation]);
+            if(bOdd)
+            {
+                strip.push_back(tri[rotation]);
+            }
+        }
+
+        for(int k=0; k<3; k++)
+        {
+            strip.push_back(tri[(rotation + k) % 3]);
+        }
+    }
+
+    return strip;
+}
+
+GLenum MeshOptimizer::chooseTopology(MeshData &mesh,
+                                     const std::vector<unsigned int> &strip)
+{
+    MeshData candidates[2] = {mesh, mesh};
+    candidates[0].indices = makeStrip(mesh.indices);
+    candidates[0].mode = GL_TRIANGLE_STRIP;
+    candidates[1].indices = strip;
+    candidates[1].mode = GL_TRIANGLE_STRIP;
+
+    VertexCacheStats bestStats = analyze(mesh);
+    for(int c=0; c<2; c++)
+    {
+        if(candidates[c].indices.empty())
+        {
+            continue;
+        }
+
+        VertexCacheStats stats = analyze(candidates[c]);
+        if(stats.transformed < bestStats.transformed ||
+           (stats.transformed == bestStats.transformed &&
+            candidates[c].indices.size() < mesh.indices.size()))
+        {
+            mesh.indices.swap(candidates[c].indices);
+            mesh.mode = GL_TRIANGLE_STRIP;
+            bestStats = stats;
+        }
+    }
+
+    return mesh.mode;
+}
+
+void MeshOptimizer::optimizeVertexFetch(MeshData &mesh)
+{
+    int vertexCount = mesh.vertices.size() / mesh.stride;
+
+    std::vector<int> remap(vertexCount, -1);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    ///Vertices no index uses are dropped
+    unsigned int next = 0;
+    for(unsigned int i=0; i<mesh.indices.size(); i++)
+    {
+        unsigned int v = mesh.indices[i];
+        if(remap[v] < 0)
+        {
+            remap[v] = next++;
+            vertices.insert(vertices.end(),
+                            mesh.vertices.begin() + v * mesh.stride,
+                            mesh.vertices.begin() + (v + 1) * mesh.stride);
+        }
+
+        mesh.indices[i] = remap[v];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+MeshBounds MeshOptimizer::computeBounds(const MeshData &mesh)
+{
+    MeshBounds bounds;
+    bounds.min = vec3(0.0f);
+    bounds.max = vec3(0.0f);
+    bounds.center = vec3(0.0f);
+    bounds.radius = 0.0f;
+
+    if(mesh.vertices.empty())
+    {
+        return bounds;
+    }
+
+    bounds.min = bounds.max = vec3(mesh.vertices[0], mesh.vertices[1],
+                                   mesh.vertices[2]);
+    for(unsigned int i=0; i<mesh.vertices.size(); i+=mesh.stride)
+    {
+        vec3 p(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+        bounds.min = glm::min(bounds.min, p);
+        bounds.max = glm::max(bounds.max, p);
+    }
+
+    ///Centered on the box, not the smallest sphere but close for our meshes
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    for(unsigned int i=0; i<mesh.vertices.size(); i+=mesh.stride)
+    {
+        vec3 p(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+        bounds.radius = glm::max(bounds.radius, length(p - bounds.center));
+    }
+
+    return bounds;
+}
+
+VertexCacheStats MeshOptimizer::analyze(const MeshData &mesh, int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = 0;
+    stats.transformed = 0;
+
+    std::vector<unsigned int> fifo(cacheSize);
+    int fifoUsed = 0;
+    int fifoNext = 0;
+
+    std::vector<char> used(mesh.vertices.size() / mesh.stride, 0);
+    unsigned int usedCount = 0;
+
+    for(unsigned int i=0; i<mesh.indices.size(); i++)
+    {
+        unsigned int v = mesh.indices[i];
+
+        bool bHit = false;
+        for(int c=0; c<fifoUsed && !bHit; c++)
+        {
+            bHit = fifo[c] == v;
+        }
+
+        if(!bHit)
+        {
+            fifo[fifoNext] = v;
+            fifoNext = (fifoNext + 1) % cacheSize;
+            fifoUsed = fifoUsed < cacheSize ? fifoUsed + 1 : cacheSize;
+            stats.transformed++;
+        }
+
+        if(!used[v])
+        {
+            used[v] = 1;
+            usedCount++;
+        }
+
+        ///Triangles that end here, degenerate ones don't count
+        bool bEnds = mesh.mode == GL_TRIANGLE_STRIP ? i >= 2 : i % 3 == 2;
+        if(bEnds)
+        {
+            unsigned int a = mesh.indices[i - 2];
+            unsigned int b = mesh.indices[i - 1];
+            if(a != b && b != v && a != v)
+            {
+                stats.triangles++;
+            }
+        }
+    }
+
+    stats.acmr = stats.triangles ? (float)stats.transformed / stats.triangles
+                                 : 0.0f;
+    stats.atvr = usedCount ? (float)stats.transformed / usedCount : 0.0f;
+
+    return stats;
+}
+
+MeshBounds MeshOptimizer::optimize(MeshData &mesh, const mat4 &transform,
+                                   const char *name)
+{
+    VertexCacheStats before = analyze(mesh);
+    unsigned int indicesBefore = mesh.indices.size();
+
+    bakeTransform(mesh, transform);
+
+    ///The strip it came as stays a candidate, a good one is hard to beat
+    std::vector<unsigned int> strip;
+    if(mesh.mode == GL_TRIANGLE_STRIP)
+    {
+        strip = mesh.indices;
+    }
+
+    toTriangleList(mesh);
+    optimizeVertexCache(mesh);
+    chooseTopology(mesh, strip);
+    optimizeVertexFetch(mesh);
+
+    VertexCacheStats after = analyze(mesh);
+
+    std::cout << name << ": " << after.triangles << " triangles, "
+    << mesh.vertices.size() / mesh.stride << " vertices, "
+    << indicesBefore << " -> " << mesh.indices.size() << " indices as a "
+    << (mesh.mode == GL_TRIANGLE_STRIP ? "strip" : "list")
+    << ", ACMR " << before.acmr << " -> " << after.acmr
+    << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+    return computeBounds(mesh);
+}
+
+#endif // MESHOPTIMIZER_H_INCLUDED
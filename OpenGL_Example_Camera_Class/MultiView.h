@@ -0,0 +1,205 @@
+#ifndef MULTIVIEW_H_INCLUDED
+#define MULTIVIEW_H_INCLUDED
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Camera.h"
+#include "Frustum.h"
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+///Size of the arrays of the view block in transform.glsl
+const int MAX_VIEWS = 8;
+
+///Uniform buffer binding point of the view block
+const int VIEW_BLOCK_BINDING = 0;
+
+///Yaw between two neighbouring views, in degrees
+const float VIEW_YAW_STEP = 30.0f;
+
+///The view block of transform.glsl, std140: every mat4 and vec4 of the
+///arrays takes its own size, so it matches the C++ layout
+struct ViewBlock
+{
+    mat4 viewProj[MAX_VIEWS];
+    ///Where every view goes on the screen: NDC center (xy) and scale (zw)
+    vec4 viewTiles[MAX_VIEWS];
+};
+
+///Draws the scene from several cameras in one pass. The view-projection
+///matrices of every camera are in one uniform buffer and every draw has one
+///instance per view: gl_InstanceID picks the camera, and the clip space
+///position is squeezed into the view's tile of the screen, with clip
+///distances so nothing crosses into the next tile. The number of draws
+///doesn't grow with the number of views.
+///The cameras fan out around the main one, VIEW_YAW_STEP apart.
+class MultiView
+{
+    private:
+
+        std::vector<Camera> cameras;
+        Frustum frusta[MAX_VIEWS];
+        ViewBlock block;
+        unsigned int uniformBuffer;
+        int iViews;
+
+    public:
+
+        ///Constructor
+        MultiView();
+
+        ///count views from now on, 1 is the normal single view path
+        void create(int count);
+
+        ///Defines the shader needs, none for a single view
+        void addDefines(ShaderDefines &defines);
+
+        ///Once per program, ties its view block to the buffer
+        void setupShader(Shader &s);
+
+        ///Once per frame, places the cameras around camera, lays the views
+        ///out on a screen of that size and uploads their matrices
+        void update(Camera &camera, float width, float height);
+
+        ///Binds the buffer of the views
+        void bind();
+
+        ///True if the sphere is inside the frustum of any view
+        bool sphereVisible(vec3 center, float radius) const;
+
+        ///Getters
+        int getViewCount();
+        bool isActive();
+        Camera &getCamera(int i);
+};
+
+///Constructor
+MultiView::MultiView()
+{
+    uniformBuffer = 0;
+    iViews = 1;
+}
+
+void MultiView::create(int count)
+{
+    if(count < 1 || count > MAX_VIEWS)
+    {
+        std::cout << "Between 1 and " << MAX_VIEWS << " views, not " << count
+        << std::endl;
+        count = count < 1 ? 1 : MAX_VIEWS;
+    }
+
+    iViews = count;
+
+    if(iViews > 1 && uniformBuffer == 0)
+    {
+        uniformBuffer = getRenderBackend()->createUniformBuffer(
+            sizeof(ViewBlock));
+    }
+
+    ///Every view writes 4 clip distances, one per edge of its tile
+    getRenderBackend()->enableClipDistances(iViews > 1 ? 4 : 0);
+}
+
+void MultiView::addDefines(ShaderDefines &defines)
+{
+    if(iViews > 1)
+    {
+        defines.push_back("MULTI_VIEW");
+    }
+}
+
+void MultiView::setupShader(Shader &s)
+{
+    if(iViews > 1 &&
+       !getRenderBackend()->setUniformBlockBinding(s.getID(), "ViewBlock",
+                                                   VIEW_BLOCK_BINDING))
+    {
+        std::cout << "Couldn't find uniform block ViewBlock" << std::endl;
+    }
+}
+
+void MultiView::update(Camera &camera, float width, float height)
+{
+    int columns = (int)ceilf(sqrtf((float)iViews));
+    int rows = (iViews + columns - 1) / columns;
+
+    cameras.clear();
+
+    for(int i=0; i<iViews; i++)
+    {
+        ///Turned by the same math the arrow keys use
+        Camera view = camera;
+        float fYaw = (i - (iViews - 1) * 0.5f) * VIEW_YAW_STEP;
+        if(fYaw != 0.0f)
+        {
+            view.MoveCamera(fYaw > 0.0f ? RIGHT_SPIN : LEFT_SPIN,
+                            fabsf(fYaw) / (SPEED * SENSITIVTY));
+        }
+        view.SetViewportSize(width / columns, height / rows);
+        cameras.push_back(view);
+
+        block.viewProj[i] = view.GetProjectionMatrix() *
+                            view.GetViewMatrix();
+        frusta[i].update(block.viewProj[i]);
+
+        ///Row 0 is at the top
+        int column = i % columns;
+        int row = i / columns;
+        block.viewTiles[i] = vec4(-1.0f + (2.0f * column + 1.0f) / columns,
+                                  1.0f - (2.0f * row + 1.0f) / rows,
+                                  1.0f / columns, 1.0f / rows);
+    }
+
+    ///Only the views in use
+    unsigned int size = sizeof(ViewBlock);
+    if(iViews < MAX_VIEWS)
+    {
+        size = (char*)&block.viewTiles[iViews] - (char*)&block;
+    }
+
+    getRenderBackend()->updateUniformBuffer(uniformBuffer, size, &block);
+}
+
+void MultiView::bind()
+{
+    getRenderBackend()->bindUniformBuffer(VIEW_BLOCK_BINDING, uniformBuffer);
+}
+
+bool MultiView::sphereVisible(vec3 center, float radius) const
+{
+    for(int i=0; i<iViews; i++)
+    {
+        if(frusta[i].sphereVisible(center, radius))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int MultiView::getViewCount()
+{
+    return iViews;
+}
+
+bool MultiView::isActive()
+{
+    return iViews > 1;
+}
+
+Camera &MultiView::getCamera(int i)
+{
+    return cameras[i];
+}
+
+#endif // MULTIVIEW_H_INCLUDED
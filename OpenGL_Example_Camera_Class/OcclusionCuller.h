@@ -0,0 +1,478 @@
+#ifndef OCCLUSIONCULLER_H_INCLUDED
+#define OCCLUSIONCULLER_H_INCLUDED
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+///SSE2 is used for the edge functions when the compiler has it
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ThreadPool.h"
+#include "FrameArena.h"
+
+using namespace glm;
+
+/// Default occlusion buffer values
+const int OCCLUSION_WIDTH  = 256;
+const int OCCLUSION_HEIGHT = 128;
+
+///An occluder triangle already in screen space, ready to rasterize
+struct OccluderTriangle
+{
+    ///Edge functions, inside when A*x + B*y + C >= 0 for all three edges
+    float A[3];
+    float B[3];
+    float C[3];
+
+    ///Depth plane, z = zA*x + zB*y + zC
+    float zA;
+    float zB;
+    float zC;
+
+    ///Bounding box in pixels
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+///Rasterizes a few occluders into a small depth buffer on the CPU, builds a
+///hierarchical Z pyramid from it and tests bounding boxes against it.
+///Depth goes from 0 (near plane) to 1 (far plane). It doesn't touch OpenGL so
+///it can run without a context.
+class OcclusionCuller
+{
+    private:
+
+        ///Size of the depth buffer
+        int iWidth;
+        int iHeight;
+
+        ///Level 0 is the depth buffer, every next level holds the farthest
+        ///depth of 2x2 texels of the previous one
+        std::vector< std::vector<float> > hiZ;
+        std::vector<int> levelWidth;
+        std::vector<int> levelHeight;
+
+        ///Current frame
+        mat4 viewProj;
+        std::vector<OccluderTriangle> triangles;
+
+        ///Threads for the rasterization, may be NULL
+        ThreadPool *pool;
+
+        ///Statistics
+        float fRasterTime;
+        int iTested;
+        int iRejected;
+
+        ///Private Functions
+        void setupTriangle(vec4 a, vec4 b, vec4 c);
+        void rasterizeBand(int y0, int y1);
+        void buildHiZ();
+
+    public:
+
+        ///Constructor
+        OcclusionCuller(int width = OCCLUSION_WIDTH,
+                        int height = OCCLUSION_HEIGHT, ThreadPool *p = NULL);
+
+        ///Clears the depth buffer and the statistics
+        void beginFrame(const mat4 &vp);
+
+        ///Queues a mesh (triangle list) as occluder for this frame
+        void addOccluder(const std::vector<vec3> &positions,
+                         const std::vector<unsigned int> &indices,
+                         const mat4 &model);
+
+        ///Rasterizes every occluder and builds the pyramid
+        void rasterizeOccluders();
+
+        ///True if the box is completely hidden behind the occluders
+        bool isOccluded(vec3 bMin, vec3 bMax);
+
+        ///Getters
+        int getWidth();
+        int getHeight();
+        const std::vector<float>& getDepthBuffer();
+        float getRasterTime();
+        float getRejectedFraction();
+
+        ///Print the cost and the result of the last frame
+        void printStats();
+};
+
+///Constructor
+OcclusionCuller::OcclusionCuller(int width, int height, ThreadPool *p)
+{
+    ///Rows are processed 4 pixels at a time
+    iWidth = (width + 3) & ~3;
+    iHeight = height;
+    pool = p;
+
+    fRasterTime = 0.0f;
+    iTested = 0;
+    iRejected = 0;
+
+    int w = iWidth;
+    int h = iHeight;
+    while(true)
+    {
+        levelWidth.push_back(w);
+        levelHeight.push_back(h);
+        hiZ.push_back(std::vector<float>(w * h, 1.0f));
+
+        if(w == 1 && h == 1)
+        {
+            break;
+        }
+
+        w = std::max(1, (w + 1) / 2);
+        h = std::max(1, (h + 1) / 2);
+    }
+}
+
+void OcclusionCuller::beginFrame(const mat4 &vp)
+{
+    viewProj = vp;
+    triangles.clear();
+
+    std::fill(hiZ[0].begin(), hiZ[0].end(), 1.0f);
+
+    iTested = 0;
+    iRejected = 0;
+}
+
+void OcclusionCuller::addOccluder(const std::vector<vec3> &positions,
+                                  const std::vector<unsigned int> &indices,
+                                  const mat4 &model)
+{
+    mat4 mvp = viewProj * model;
+
+    ///Only needed until the triangles are set up
+    FrameVector<vec4> clip(positions.size());
+    for(unsigned int i=0; i<positions.size(); i++)
+    {
+        clip[i] = mvp * vec4(positions[i], 1.0f);
+    }
+
+    for(unsigned int i=0; i+2<indices.size(); i+=3)
+    {
+        setupTriangle(clip[indices[i]], clip[indices[i+1]],
+                      clip[indices[i+2]]);
+    }
+}
+
+///Projects the triangle and precomputes its edge and depth equations
+void OcclusionCuller::setupTriangle(vec4 a, vec4 b, vec4 c)
+{
+    ///Triangles crossing the near plane are dropped, leaving out an occluder
+    ///is always safe
+    if(a.z < -a.w || b.z < -b.w || c.z < -c.w)
+    {
+        return;
+    }
+
+    vec4 v[3] = {a, b, c};
+    float x[3], y[3], z[3];
+    for(int i=0; i<3; i++)
+    {
+        x[i] = (v[i].x / v[i].w * 0.5f + 0.5f) * iWidth;
+        y[i] = (v[i].y / v[i].w * 0.5f + 0.5f) * iHeight;
+        z[i] = v[i].z / v[i].w * 0.5f + 0.5f;
+    }
+
+    float fArea = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+    if(fabsf(fArea) < 1e-6f)
+    {
+        return;
+    }
+
+    ///Make the winding counter clockwise so inside is always positive
+    if(fArea < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        fArea = -fArea;
+    }
+
+    OccluderTriangle t;
+
+    t.minX = std::max(0, (int)floorf(std::min(x[0], std::min(x[1], x[2]))));
+    t.maxX = std::min(iWidth - 1,
+                      (int)ceilf(std::max(x[0], std::max(x[1], x[2]))));
+    t.minY = std::max(0, (int)floorf(std::min(y[0], std::min(y[1], y[2]))));
+    t.maxY = std::min(iHeight - 1,
+                      (int)ceilf(std::max(y[1], std::max(y[0], y[2]))));
+
+    if(t.minX > t.maxX || t.minY > t.maxY)
+    {
+        return;
+    }
+
+    for(int e=0; e<3; e++)
+    {
+        int n = (e + 1) % 3;
+        t.A[e] = -(y[n] - y[e]);
+        t.B[e] = x[n] - x[e];
+        t.C[e] = (y[n] - y[e]) * x[e] - (x[n] - x[e]) * y[e];
+    }
+
+    t.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) /
+           fArea;
+    t.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) /
+           fArea;
+    t.zC = z[0] - t.zA * x[0] - t.zB * y[0];
+
+    triangles.push_back(t);
+}
+
+///Rasterizes every triangle in the rows [y0, y1). Bands don't share pixels so
+///they can run on different threads.
+void OcclusionCuller::rasterizeBand(int y0, int y1)
+{
+    float *depth = &hiZ[0][0];
+
+    for(unsigned int i=0; i<triangles.size(); i++)
+    {
+        const OccluderTriangle &t = triangles[i];
+
+        int rowStart = std::max(y0, t.minY);
+        int rowEnd = std::min(y1 - 1, t.maxY);
+        int colStart = t.minX & ~3;
+
+        for(int y=rowStart; y<=rowEnd; y++)
+        {
+            float py = y + 0.5f;
+            float *row = depth + y * iWidth;
+
+#ifdef __SSE2__
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 e0Row = _mm_set1_ps(t.B[0] * py + t.C[0]);
+            __m128 e1Row = _mm_set1_ps(t.B[1] * py + t.C[1]);
+            __m128 e2Row = _mm_set1_ps(t.B[2] * py + t.C[2]);
+            __m128 zRow = _mm_set1_ps(t.zB * py + t.zC);
+
+            for(int x=colStart; x<=t.maxX; x+=4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[0]), px),
+                                       e0Row);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[1]), px),
+                                       e1Row);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.A[2]), px),
+                                       e2Row);
+
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                _mm_and_ps(_mm_cmpge_ps(e1, zero),
+                                           _mm_cmpge_ps(e2, zero)));
+
+                if(_mm_movemask_ps(inside) == 0)
+                {
+                    continue;
+                }
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.zA), px), zRow);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                                 _mm_andnot_ps(inside, old)));
+            }
+#else
+            for(int x=colStart; x<=t.maxX; x++)
+            {
+                float px = x + 0.5f;
+
+                if(t.A[0] * px + t.B[0] * py + t.C[0] >= 0.0f &&
+                   t.A[1] * px + t.B[1] * py + t.C[1] >= 0.0f &&
+                   t.A[2] * px + t.B[2] * py + t.C[2] >= 0.0f)
+                {
+                    float z = t.zA * px + t.zB * py + t.zC;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+#endif
+        }
+    }
+}
+
+///Every texel of a level is the farthest depth of the 2x2 texels under it
+void OcclusionCuller::buildHiZ()
+{
+    for(unsigned int l=1; l<hiZ.size(); l++)
+    {
+        const std::vector<float> &src = hiZ[l-1];
+        std::vector<float> &dst = hiZ[l];
+
+        int sw = levelWidth[l-1];
+        int sh = levelHeight[l-1];
+
+        for(int y=0; y<levelHeight[l]; y++)
+        {
+            int y0 = std::min(y * 2, sh - 1);
+            int y1 = std::min(y * 2 + 1, sh - 1);
+
+            for(int x=0; x<levelWidth[l]; x++)
+            {
+                int x0 = std::min(x * 2, sw - 1);
+                int x1 = std::min(x * 2 + 1, sw - 1);
+
+                dst[y * levelWidth[l] + x] =
+                    std::max(std::max(src[y0 * sw + x0], src[y0 * sw + x1]),
+                             std::max(src[y1 * sw + x0], src[y1 * sw + x1]));
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeOccluders()
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    int bands = pool ? pool->getThreadCount() * 2 : 1;
+    int bandHeight = (iHeight + bands - 1) / bands;
+
+    if(pool)
+    {
+        pool->run(bands, [&](int b)
+        {
+            rasterizeBand(b * bandHeight,
+                          std::min(iHeight, (b + 1) * bandHeight));
+        });
+    }
+    else
+    {
+        rasterizeBand(0, iHeight);
+    }
+
+    buildHiZ();
+
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    fRasterTime = elapsed.count();
+}
+
+bool OcclusionCuller::isOccluded(vec3 bMin, vec3 bMax)
+{
+    iTested++;
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    float minZ = 1.0f;
+
+    for(int i=0; i<8; i++)
+    {
+        vec4 p = viewProj * vec4(i & 1 ? bMax.x : bMin.x,
+                                 i & 2 ? bMax.y : bMin.y,
+                                 i & 4 ? bMax.z : bMin.z, 1.0f);
+
+        ///The box touches the near plane, we can't tell
+        if(p.z < -p.w || p.w <= 0.0f)
+        {
+            return false;
+        }
+
+        float x = (p.x / p.w * 0.5f + 0.5f) * iWidth;
+        float y = (p.y / p.w * 0.5f + 0.5f) * iHeight;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, p.z / p.w * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, (int)floorf(minX));
+    int y0 = std::max(0, (int)floorf(minY));
+    int x1 = std::min(iWidth - 1, (int)floorf(maxX));
+    int y1 = std::min(iHeight - 1, (int)floorf(maxY));
+
+    ///Out of the screen, that's the frustum culling's job
+    if(x0 > x1 || y0 > y1)
+    {
+        return false;
+    }
+
+    ///Go down the pyramid until the box covers at most 2x2 texels
+    unsigned int l = 0;
+    while(l + 1 < hiZ.size() && ((x1 >> l) - (x0 >> l) > 1 ||
+                                 (y1 >> l) - (y0 >> l) > 1))
+    {
+        l++;
+    }
+
+    float maxDepth = 0.0f;
+    for(int y=(y0 >> l); y<=(y1 >> l); y++)
+    {
+        for(int x=(x0 >> l); x<=(x1 >> l); x++)
+        {
+            maxDepth = std::max(maxDepth, hiZ[l][y * levelWidth[l] + x]);
+        }
+    }
+
+    if(minZ > maxDepth)
+    {
+        iRejected++;
+        return true;
+    }
+
+    return false;
+}
+
+///\/////////////////////////////////Getters////////////////////////////////////
+
+int OcclusionCuller::getWidth()
+{
+    return iWidth;
+}
+
+int OcclusionCuller::getHeight()
+{
+    return iHeight;
+}
+
+const std::vector<float>& OcclusionCuller::getDepthBuffer()
+{
+    return hiZ[0];
+}
+
+float OcclusionCuller::getRasterTime()
+{
+    return fRasterTime;
+}
+
+float OcclusionCuller::getRejectedFraction()
+{
+    if(iTested == 0)
+    {
+        return 0.0f;
+    }
+
+    return (float)iRejected / (float)iTested;
+}
+
+///\////////////////////////////////////////////////////////////////////////////
+
+void OcclusionCuller::printStats()
+{
+    std::cout << "Occlusion: " << triangles.size() << " occluder triangles in "
+    << fRasterTime << " ms, rejected " << iRejected << " of " << iTested
+    << " instances (" << getRejectedFraction() * 100.0f << "%)" << std::endl;
+}
+
+#endif // OCCLUSIONCULLER_H_INCLUDED
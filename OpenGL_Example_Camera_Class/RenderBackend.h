@@ -0,0 +1,1873 @@
+#ifndef RENDERBACKEND_H_INCLUDED
+#define RENDERBACKEND_H_INCLUDED
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+///Every call a backend can receive, also the opcodes of the recorded log
+enum Backend_Command
+{
+    CMD_CREATE_PROGRAM = 1,
+    CMD_GET_UNIFORM_LOCATION,
+    CMD_USE_PROGRAM,
+    CMD_UNIFORM_1I,
+    CMD_UNIFORM_1F,
+    CMD_UNIFORM_MATRIX4FV,
+    CMD_CREATE_VERTEX_ARRAY,
+    CMD_BIND_VERTEX_ARRAY,
+    CMD_DRAW_ELEMENTS,
+    CMD_CREATE_TEXTURE_2D,
+    CMD_BIND_TEXTURE,
+    CMD_CLEAR,
+    CMD_ENABLE_DEPTH_TEST,
+    CMD_END_FRAME,
+    CMD_UNIFORM_2UIV,
+    CMD_CREATE_TEXTURE_ARRAY,
+    CMD_BIND_TEXTURE_ARRAY,
+    CMD_DELETE_TEXTURE,
+    CMD_CREATE_UNIFORM_BUFFER,
+    CMD_UPDATE_UNIFORM_BUFFER,
+    CMD_BIND_UNIFORM_BUFFER,
+    CMD_UNIFORM_BLOCK_BINDING,
+    CMD_DRAW_ELEMENTS_INSTANCED,
+    CMD_ENABLE_CLIP_DISTANCES
+};
+
+///Layout of one attribute inside the vertex buffer, in floats
+struct VertexAttribute
+{
+    unsigned int index;
+    int size;
+    int stride;
+    int offset;
+};
+
+///Calls made since the last resetStats()
+struct BackendStats
+{
+    unsigned int programBinds;
+    unsigned int uniformSets;
+    unsigned int vertexArrayBinds;
+    unsigned int drawCalls;
+    unsigned int textureCreates;
+    unsigned int textureBinds;
+    unsigned int bufferUpdates;
+
+    ///glBind* and glActiveTexture calls, to draw and to edit. Only the
+    ///OpenGL backend counts them.
+    unsigned int bindCalls;
+};
+
+///Everything the renderer asks from the graphics API goes through here, so
+///the same frame can run on OpenGL, on nothing or into a log
+class RenderBackend
+{
+    protected:
+
+        BackendStats stats;
+
+    public:
+
+        ///Constructor
+        RenderBackend();
+        virtual ~RenderBackend() {}
+
+        ///Programs, returns 0 if compiling or linking failed
+        virtual unsigned int createProgram(const std::string &vertexCode,
+                                           const std::string &fragmentCode) = 0;
+        virtual int getUniformLocation(unsigned int program,
+                                       const char *name) = 0;
+        virtual void useProgram(unsigned int program) = 0;
+
+        ///Uniforms of the current program
+        virtual void setUniform1i(int location, int value) = 0;
+        virtual void setUniform1f(int location, float value) = 0;
+        virtual void setUniformMatrix4fv(int location, const float *m) = 0;
+        virtual void setUniform2uiv(int location, int count,
+                                    const unsigned int *values) = 0;
+
+        ///Geometry, the vertex array owns its vertex and element buffers
+        virtual unsigned int createVertexArray(const float *vertices,
+                                               unsigned int vertexBytes,
+                                               const unsigned int *indices,
+                                               unsigned int indexBytes,
+                                               const VertexAttribute *attribs,
+                                               int attribCount) = 0;
+        virtual void bindVertexArray(unsigned int vao) = 0;
+        virtual void drawElements(GLenum mode, unsigned int count,
+                                  unsigned int firstIndex, int baseVertex) = 0;
+        virtual void drawElementsInstanced(GLenum mode, unsigned int count,
+                                           unsigned int firstIndex,
+                                           int baseVertex,
+                                           int instances) = 0;
+
+        ///Uniform buffers, the block of a program is tied to a binding point
+        ///and the buffer bound there feeds it. False if the program has no
+        ///block of that name.
+        virtual unsigned int createUniformBuffer(unsigned int size) = 0;
+        virtual void updateUniformBuffer(unsigned int buffer,
+                                         unsigned int size,
+                                         const void *data) = 0;
+        virtual void bindUniformBuffer(int binding, unsigned int buffer) = 0;
+        virtual bool setUniformBlockBinding(unsigned int program,
+                                            const char *name,
+                                            int binding) = 0;
+
+        ///Textures, RGB(A) 8 bits with mipmaps, repeat and linear filtering
+        virtual unsigned int createTexture2D(int width, int height,
+                                             int channels,
+                                             const unsigned char *data) = 0;
+        virtual void bindTexture(int unit, unsigned int texture) = 0;
+        virtual void deleteTexture(unsigned int texture) = 0;
+
+        ///Texture arrays, RGBA 8 bits, layers are stored one after the other
+        virtual unsigned int createTextureArray(int width, int height,
+                                                int layers,
+                                                const unsigned char *data) = 0;
+        virtual void bindTextureArray(int unit, unsigned int texture) = 0;
+
+        ///Bindless textures, the handle of a 2D texture made resident. Only
+        ///valid if supportsBindless() is true.
+        virtual bool supportsBindless() { return false; }
+        virtual unsigned long long getBindlessHandle(unsigned int texture)
+        {
+            return 0;
+        }
+
+        ///Creates and edits the resources through their names instead of
+        ///binding them first, if the context can. False if it can't.
+        virtual bool setDirectStateAccess(bool bEnable) { return false; }
+        virtual bool usesDirectStateAccess() { return false; }
+
+        ///Bindings of what the lighting clusters, the GPU culling, the
+        ///capture and the dynamic resolution create and fill themselves.
+        ///Counted, not recorded: none of them runs in a replay. The texture
+        ///leaves unit 0 active, for the textures edited after it.
+        virtual void bindBuffer(GLenum target, unsigned int buffer) {}
+        virtual void bindBufferBase(GLenum target, int index,
+                                    unsigned int buffer) {}
+        virtual void bindTextureTarget(GLenum target, int unit,
+                                       unsigned int texture) {}
+        virtual void bindFramebuffer(GLenum target,
+                                     unsigned int framebuffer) {}
+        virtual void bindRenderbuffer(unsigned int renderbuffer) {}
+
+        ///Frame
+        virtual void clear(float r, float g, float b, float a) = 0;
+        virtual void enableDepthTest() = 0;
+        ///gl_ClipDistance[0] to [count - 1] are used, 0 turns them off
+        virtual void enableClipDistances(int count) = 0;
+        virtual void endFrame() {}
+
+        ///Statistics
+        BackendStats getStats();
+        void resetStats();
+};
+
+///Constructor
+RenderBackend::RenderBackend()
+{
+    resetStats();
+}
+
+BackendStats RenderBackend::getStats()
+{
+    return stats;
+}
+
+void RenderBackend::resetStats()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+///\//////////////////////////////////GLBackend/////////////////////////////////
+
+///Straight OpenGL calls, needs a current context. With direct state access
+///(GL 4.5 or ARB_direct_state_access) the buffers and textures get immutable
+///storage and are filled, configured and bound to their units through their
+///names: nothing is bound to edit it, and the bindings the draws use stay
+///as they are. Otherwise everything is bound to a target and edited there.
+class GLBackend : public RenderBackend
+{
+    private:
+
+        bool bDirectStateAccess;
+
+        unsigned int compileShader(GLenum type, const std::string &code);
+
+        ///Levels of a full mipmap chain
+        static int getMipLevels(int width, int height);
+
+    public:
+
+        ///Constructor
+        GLBackend();
+
+        unsigned int createProgram(const std::string &vertexCode,
+                                   const std::string &fragmentCode);
+        int getUniformLocation(unsigned int program, const char *name);
+        void useProgram(unsigned int program);
+
+        void setUniform1i(int location, int value);
+        void setUniform1f(int location, float value);
+        void setUniformMatrix4fv(int location, const float *m);
+        void setUniform2uiv(int location, int count,
+                            const unsigned int *values);
+
+        unsigned int createVertexArray(const float *vertices,
+                                       unsigned int vertexBytes,
+                                       const unsigned int *indices,
+                                       unsigned int indexBytes,
+                                       const VertexAttribute *attribs,
+                                       int attribCount);
+        void bindVertexArray(unsigned int vao);
+        void drawElements(GLenum mode, unsigned int count,
+                          unsigned int firstIndex, int baseVertex);
+        void drawElementsInstanced(GLenum mode, unsigned int count,
+                                   unsigned int firstIndex, int baseVertex,
+                                   int instances);
+
+        unsigned int createUniformBuffer(unsigned int size);
+        void updateUniformBuffer(unsigned int buffer, unsigned int size,
+                                 const void *data);
+        void bindUniformBuffer(int binding, unsigned int buffer);
+        bool setUniformBlockBinding(unsigned int program, const char *name,
+                                    int binding);
+
+        unsigned int createTexture2D(int width, int height, int channels,
+                                     const unsigned char *data);
+        void bindTexture(int unit, unsigned int texture);
+        void deleteTexture(unsigned int texture);
+        unsigned int createTextureArray(int width, int height, int layers,
+                                        const unsigned char *data);
+        void bindTextureArray(int unit, unsigned int texture);
+        bool supportsBindless();
+        unsigned long long getBindlessHandle(unsigned int texture);
+        bool setDirectStateAccess(bool bEnable);
+        bool usesDirectStateAccess();
+
+        void bindBuffer(GLenum target, unsigned int buffer);
+        void bindBufferBase(GLenum target, int index, unsigned int buffer);
+        void bindTextureTarget(GLenum target, int unit, unsigned int texture);
+        void bindFramebuffer(GLenum target, unsigned int framebuffer);
+        void bindRenderbuffer(unsigned int renderbuffer);
+
+        void clear(float r, float g, float b, float a);
+        void enableDepthTest();
+        void enableClipDistances(int count);
+};
+
+///Constructor
+GLBackend::GLBackend()
+{
+    bDirectStateAccess = false;
+}
+
+int GLBackend::getMipLevels(int width, int height)
+{
+    int levels = 1;
+    while((width | height) >> levels)
+    {
+        levels++;
+    }
+
+    return levels;
+}
+
+bool GLBackend::setDirectStateAccess(bool bEnable)
+{
+    bDirectStateAccess = bEnable && (GLEW_VERSION_4_5 ||
+                                     GLEW_ARB_direct_state_access);
+    return bDirectStateAccess;
+}
+
+bool GLBackend::usesDirectStateAccess()
+{
+    return bDirectStateAccess;
+}
+
+void GLBackend::bindBuffer(GLenum target, unsigned int buffer)
+{
+    stats.bindCalls++;
+    glBindBuffer(target, buffer);
+}
+
+void GLBackend::bindBufferBase(GLenum target, int index, unsigned int buffer)
+{
+    stats.bindCalls++;
+    glBindBufferBase(target, index, buffer);
+}
+
+void GLBackend::bindTextureTarget(GLenum target, int unit,
+                                  unsigned int texture)
+{
+    ///Always to the target, glBindTextureUnit refuses a texture that was
+    ///only named by glGenTextures and never bound
+    stats.textureBinds++;
+    stats.bindCalls += 2;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+
+    if(unit != 0)
+    {
+        stats.bindCalls++;
+        glActiveTexture(GL_TEXTURE0);
+    }
+}
+
+void GLBackend::bindFramebuffer(GLenum target, unsigned int framebuffer)
+{
+    stats.bindCalls++;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void GLBackend::bindRenderbuffer(unsigned int renderbuffer)
+{
+    stats.bindCalls++;
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+}
+
+unsigned int GLBackend::compileShader(GLenum type, const std::string &code)
+{
+    const char *source = code.c_str();
+    const char *name = type == GL_VERTEX_SHADER ? "Vertex" : "Fragment";
+    int success;
+    char infoLog[512];
+
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    /// print compile errors if any
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if(success)
+    {
+        std::cout << name << " Shader compiled successfully" << std::endl;
+    }
+    else
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << (type == GL_VERTEX_SHADER ?
+                     "VERTEX" : "FRAGMENT") << "::COMPILATION_FAILED\n"
+        << infoLog << std::endl;
+    }
+
+    return shader;
+}
+
+unsigned int GLBackend::createProgram(const std::string &vertexCode,
+                                      const std::string &fragmentCode)
+{
+    int success;
+    char infoLog[512];
+
+    unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexCode);
+    unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
+
+    ///Link the shaders, to the shader program
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+
+    /// print linking errors if any
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(success)
+    {
+        std::cout << "Shader Program of ID " << program
+        << " was linked successfully" << std::endl;
+    }
+    else
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog
+        << std::endl;
+    }
+
+    ///Once the linking is done, delete the shader objects
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    ///A program that didn't link is of no use, 0 as documented
+    if(!success)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+int GLBackend::getUniformLocation(unsigned int program, const char *name)
+{
+    return glGetUniformLocation(program, name);
+}
+
+void GLBackend::useProgram(unsigned int program)
+{
+    stats.programBinds++;
+    glUseProgram(program);
+}
+
+void GLBackend::setUniform1i(int location, int value)
+{
+    stats.uniformSets++;
+    glUniform1i(location, value);
+}
+
+void GLBackend::setUniform1f(int location, float value)
+{
+    stats.uniformSets++;
+    glUniform1f(location, value);
+}
+
+void GLBackend::setUniformMatrix4fv(int location, const float *m)
+{
+    stats.uniformSets++;
+    glUniformMatrix4fv(location, 1, GL_FALSE, m);
+}
+
+unsigned int GLBackend::createVertexArray(const float *vertices,
+                                          unsigned int vertexBytes,
+                                          const unsigned int *indices,
+                                          unsigned int indexBytes,
+                                          const VertexAttribute *attribs,
+                                          int attribCount)
+{
+    unsigned int vao, vbo, ebo;
+
+    if(bDirectStateAccess)
+    {
+        glCreateVertexArrays(1, &vao);
+        glCreateBuffers(1, &vbo);
+        glCreateBuffers(1, &ebo);
+
+        glNamedBufferStorage(vbo, vertexBytes, vertices, 0);
+        glNamedBufferStorage(ebo, indexBytes, indices, 0);
+
+        ///The format of every attribute apart from the buffer it reads.
+        ///Attributes with the stride of the first one share its binding.
+        for(int i=0; i<attribCount; i++)
+        {
+            unsigned int binding = attribs[i].stride == attribs[0].stride ?
+                                   0 : attribs[i].index;
+
+            glVertexArrayVertexBuffer(vao, binding, vbo, 0,
+                                      attribs[i].stride * sizeof(float));
+            glVertexArrayAttribFormat(vao, attribs[i].index, attribs[i].size,
+                                      GL_FLOAT, GL_FALSE,
+                                      attribs[i].offset * sizeof(float));
+            glVertexArrayAttribBinding(vao, attribs[i].index, binding);
+            glEnableVertexArrayAttrib(vao, attribs[i].index);
+        }
+
+        glVertexArrayElementBuffer(vao, ebo);
+        return vao;
+    }
+
+    stats.bindCalls += 3;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+
+    ///First Bind the VAO, so that all the configuration is saved in this VAO
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+
+    ///Set the info of how the VBO must be read
+    for(int i=0; i<attribCount; i++)
+    {
+        glVertexAttribPointer(attribs[i].index, attribs[i].size, GL_FLOAT,
+                              GL_FALSE, attribs[i].stride * sizeof(float),
+                              (void*)(attribs[i].offset * sizeof(float)));
+        glEnableVertexAttribArray(attribs[i].index);
+    }
+
+    return vao;
+}
+
+void GLBackend::bindVertexArray(unsigned int vao)
+{
+    stats.vertexArrayBinds++;
+    stats.bindCalls++;
+    glBindVertexArray(vao);
+}
+
+void GLBackend::drawElements(GLenum mode, unsigned int count,
+                             unsigned int firstIndex, int baseVertex)
+{
+    stats.drawCalls++;
+    glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT,
+                             (void*)(firstIndex * sizeof(unsigned int)),
+                             baseVertex);
+}
+
+void GLBackend::drawElementsInstanced(GLenum mode, unsigned int count,
+                                      unsigned int firstIndex, int baseVertex,
+                                      int instances)
+{
+    stats.drawCalls++;
+    glDrawElementsInstancedBaseVertex(mode, count, GL_UNSIGNED_INT,
+                                      (void*)(firstIndex *
+                                              sizeof(unsigned int)),
+                                      instances, baseVertex);
+}
+
+unsigned int GLBackend::createUniformBuffer(unsigned int size)
+{
+    unsigned int buffer;
+
+    if(bDirectStateAccess)
+    {
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, NULL, GL_DYNAMIC_STORAGE_BIT);
+        return buffer;
+    }
+
+    stats.bindCalls += 2;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    return buffer;
+}
+
+void GLBackend::updateUniformBuffer(unsigned int buffer, unsigned int size,
+                                    const void *data)
+{
+    stats.bufferUpdates++;
+
+    if(bDirectStateAccess)
+    {
+        glNamedBufferSubData(buffer, 0, size, data);
+        return;
+    }
+
+    stats.bindCalls += 2;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void GLBackend::bindUniformBuffer(int binding, unsigned int buffer)
+{
+    stats.bindCalls++;
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+bool GLBackend::setUniformBlockBinding(unsigned int program, const char *name,
+                                       int binding)
+{
+    unsigned int index = glGetUniformBlockIndex(program, name);
+    if(index == GL_INVALID_INDEX)
+    {
+        return false;
+    }
+
+    glUniformBlockBinding(program, index, binding);
+    return true;
+}
+
+unsigned int GLBackend::createTexture2D(int width, int height, int channels,
+                                        const unsigned char *data)
+{
+    unsigned int texture;
+    GLint previous;
+    GLenum format = channels == 4 ? GL_RGBA : GL_RGB;
+
+    stats.textureCreates++;
+
+    ///Rows of RGB images aren't always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if(bDirectStateAccess)
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTextureStorage2D(texture, getMipLevels(width, height),
+                           channels == 4 ? GL_RGBA8 : GL_RGB8, width, height);
+        if(data)
+        {
+            glTextureSubImage2D(texture, 0, 0, 0, width, height, format,
+                                GL_UNSIGNED_BYTE, data);
+            glGenerateTextureMipmap(texture);
+        }
+
+        return texture;
+    }
+
+    stats.bindCalls += 2;
+
+    ///Creating a texture must not change what the active unit samples
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    ///Set the texture wrapping/filtering options
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    ///Populate the object with data and generate its MipMap
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
+                 GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glBindTexture(GL_TEXTURE_2D, previous);
+
+    return texture;
+}
+
+void GLBackend::bindTexture(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+
+    if(bDirectStateAccess)
+    {
+        stats.bindCalls++;
+        glBindTextureUnit(unit, texture);
+        return;
+    }
+
+    stats.bindCalls += 2;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLBackend::setUniform2uiv(int location, int count,
+                               const unsigned int *values)
+{
+    stats.uniformSets++;
+    glUniform2uiv(location, count, values);
+}
+
+unsigned int GLBackend::createTextureArray(int width, int height, int layers,
+                                           const unsigned char *data)
+{
+    unsigned int texture;
+    GLint previous;
+
+    stats.textureCreates++;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if(bDirectStateAccess)
+    {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTextureStorage3D(texture, getMipLevels(width, height), GL_RGBA8,
+                           width, height, layers);
+        if(data)
+        {
+            glTextureSubImage3D(texture, 0, 0, 0, 0, width, height, layers,
+                                GL_RGBA, GL_UNSIGNED_BYTE, data);
+            glGenerateTextureMipmap(texture);
+        }
+
+        return texture;
+    }
+
+    stats.bindCalls += 2;
+
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previous);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+    ///Same options as the 2D textures
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, previous);
+
+    return texture;
+}
+
+void GLBackend::bindTextureArray(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+
+    if(bDirectStateAccess)
+    {
+        stats.bindCalls++;
+        glBindTextureUnit(unit, texture);
+        return;
+    }
+
+    stats.bindCalls += 2;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+bool GLBackend::supportsBindless()
+{
+    return GLEW_ARB_bindless_texture;
+}
+
+unsigned long long GLBackend::getBindlessHandle(unsigned int texture)
+{
+    GLuint64 handle = glGetTextureHandleARB(texture);
+    glMakeTextureHandleResidentARB(handle);
+    return handle;
+}
+
+void GLBackend::deleteTexture(unsigned int texture)
+{
+    glDeleteTextures(1, &texture);
+}
+
+void GLBackend::clear(float r, float g, float b, float a)
+{
+    glClearColor(r, g, b, a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GLBackend::enableDepthTest()
+{
+    glEnable(GL_DEPTH_TEST);
+}
+
+void GLBackend::enableClipDistances(int count)
+{
+    for(int i=0; i<8; i++)
+    {
+        if(i < count)
+        {
+            glEnable(GL_CLIP_DISTANCE0 + i);
+        }
+        else
+        {
+            glDisable(GL_CLIP_DISTANCE0 + i);
+        }
+    }
+}
+
+///\/////////////////////////////////NullBackend////////////////////////////////
+
+///Takes every call and does nothing, only counts. Used to measure the CPU
+///cost of our own frame without the driver.
+class NullBackend : public RenderBackend
+{
+    private:
+
+        unsigned int nextID;
+
+        ///Uniform names of every program, the location is the index
+        std::map<unsigned int, std::vector<std::string> > uniforms;
+
+    public:
+
+        ///Constructor
+        NullBackend();
+
+        unsigned int createProgram(const std::string &vertexCode,
+                                   const std::string &fragmentCode);
+        int getUniformLocation(unsigned int program, const char *name);
+        void useProgram(unsigned int program);
+
+        void setUniform1i(int location, int value);
+        void setUniform1f(int location, float value);
+        void setUniformMatrix4fv(int location, const float *m);
+        void setUniform2uiv(int location, int count,
+                            const unsigned int *values);
+
+        unsigned int createVertexArray(const float *vertices,
+                                       unsigned int vertexBytes,
+                                       const unsigned int *indices,
+                                       unsigned int indexBytes,
+                                       const VertexAttribute *attribs,
+                                       int attribCount);
+        void bindVertexArray(unsigned int vao);
+        void drawElements(GLenum mode, unsigned int count,
+                          unsigned int firstIndex, int baseVertex);
+        void drawElementsInstanced(GLenum mode, unsigned int count,
+                                   unsigned int firstIndex, int baseVertex,
+                                   int instances);
+
+        unsigned int createUniformBuffer(unsigned int size);
+        void updateUniformBuffer(unsigned int buffer, unsigned int size,
+                                 const void *data);
+        void bindUniformBuffer(int binding, unsigned int buffer);
+        bool setUniformBlockBinding(unsigned int program, const char *name,
+                                    int binding);
+
+        unsigned int createTexture2D(int width, int height, int channels,
+                                     const unsigned char *data);
+        void bindTexture(int unit, unsigned int texture);
+        void deleteTexture(unsigned int texture);
+        unsigned int createTextureArray(int width, int height, int layers,
+                                        const unsigned char *data);
+        void bindTextureArray(int unit, unsigned int texture);
+        bool supportsBindless();
+        unsigned long long getBindlessHandle(unsigned int texture);
+
+        void clear(float r, float g, float b, float a);
+        void enableDepthTest();
+        void enableClipDistances(int count);
+};
+
+///Constructor
+NullBackend::NullBackend()
+{
+    nextID = 1;
+}
+
+unsigned int NullBackend::createProgram(const std::string &vertexCode,
+                                        const std::string &fragmentCode)
+{
+    return nextID++;
+}
+
+int NullBackend::getUniformLocation(unsigned int program, const char *name)
+{
+    std::vector<std::string> &names = uniforms[program];
+
+    for(unsigned int i=0; i<names.size(); i++)
+    {
+        if(names[i] == name)
+        {
+            return i;
+        }
+    }
+
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+void NullBackend::useProgram(unsigned int program)
+{
+    stats.programBinds++;
+}
+
+void NullBackend::setUniform1i(int location, int value)
+{
+    stats.uniformSets++;
+}
+
+void NullBackend::setUniform1f(int location, float value)
+{
+    stats.uniformSets++;
+}
+
+void NullBackend::setUniformMatrix4fv(int location, const float *m)
+{
+    stats.uniformSets++;
+}
+
+unsigned int NullBackend::createVertexArray(const float *vertices,
+                                            unsigned int vertexBytes,
+                                            const unsigned int *indices,
+                                            unsigned int indexBytes,
+                                            const VertexAttribute *attribs,
+                                            int attribCount)
+{
+    return nextID++;
+}
+
+void NullBackend::bindVertexArray(unsigned int vao)
+{
+    stats.vertexArrayBinds++;
+}
+
+void NullBackend::drawElements(GLenum mode, unsigned int count,
+                               unsigned int firstIndex, int baseVertex)
+{
+    stats.drawCalls++;
+}
+
+void NullBackend::drawElementsInstanced(GLenum mode, unsigned int count,
+                                        unsigned int firstIndex,
+                                        int baseVertex, int instances)
+{
+    stats.drawCalls++;
+}
+
+unsigned int NullBackend::createUniformBuffer(unsigned int size)
+{
+    return nextID++;
+}
+
+void NullBackend::updateUniformBuffer(unsigned int buffer, unsigned int size,
+                                      const void *data)
+{
+    stats.bufferUpdates++;
+}
+
+void NullBackend::bindUniformBuffer(int binding, unsigned int buffer)
+{
+}
+
+bool NullBackend::setUniformBlockBinding(unsigned int program,
+                                         const char *name, int binding)
+{
+    return true;
+}
+
+unsigned int NullBackend::createTexture2D(int width, int height, int channels,
+                                          const unsigned char *data)
+{
+    stats.textureCreates++;
+    return nextID++;
+}
+
+void NullBackend::bindTexture(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+}
+
+void NullBackend::setUniform2uiv(int location, int count,
+                                 const unsigned int *values)
+{
+    stats.uniformSets++;
+}
+
+unsigned int NullBackend::createTextureArray(int width, int height,
+                                             int layers,
+                                             const unsigned char *data)
+{
+    stats.textureCreates++;
+    return nextID++;
+}
+
+void NullBackend::bindTextureArray(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+}
+
+///Acts as if it had bindless textures, so that path can be measured too
+bool NullBackend::supportsBindless()
+{
+    return true;
+}
+
+unsigned long long NullBackend::getBindlessHandle(unsigned int texture)
+{
+    return texture;
+}
+
+void NullBackend::deleteTexture(unsigned int texture)
+{
+}
+
+void NullBackend::clear(float r, float g, float b, float a)
+{
+}
+
+void NullBackend::enableDepthTest()
+{
+}
+
+void NullBackend::enableClipDistances(int count)
+{
+}
+
+///\//////////////////////////////RecordingBackend//////////////////////////////
+
+///Magic number and version at the start of every log
+const char RENDER_LOG_MAGIC[4] = {'R', 'L', 'O', 'G'};
+const unsigned int RENDER_LOG_VERSION = 1;
+
+///Writes every call to a binary log and passes it on to another backend
+///(or to none). Every command is a 1 byte opcode followed by its arguments,
+///32 bit values in the machine's byte order. Calls that return an ID also
+///store it, so a replay can map the IDs of the recording to its own.
+///Bindless handles can't be replayed, so a recording never offers them.
+class RecordingBackend : public RenderBackend
+{
+    private:
+
+        FILE *file;
+        RenderBackend *inner;
+
+        ///IDs handed out when there is no inner backend
+        unsigned int nextID;
+
+        ///Private Functions
+        void writeOpcode(Backend_Command cmd);
+        void writeUInt(unsigned int v);
+        void writeInt(int v);
+        void writeFloat(float v);
+        void writeBytes(const void *data, unsigned int size);
+        void writeString(const std::string &s);
+
+    public:
+
+        ///Constructor, inner may be NULL
+        RecordingBackend(const char *path, RenderBackend *innerBackend);
+        ~RecordingBackend();
+
+        bool isOpen();
+
+        unsigned int createProgram(const std::string &vertexCode,
+                                   const std::string &fragmentCode);
+        int getUniformLocation(unsigned int program, const char *name);
+        void useProgram(unsigned int program);
+
+        void setUniform1i(int location, int value);
+        void setUniform1f(int location, float value);
+        void setUniformMatrix4fv(int location, const float *m);
+        void setUniform2uiv(int location, int count,
+                            const unsigned int *values);
+
+        unsigned int createVertexArray(const float *vertices,
+                                       unsigned int vertexBytes,
+                                       const unsigned int *indices,
+                                       unsigned int indexBytes,
+                                       const VertexAttribute *attribs,
+                                       int attribCount);
+        void bindVertexArray(unsigned int vao);
+        void drawElements(GLenum mode, unsigned int count,
+                          unsigned int firstIndex, int baseVertex);
+        void drawElementsInstanced(GLenum mode, unsigned int count,
+                                   unsigned int firstIndex, int baseVertex,
+                                   int instances);
+
+        unsigned int createUniformBuffer(unsigned int size);
+        void updateUniformBuffer(unsigned int buffer, unsigned int size,
+                                 const void *data);
+        void bindUniformBuffer(int binding, unsigned int buffer);
+        bool setUniformBlockBinding(unsigned int program, const char *name,
+                                    int binding);
+
+        unsigned int createTexture2D(int width, int height, int channels,
+                                     const unsigned char *data);
+        void bindTexture(int unit, unsigned int texture);
+        void deleteTexture(unsigned int texture);
+        unsigned int createTextureArray(int width, int height, int layers,
+                                        const unsigned char *data);
+        void bindTextureArray(int unit, unsigned int texture);
+
+        void bindBuffer(GLenum target, unsigned int buffer);
+        void bindBufferBase(GLenum target, int index, unsigned int buffer);
+        void bindTextureTarget(GLenum target, int unit, unsigned int texture);
+        void bindFramebuffer(GLenum target, unsigned int framebuffer);
+        void bindRenderbuffer(unsigned int renderbuffer);
+
+        void clear(float r, float g, float b, float a);
+        void enableDepthTest();
+        void enableClipDistances(int count);
+        void endFrame();
+};
+
+///Constructor
+RecordingBackend::RecordingBackend(const char *path,
+                                   RenderBackend *innerBackend)
+{
+    inner = innerBackend;
+    nextID = 1;
+
+    file = fopen(path, "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::RENDER_LOG::COULD_NOT_OPEN " << path << std::endl;
+        return;
+    }
+
+    fwrite(RENDER_LOG_MAGIC, 1, 4, file);
+    writeUInt(RENDER_LOG_VERSION);
+}
+
+RecordingBackend::~RecordingBackend()
+{
+    if(file)
+    {
+        fclose(file);
+    }
+}
+
+bool RecordingBackend::isOpen()
+{
+    return file != NULL;
+}
+
+///\//////////////////////////////////Writing///////////////////////////////////
+
+void RecordingBackend::writeOpcode(Backend_Command cmd)
+{
+    unsigned char op = (unsigned char)cmd;
+    writeBytes(&op, 1);
+}
+
+void RecordingBackend::writeUInt(unsigned int v)
+{
+    writeBytes(&v, 4);
+}
+
+void RecordingBackend::writeInt(int v)
+{
+    writeBytes(&v, 4);
+}
+
+void RecordingBackend::writeFloat(float v)
+{
+    writeBytes(&v, 4);
+}
+
+void RecordingBackend::writeBytes(const void *data, unsigned int size)
+{
+    if(file && size > 0)
+    {
+        fwrite(data, 1, size, file);
+    }
+}
+
+void RecordingBackend::writeString(const std::string &s)
+{
+    writeUInt(s.size());
+    writeBytes(s.c_str(), s.size());
+}
+
+///\////////////////////////////////////////////////////////////////////////////
+
+unsigned int RecordingBackend::createProgram(const std::string &vertexCode,
+                                             const std::string &fragmentCode)
+{
+    unsigned int id = inner ? inner->createProgram(vertexCode, fragmentCode)
+                            : nextID++;
+
+    writeOpcode(CMD_CREATE_PROGRAM);
+    writeUInt(id);
+    writeString(vertexCode);
+    writeString(fragmentCode);
+
+    return id;
+}
+
+int RecordingBackend::getUniformLocation(unsigned int program,
+                                         const char *name)
+{
+    int location = inner ? inner->getUniformLocation(program, name) : 0;
+
+    writeOpcode(CMD_GET_UNIFORM_LOCATION);
+    writeUInt(program);
+    writeInt(location);
+    writeString(name);
+
+    return location;
+}
+
+void RecordingBackend::useProgram(unsigned int program)
+{
+    stats.programBinds++;
+    writeOpcode(CMD_USE_PROGRAM);
+    writeUInt(program);
+
+    if(inner)
+    {
+        inner->useProgram(program);
+    }
+}
+
+void RecordingBackend::setUniform1i(int location, int value)
+{
+    stats.uniformSets++;
+    writeOpcode(CMD_UNIFORM_1I);
+    writeInt(location);
+    writeInt(value);
+
+    if(inner)
+    {
+        inner->setUniform1i(location, value);
+    }
+}
+
+void RecordingBackend::setUniform1f(int location, float value)
+{
+    stats.uniformSets++;
+    writeOpcode(CMD_UNIFORM_1F);
+    writeInt(location);
+    writeFloat(value);
+
+    if(inner)
+    {
+        inner->setUniform1f(location, value);
+    }
+}
+
+void RecordingBackend::setUniformMatrix4fv(int location, const float *m)
+{
+    stats.uniformSets++;
+    writeOpcode(CMD_UNIFORM_MATRIX4FV);
+    writeInt(location);
+    writeBytes(m, 16 * sizeof(float));
+
+    if(inner)
+    {
+        inner->setUniformMatrix4fv(location, m);
+    }
+}
+
+unsigned int RecordingBackend::createVertexArray(const float *vertices,
+                                                 unsigned int vertexBytes,
+                                                 const unsigned int *indices,
+                                                 unsigned int indexBytes,
+                                                 const VertexAttribute *attribs,
+                                                 int attribCount)
+{
+    unsigned int id = inner ? inner->createVertexArray(vertices, vertexBytes,
+                                                       indices, indexBytes,
+                                                       attribs, attribCount)
+                            : nextID++;
+
+    writeOpcode(CMD_CREATE_VERTEX_ARRAY);
+    writeUInt(id);
+    writeUInt(vertexBytes);
+    writeBytes(vertices, vertexBytes);
+    writeUInt(indexBytes);
+    writeBytes(indices, indexBytes);
+    writeInt(attribCount);
+    writeBytes(attribs, attribCount * sizeof(VertexAttribute));
+
+    return id;
+}
+
+void RecordingBackend::bindVertexArray(unsigned int vao)
+{
+    stats.vertexArrayBinds++;
+    writeOpcode(CMD_BIND_VERTEX_ARRAY);
+    writeUInt(vao);
+
+    if(inner)
+    {
+        inner->bindVertexArray(vao);
+    }
+}
+
+void RecordingBackend::drawElements(GLenum mode, unsigned int count,
+                                    unsigned int firstIndex, int baseVertex)
+{
+    stats.drawCalls++;
+    writeOpcode(CMD_DRAW_ELEMENTS);
+    writeUInt(mode);
+    writeUInt(count);
+    writeUInt(firstIndex);
+    writeInt(baseVertex);
+
+    if(inner)
+    {
+        inner->drawElements(mode, count, firstIndex, baseVertex);
+    }
+}
+
+void RecordingBackend::drawElementsInstanced(GLenum mode, unsigned int count,
+                                             unsigned int firstIndex,
+                                             int baseVertex, int instances)
+{
+    stats.drawCalls++;
+    writeOpcode(CMD_DRAW_ELEMENTS_INSTANCED);
+    writeUInt(mode);
+    writeUInt(count);
+    writeUInt(firstIndex);
+    writeInt(baseVertex);
+    writeInt(instances);
+
+    if(inner)
+    {
+        inner->drawElementsInstanced(mode, count, firstIndex, baseVertex,
+                                     instances);
+    }
+}
+
+unsigned int RecordingBackend::createUniformBuffer(unsigned int size)
+{
+    unsigned int id = inner ? inner->createUniformBuffer(size) : nextID++;
+
+    writeOpcode(CMD_CREATE_UNIFORM_BUFFER);
+    writeUInt(id);
+    writeUInt(size);
+
+    return id;
+}
+
+void RecordingBackend::updateUniformBuffer(unsigned int buffer,
+                                           unsigned int size,
+                                           const void *data)
+{
+    stats.bufferUpdates++;
+    writeOpcode(CMD_UPDATE_UNIFORM_BUFFER);
+    writeUInt(buffer);
+    writeUInt(size);
+    writeBytes(data, size);
+
+    if(inner)
+    {
+        inner->updateUniformBuffer(buffer, size, data);
+    }
+}
+
+void RecordingBackend::bindUniformBuffer(int binding, unsigned int buffer)
+{
+    writeOpcode(CMD_BIND_UNIFORM_BUFFER);
+    writeInt(binding);
+    writeUInt(buffer);
+
+    if(inner)
+    {
+        inner->bindUniformBuffer(binding, buffer);
+    }
+}
+
+bool RecordingBackend::setUniformBlockBinding(unsigned int program,
+                                              const char *name, int binding)
+{
+    writeOpcode(CMD_UNIFORM_BLOCK_BINDING);
+    writeUInt(program);
+    writeInt(binding);
+    writeString(name);
+
+    return inner ? inner->setUniformBlockBinding(program, name, binding)
+                 : true;
+}
+
+unsigned int RecordingBackend::createTexture2D(int width, int height,
+                                               int channels,
+                                               const unsigned char *data)
+{
+    stats.textureCreates++;
+
+    unsigned int id = inner ? inner->createTexture2D(width, height, channels,
+                                                     data)
+                            : nextID++;
+
+    writeOpcode(CMD_CREATE_TEXTURE_2D);
+    writeUInt(id);
+    writeInt(width);
+    writeInt(height);
+    writeInt(channels);
+    writeBytes(data, width * height * channels);
+
+    return id;
+}
+
+void RecordingBackend::bindTexture(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+    writeOpcode(CMD_BIND_TEXTURE);
+    writeInt(unit);
+    writeUInt(texture);
+
+    if(inner)
+    {
+        inner->bindTexture(unit, texture);
+    }
+}
+
+void RecordingBackend::setUniform2uiv(int location, int count,
+                                      const unsigned int *values)
+{
+    stats.uniformSets++;
+    writeOpcode(CMD_UNIFORM_2UIV);
+    writeInt(location);
+    writeInt(count);
+    writeBytes(values, count * 2 * sizeof(unsigned int));
+
+    if(inner)
+    {
+        inner->setUniform2uiv(location, count, values);
+    }
+}
+
+unsigned int RecordingBackend::createTextureArray(int width, int height,
+                                                  int layers,
+                                                  const unsigned char *data)
+{
+    stats.textureCreates++;
+
+    unsigned int id = inner ? inner->createTextureArray(width, height, layers,
+                                                        data)
+                            : nextID++;
+
+    writeOpcode(CMD_CREATE_TEXTURE_ARRAY);
+    writeUInt(id);
+    writeInt(width);
+    writeInt(height);
+    writeInt(layers);
+    writeBytes(data, width * height * layers * 4);
+
+    return id;
+}
+
+void RecordingBackend::bindTextureArray(int unit, unsigned int texture)
+{
+    stats.textureBinds++;
+    writeOpcode(CMD_BIND_TEXTURE_ARRAY);
+    writeInt(unit);
+    writeUInt(texture);
+
+    if(inner)
+    {
+        inner->bindTextureArray(unit, texture);
+    }
+}
+
+void RecordingBackend::deleteTexture(unsigned int texture)
+{
+    writeOpcode(CMD_DELETE_TEXTURE);
+    writeUInt(texture);
+
+    if(inner)
+    {
+        inner->deleteTexture(texture);
+    }
+}
+
+void RecordingBackend::clear(float r, float g, float b, float a)
+{
+    writeOpcode(CMD_CLEAR);
+    writeFloat(r);
+    writeFloat(g);
+    writeFloat(b);
+    writeFloat(a);
+
+    if(inner)
+    {
+        inner->clear(r, g, b, a);
+    }
+}
+
+void RecordingBackend::enableDepthTest()
+{
+    writeOpcode(CMD_ENABLE_DEPTH_TEST);
+
+    if(inner)
+    {
+        inner->enableDepthTest();
+    }
+}
+
+void RecordingBackend::enableClipDistances(int count)
+{
+    writeOpcode(CMD_ENABLE_CLIP_DISTANCES);
+    writeInt(count);
+
+    if(inner)
+    {
+        inner->enableClipDistances(count);
+    }
+}
+
+///The bindings that aren't recorded only go on to the inner backend
+void RecordingBackend::bindBuffer(GLenum target, unsigned int buffer)
+{
+    if(inner)
+    {
+        inner->bindBuffer(target, buffer);
+    }
+}
+
+void RecordingBackend::bindBufferBase(GLenum target, int index,
+                                      unsigned int buffer)
+{
+    if(inner)
+    {
+        inner->bindBufferBase(target, index, buffer);
+    }
+}
+
+void RecordingBackend::bindTextureTarget(GLenum target, int unit,
+                                         unsigned int texture)
+{
+    if(inner)
+    {
+        inner->bindTextureTarget(target, unit, texture);
+    }
+}
+
+void RecordingBackend::bindFramebuffer(GLenum target,
+                                       unsigned int framebuffer)
+{
+    if(inner)
+    {
+        inner->bindFramebuffer(target, framebuffer);
+    }
+}
+
+void RecordingBackend::bindRenderbuffer(unsigned int renderbuffer)
+{
+    if(inner)
+    {
+        inner->bindRenderbuffer(renderbuffer);
+    }
+}
+
+void RecordingBackend::endFrame()
+{
+    writeOpcode(CMD_END_FRAME);
+
+    if(inner)
+    {
+        inner->endFrame();
+    }
+}
+
+///\/////////////////////////////////Replaying//////////////////////////////////
+
+///a * b, or the largest size when it doesn't fit, which no blob passes
+unsigned long long multiplyLogSize(unsigned long long a, unsigned long long b)
+{
+    return b != 0 && a > ULLONG_MAX / b ? ULLONG_MAX : a * b;
+}
+
+///Reads size bytes of a log into buffer. False on a short read, or when size
+///is more than what is left of the file, which only a broken log has, so it
+///never grows the buffer past the file.
+template <class Buffer>
+bool readRenderLogBlob(FILE *f, long fileSize, unsigned long long size,
+                       Buffer &buffer)
+{
+    long position = ftell(f);
+    if(position < 0 || size > (unsigned long long)(fileSize - position))
+    {
+        return false;
+    }
+
+    buffer.resize(size);
+    return size == 0 || fread(&buffer[0], 1, size, f) == size;
+}
+
+///Reads a log written by RecordingBackend and sends every call to target.
+///Returns the number of frames replayed, or -1 if the log is broken.
+int replayRenderLog(const char *path, RenderBackend &target)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        std::cout << "ERROR::RENDER_LOG::COULD_NOT_OPEN " << path << std::endl;
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char magic[4];
+    unsigned int version = 0;
+    if(fread(magic, 1, 4, f) != 4 || memcmp(magic, RENDER_LOG_MAGIC, 4) != 0 ||
+       fread(&version, 4, 1, f) != 1 || version != RENDER_LOG_VERSION)
+    {
+        std::cout << "ERROR::RENDER_LOG::BAD_HEADER " << path << std::endl;
+        fclose(f);
+        return -1;
+    }
+
+    ///IDs and uniform locations of the recording -> ours
+    std::map<unsigned int, unsigned int> ids;
+    std::map< std::pair<unsigned int, int>, int > locations;
+    unsigned int currentProgram = 0;
+
+    int frames = 0;
+    bool bOk = true;
+    int op;
+
+    ///Small readers, any short read marks the log as broken
+    #define READ_VALUE(v) bOk = bOk && fread(&(v), sizeof(v), 1, f) == 1
+    #define READ_BLOB(buffer, size) \
+        bOk = bOk && readRenderLogBlob(f, fileSize, size, buffer)
+
+    std::string s1, s2;
+    std::vector<unsigned char> blob1, blob2, blob3;
+
+    while(bOk && (op = fgetc(f)) != EOF)
+    {
+        unsigned int u, u2, u3, size;
+        int i, i2, i3;
+        ///Sizes made from counts in the log, 64 bits so they can't wrap
+        unsigned long long bytes;
+        float v[16];
+
+        switch(op)
+        {
+            case CMD_CREATE_PROGRAM:
+                READ_VALUE(u);
+                READ_VALUE(size); READ_BLOB(s1, size);
+                READ_VALUE(size); READ_BLOB(s2, size);
+                if(bOk) ids[u] = target.createProgram(s1, s2);
+                break;
+
+            case CMD_GET_UNIFORM_LOCATION:
+                READ_VALUE(u);
+                READ_VALUE(i);
+                READ_VALUE(size); READ_BLOB(s1, size);
+                if(bOk)
+                {
+                    locations[std::make_pair(u, i)] =
+                        target.getUniformLocation(ids[u], s1.c_str());
+                }
+                break;
+
+            case CMD_USE_PROGRAM:
+                READ_VALUE(u);
+                currentProgram = u;
+                if(bOk) target.useProgram(ids[u]);
+                break;
+
+            case CMD_UNIFORM_1I:
+                READ_VALUE(i);
+                READ_VALUE(i2);
+                if(bOk)
+                {
+                    target.setUniform1i(
+                        locations[std::make_pair(currentProgram, i)], i2);
+                }
+                break;
+
+            case CMD_UNIFORM_1F:
+                READ_VALUE(i);
+                READ_VALUE(v[0]);
+                if(bOk)
+                {
+                    target.setUniform1f(
+                        locations[std::make_pair(currentProgram, i)], v[0]);
+                }
+                break;
+
+            case CMD_UNIFORM_MATRIX4FV:
+                READ_VALUE(i);
+                READ_VALUE(v);
+                if(bOk)
+                {
+                    target.setUniformMatrix4fv(
+                        locations[std::make_pair(currentProgram, i)], v);
+                }
+                break;
+
+            case CMD_CREATE_VERTEX_ARRAY:
+                READ_VALUE(u);
+                READ_VALUE(u2); READ_BLOB(blob1, u2);
+                READ_VALUE(u3); READ_BLOB(blob2, u3);
+                READ_VALUE(i);
+                bOk = bOk && i >= 0;
+                bytes = (unsigned long long)i * sizeof(VertexAttribute);
+                READ_BLOB(blob3, bytes);
+                if(bOk)
+                {
+                    ids[u] = target.createVertexArray(
+                        (const float*)(u2 ? &blob1[0] : NULL), u2,
+                        (const unsigned int*)(u3 ? &blob2[0] : NULL), u3,
+                        (const VertexAttribute*)(i ? &blob3[0] : NULL), i);
+                }
+                break;
+
+            case CMD_BIND_VERTEX_ARRAY:
+                READ_VALUE(u);
+                if(bOk) target.bindVertexArray(ids[u]);
+                break;
+
+            case CMD_DRAW_ELEMENTS:
+                READ_VALUE(u);
+                READ_VALUE(u2);
+                READ_VALUE(u3);
+                READ_VALUE(i);
+                if(bOk) target.drawElements(u, u2, u3, i);
+                break;
+
+            case CMD_CREATE_TEXTURE_2D:
+                READ_VALUE(u);
+                READ_VALUE(i);
+                READ_VALUE(i2);
+                READ_VALUE(i3);
+                ///Backends only take RGB and RGBA
+                bOk = bOk && i >= 0 && i2 >= 0 && (i3 == 3 || i3 == 4);
+                bytes = (unsigned long long)i * i2 * i3;
+                READ_BLOB(blob1, bytes);
+                if(bOk)
+                {
+                    ids[u] = target.createTexture2D(i, i2, i3,
+                                                    bytes ? &blob1[0] : NULL);
+                }
+                break;
+
+            case CMD_BIND_TEXTURE:
+                READ_VALUE(i);
+                READ_VALUE(u);
+                if(bOk) target.bindTexture(i, ids[u]);
+                break;
+
+            case CMD_UNIFORM_2UIV:
+                READ_VALUE(i);
+                READ_VALUE(i2);
+                bOk = bOk && i2 >= 0;
+                bytes = (unsigned long long)i2 * 2 * sizeof(unsigned int);
+                READ_BLOB(blob1, bytes);
+                if(bOk && bytes > 0)
+                {
+                    target.setUniform2uiv(
+                        locations[std::make_pair(currentProgram, i)], i2,
+                        (const unsigned int*)&blob1[0]);
+                }
+                break;
+
+            case CMD_CREATE_TEXTURE_ARRAY:
+                READ_VALUE(u);
+                READ_VALUE(i);
+                READ_VALUE(i2);
+                READ_VALUE(i3);
+                bOk = bOk && i >= 0 && i2 >= 0 && i3 >= 0;
+                bytes = multiplyLogSize((unsigned long long)i * i2, i3);
+                bytes = multiplyLogSize(bytes, 4);
+                READ_BLOB(blob1, bytes);
+                if(bOk)
+                {
+                    ids[u] = target.createTextureArray(
+                        i, i2, i3, bytes ? &blob1[0] : NULL);
+                }
+                break;
+
+            case CMD_BIND_TEXTURE_ARRAY:
+                READ_VALUE(i);
+                READ_VALUE(u);
+                if(bOk) target.bindTextureArray(i, ids[u]);
+                break;
+
+            case CMD_DELETE_TEXTURE:
+                READ_VALUE(u);
+                if(bOk)
+                {
+                    target.deleteTexture(ids[u]);
+                    ids.erase(u);
+                }
+                break;
+
+            case CMD_DRAW_ELEMENTS_INSTANCED:
+                READ_VALUE(u);
+                READ_VALUE(u2);
+                READ_VALUE(u3);
+                READ_VALUE(i);
+                READ_VALUE(i2);
+                if(bOk) target.drawElementsInstanced(u, u2, u3, i, i2);
+                break;
+
+            case CMD_CREATE_UNIFORM_BUFFER:
+                READ_VALUE(u);
+                READ_VALUE(u2);
+                if(bOk) ids[u] = target.createUniformBuffer(u2);
+                break;
+
+            case CMD_UPDATE_UNIFORM_BUFFER:
+                READ_VALUE(u);
+                READ_VALUE(size); READ_BLOB(blob1, size);
+                if(bOk && size > 0)
+                {
+                    target.updateUniformBuffer(ids[u], size, &blob1[0]);
+                }
+                break;
+
+            case CMD_BIND_UNIFORM_BUFFER:
+                READ_VALUE(i);
+                READ_VALUE(u);
+                if(bOk) target.bindUniformBuffer(i, ids[u]);
+                break;
+
+            case CMD_UNIFORM_BLOCK_BINDING:
+                READ_VALUE(u);
+                READ_VALUE(i);
+                READ_VALUE(size); READ_BLOB(s1, size);
+                if(bOk) target.setUniformBlockBinding(ids[u], s1.c_str(), i);
+                break;
+
+            case CMD_ENABLE_CLIP_DISTANCES:
+                READ_VALUE(i);
+                if(bOk) target.enableClipDistances(i);
+                break;
+
+            case CMD_CLEAR:
+                READ_VALUE(v[0]);
+                READ_VALUE(v[1]);
+                READ_VALUE(v[2]);
+                READ_VALUE(v[3]);
+                if(bOk) target.clear(v[0], v[1], v[2], v[3]);
+                break;
+
+            case CMD_ENABLE_DEPTH_TEST:
+                target.enableDepthTest();
+                break;
+
+            case CMD_END_FRAME:
+                target.endFrame();
+                frames++;
+                break;
+
+            default:
+                bOk = false;
+                break;
+        }
+    }
+
+    #undef READ_VALUE
+    #undef READ_BLOB
+
+    fclose(f);
+
+    if(!bOk)
+    {
+        std::cout << "ERROR::RENDER_LOG::BROKEN " << path << std::endl;
+        return -1;
+    }
+
+    return frames;
+}
+
+///\///////////////////////////////Current backend//////////////////////////////
+
+///The backend Shader and the render loop send their calls to
+RenderBackend* currentRenderBackend = NULL;
+
+RenderBackend* getRenderBackend()
+{
+    ///OpenGL unless told otherwise
+    static GLBackend glBackend;
+
+    if(!currentRenderBackend)
+    {
+        currentRenderBackend = &glBackend;
+    }
+
+    return currentRenderBackend;
+}
+
+void setRenderBackend(RenderBackend *backend)
+{
+    currentRenderBackend = backend;
+}
+
+#endif // RENDERBACKEND_H_INCLUDED
@@ -0,0 +1,223 @@
+#ifndef RENDERONDEMAND_H_INCLUDED
+#define RENDERONDEMAND_H_INCLUDED
+
+#include <chrono>
+#include <iostream>
+
+///GLFW
+#include <GL/glfw3.h>
+
+#include "Camera.h"
+
+///Longest the loop sleeps without events, in seconds. The shader files and
+///the telemetry are still looked at that often.
+const double ON_DEMAND_TIMEOUT = 0.1;
+
+///Why a frame is drawn
+enum Dirty_Reason
+{
+    DIRTY_CAMERA,       ///MoveCamera was called
+    DIRTY_ANIMATION,    ///Something in the scene moves by itself
+    DIRTY_RESIZE,       ///The window changed size, or is new
+    DIRTY_RESOURCE,     ///A texture level, a shader or a variant changed
+    DIRTY_REASON_COUNT
+};
+
+const char *DIRTY_REASON_NAMES[DIRTY_REASON_COUNT] = {
+    "camera", "animation", "resize", "resource"
+};
+
+///Bit of a Dirty_Reason in a frame's reasons
+#define DIRTY_BIT(reason) (1u << (reason))
+
+///Draws a frame only when something would change it. Everything that can
+///change the picture marks a reason; the loop asks beginFrame() whether
+///this iteration draws, and when it doesn't the window isn't swapped and
+///the loop sleeps in glfwWaitEventsTimeout until there is an event. The
+///time asleep isn't given to the camera as deltaTime, so the first key
+///press after a pause doesn't jump.
+class RenderOnDemand
+{
+    private:
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        bool bActive;
+        bool bIdle;
+
+        ///Reasons marked since the last frame, and those of the last frame
+        unsigned int dirty;
+        unsigned int lastReasons;
+
+        ///MoveCamera calls at the last frame
+        unsigned int cameraMoves;
+
+        ///Stats since the last print
+        int framesDrawn;
+        int framesSkipped;
+        int reasonFrames[DIRTY_REASON_COUNT];
+        double idleSeconds;
+        Clock::time_point statsStart;
+
+    public:
+
+        ///Constructor
+        RenderOnDemand();
+
+        ///Turns it on, the first frame is drawn
+        void create(Camera &camera);
+
+        void markDirty(Dirty_Reason reason);
+
+        ///True if this iteration of the loop draws. bAnimating is true when
+        ///the scene moves by itself.
+        bool beginFrame(Camera &camera, bool bAnimating);
+
+        ///Polls the events, or sleeps until one comes if the iteration
+        ///didn't draw. Returns the seconds it slept.
+        double waitEvents();
+
+        ///Prints what the frames were drawn for and the time spent idle
+        void printStats();
+
+        ///Getters
+        bool isActive();
+        bool isIdle();
+        unsigned int getLastReasons();
+};
+
+///Constructor
+RenderOnDemand::RenderOnDemand()
+{
+    bActive = false;
+    bIdle = false;
+    dirty = 0;
+    lastReasons = 0;
+    cameraMoves = 0;
+
+    framesDrawn = 0;
+    framesSkipped = 0;
+    for(int r=0; r<DIRTY_REASON_COUNT; r++)
+    {
+        reasonFrames[r] = 0;
+    }
+    idleSeconds = 0.0;
+}
+
+void RenderOnDemand::create(Camera &camera)
+{
+    bActive = true;
+    dirty = DIRTY_BIT(DIRTY_RESIZE);
+    cameraMoves = camera.GetMoveCount();
+    statsStart = Clock::now();
+
+    std::cout << "Render on demand: frames are drawn only when something "
+    "changes" << std::endl;
+}
+
+void RenderOnDemand::markDirty(Dirty_Reason reason)
+{
+    dirty |= DIRTY_BIT(reason);
+}
+
+bool RenderOnDemand::beginFrame(Camera &camera, bool bAnimating)
+{
+    if(!bActive)
+    {
+        return true;
+    }
+
+    if(camera.GetMoveCount() != cameraMoves)
+    {
+        cameraMoves = camera.GetMoveCount();
+        markDirty(DIRTY_CAMERA);
+    }
+
+    if(bAnimating)
+    {
+        markDirty(DIRTY_ANIMATION);
+    }
+
+    bIdle = dirty == 0;
+    if(bIdle)
+    {
+        framesSkipped++;
+        return false;
+    }
+
+    lastReasons = dirty;
+    dirty = 0;
+
+    framesDrawn++;
+    for(int r=0; r<DIRTY_REASON_COUNT; r++)
+    {
+        if(lastReasons & DIRTY_BIT(r))
+        {
+            reasonFrames[r]++;
+        }
+    }
+
+    return true;
+}
+
+double RenderOnDemand::waitEvents()
+{
+    if(!bActive || !bIdle)
+    {
+        glfwPollEvents();
+        return 0.0;
+    }
+
+    Clock::time_point start = Clock::now();
+    glfwWaitEventsTimeout(ON_DEMAND_TIMEOUT);
+
+    std::chrono::duration<double> slept = Clock::now() - start;
+    idleSeconds += slept.count();
+    return slept.count();
+}
+
+void RenderOnDemand::printStats()
+{
+    if(!bActive)
+    {
+        return;
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - statsStart;
+
+    std::cout << "On demand: " << framesDrawn << " frames drawn (";
+    for(int r=0; r<DIRTY_REASON_COUNT; r++)
+    {
+        std::cout << (r > 0 ? ", " : "") << DIRTY_REASON_NAMES[r] << " "
+        << reasonFrames[r];
+    }
+    std::cout << "), " << framesSkipped << " skipped, idle "
+    << 100.0 * idleSeconds / elapsed.count() << "% of the time"
+    << std::endl;
+
+    framesDrawn = 0;
+    framesSkipped = 0;
+    for(int r=0; r<DIRTY_REASON_COUNT; r++)
+    {
+        reasonFrames[r] = 0;
+    }
+    idleSeconds = 0.0;
+    statsStart = Clock::now();
+}
+
+bool RenderOnDemand::isActive()
+{
+    return bActive;
+}
+
+bool RenderOnDemand::isIdle()
+{
+    return bActive && bIdle;
+}
+
+unsigned int RenderOnDemand::getLastReasons()
+{
+    return lastReasons;
+}
+
+#endif // RENDERONDEMAND_H_INCLUDED
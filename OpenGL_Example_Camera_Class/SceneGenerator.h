@@ -0,0 +1,531 @@
+#ifndef SCENEGENERATOR_H_INCLUDED
+#define SCENEGENERATOR_H_INCLUDED
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+///The file is mapped, not read
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+///Magic number and version at the start of every scene file
+const char SCENE_FILE_MAGIC[4] = {'S', 'C', 'N', 'E'};
+const unsigned int SCENE_FILE_VERSION = 1;
+
+///Instances a scene can have
+const int SCENE_MIN_INSTANCES = 1;
+const int SCENE_MAX_INSTANCES = 10000000;
+
+///Space between the centers of the cubes of a grid, the cubes are 1 wide
+const float SCENE_GRID_SPACING = 3.0f;
+
+///Space between the walls, one behind the other
+const float SCENE_WALL_SPACING = 6.0f;
+
+enum Scene_Layout
+{
+    SCENE_UNIFORM,      ///Anywhere in a box
+    SCENE_CLUSTERED,    ///In tight groups spread over the box
+    SCENE_GRID,         ///On a regular grid
+    SCENE_WALLS,        ///Solid walls, one behind the other
+    SCENE_LAYOUT_COUNT
+};
+
+const char *SCENE_LAYOUT_NAMES[SCENE_LAYOUT_COUNT] = {
+    "uniform", "clustered", "grid", "walls"
+};
+
+///What a scene file starts with, 28 bytes
+struct SceneHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int count;
+    unsigned int layout;
+    unsigned int seed;
+
+    ///The instances use textures and clips below these
+    unsigned int textureCount;
+    unsigned int clipCount;
+};
+
+///One instance as it is in the file, 24 bytes. The textures and clips are
+///indices the program that loads the scene gives a meaning to.
+struct SceneInstance
+{
+    float position[3];
+    float offset;
+    float speed;
+    unsigned char clip;
+    unsigned char baseTexture;
+    unsigned char detailTexture;
+    unsigned char unused;
+};
+
+///What to generate, the same description always gives the same instances
+struct SceneDesc
+{
+    int count;
+    Scene_Layout layout;
+    unsigned int seed;
+    int textureCount;
+    int clipCount;
+};
+
+///Returns the layout with that name, SCENE_LAYOUT_COUNT if there is none
+Scene_Layout getSceneLayout(const char *name)
+{
+    for(int l=0; l<SCENE_LAYOUT_COUNT; l++)
+    {
+        if(strcmp(name, SCENE_LAYOUT_NAMES[l]) == 0)
+        {
+            return (Scene_Layout)l;
+        }
+    }
+
+    return SCENE_LAYOUT_COUNT;
+}
+
+///\///////////////////////////////SceneGenerator//////////////////////////////
+
+///Fills a scene from a seed. The random numbers come from an LCG of its own,
+///not rand() or <random>, so a seed gives the same file with every compiler.
+///The cubes are placed in front of the camera at the origin, in a box that
+///grows with the count so the density stays about the same.
+class SceneGenerator
+{
+    private:
+
+        unsigned int state;
+
+        ///Random numbers, [0, 1) and [0, n)
+        float next();
+        int nextInt(int n);
+
+        ///About normal, mean 0 and deviation 0.5
+        float nextNormal();
+
+        ///Textures and animation of an instance
+        void randomize(SceneInstance &instance, const SceneDesc &desc);
+
+        ///The layouts
+        void placeUniform(std::vector<SceneInstance> &out, float side);
+        void placeClustered(std::vector<SceneInstance> &out, float side);
+        void placeGrid(std::vector<SceneInstance> &out);
+        void placeWalls(std::vector<SceneInstance> &out, const SceneDesc &desc);
+
+    public:
+
+        ///Generates desc.count instances into out
+        void generate(const SceneDesc &desc, std::vector<SceneInstance> &out);
+
+        ///Writes a scene to path, false if it couldn't
+        static bool write(const char *path, const SceneDesc &desc,
+                          const std::vector<SceneInstance> &instances);
+};
+
+float SceneGenerator::next()
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) / 16777216.0f;
+}
+
+int SceneGenerator::nextInt(int n)
+{
+    return std::min((int)(next() * n), n - 1);
+}
+
+float SceneGenerator::nextNormal()
+{
+    return (next() + next() + next() - 1.5f);
+}
+
+void SceneGenerator::randomize(SceneInstance &instance, const SceneDesc &desc)
+{
+    instance.clip = nextInt(desc.clipCount);
+    instance.offset = next() * 10.0f;
+    instance.speed = 0.5f + next();
+    instance.baseTexture = nextInt(desc.textureCount);
+    instance.detailTexture = nextInt(desc.textureCount);
+    instance.unused = 0;
+}
+
+void SceneGenerator::placeUniform(std::vector<SceneInstance> &out, float side)
+{
+    for(unsigned int i=0; i<out.size(); i++)
+    {
+        out[i].position[0] = (next() - 0.5f) * side;
+        out[i].position[1] = (next() - 0.5f) * side;
+        out[i].position[2] = -next() * side;
+    }
+}
+
+void SceneGenerator::placeClustered(std::vector<SceneInstance> &out,
+                                    float side)
+{
+    ///About a thousand cubes in every cluster, as tight as a grid
+    int clusters = std::max(1, (int)out.size() / 1000);
+    float spread = std::cbrt((float)out.size() / clusters) *
+                   SCENE_GRID_SPACING * 0.5f;
+
+    std::vector<float> centers(clusters * 3);
+    for(int c=0; c<clusters; c++)
+    {
+        centers[c * 3] = (next() - 0.5f) * side;
+        centers[c * 3 + 1] = (next() - 0.5f) * side;
+        centers[c * 3 + 2] = -next() * side;
+    }
+
+    for(unsigned int i=0; i<out.size(); i++)
+    {
+        const float *center = &centers[nextInt(clusters) * 3];
+        out[i].position[0] = center[0] + nextNormal() * spread;
+        out[i].position[1] = center[1] + nextNormal() * spread;
+        out[i].position[2] = center[2] + nextNormal() * spread;
+    }
+}
+
+void SceneGenerator::placeGrid(std::vector<SceneInstance> &out)
+{
+    int n = out.size();
+    int side = (int)std::ceil(std::cbrt((float)n));
+    float half = (side - 1) * SCENE_GRID_SPACING * 0.5f;
+
+    for(int i=0; i<n; i++)
+    {
+        out[i].position[0] = (i % side) * SCENE_GRID_SPACING - half;
+        out[i].position[1] = (i / side % side) * SCENE_GRID_SPACING - half;
+        out[i].position[2] = -(i / (side * side)) * SCENE_GRID_SPACING -
+                             SCENE_GRID_SPACING;
+    }
+}
+
+void SceneGenerator::placeWalls(std::vector<SceneInstance> &out,
+                                const SceneDesc &desc)
+{
+    ///Square walls of touching cubes, each a little to the side of the one
+    ///in front, so most of every wall is hidden
+    int n = out.size();
+    int walls = std::max(1, (int)std::cbrt((float)n) / 4);
+    int side = (int)std::ceil(std::sqrt((float)n / walls));
+    int perWall = side * side;
+    float half = (side - 1) * 0.5f;
+
+    int wall = -1;
+    float shift = 0.0f;
+    unsigned char texture = 0;
+
+    for(int i=0; i<n; i++)
+    {
+        int k = i % perWall;
+
+        ///Every wall is made of one texture
+        if(i / perWall != wall)
+        {
+            wall = i / perWall;
+            shift = (next() - 0.5f) * side * 0.25f;
+            texture = nextInt(desc.textureCount);
+        }
+
+        out[i].position[0] = k % side - half + shift;
+        out[i].position[1] = k / side - half;
+        out[i].position[2] = -wall * SCENE_WALL_SPACING - SCENE_WALL_SPACING;
+        out[i].baseTexture = texture;
+    }
+}
+
+void SceneGenerator::generate(const SceneDesc &desc,
+                              std::vector<SceneInstance> &out)
+{
+    state = desc.seed;
+
+    out.resize(desc.count);
+    for(int i=0; i<desc.count; i++)
+    {
+        randomize(out[i], desc);
+    }
+
+    ///As dense as the cubes generateCubeInstances spreads around
+    float side = std::max(10.0f, std::cbrt((float)desc.count) * 3.0f);
+
+    switch(desc.layout)
+    {
+        case SCENE_CLUSTERED:
+            placeClustered(out, side);
+            break;
+        case SCENE_GRID:
+            placeGrid(out);
+            break;
+        case SCENE_WALLS:
+            placeWalls(out, desc);
+            break;
+        default:
+            placeUniform(out, side);
+            break;
+    }
+}
+
+bool SceneGenerator::write(const char *path, const SceneDesc &desc,
+                           const std::vector<SceneInstance> &instances)
+{
+    FILE *f = fopen(path, "wb");
+    if(!f)
+    {
+        std::cout << "ERROR::SCENE::COULD_NOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    SceneHeader header;
+    memcpy(header.magic, SCENE_FILE_MAGIC, 4);
+    header.version = SCENE_FILE_VERSION;
+    header.count = instances.size();
+    header.layout = desc.layout;
+    header.seed = desc.seed;
+    header.textureCount = desc.textureCount;
+    header.clipCount = desc.clipCount;
+
+    bool bOk = fwrite(&header, sizeof(header), 1, f) == 1 &&
+               (instances.empty() ||
+                fwrite(&instances[0], sizeof(SceneInstance),
+                       instances.size(), f) == instances.size());
+
+    if(fclose(f) != 0 || !bOk)
+    {
+        std::cout << "ERROR::SCENE::COULD_NOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+///\/////////////////////////////////SceneFile/////////////////////////////////
+
+///A scene file mapped into memory, the instances are read where they are in
+///the file and only the pages that are touched get loaded
+class SceneFile
+{
+    private:
+
+        const unsigned char *data;
+        unsigned long long size;
+
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+
+        ///Private Functions
+        int findBrokenInstance() const;
+
+    public:
+
+        ///Constructor
+        SceneFile();
+        ~SceneFile();
+
+        ///Maps path, false if it can't, it isn't a scene of this version or
+        ///an instance uses a texture or clip the header doesn't have
+        bool open(const char *path);
+        void close();
+
+        ///Getters
+        bool isOpen() const;
+        const SceneHeader &getHeader() const;
+        const SceneInstance *getInstances() const;
+        int getCount() const;
+        unsigned long long getSize() const;
+};
+
+///Constructor
+SceneFile::SceneFile()
+{
+    data = NULL;
+    size = 0;
+
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+}
+
+SceneFile::~SceneFile()
+{
+    close();
+}
+
+bool SceneFile::open(const char *path)
+{
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    LARGE_INTEGER fileSize;
+    if(file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &fileSize))
+    {
+        size = fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+
+    if(mapping)
+    {
+        data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ,
+                                                    0, 0, 0);
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+
+    struct stat info;
+    if(fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        size = info.st_size;
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? NULL : (const unsigned char *)mapped;
+    }
+
+    if(fd >= 0)
+    {
+        ::close(fd);
+    }
+#endif
+
+    if(!data)
+    {
+        std::cout << "ERROR::SCENE::COULD_NOT_OPEN " << path << std::endl;
+        close();
+        return false;
+    }
+
+    bool bOk = size >= sizeof(SceneHeader);
+
+    const SceneHeader &header = getHeader();
+    bOk = bOk && memcmp(header.magic, SCENE_FILE_MAGIC, 4) == 0 &&
+                 header.version == SCENE_FILE_VERSION &&
+                 header.layout < SCENE_LAYOUT_COUNT &&
+                 size == sizeof(SceneHeader) +
+                         (unsigned long long)header.count *
+                         sizeof(SceneInstance);
+
+    if(!bOk)
+    {
+        std::cout << "ERROR::SCENE::BROKEN " << path << std::endl;
+        close();
+        return false;
+    }
+
+    if(header.count < (unsigned int)SCENE_MIN_INSTANCES ||
+       header.count > (unsigned int)SCENE_MAX_INSTANCES)
+    {
+        std::cout << "ERROR::SCENE::INSTANCE_COUNT " << header.count << " in "
+        << path << std::endl;
+        close();
+        return false;
+    }
+
+    ///The instances index tables of the loader, none is trusted
+    int broken = findBrokenInstance();
+    if(broken >= 0)
+    {
+        std::cout << "ERROR::SCENE::BROKEN_INSTANCE " << broken << " in "
+        << path << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+///First instance with a clip or texture out of the range of the header or a
+///position that isn't a number, -1 if there is none
+int SceneFile::findBrokenInstance() const
+{
+    const SceneHeader &header = getHeader();
+    const SceneInstance *instances = getInstances();
+
+    for(int i=0; i<getCount(); i++)
+    {
+        const SceneInstance &instance = instances[i];
+
+        if(instance.clip >= header.clipCount ||
+           instance.baseTexture >= header.textureCount ||
+           instance.detailTexture >= header.textureCount ||
+           !std::isfinite(instance.position[0]) ||
+           !std::isfinite(instance.position[1]) ||
+           !std::isfinite(instance.position[2]) ||
+           !std::isfinite(instance.offset) || !std::isfinite(instance.speed))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void SceneFile::close()
+{
+#ifdef _WIN32
+    if(data)
+    {
+        UnmapViewOfFile(data);
+    }
+    if(mapping)
+    {
+        CloseHandle(mapping);
+    }
+    if(file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    if(data)
+    {
+        munmap((void *)data, size);
+    }
+#endif
+
+    data = NULL;
+    size = 0;
+}
+
+///\/////////////////////////////////Getters////////////////////////////////////
+
+bool SceneFile::isOpen() const
+{
+    return data != NULL;
+}
+
+const SceneHeader &SceneFile::getHeader() const
+{
+    return *(const SceneHeader *)data;
+}
+
+const SceneInstance *SceneFile::getInstances() const
+{
+    return (const SceneInstance *)(data + sizeof(SceneHeader));
+}
+
+int SceneFile::getCount() const
+{
+    return isOpen() ? getHeader().count : 0;
+}
+
+unsigned long long SceneFile::getSize() const
+{
+    return size;
+}
+
+#endif // SCENEGENERATOR_H_INCLUDED
@@ -15,6 +15,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "RenderBackend.h"
+#include "ShaderPreprocessor.h"
+
 class Shader
 {
     private:
@@ -22,21 +25,45 @@ class Shader
         ///The ID of this Shader Program
         unsigned int ID;
 
+        ///Where the sources were read from, to build it again
+        string vertexFile;
+        string fragmentFile;
+        ShaderDefines defines;
+
+        ///Every file read the last time, includes too
+        vector<string> dependencies;
+
     public:
 
         ///Constructor
-        Shader(const GLchar* , const GLchar*);
+        Shader(const GLchar* , const GLchar*,
+               const ShaderDefines &defines = ShaderDefines());
 
         ///Getters
         int getID();
+        const string &getVertexPath();
+        const string &getFragmentPath();
+        const ShaderDefines &getDefines();
+        const vector<string> &getDependencies();
+
+        ///Reads the sources again with the includes and defines resolved,
+        ///false if a file couldn't be read
+        bool readSources(string &vertexCode, string &fragmentCode);
+
+        ///Replaces the program, returns the old one so it can be deleted
+        unsigned int swapProgram(unsigned int newID);
 
         ///Setters - *GLSL uniforms*
-        void setBool(const string &name, bool value);
-        void setInt(const string &name, int value);
-        void setFloat(const string &name, float value);
+        void setBool(const GLchar *name, bool value);
+        void setInt(const GLchar *name, int value);
+        void setFloat(const GLchar *name, float value);
 
         ///--4x4 Matrix (Floats)
-        void setMatrix4fv(const string &name, glm::mat4);
+        void setMatrix4fv(const GLchar *name, const glm::mat4 &);
+
+        ///--Array of uvec2
+        void setUInt2v(const GLchar *name, int count,
+                       const unsigned int *values);
 
         ///Use this function to set 'this' shader as the current
         ///OpenGL shader
@@ -46,124 +73,48 @@ class Shader
 
 
 ///This function receives the path of all the shaders, compiles them and links
-///them into 'this' shader program
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+///them into 'this' shader program. The defines are added to both shaders.
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath,
+               const ShaderDefines &defines)
 {
+    vertexFile = vertexPath;
+    fragmentFile = fragmentPath;
+    this->defines = defines;
+
     /// 1. retrieve the vertex/fragment source code from filePath
     string vertexCode;
     string fragmentCode;
 
-    ifstream vShaderFile;
-    ifstream fShaderFile;
-
-    /// ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions (ifstream::failbit | ifstream::badbit);
-    fShaderFile.exceptions (ifstream::failbit | ifstream::badbit);
-    try
-    {
-        /// open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        stringstream vShaderStream, fShaderStream;
-
-        /// read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-
-        /// close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        /// convert stream into string
-        vertexCode   = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch(ifstream::failure e)
-    {
-        cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << endl;
-    }
-
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-
-    /// 2. compile shaders
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
-
-    ///Create a vertex Shader Object
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-
-    ///Populate the object with the shader code
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-
-    ///Compile the shader
-    glCompileShader(vertex);
-
-    /// print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if(success)
-    {
-        cout << "Vertex Shader compiled successfully" << endl;
-    }
-    else
-    {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog
-        << endl;
-    }
-
-    ///Same process for fragment shader.
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-
-    if(success)
-    {
-        cout << "Fragment Shader compiled successfully" << endl;
-    }
-    else
-    {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog
-        << endl;
-    }
-
-    ///Once the shaders are compiled link them into a shader program
+    readSources(vertexCode, fragmentCode);
 
-    ///Create a shader program and link them to 'this' ID
-    ID = glCreateProgram();
+    /// 2. compile and link them into a shader program, the backend prints
+    ///the errors if any
+    ID = getRenderBackend()->createProgram(vertexCode, fragmentCode);
+}
 
-    ///Link the shaders, to the shader program
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
+///Retrieves the vertex/fragment source code from the files
+bool Shader::readSources(string &vertexCode, string &fragmentCode)
+{
+    vector<string> fragmentDependencies;
 
-    /// print linking errors if any
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    if(success)
+    if(!ShaderPreprocessor::process(vertexFile, defines, vertexCode,
+                                    dependencies) ||
+       !ShaderPreprocessor::process(fragmentFile, defines, fragmentCode,
+                                    fragmentDependencies))
     {
-        cout << "Shader Program of ID " << ID << " was linked successfully"
-        << endl;
-    }
-    else
-    {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << endl;
+        return false;
     }
 
-    ///Once the linking is done, delete the shader objects, we don't need them
-    ///anymore
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    dependencies.insert(dependencies.end(), fragmentDependencies.begin(),
+                        fragmentDependencies.end());
+    return true;
 }
 
 ///Use this function to set 'this' shader as the current
 ///OpenGL shader
 void Shader::use()
 {
-    glUseProgram(ID);
+    getRenderBackend()->useProgram(ID);
 }
 
 ///This function returns the ID if 'this' shader object
@@ -172,15 +123,42 @@ int Shader::getID()
     return ID;
 }
 
+const string &Shader::getVertexPath()
+{
+    return vertexFile;
+}
+
+const string &Shader::getFragmentPath()
+{
+    return fragmentFile;
+}
+
+const ShaderDefines &Shader::getDefines()
+{
+    return defines;
+}
+
+const vector<string> &Shader::getDependencies()
+{
+    return dependencies;
+}
+
+unsigned int Shader::swapProgram(unsigned int newID)
+{
+    unsigned int oldID = ID;
+    ID = newID;
+    return oldID;
+}
+
 ///\////////////////Sets - Uniforms (GLSL)//////////////////////////////////////
 
-void Shader::setBool(const string &name, bool value)
+void Shader::setBool(const GLchar *name, bool value)
 {
-    int uniformLocation = glGetUniformLocation(ID, name.c_str());
+    int uniformLocation = getRenderBackend()->getUniformLocation(ID, name);
 
     if(uniformLocation != -1)
     {
-        glUniform1i(uniformLocation, (int)value);
+        getRenderBackend()->setUniform1i(uniformLocation, (int)value);
     }
     else
     {
@@ -190,13 +168,13 @@ void Shader::setBool(const string &name, bool value)
 
 }
 
-void Shader::setInt(const string &name, int value)
+void Shader::setInt(const GLchar *name, int value)
 {
-    int uniformLocation = glGetUniformLocation(ID, name.c_str());
+    int uniformLocation = getRenderBackend()->getUniformLocation(ID, name);
 
     if(uniformLocation != -1)
     {
-        glUniform1i(uniformLocation, value);
+        getRenderBackend()->setUniform1i(uniformLocation, value);
     }
     else
     {
@@ -206,13 +184,13 @@ void Shader::setInt(const string &name, int value)
 
 }
 
-void Shader::setFloat(const string &name, float value)
+void Shader::setFloat(const GLchar *name, float value)
 {
-    int uniformLocation = glGetUniformLocation(ID, name.c_str());
+    int uniformLocation = getRenderBackend()->getUniformLocation(ID, name);
 
     if(uniformLocation != -1)
     {
-        glUniform1i(uniformLocation, value);
+        getRenderBackend()->setUniform1f(uniformLocation, value);
     }
     else
     {
@@ -222,13 +200,30 @@ void Shader::setFloat(const string &name, float value)
 
 }
 
-void Shader::setMatrix4fv(const string &name, glm::mat4 mat)
+void Shader::setMatrix4fv(const GLchar *name, const glm::mat4 &mat)
+{
+    int uniformLocation = getRenderBackend()->getUniformLocation(ID, name);
+
+    if(uniformLocation != -1)
+    {
+        getRenderBackend()->setUniformMatrix4fv(uniformLocation,
+                                                glm::value_ptr(mat));
+    }
+    else
+    {
+        cout << "Couldn't find uniform " << name << " in Shader program " << ID
+        << endl;
+    }
+}
+
+void Shader::setUInt2v(const GLchar *name, int count,
+                       const unsigned int *values)
 {
-    int uniformLocation = glGetUniformLocation(ID, name.c_str());
+    int uniformLocation = getRenderBackend()->getUniformLocation(ID, name);
 
     if(uniformLocation != -1)
     {
-        glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(mat));
+        getRenderBackend()->setUniform2uiv(uniformLocation, count, values);
     }
     else
     {
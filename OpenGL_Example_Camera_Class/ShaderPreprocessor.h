@@ -0,0 +1,217 @@
+#ifndef SHADERPREPROCESSOR_H_INCLUDED
+#define SHADERPREPROCESSOR_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+///A list of "NAME" or "NAME VALUE" entries, one #define each
+typedef std::vector<std::string> ShaderDefines;
+
+///How deep includes may nest before it is taken as a cycle
+const int MAX_INCLUDE_DEPTH = 16;
+
+///Turns a GLSL file into the source that is given to the compiler:
+///  - #include "file" is replaced by the file, relative to the one including
+///    it. Every file is only included once.
+///  - The defines are written right after the #version line.
+///  - #line directives keep the line numbers of the compiler errors right,
+///    the source string number is the index of the file in dependencies.
+class ShaderPreprocessor
+{
+    private:
+
+        static bool expand(const std::string &path, int depth,
+                           std::string &out,
+                           std::vector<std::string> &dependencies);
+        static std::string getDirectory(const std::string &path);
+
+    public:
+
+        ///Fills out with the final source and dependencies with every file
+        ///that was read, the first one is path. False if a file is missing.
+        static bool process(const std::string &path,
+                            const ShaderDefines &defines, std::string &out,
+                            std::vector<std::string> &dependencies);
+
+        ///Same value for the same set of defines, whatever their order
+        static unsigned long long hashDefines(const ShaderDefines &defines);
+        static std::string describeDefines(const ShaderDefines &defines);
+};
+
+std::string ShaderPreprocessor::getDirectory(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+bool ShaderPreprocessor::expand(const std::string &path, int depth,
+                                std::string &out,
+                                std::vector<std::string> &dependencies)
+{
+    if(depth > MAX_INCLUDE_DEPTH)
+    {
+        std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+        return false;
+    }
+
+    ///Included once only
+    if(std::find(dependencies.begin(), dependencies.end(), path) !=
+       dependencies.end())
+    {
+        return true;
+    }
+
+    std::ifstream file(path.c_str());
+    if(!file)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path
+        << std::endl;
+        return false;
+    }
+
+    int fileIndex = dependencies.size();
+    dependencies.push_back(path);
+
+    std::ostringstream lineDirective;
+    if(depth > 0)
+    {
+        lineDirective << "#line 1 " << fileIndex << "\n";
+        out += lineDirective.str();
+    }
+
+    std::string line;
+    int lineNumber = 0;
+
+    while(std::getline(file, line))
+    {
+        lineNumber++;
+
+        ///Files saved on Windows
+        if(!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.erase(line.size() - 1);
+        }
+
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos ||
+           line.compare(start, 8, "#include") != 0)
+        {
+            out += line;
+            out += '\n';
+            continue;
+        }
+
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open :
+                                                   line.find('"', open + 1);
+        if(close == std::string::npos)
+        {
+            std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << "("
+            << lineNumber << ")" << std::endl;
+            return false;
+        }
+
+        std::string includePath = getDirectory(path) +
+                                  line.substr(open + 1, close - open - 1);
+
+        if(!expand(includePath, depth + 1, out, dependencies))
+        {
+            return false;
+        }
+
+        ///Back to this file
+        lineDirective.str("");
+        lineDirective << "#line " << lineNumber + 1 << " " << fileIndex
+                      << "\n";
+        out += lineDirective.str();
+    }
+
+    return true;
+}
+
+bool ShaderPreprocessor::process(const std::string &path,
+                                 const ShaderDefines &defines,
+                                 std::string &out,
+                                 std::vector<std::string> &dependencies)
+{
+    std::string source;
+
+    out.clear();
+    dependencies.clear();
+
+    if(!expand(path, 0, source, dependencies))
+    {
+        return false;
+    }
+
+    ///#version must come before anything else, the defines go after it
+    size_t version = source.find("#version");
+    size_t insertAt = 0;
+    int versionLine = 0;
+
+    if(version != std::string::npos)
+    {
+        insertAt = source.find('\n', version);
+        insertAt = insertAt == std::string::npos ? source.size() :
+                                                   insertAt + 1;
+        versionLine = std::count(source.begin(), source.begin() + insertAt,
+                                 '\n');
+    }
+
+    std::ostringstream header;
+    for(unsigned int i=0; i<defines.size(); i++)
+    {
+        header << "#define " << defines[i] << "\n";
+    }
+    header << "#line " << versionLine + 1 << " 0\n";
+
+    out = source.substr(0, insertAt) + header.str() + source.substr(insertAt);
+    return true;
+}
+
+///\/////////////////////////////Define sets///////////////////////////////////
+
+std::string ShaderPreprocessor::describeDefines(const ShaderDefines &defines)
+{
+    ShaderDefines sorted(defines);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string description;
+    for(unsigned int i=0; i<sorted.size(); i++)
+    {
+        description += (i ? " " : "") + sorted[i];
+    }
+
+    return description.empty() ? "<default>" : description;
+}
+
+///FNV-1a over the sorted defines
+unsigned long long ShaderPreprocessor::hashDefines(
+    const ShaderDefines &defines)
+{
+    ShaderDefines sorted(defines);
+    std::sort(sorted.begin(), sorted.end());
+
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for(unsigned int i=0; i<sorted.size(); i++)
+    {
+        for(unsigned int c=0; c<sorted[i].size(); c++)
+        {
+            hash ^= (unsigned char)sorted[i][c];
+            hash *= 1099511628211ULL;
+        }
+
+        ///Separator, so "AB" and "A","B" differ
+        hash ^= 0xff;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+#endif // SHADERPREPROCESSOR_H_INCLUDED
@@ -0,0 +1,522 @@
+#ifndef SHADERRELOADER_H_INCLUDED
+#define SHADERRELOADER_H_INCLUDED
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+///GLFW
+#include <GL/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+#include "Shader.h"
+#include "FileWatcher.h"
+
+///Time to wait after the last write before compiling, editors may save the
+///vertex and the fragment shader one after the other
+const float RELOAD_SETTLE_TIME = 0.05f;
+
+enum Reload_State
+{
+    RELOAD_IDLE,
+    RELOAD_SETTLING,
+    RELOAD_COMPILING
+};
+
+///Watches the files of a set of Shaders, includes too, and builds the ones
+///that use a changed file again, one at a time, without stalling the frame.
+///The compile and link run on the driver's threads with
+///GL_KHR_parallel_shader_compile, or on a worker thread with a shared context
+///otherwise. The new program only replaces the old one once it
+///links, a broken edit keeps the last good program.
+class ShaderReloader
+{
+    private:
+
+        typedef std::chrono::steady_clock Clock;
+
+        std::vector<Shader*> shaders;
+        FileWatcher watcher;
+        Reload_State state;
+
+        ///Shaders waiting to be built and the one being built
+        std::vector<Shader*> queue;
+        Shader *shader;
+
+        Clock::time_point changeTime;
+        Clock::time_point compileStart;
+        float fLongestFrame;
+
+        ///GL_KHR_parallel_shader_compile
+        bool bParallelCompile;
+        unsigned int pendingProgram;
+        unsigned int pendingVertex;
+        unsigned int pendingFragment;
+
+        ///Worker thread with its own context, shared with the window's
+        GLFWwindow *workerContext;
+        std::thread worker;
+        std::mutex mtx;
+        std::condition_variable wakeUp;
+        std::string jobVertex;
+        std::string jobFragment;
+        bool bJob;
+        bool bStop;
+        std::atomic<bool> bJobDone;
+        unsigned int workerProgram;
+        bool bWorkerSuccess;
+        std::string workerLog;
+
+        ///Private Functions
+        void queueChanged(const std::vector<std::string> &changed);
+        void startCompile();
+        bool pollParallelCompile(unsigned int &program);
+        bool pollWorkerCompile(unsigned int &program);
+        void finishReload(Shader *reloaded, unsigned int program);
+        void workerLoop();
+
+        static unsigned int compile(GLenum type, const std::string &code);
+        static bool getCompileLog(unsigned int shader, std::string &log);
+        static bool getLinkLog(unsigned int program, std::string &log);
+
+    public:
+
+        ///Constructor, window is the context the programs are used in
+        ShaderReloader(GLFWwindow *window);
+        ~ShaderReloader();
+
+        ///Starts watching the files of a shader, once per shader
+        void watch(Shader *shader);
+
+        ///Call once per frame, returns the shader whose program was swapped
+        ///in, its uniforms must be set again. NULL most of the time.
+        Shader *update(float frameTime);
+};
+
+///Constructor
+ShaderReloader::ShaderReloader(GLFWwindow *window)
+{
+    shader = NULL;
+    state = RELOAD_IDLE;
+    fLongestFrame = 0.0f;
+
+    pendingProgram = 0;
+    pendingVertex = 0;
+    pendingFragment = 0;
+
+    workerContext = NULL;
+    bJob = false;
+    bStop = false;
+    bJobDone = false;
+    workerProgram = 0;
+    bWorkerSuccess = false;
+
+    bParallelCompile = GLEW_KHR_parallel_shader_compile;
+
+    if(bParallelCompile)
+    {
+        ///Let the driver use as many threads as it wants
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    else
+    {
+        ///An invisible window only to get a context that shares objects
+        ///with the main one
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerContext = glfwCreateWindow(1, 1, "", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+        if(workerContext)
+        {
+            worker = std::thread(&ShaderReloader::workerLoop, this);
+        }
+        else
+        {
+            std::cout << "Couldn't create a shared context, shaders will "
+            << "be reloaded on the render thread" << std::endl;
+        }
+    }
+
+    std::cout << "Watching the shaders with "
+    << (watcher.usesInotify() ? "inotify" : "polling") << ", compiling with "
+    << (bParallelCompile ? "GL_KHR_parallel_shader_compile" :
+        workerContext ? "a shared context" : "the render thread")
+    << std::endl;
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    if(worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            bStop = true;
+        }
+        wakeUp.notify_one();
+        worker.join();
+    }
+
+    if(workerContext)
+    {
+        glfwDestroyWindow(workerContext);
+    }
+
+    if(pendingProgram)
+    {
+        glDeleteShader(pendingVertex);
+        glDeleteShader(pendingFragment);
+        glDeleteProgram(pendingProgram);
+    }
+}
+
+///\////////////////////////////GL helpers/////////////////////////////////////
+
+unsigned int ShaderReloader::compile(GLenum type, const std::string &code)
+{
+    const char *source = code.c_str();
+
+    unsigned int id = glCreateShader(type);
+    glShaderSource(id, 1, &source, NULL);
+    glCompileShader(id);
+
+    return id;
+}
+
+bool ShaderReloader::getCompileLog(unsigned int shader, std::string &log)
+{
+    int success;
+    char infoLog[512];
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        log += infoLog;
+    }
+
+    return success != 0;
+}
+
+bool ShaderReloader::getLinkLog(unsigned int program, std::string &log)
+{
+    int success;
+    char infoLog[512];
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        log += infoLog;
+    }
+
+    return success != 0;
+}
+
+///\/////////////////////////////Reloading/////////////////////////////////////
+
+void ShaderReloader::watch(Shader *shader)
+{
+    if(std::find(shaders.begin(), shaders.end(), shader) != shaders.end())
+    {
+        return;
+    }
+
+    shaders.push_back(shader);
+
+    const std::vector<std::string> &files = shader->getDependencies();
+    for(unsigned int i=0; i<files.size(); i++)
+    {
+        watcher.addFile(files[i]);
+    }
+}
+
+void ShaderReloader::queueChanged(const std::vector<std::string> &changed)
+{
+    for(unsigned int i=0; i<shaders.size(); i++)
+    {
+        if(std::find(queue.begin(), queue.end(), shaders[i]) != queue.end())
+        {
+            continue;
+        }
+
+        const std::vector<std::string> &files = shaders[i]->getDependencies();
+        for(unsigned int j=0; j<changed.size(); j++)
+        {
+            if(std::find(files.begin(), files.end(), changed[j]) !=
+               files.end())
+            {
+                queue.push_back(shaders[i]);
+                break;
+            }
+        }
+    }
+}
+
+Shader *ShaderReloader::update(float frameTime)
+{
+    std::vector<std::string> changed;
+    if(watcher.poll(changed))
+    {
+        ///An edit made while compiling queues that shader again
+        queueChanged(changed);
+        changeTime = Clock::now();
+
+        if(state == RELOAD_IDLE && !queue.empty())
+        {
+            state = RELOAD_SETTLING;
+            fLongestFrame = 0.0f;
+        }
+    }
+
+    if(state == RELOAD_IDLE)
+    {
+        return NULL;
+    }
+
+    fLongestFrame = std::max(fLongestFrame, frameTime);
+
+    if(state == RELOAD_SETTLING)
+    {
+        if(std::chrono::duration<float>(Clock::now() - changeTime).count() >=
+           RELOAD_SETTLE_TIME)
+        {
+            shader = queue.front();
+            queue.erase(queue.begin());
+            startCompile();
+        }
+        return NULL;
+    }
+
+    unsigned int program = 0;
+    bool bFinished = bParallelCompile ? pollParallelCompile(program) :
+                                        pollWorkerCompile(program);
+
+    if(!bFinished)
+    {
+        return NULL;
+    }
+
+    state = queue.empty() ? RELOAD_IDLE : RELOAD_SETTLING;
+
+    Shader *reloaded = shader;
+    shader = NULL;
+
+    if(!program)
+    {
+        std::cout << "Keeping shader program " << reloaded->getID()
+        << std::endl;
+        return NULL;
+    }
+
+    finishReload(reloaded, program);
+    return reloaded;
+}
+
+void ShaderReloader::startCompile()
+{
+    std::string vertexCode, fragmentCode;
+
+    if(!shader->readSources(vertexCode, fragmentCode))
+    {
+        shader = NULL;
+        state = queue.empty() ? RELOAD_IDLE : RELOAD_SETTLING;
+        return;
+    }
+
+    compileStart = Clock::now();
+    state = RELOAD_COMPILING;
+
+    if(bParallelCompile)
+    {
+        ///None of these wait for the compiler as long as no status is asked
+        ///for before GL_COMPLETION_STATUS_KHR says it is done
+        pendingVertex = compile(GL_VERTEX_SHADER, vertexCode);
+        pendingFragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+
+        pendingProgram = glCreateProgram();
+        glAttachShader(pendingProgram, pendingVertex);
+        glAttachShader(pendingProgram, pendingFragment);
+        glLinkProgram(pendingProgram);
+    }
+    else if(workerContext)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobVertex = vertexCode;
+            jobFragment = fragmentCode;
+            bJob = true;
+            bJobDone = false;
+        }
+        wakeUp.notify_one();
+    }
+    else
+    {
+        ///Nothing else to do it, the frame will stall
+        std::string log;
+
+        unsigned int vertex = compile(GL_VERTEX_SHADER, vertexCode);
+        unsigned int fragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+        bool bVertex = getCompileLog(vertex, log);
+        bool bFragment = getCompileLog(fragment, log);
+
+        workerProgram = glCreateProgram();
+        glAttachShader(workerProgram, vertex);
+        glAttachShader(workerProgram, fragment);
+        glLinkProgram(workerProgram);
+
+        bWorkerSuccess = getLinkLog(workerProgram, log) && bVertex &&
+                         bFragment;
+        workerLog = log;
+
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+        bJobDone = true;
+    }
+}
+
+bool ShaderReloader::pollParallelCompile(unsigned int &program)
+{
+    int done = 0;
+    glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+    if(!done)
+    {
+        return false;
+    }
+
+    std::string log;
+    bool bVertex = getCompileLog(pendingVertex, log);
+    bool bFragment = getCompileLog(pendingFragment, log);
+    bool bLinked = getLinkLog(pendingProgram, log);
+
+    glDeleteShader(pendingVertex);
+    glDeleteShader(pendingFragment);
+
+    if(bVertex && bFragment && bLinked)
+    {
+        program = pendingProgram;
+    }
+    else
+    {
+        std::cout << "ERROR::SHADER::RELOAD_FAILED\n" << log << std::endl;
+        glDeleteProgram(pendingProgram);
+        program = 0;
+    }
+
+    pendingProgram = 0;
+    pendingVertex = 0;
+    pendingFragment = 0;
+
+    return true;
+}
+
+bool ShaderReloader::pollWorkerCompile(unsigned int &program)
+{
+    if(!bJobDone)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if(bWorkerSuccess)
+    {
+        program = workerProgram;
+    }
+    else
+    {
+        std::cout << "ERROR::SHADER::RELOAD_FAILED\n" << workerLog
+        << std::endl;
+        glDeleteProgram(workerProgram);
+        program = 0;
+    }
+
+    workerProgram = 0;
+    bJobDone = false;
+
+    return true;
+}
+
+void ShaderReloader::finishReload(Shader *reloaded, unsigned int program)
+{
+    Clock::time_point now = Clock::now();
+
+    unsigned int oldProgram = reloaded->swapProgram(program);
+    glDeleteProgram(oldProgram);
+
+    ///An include may have been added
+    const std::vector<std::string> &files = reloaded->getDependencies();
+    for(unsigned int i=0; i<files.size(); i++)
+    {
+        watcher.addFile(files[i]);
+    }
+
+    std::cout << "Shader program " << program << " ("
+    << ShaderPreprocessor::describeDefines(reloaded->getDefines())
+    << ") replaced " << oldProgram << ": "
+    << std::chrono::duration<float, std::milli>(now - changeTime).count()
+    << " ms after the change, compile "
+    << std::chrono::duration<float, std::milli>(now - compileStart).count()
+    << " ms, longest frame " << fLongestFrame * 1000.0f << " ms" << std::endl;
+}
+
+///Compiles the jobs on the shared context, the program is finished with
+///glFinish before it is handed to the render thread
+void ShaderReloader::workerLoop()
+{
+    glfwMakeContextCurrent(workerContext);
+
+    while(true)
+    {
+        std::string vertexCode, fragmentCode;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            wakeUp.wait(lock, [&]{ return bStop || bJob; });
+            if(bStop)
+            {
+                break;
+            }
+            vertexCode.swap(jobVertex);
+            fragmentCode.swap(jobFragment);
+            bJob = false;
+        }
+
+        std::string log;
+
+        unsigned int vertex = compile(GL_VERTEX_SHADER, vertexCode);
+        unsigned int fragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+        bool bVertex = getCompileLog(vertex, log);
+        bool bFragment = getCompileLog(fragment, log);
+
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        bool bLinked = getLinkLog(program, log);
+
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        glFinish();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            workerProgram = program;
+            bWorkerSuccess = bVertex && bFragment && bLinked;
+            workerLog = log;
+        }
+        bJobDone = true;
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
+
+#endif // SHADERRELOADER_H_INCLUDED
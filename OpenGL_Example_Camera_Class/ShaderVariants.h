@@ -0,0 +1,145 @@
+#ifndef SHADERVARIANTS_H_INCLUDED
+#define SHADERVARIANTS_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+///Every permutation of one vertex/fragment pair, one program per set of
+///defines. A variant is compiled the first time it is asked for, unless it
+///was declared in precompile() at load time.
+class ShaderVariants
+{
+    private:
+
+        std::string vertexPath;
+        std::string fragmentPath;
+
+        ///Called on every new program, to set its samplers and such
+        std::function<void(Shader&)> setup;
+
+        ///Keyed by ShaderPreprocessor::hashDefines()
+        std::map<unsigned long long, Shader*> variants;
+
+        ///Same programs, in the order they were compiled
+        std::vector<Shader*> compiled;
+
+        ///Private Functions
+        Shader *compile(const ShaderDefines &defines, bool bLazy);
+
+    public:
+
+        ///Constructor
+        ShaderVariants(const std::string &vertexPath,
+                       const std::string &fragmentPath,
+                       const std::function<void(Shader&)> &setup = NULL);
+        ~ShaderVariants();
+
+        ///The program for this set of defines, compiled now if it isn't yet
+        Shader *get(const ShaderDefines &defines);
+
+        ///Compiles every listed variant, reporting the time each one took
+        void precompile(const std::vector<ShaderDefines> &list);
+
+        ///Getters
+        int getVariantCount();
+        Shader *getVariant(int i);
+};
+
+///Constructor
+ShaderVariants::ShaderVariants(const std::string &vertexPath,
+                               const std::string &fragmentPath,
+                               const std::function<void(Shader&)> &setup)
+{
+    this->vertexPath = vertexPath;
+    this->fragmentPath = fragmentPath;
+    this->setup = setup;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    for(unsigned int i=0; i<compiled.size(); i++)
+    {
+        delete compiled[i];
+    }
+}
+
+Shader *ShaderVariants::compile(const ShaderDefines &defines, bool bLazy)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(),
+                                defines);
+
+    if(setup)
+    {
+        setup(*shader);
+    }
+
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << (bLazy ? "Compiled variant on first use (" :
+                          "Precompiled variant (")
+    << ShaderPreprocessor::describeDefines(defines) << ") in "
+    << elapsed.count() << " ms" << std::endl;
+
+    variants[ShaderPreprocessor::hashDefines(defines)] = shader;
+    compiled.push_back(shader);
+    return shader;
+}
+
+Shader *ShaderVariants::get(const ShaderDefines &defines)
+{
+    std::map<unsigned long long, Shader*>::iterator it =
+        variants.find(ShaderPreprocessor::hashDefines(defines));
+
+    if(it != variants.end())
+    {
+        return it->second;
+    }
+
+    return compile(defines, true);
+}
+
+void ShaderVariants::precompile(const std::vector<ShaderDefines> &list)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    int count = 0;
+    for(unsigned int i=0; i<list.size(); i++)
+    {
+        if(variants.find(ShaderPreprocessor::hashDefines(list[i])) ==
+           variants.end())
+        {
+            compile(list[i], false);
+            count++;
+        }
+    }
+
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << count << " shader variants precompiled in "
+    << elapsed.count() << " ms" << std::endl;
+}
+
+int ShaderVariants::getVariantCount()
+{
+    return compiled.size();
+}
+
+Shader *ShaderVariants::getVariant(int i)
+{
+    return compiled[i];
+}
+
+#endif // SHADERVARIANTS_H_INCLUDED
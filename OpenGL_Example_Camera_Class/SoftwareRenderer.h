@@ -0,0 +1,878 @@
+#ifndef SOFTWARERENDERER_H_INCLUDED
+#define SOFTWARERENDERER_H_INCLUDED
+
+///GLEW
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+///SSE2 is used for the edge functions when the compiler has it
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+///Only the declarations, main.cpp holds the implementation
+#include <stb_image.h>
+
+#include "ThreadPool.h"
+
+using namespace glm;
+
+/// Default software renderer values
+const int SOFTWARE_TILE_SIZE = 64;
+const int SOFTWARE_DRAWS_PER_JOB = 16;
+
+///\////////////////////////////////SoftwareTexture/////////////////////////////
+
+///A texture in memory, sampled like GL_LINEAR + GL_REPEAT on level 0
+class SoftwareTexture
+{
+    private:
+
+        int iWidth;
+        int iHeight;
+        int iChannels;
+        std::vector<unsigned char> data;
+
+        vec4 texel(int x, int y) const;
+
+    public:
+
+        ///Constructor
+        SoftwareTexture();
+
+        ///Loads an image with stb_image, flip works like
+        ///stbi_set_flip_vertically_on_load
+        bool load(const char *path, bool flip);
+
+        ///Bilinear sample, uv wraps around
+        vec4 sample(vec2 uv) const;
+};
+
+SoftwareTexture::SoftwareTexture()
+{
+    iWidth = 0;
+    iHeight = 0;
+    iChannels = 0;
+}
+
+bool SoftwareTexture::load(const char *path, bool flip)
+{
+    stbi_set_flip_vertically_on_load(flip);
+
+    unsigned char *pixels = stbi_load(path, &iWidth, &iHeight, &iChannels, 0);
+
+    stbi_set_flip_vertically_on_load(false);
+
+    if(!pixels)
+    {
+        std::cout << "Failed to load texture data " << path << std::endl;
+        iWidth = iHeight = iChannels = 0;
+        return false;
+    }
+
+    data.assign(pixels, pixels + iWidth * iHeight * iChannels);
+    stbi_image_free(pixels);
+
+    return true;
+}
+
+vec4 SoftwareTexture::texel(int x, int y) const
+{
+    ///GL_REPEAT
+    x %= iWidth;
+    y %= iHeight;
+    if(x < 0) x += iWidth;
+    if(y < 0) y += iHeight;
+
+    const unsigned char *p = &data[(y * iWidth + x) * iChannels];
+
+    ///Missing channels read like OpenGL does, (r, 0, 0, 1)
+    return vec4(p[0] / 255.0f,
+                iChannels > 1 ? p[1] / 255.0f : 0.0f,
+                iChannels > 2 ? p[2] / 255.0f : 0.0f,
+                iChannels > 3 ? p[3] / 255.0f : 1.0f);
+}
+
+vec4 SoftwareTexture::sample(vec2 uv) const
+{
+    if(data.empty())
+    {
+        return vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    ///Texel centers are at half coordinates
+    float fx = uv.x * iWidth - 0.5f;
+    float fy = uv.y * iHeight - 0.5f;
+
+    float x0 = floorf(fx);
+    float y0 = floorf(fy);
+    float tx = fx - x0;
+    float ty = fy - y0;
+
+    int ix = (int)x0;
+    int iy = (int)y0;
+
+    vec4 top = texel(ix, iy) * (1.0f - tx) + texel(ix + 1, iy) * tx;
+    vec4 bottom = texel(ix, iy + 1) * (1.0f - tx) + texel(ix + 1, iy + 1) * tx;
+
+    return top * (1.0f - ty) + bottom * ty;
+}
+
+///\////////////////////////////////SoftwareFramebuffer/////////////////////////
+
+///Color (RGBA8) and depth buffer in memory. Row 0 is the bottom row, like in
+///OpenGL.
+class SoftwareFramebuffer
+{
+    private:
+
+        int iWidth;
+        int iHeight;
+
+    public:
+
+        std::vector<unsigned int> color;
+        std::vector<float> depth;
+
+        ///Constructor
+        SoftwareFramebuffer(int width = 0, int height = 0);
+
+        void resize(int width, int height);
+        void clear(vec4 clearColor);
+
+        ///Getters
+        int getWidth() const;
+        int getHeight() const;
+
+        ///Binary PPM (P6) images, written top row first
+        bool savePPM(const char *path) const;
+        bool loadPPM(const char *path);
+
+        ///Fraction of pixels where a channel differs by more than tolerance
+        float compare(const SoftwareFramebuffer &reference,
+                      int tolerance) const;
+};
+
+SoftwareFramebuffer::SoftwareFramebuffer(int width, int height)
+{
+    iWidth = 0;
+    iHeight = 0;
+    resize(width, height);
+}
+
+void SoftwareFramebuffer::resize(int width, int height)
+{
+    iWidth = width;
+    iHeight = height;
+    color.assign(width * height, 0);
+    depth.assign(width * height, 1.0f);
+}
+
+void SoftwareFramebuffer::clear(vec4 clearColor)
+{
+    unsigned int r = (unsigned int)(clamp(clearColor.x, 0.0f, 1.0f) * 255.0f
+                                    + 0.5f);
+    unsigned int g = (unsigned int)(clamp(clearColor.y, 0.0f, 1.0f) * 255.0f
+                                    + 0.5f);
+    unsigned int b = (unsigned int)(clamp(clearColor.z, 0.0f, 1.0f) * 255.0f
+                                    + 0.5f);
+    unsigned int a = (unsigned int)(clamp(clearColor.w, 0.0f, 1.0f) * 255.0f
+                                    + 0.5f);
+
+    std::fill(color.begin(), color.end(), r | (g << 8) | (b << 16) | (a << 24));
+    std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+int SoftwareFramebuffer::getWidth() const
+{
+    return iWidth;
+}
+
+int SoftwareFramebuffer::getHeight() const
+{
+    return iHeight;
+}
+
+bool SoftwareFramebuffer::savePPM(const char *path) const
+{
+    FILE *f = fopen(path, "wb");
+    if(!f)
+    {
+        std::cout << "ERROR::FRAMEBUFFER::COULD_NOT_WRITE " << path
+        << std::endl;
+        return false;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", iWidth, iHeight);
+
+    std::vector<unsigned char> row(iWidth * 3);
+    for(int y=iHeight-1; y>=0; y--)
+    {
+        for(int x=0; x<iWidth; x++)
+        {
+            unsigned int c = color[y * iWidth + x];
+            row[x * 3]     = c & 0xFF;
+            row[x * 3 + 1] = (c >> 8) & 0xFF;
+            row[x * 3 + 2] = (c >> 16) & 0xFF;
+        }
+        fwrite(&row[0], 1, row.size(), f);
+    }
+
+    fclose(f);
+    return true;
+}
+
+bool SoftwareFramebuffer::loadPPM(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        std::cout << "ERROR::FRAMEBUFFER::COULD_NOT_READ " << path << std::endl;
+        return false;
+    }
+
+    int width, height, maxValue;
+    if(fscanf(f, "P6 %d %d %d", &width, &height, &maxValue) != 3 ||
+       maxValue != 255)
+    {
+        std::cout << "ERROR::FRAMEBUFFER::NOT_A_PPM " << path << std::endl;
+        fclose(f);
+        return false;
+    }
+
+    ///Single whitespace before the pixel data
+    fgetc(f);
+
+    resize(width, height);
+
+    std::vector<unsigned char> row(width * 3);
+    for(int y=height-1; y>=0; y--)
+    {
+        if(fread(&row[0], 1, row.size(), f) != row.size())
+        {
+            std::cout << "ERROR::FRAMEBUFFER::TRUNCATED " << path << std::endl;
+            fclose(f);
+            return false;
+        }
+
+        for(int x=0; x<width; x++)
+        {
+            color[y * width + x] = row[x * 3] | (row[x * 3 + 1] << 8) |
+                                   (row[x * 3 + 2] << 16) | (0xFFu << 24);
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+float SoftwareFramebuffer::compare(const SoftwareFramebuffer &reference,
+                                   int tolerance) const
+{
+    if(reference.iWidth != iWidth || reference.iHeight != iHeight)
+    {
+        return 1.0f;
+    }
+
+    int different = 0;
+    for(unsigned int i=0; i<color.size(); i++)
+    {
+        for(int c=0; c<3; c++)
+        {
+            int a = (color[i] >> (c * 8)) & 0xFF;
+            int b = (reference.color[i] >> (c * 8)) & 0xFF;
+
+            if(abs(a - b) > tolerance)
+            {
+                different++;
+                break;
+            }
+        }
+    }
+
+    return color.empty() ? 0.0f : (float)different / (float)color.size();
+}
+
+///\////////////////////////////////SoftwareRenderer////////////////////////////
+
+///Output of the vertex shader
+struct SoftwareVertex
+{
+    vec4 clip;
+    vec3 color;
+    vec2 uv;
+};
+
+///A triangle ready to rasterize, attributes are already divided by w so they
+///can be interpolated linearly on screen
+struct SoftwareTriangle
+{
+    ///Edge functions, inside when A*x + B*y + C >= 0 for all three edges.
+    ///Edge i is opposite to vertex i, so its value is the weight of vertex i
+    float A[3];
+    float B[3];
+    float C[3];
+    bool topLeft[3];
+    float fInvArea;
+
+    float z[3];
+    float invW[3];
+    vec3 colorW[3];
+    vec2 uvW[3];
+
+    ///Textures of the draw it comes from
+    const SoftwareTexture *texture1;
+    const SoftwareTexture *texture2;
+
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+///A queued draw call, same arguments as glDrawElementsBaseVertex
+struct SoftwareDraw
+{
+    mat4 modelMat;
+    GLenum mode;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+
+    ///The ones set when the draw was queued
+    const SoftwareTexture *texture1;
+    const SoftwareTexture *texture2;
+};
+
+///Renders the cube scene without OpenGL. It runs the same math as
+///vShader.vs and fShader.fs: clip = proj * view * model * local * pos and
+///mix(texture1, texture2, 0.2) * color, with perspective correct
+///interpolation and a depth test (GL_LESS).
+///Draws are queued and executed in endFrame(): the vertices of every draw are
+///shaded in parallel, the triangles are binned in screen tiles and every tile
+///is rasterized by one thread, in submission order.
+class SoftwareRenderer
+{
+    private:
+
+        ///Vertex layout is the same as the VBO: position, color, texcoord
+        const float *vertexData;
+        int iVertexCount;
+        const unsigned int *indexData;
+
+        const SoftwareTexture *texture1;
+        const SoftwareTexture *texture2;
+
+        mat4 viewMat;
+        mat4 projMat;
+
+        SoftwareFramebuffer *target;
+        ThreadPool *pool;
+
+        std::vector<SoftwareDraw> draws;
+
+        ///One triangle list per job of draws, kept in submission order
+        std::vector< std::vector<SoftwareTriangle> > jobTriangles;
+
+        ///Triangles touching every tile, (job, triangle) pairs
+        int iTilesX;
+        int iTilesY;
+        std::vector< std::vector< std::pair<int, int> > > tiles;
+
+        ///Private Functions
+        void processDraws(int job);
+        void clipAndSetup(const SoftwareVertex &a, const SoftwareVertex &b,
+                          const SoftwareVertex &c,
+                          std::vector<SoftwareTriangle> &out);
+        void setupTriangle(const SoftwareVertex *v,
+                           std::vector<SoftwareTriangle> &out);
+        void rasterizeTile(int tile);
+        void shadePixel(const SoftwareTriangle &t, int x, int y, float l0,
+                        float l1, float l2);
+
+    public:
+
+        ///Constructor
+        SoftwareRenderer(ThreadPool *p = NULL);
+
+        ///Scene data
+        void setMesh(const float *vertices, int vertexCount,
+                     const unsigned int *indices);
+        ///Textures of the next draws, like binding them to units 0 and 1
+        void setTextures(const SoftwareTexture *t1, const SoftwareTexture *t2);
+        void setViewMat(const mat4 &m);
+        void setProjMat(const mat4 &m);
+        void setThreadPool(ThreadPool *p);
+
+        ///Frame
+        void beginFrame(SoftwareFramebuffer *fb, vec4 clearColor);
+        void draw(const mat4 &model, GLenum mode, unsigned int first,
+                  unsigned int count, int baseVertex);
+        void endFrame();
+};
+
+///Constructor
+SoftwareRenderer::SoftwareRenderer(ThreadPool *p)
+{
+    vertexData = NULL;
+    iVertexCount = 0;
+    indexData = NULL;
+    texture1 = NULL;
+    texture2 = NULL;
+    target = NULL;
+    pool = p;
+    iTilesX = 0;
+    iTilesY = 0;
+}
+
+void SoftwareRenderer::setMesh(const float *vertices, int vertexCount,
+                               const unsigned int *indices)
+{
+    vertexData = vertices;
+    iVertexCount = vertexCount;
+    indexData = indices;
+}
+
+void SoftwareRenderer::setTextures(const SoftwareTexture *t1,
+                                   const SoftwareTexture *t2)
+{
+    texture1 = t1;
+    texture2 = t2;
+}
+
+void SoftwareRenderer::setViewMat(const mat4 &m)
+{
+    viewMat = m;
+}
+
+void SoftwareRenderer::setProjMat(const mat4 &m)
+{
+    projMat = m;
+}
+
+void SoftwareRenderer::setThreadPool(ThreadPool *p)
+{
+    pool = p;
+}
+
+void SoftwareRenderer::beginFrame(SoftwareFramebuffer *fb, vec4 clearColor)
+{
+    target = fb;
+    target->clear(clearColor);
+    draws.clear();
+}
+
+void SoftwareRenderer::draw(const mat4 &model, GLenum mode,
+                            unsigned int first, unsigned int count,
+                            int baseVertex)
+{
+    SoftwareDraw d;
+    d.modelMat = model;
+    d.mode = mode;
+    d.firstIndex = first;
+    d.indexCount = count;
+    d.baseVertex = baseVertex;
+    d.texture1 = texture1;
+    d.texture2 = texture2;
+    draws.push_back(d);
+}
+
+///Vertex shader and primitive assembly for a group of draws
+void SoftwareRenderer::processDraws(int job)
+{
+    std::vector<SoftwareTriangle> &out = jobTriangles[job];
+    out.clear();
+
+    int first = job * SOFTWARE_DRAWS_PER_JOB;
+    int last = std::min((int)draws.size(), first + SOFTWARE_DRAWS_PER_JOB);
+
+    std::vector<SoftwareVertex> shaded;
+
+    for(int d=first; d<last; d++)
+    {
+        const SoftwareDraw &draw = draws[d];
+        mat4 mvp = projMat * viewMat * draw.modelMat;
+
+        const unsigned int *index = indexData + draw.firstIndex;
+
+        ///Range of vertices this draw uses
+        unsigned int minIndex = 0xFFFFFFFFu;
+        unsigned int maxIndex = 0;
+        for(unsigned int i=0; i<draw.indexCount; i++)
+        {
+            minIndex = std::min(minIndex, index[i]);
+            maxIndex = std::max(maxIndex, index[i]);
+        }
+
+        if(draw.indexCount == 0)
+        {
+            continue;
+        }
+
+        ///Vertex shader, once per vertex
+        shaded.resize(maxIndex - minIndex + 1);
+        for(unsigned int i=0; i<shaded.size(); i++)
+        {
+            const float *v = vertexData +
+                             (minIndex + i + draw.baseVertex) * 8;
+
+            shaded[i].clip = mvp * vec4(v[0], v[1], v[2], 1.0f);
+            shaded[i].color = vec3(v[3], v[4], v[5]);
+            shaded[i].uv = vec2(v[6], v[7]);
+        }
+
+        ///Primitive assembly
+        unsigned int firstTriangle = out.size();
+        int step = draw.mode == GL_TRIANGLE_STRIP ? 1 : 3;
+        for(unsigned int i=0; i+2<draw.indexCount; i+=step)
+        {
+            clipAndSetup(shaded[index[i] - minIndex],
+                         shaded[index[i + 1] - minIndex],
+                         shaded[index[i + 2] - minIndex], out);
+        }
+
+        for(unsigned int i=firstTriangle; i<out.size(); i++)
+        {
+            out[i].texture1 = draw.texture1;
+            out[i].texture2 = draw.texture2;
+        }
+    }
+}
+
+///Clips the triangle against the near plane (z > -w), the other planes are
+///handled by the screen bounds and the depth test
+void SoftwareRenderer::clipAndSetup(const SoftwareVertex &a,
+                                    const SoftwareVertex &b,
+                                    const SoftwareVertex &c,
+                                    std::vector<SoftwareTriangle> &out)
+{
+    const SoftwareVertex *in[3] = {&a, &b, &c};
+    SoftwareVertex poly[4];
+    int count = 0;
+
+    for(int i=0; i<3; i++)
+    {
+        const SoftwareVertex &p = *in[i];
+        const SoftwareVertex &q = *in[(i + 1) % 3];
+
+        float dp = p.clip.z + p.clip.w;
+        float dq = q.clip.z + q.clip.w;
+
+        if(dp >= 0.0f)
+        {
+            poly[count++] = p;
+        }
+
+        ///The edge crosses the plane
+        if((dp >= 0.0f) != (dq >= 0.0f))
+        {
+            float t = dp / (dp - dq);
+            SoftwareVertex v;
+            v.clip = p.clip + (q.clip - p.clip) * t;
+            v.color = p.color + (q.color - p.color) * t;
+            v.uv = p.uv + (q.uv - p.uv) * t;
+            poly[count++] = v;
+        }
+    }
+
+    ///Fan out the clipped polygon
+    for(int i=1; i+1<count; i++)
+    {
+        SoftwareVertex tri[3] = {poly[0], poly[i], poly[i + 1]};
+        setupTriangle(tri, out);
+    }
+}
+
+void SoftwareRenderer::setupTriangle(const SoftwareVertex *v,
+                                     std::vector<SoftwareTriangle> &out)
+{
+    int w = target->getWidth();
+    int h = target->getHeight();
+
+    float x[3], y[3];
+    SoftwareTriangle t;
+
+    for(int i=0; i<3; i++)
+    {
+        float invW = 1.0f / v[i].clip.w;
+
+        x[i] = (v[i].clip.x * invW * 0.5f + 0.5f) * w;
+        y[i] = (v[i].clip.y * invW * 0.5f + 0.5f) * h;
+
+        t.z[i] = v[i].clip.z * invW * 0.5f + 0.5f;
+        t.invW[i] = invW;
+        t.colorW[i] = v[i].color * invW;
+        t.uvW[i] = v[i].uv * invW;
+    }
+
+    float fArea = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+    if(fArea == 0.0f)
+    {
+        return;
+    }
+
+    ///Both windings are drawn (no face culling), flip the clockwise ones so
+    ///inside is always positive
+    if(fArea < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(t.z[1], t.z[2]);
+        std::swap(t.invW[1], t.invW[2]);
+        std::swap(t.colorW[1], t.colorW[2]);
+        std::swap(t.uvW[1], t.uvW[2]);
+        fArea = -fArea;
+    }
+
+    t.minX = std::max(0, (int)floorf(std::min(x[0], std::min(x[1], x[2]))));
+    t.maxX = std::min(w - 1, (int)ceilf(std::max(x[0], std::max(x[1], x[2]))));
+    t.minY = std::max(0, (int)floorf(std::min(y[0], std::min(y[1], y[2]))));
+    t.maxY = std::min(h - 1, (int)ceilf(std::max(y[0], std::max(y[1], y[2]))));
+
+    if(t.minX > t.maxX || t.minY > t.maxY)
+    {
+        return;
+    }
+
+    ///Edge i goes from vertex i+1 to vertex i+2
+    for(int i=0; i<3; i++)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+
+        float dx = x[b] - x[a];
+        float dy = y[b] - y[a];
+
+        t.A[i] = -dy;
+        t.B[i] = dx;
+        t.C[i] = dy * x[a] - dx * y[a];
+
+        ///Top-left rule, pixels exactly on a shared edge belong to one
+        ///triangle only
+        t.topLeft[i] = (dy < 0.0f) || (dy == 0.0f && dx < 0.0f);
+    }
+
+    t.fInvArea = 1.0f / fArea;
+
+    out.push_back(t);
+}
+
+///Fragment shader and depth test for one pixel
+void SoftwareRenderer::shadePixel(const SoftwareTriangle &t, int x, int y,
+                                  float l0, float l1, float l2)
+{
+    int w = target->getWidth();
+
+    float z = l0 * t.z[0] + l1 * t.z[1] + l2 * t.z[2];
+
+    float &depth = target->depth[y * w + x];
+    if(z >= depth || z > 1.0f)
+    {
+        return;
+    }
+    depth = z;
+
+    ///Perspective correct attributes
+    float invW = l0 * t.invW[0] + l1 * t.invW[1] + l2 * t.invW[2];
+    float fW = 1.0f / invW;
+
+    vec3 color = (t.colorW[0] * l0 + t.colorW[1] * l1 + t.colorW[2] * l2) * fW;
+    vec2 uv = (t.uvW[0] * l0 + t.uvW[1] * l1 + t.uvW[2] * l2) * fW;
+
+    ///FragColor = mix(texture(myTexture), texture(myTexture2), 0.2) * color
+    vec4 c1 = t.texture1 ? t.texture1->sample(uv) : vec4(1.0f);
+    vec4 c2 = t.texture2 ? t.texture2->sample(uv) : vec4(1.0f);
+    vec4 c = (c1 * 0.8f + c2 * 0.2f) * vec4(color, 1.0f);
+
+    unsigned int r = (unsigned int)(clamp(c.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+    unsigned int g = (unsigned int)(clamp(c.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+    unsigned int b = (unsigned int)(clamp(c.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+    unsigned int a = (unsigned int)(clamp(c.w, 0.0f, 1.0f) * 255.0f + 0.5f);
+
+    target->color[y * w + x] = r | (g << 8) | (b << 16) | (a << 24);
+}
+
+void SoftwareRenderer::rasterizeTile(int tile)
+{
+    int tileX0 = (tile % iTilesX) * SOFTWARE_TILE_SIZE;
+    int tileY0 = (tile / iTilesX) * SOFTWARE_TILE_SIZE;
+    int tileX1 = std::min(target->getWidth(), tileX0 + SOFTWARE_TILE_SIZE) - 1;
+    int tileY1 = std::min(target->getHeight(), tileY0 + SOFTWARE_TILE_SIZE) - 1;
+
+    const std::vector< std::pair<int, int> > &list = tiles[tile];
+
+    for(unsigned int n=0; n<list.size(); n++)
+    {
+        const SoftwareTriangle &t =
+            jobTriangles[list[n].first][list[n].second];
+
+        int x0 = std::max(tileX0, t.minX);
+        int x1 = std::min(tileX1, t.maxX);
+        int y0 = std::max(tileY0, t.minY);
+        int y1 = std::min(tileY1, t.maxY);
+
+        for(int y=y0; y<=y1; y++)
+        {
+            float py = y + 0.5f;
+
+#ifdef __SSE2__
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 e[3];
+            __m128 inside[3];
+            __m128 row[3];
+            __m128 stepA[3];
+            __m128 fair[3];
+
+            for(int i=0; i<3; i++)
+            {
+                row[i] = _mm_set1_ps(t.B[i] * py + t.C[i]);
+                stepA[i] = _mm_set1_ps(t.A[i]);
+
+                ///All bits set for top-left edges (>= 0), clear otherwise (> 0)
+                fair[i] = t.topLeft[i] ? _mm_castsi128_ps(_mm_set1_epi32(-1))
+                                       : zero;
+            }
+
+            for(int x=x0; x<=x1; x+=4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+                for(int i=0; i<3; i++)
+                {
+                    e[i] = _mm_add_ps(_mm_mul_ps(stepA[i], px), row[i]);
+                    inside[i] = _mm_or_ps(_mm_cmpgt_ps(e[i], zero),
+                                          _mm_and_ps(fair[i],
+                                                     _mm_cmpeq_ps(e[i], zero)));
+                    mask = _mm_and_ps(mask, inside[i]);
+                }
+
+                int bits = _mm_movemask_ps(mask);
+                if(bits == 0)
+                {
+                    continue;
+                }
+
+                float e0[4], e1[4], e2[4];
+                _mm_storeu_ps(e0, e[0]);
+                _mm_storeu_ps(e1, e[1]);
+                _mm_storeu_ps(e2, e[2]);
+
+                for(int k=0; k<4 && x + k <= x1; k++)
+                {
+                    if(bits & (1 << k))
+                    {
+                        shadePixel(t, x + k, y, e0[k] * t.fInvArea,
+                                   e1[k] * t.fInvArea, e2[k] * t.fInvArea);
+                    }
+                }
+            }
+#else
+            for(int x=x0; x<=x1; x++)
+            {
+                float px = x + 0.5f;
+                float e[3];
+                bool bInside = true;
+
+                for(int i=0; i<3; i++)
+                {
+                    e[i] = t.A[i] * px + t.B[i] * py + t.C[i];
+                    bInside = bInside && (e[i] > 0.0f ||
+                                          (e[i] == 0.0f && t.topLeft[i]));
+                }
+
+                if(bInside)
+                {
+                    shadePixel(t, x, y, e[0] * t.fInvArea, e[1] * t.fInvArea,
+                               e[2] * t.fInvArea);
+                }
+            }
+#endif
+        }
+    }
+}
+
+void SoftwareRenderer::endFrame()
+{
+    if(!target || !vertexData || !indexData)
+    {
+        return;
+    }
+
+    ///1. Vertex shading and triangle setup, in groups of draws
+    int jobs = (draws.size() + SOFTWARE_DRAWS_PER_JOB - 1) /
+               SOFTWARE_DRAWS_PER_JOB;
+    jobTriangles.resize(jobs);
+
+    if(pool)
+    {
+        pool->run(jobs, [&](int j) { processDraws(j); });
+    }
+    else
+    {
+        for(int j=0; j<jobs; j++)
+        {
+            processDraws(j);
+        }
+    }
+
+    ///2. Binning, in submission order so every tile draws like OpenGL would
+    iTilesX = (target->getWidth() + SOFTWARE_TILE_SIZE - 1) /
+              SOFTWARE_TILE_SIZE;
+    iTilesY = (target->getHeight() + SOFTWARE_TILE_SIZE - 1) /
+              SOFTWARE_TILE_SIZE;
+
+    tiles.resize(iTilesX * iTilesY);
+    for(unsigned int i=0; i<tiles.size(); i++)
+    {
+        tiles[i].clear();
+    }
+
+    for(int j=0; j<jobs; j++)
+    {
+        for(unsigned int n=0; n<jobTriangles[j].size(); n++)
+        {
+            const SoftwareTriangle &t = jobTriangles[j][n];
+
+            for(int ty=t.minY / SOFTWARE_TILE_SIZE;
+                ty<=t.maxY / SOFTWARE_TILE_SIZE; ty++)
+            {
+                for(int tx=t.minX / SOFTWARE_TILE_SIZE;
+                    tx<=t.maxX / SOFTWARE_TILE_SIZE; tx++)
+                {
+                    tiles[ty * iTilesX + tx].push_back(std::make_pair(j, n));
+                }
+            }
+        }
+    }
+
+    ///3. Rasterization, one tile per job
+    if(pool)
+    {
+        pool->run(tiles.size(), [&](int tile) { rasterizeTile(tile); });
+    }
+    else
+    {
+        for(unsigned int tile=0; tile<tiles.size(); tile++)
+        {
+            rasterizeTile(tile);
+        }
+    }
+}
+
+#endif // SOFTWARERENDERER_H_INCLUDED
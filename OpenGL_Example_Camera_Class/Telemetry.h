@@ -0,0 +1,590 @@
+#ifndef TELEMETRY_H_INCLUDED
+#define TELEMETRY_H_INCLUDED
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TELEMETRY_SOCKETS
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+///A peer that hangs up mid-write raises SIGPIPE, which kills the process.
+///Linux turns it off per send(), macOS per socket.
+#ifdef MSG_NOSIGNAL
+#define TELEMETRY_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define TELEMETRY_SEND_FLAGS 0
+#endif
+#endif
+
+///Buckets of every histogram, the upper bound of bucket i is base * 2^i
+const int TELEMETRY_BUCKETS = 24;
+
+///Where the snapshots are served unless told otherwise
+const char TELEMETRY_SOCKET_PATH[] = "/tmp/opengl_camera_telemetry.sock";
+
+///How long the server waits for the request line of a client, in ms
+const int TELEMETRY_READ_TIMEOUT = 100;
+
+enum Telemetry_Metric
+{
+    METRIC_FRAME_TIME,
+    METRIC_DRAW_CALLS,
+    METRIC_TRIANGLES,
+    METRIC_UNIFORM_UPLOADS,
+    METRIC_TEXTURE_BYTES,
+    METRIC_CULLED_INSTANCES,
+    METRIC_INPUT_LATENCY,
+    METRIC_COUNT
+};
+
+///A histogram with power of two buckets written by one thread, the render
+///thread, and read by any other. Every field is a relaxed atomic: there is
+///one writer so nothing needs a read-modify-write, and a reader may see a
+///frame half added, which a snapshot can live with.
+class TelemetryHistogram
+{
+    private:
+
+        const char *name;
+        const char *help;
+        double base;
+
+        std::atomic<unsigned long long> buckets[TELEMETRY_BUCKETS + 1];
+        std::atomic<unsigned long long> count;
+        std::atomic<double> sum;
+        std::atomic<double> last;
+
+        ///Private Functions
+        double getQuantile(const unsigned long long *counts,
+                           unsigned long long total, double q) const;
+
+    public:
+
+        ///Constructor
+        TelemetryHistogram();
+
+        ///name is the metric name, base the bound of the first bucket
+        void setup(const char *name, const char *help, double base);
+
+        ///Render thread only
+        void add(double value);
+
+        ///Any thread
+        void writePrometheus(std::ostream &out) const;
+        void writeLine(std::ostream &out) const;
+};
+
+///Per frame counters of the renderer, aggregated into histograms without
+///locks on the render thread and served to anyone who connects to a Unix
+///domain socket. A client sends one request line:
+///  "lines"        one line per metric with count, sum, last, p50 and p99
+///  anything else  Prometheus text format, an HTTP GET gets HTTP headers
+///                 too so curl --unix-socket and scrapers work
+///The time record() takes is itself a metric, to keep an eye on overhead.
+class Telemetry
+{
+    private:
+
+        TelemetryHistogram metrics[METRIC_COUNT];
+        std::atomic<unsigned long long> frames;
+        std::atomic<double> overheadSeconds;
+        std::atomic<double> frameSeconds;
+
+        std::string socketPath;
+        std::thread server;
+        std::atomic<bool> bStop;
+        int listenFd;
+
+        ///Which file the socket we bound is, so stop() only removes ours
+        unsigned long long socketDevice;
+        unsigned long long socketInode;
+
+        ///Private Functions
+        void serverLoop();
+        void serveClient(int fd);
+
+    public:
+
+        ///Constructor
+        Telemetry();
+        ~Telemetry();
+
+        ///Starts serving on the socket, false if it couldn't be opened
+        bool start(const std::string &path);
+        void stop();
+
+        ///Once per frame, render thread only. frameTime and inputLatency
+        ///are in seconds.
+        void record(float frameTime, unsigned int drawCalls,
+                    unsigned long long triangles,
+                    unsigned int uniformUploads,
+                    unsigned long long textureBytes,
+                    unsigned int culledInstances, double inputLatency);
+
+        ///The text a client asking for format gets
+        std::string getSnapshot(bool bLines) const;
+
+        ///Share of the frame time spent in record(), in percent
+        float getOverheadPercent() const;
+};
+
+///Connects to a telemetry socket, prints the snapshot and returns the exit
+///code. format is "lines" or "prometheus".
+int runTelemetryClient(const char *path, const char *format);
+
+///\///////////////////////////////TelemetryHistogram///////////////////////////
+
+///Constructor
+TelemetryHistogram::TelemetryHistogram()
+{
+    name = "";
+    help = "";
+    base = 1.0;
+
+    for(int i=0; i<=TELEMETRY_BUCKETS; i++)
+    {
+        buckets[i] = 0;
+    }
+    count = 0;
+    sum = 0.0;
+    last = 0.0;
+}
+
+void TelemetryHistogram::setup(const char *name, const char *help,
+                               double base)
+{
+    this->name = name;
+    this->help = help;
+    this->base = base;
+}
+
+void TelemetryHistogram::add(double value)
+{
+    ///First bucket whose bound is >= value, the last one is +Inf
+    int bucket = 0;
+    if(value > base)
+    {
+        bucket = (int)ceil(log2(value / base));
+        bucket = bucket > TELEMETRY_BUCKETS ? TELEMETRY_BUCKETS : bucket;
+    }
+
+    std::memory_order relaxed = std::memory_order_relaxed;
+    buckets[bucket].store(buckets[bucket].load(relaxed) + 1, relaxed);
+    count.store(count.load(relaxed) + 1, relaxed);
+    sum.store(sum.load(relaxed) + value, relaxed);
+    last.store(value, relaxed);
+}
+
+///Upper bound of the bucket the q quantile falls in
+double TelemetryHistogram::getQuantile(const unsigned long long *counts,
+                                       unsigned long long total,
+                                       double q) const
+{
+    unsigned long long rank = (unsigned long long)ceil(q * total);
+    unsigned long long seen = 0;
+
+    for(int i=0; i<TELEMETRY_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if(seen >= rank)
+        {
+            return base * pow(2.0, i);
+        }
+    }
+
+    return INFINITY;
+}
+
+void TelemetryHistogram::writePrometheus(std::ostream &out) const
+{
+    std::memory_order relaxed = std::memory_order_relaxed;
+
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " histogram\n";
+
+    ///Prometheus buckets are cumulative
+    unsigned long long cumulative = 0;
+    for(int i=0; i<TELEMETRY_BUCKETS; i++)
+    {
+        cumulative += buckets[i].load(relaxed);
+        out << name << "_bucket{le=\"" << base * pow(2.0, i) << "\"} "
+            << cumulative << "\n";
+    }
+    cumulative += buckets[TELEMETRY_BUCKETS].load(relaxed);
+
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << sum.load(relaxed) << "\n";
+    out << name << "_count " << cumulative << "\n";
+    out << name << "_last " << last.load(relaxed) << "\n";
+}
+
+void TelemetryHistogram::writeLine(std::ostream &out) const
+{
+    std::memory_order relaxed = std::memory_order_relaxed;
+
+    unsigned long long counts[TELEMETRY_BUCKETS + 1];
+    unsigned long long total = 0;
+    for(int i=0; i<=TELEMETRY_BUCKETS; i++)
+    {
+        counts[i] = buckets[i].load(relaxed);
+        total += counts[i];
+    }
+
+    out << name << " count=" << total << " sum=" << sum.load(relaxed)
+        << " last=" << last.load(relaxed);
+
+    if(total > 0)
+    {
+        out << " p50<=" << getQuantile(counts, total, 0.5)
+            << " p99<=" << getQuantile(counts, total, 0.99);
+    }
+
+    out << "\n";
+}
+
+///\//////////////////////////////////Telemetry/////////////////////////////////
+
+///Constructor
+Telemetry::Telemetry()
+{
+    metrics[METRIC_FRAME_TIME].setup("camera_frame_time_ms",
+                                     "Time between two frames", 0.25);
+    metrics[METRIC_DRAW_CALLS].setup("camera_draw_calls",
+                                     "Draw calls per frame", 1.0);
+    metrics[METRIC_TRIANGLES].setup("camera_triangles",
+                                    "Triangles drawn per frame", 1.0);
+    metrics[METRIC_UNIFORM_UPLOADS].setup("camera_uniform_uploads",
+                                          "Uniforms set per frame", 1.0);
+    metrics[METRIC_TEXTURE_BYTES].setup("camera_texture_bytes",
+                                        "Texture memory in use", 65536.0);
+    metrics[METRIC_CULLED_INSTANCES].setup("camera_culled_instances",
+                                           "Instances culled per frame",
+                                           1.0);
+    metrics[METRIC_INPUT_LATENCY].setup("camera_input_latency_ms",
+                                        "Input poll to submit of the frame "
+                                        "that shows it", 0.25);
+
+    frames = 0;
+    overheadSeconds = 0.0;
+    frameSeconds = 0.0;
+    bStop = false;
+    listenFd = -1;
+    socketDevice = 0;
+    socketInode = 0;
+}
+
+Telemetry::~Telemetry()
+{
+    stop();
+}
+
+void Telemetry::record(float frameTime, unsigned int drawCalls,
+                       unsigned long long triangles,
+                       unsigned int uniformUploads,
+                       unsigned long long textureBytes,
+                       unsigned int culledInstances, double inputLatency)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    metrics[METRIC_FRAME_TIME].add(frameTime * 1000.0);
+    metrics[METRIC_DRAW_CALLS].add(drawCalls);
+    metrics[METRIC_TRIANGLES].add((double)triangles);
+    metrics[METRIC_UNIFORM_UPLOADS].add(uniformUploads);
+    metrics[METRIC_TEXTURE_BYTES].add((double)textureBytes);
+    metrics[METRIC_CULLED_INSTANCES].add(culledInstances);
+    metrics[METRIC_INPUT_LATENCY].add(inputLatency * 1000.0);
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    std::memory_order relaxed = std::memory_order_relaxed;
+    frames.store(frames.load(relaxed) + 1, relaxed);
+    overheadSeconds.store(overheadSeconds.load(relaxed) + elapsed.count(),
+                          relaxed);
+    frameSeconds.store(frameSeconds.load(relaxed) + frameTime, relaxed);
+}
+
+float Telemetry::getOverheadPercent() const
+{
+    double total = frameSeconds.load(std::memory_order_relaxed);
+    return total > 0.0 ?
+           100.0 * overheadSeconds.load(std::memory_order_relaxed) / total :
+           0.0f;
+}
+
+std::string Telemetry::getSnapshot(bool bLines) const
+{
+    std::ostringstream out;
+    std::memory_order relaxed = std::memory_order_relaxed;
+
+    for(int m=0; m<METRIC_COUNT; m++)
+    {
+        if(bLines)
+        {
+            metrics[m].writeLine(out);
+        }
+        else
+        {
+            metrics[m].writePrometheus(out);
+        }
+    }
+
+    if(bLines)
+    {
+        out << "camera_frames " << frames.load(relaxed)
+            << "\ncamera_telemetry_overhead_percent "
+            << getOverheadPercent() << "\n";
+    }
+    else
+    {
+        out << "# TYPE camera_frames counter\n"
+            << "camera_frames " << frames.load(relaxed) << "\n"
+            << "# TYPE camera_telemetry_overhead_seconds counter\n"
+            << "camera_telemetry_overhead_seconds "
+            << overheadSeconds.load(relaxed) << "\n";
+    }
+
+    return out.str();
+}
+
+///\////////////////////////////////////Server//////////////////////////////////
+
+#ifdef TELEMETRY_SOCKETS
+///Writes all of data to the socket. False if the peer is gone (EPIPE) or
+///the write failed, the caller drops the connection.
+bool sendAll(int fd, const char *data, size_t size)
+{
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    while(size > 0)
+    {
+        ssize_t sent = send(fd, data, size, TELEMETRY_SEND_FLAGS);
+        if(sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+#endif
+
+bool Telemetry::start(const std::string &path)
+{
+#ifdef TELEMETRY_SOCKETS
+    struct sockaddr_un address;
+    if(path.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "Telemetry socket path too long " << path << std::endl;
+        return false;
+    }
+
+    ///A socket left behind by a run that crashed is replaced, anything else
+    ///at the path is left alone
+    struct stat file;
+    if(lstat(path.c_str(), &file) == 0)
+    {
+        if(!S_ISSOCK(file.st_mode))
+        {
+            std::cout << "ERROR::TELEMETRY::NOT_A_SOCKET " << path
+                      << std::endl;
+            return false;
+        }
+
+        unlink(path.c_str());
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listenFd < 0)
+    {
+        std::cout << "Couldn't create the telemetry socket" << std::endl;
+        return false;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+
+    if(bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+       listen(listenFd, 4) != 0)
+    {
+        std::cout << "Couldn't listen on " << path << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    if(lstat(path.c_str(), &file) == 0)
+    {
+        socketDevice = file.st_dev;
+        socketInode = file.st_ino;
+    }
+
+    socketPath = path;
+    bStop = false;
+    server = std::thread(&Telemetry::serverLoop, this);
+
+    std::cout << "Serving telemetry on " << path << std::endl;
+    return true;
+#else
+    std::cout << "Telemetry needs Unix domain sockets" << std::endl;
+    return false;
+#endif
+}
+
+void Telemetry::stop()
+{
+    if(!server.joinable())
+    {
+        return;
+    }
+
+    bStop = true;
+    server.join();
+
+#ifdef TELEMETRY_SOCKETS
+    close(listenFd);
+    listenFd = -1;
+
+    ///Only if the path is still the socket this run made
+    struct stat file;
+    if(lstat(socketPath.c_str(), &file) == 0 && S_ISSOCK(file.st_mode) &&
+       (unsigned long long)file.st_dev == socketDevice &&
+       (unsigned long long)file.st_ino == socketInode)
+    {
+        unlink(socketPath.c_str());
+    }
+#endif
+}
+
+void Telemetry::serverLoop()
+{
+#ifdef TELEMETRY_SOCKETS
+    while(!bStop)
+    {
+        ///Wake up now and then to see if it's time to stop
+        struct pollfd listener = {listenFd, POLLIN, 0};
+        if(poll(&listener, 1, 200) <= 0)
+        {
+            continue;
+        }
+
+        int client = accept(listenFd, NULL, NULL);
+        if(client >= 0)
+        {
+            serveClient(client);
+            close(client);
+        }
+    }
+#endif
+}
+
+void Telemetry::serveClient(int fd)
+{
+#ifdef TELEMETRY_SOCKETS
+    char request[256] = {0};
+
+    struct pollfd reader = {fd, POLLIN, 0};
+    if(poll(&reader, 1, TELEMETRY_READ_TIMEOUT) > 0)
+    {
+        ssize_t length = read(fd, request, sizeof(request) - 1);
+        request[length > 0 ? length : 0] = '\0';
+    }
+
+    bool bHttp = strncmp(request, "GET ", 4) == 0;
+    bool bLines = strncmp(request, "lines", 5) == 0;
+
+    std::string body = getSnapshot(bLines);
+    std::string response;
+
+    if(bHttp)
+    {
+        std::ostringstream header;
+        header << "HTTP/1.0 200 OK\r\n"
+               << "Content-Type: text/plain; version=0.0.4\r\n"
+               << "Content-Length: " << body.size() << "\r\n\r\n";
+        response = header.str();
+    }
+    response += body;
+
+    ///A client that hung up is just dropped
+    sendAll(fd, response.c_str(), response.size());
+#endif
+}
+
+///\////////////////////////////////////Client//////////////////////////////////
+
+int runTelemetryClient(const char *path, const char *format)
+{
+#ifdef TELEMETRY_SOCKETS
+    struct sockaddr_un address;
+    if(strlen(path) >= sizeof(address.sun_path))
+    {
+        std::cout << "Telemetry socket path too long " << path << std::endl;
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if(fd < 0 ||
+       connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+    {
+        std::cout << "Couldn't connect to " << path << std::endl;
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+
+    std::string request = std::string(format) + "\n";
+    if(!sendAll(fd, request.c_str(), request.size()))
+    {
+        std::cout << "The telemetry server hung up" << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    char buffer[4096];
+    ssize_t length;
+    while((length = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        std::cout.write(buffer, length);
+    }
+    std::cout.flush();
+
+    close(fd);
+    return 0;
+#else
+    std::cout << "Telemetry needs Unix domain sockets" << std::endl;
+    return 1;
+#endif
+}
+
+#endif // TELEMETRY_H_INCLUDED
@@ -0,0 +1,404 @@
+#ifndef TEXTURELIBRARY_H_INCLUDED
+#define TEXTURELIBRARY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include <stb_image.h>
+
+#include "RenderBackend.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+///Size of the handle table in fShader.fs
+const int MAX_TEXTURE_LAYERS = 16;
+
+enum Texture_Mode
+{
+    ///One texture object per image, bound to units 0 and 1 before a draw
+    ///that uses different ones than the last draw
+    TEXTURE_UNITS,
+    ///Every image is a layer of one GL_TEXTURE_2D_ARRAY bound once
+    TEXTURE_ARRAY,
+    ///One texture object per image, the shader gets their bindless handles
+    TEXTURE_BINDLESS
+};
+
+///The textures of the scene, all the same size. Draws pick two of them
+///(base and detail) by index, which in the array and bindless modes is only a
+///uniform: no texture is bound between draws.
+class TextureLibrary
+{
+    private:
+
+        struct Layer
+        {
+            std::string path;
+            bool flip;
+            ///The level that was uploaded, the whole image unless build()
+            ///was given a first level
+            std::vector<unsigned char> rgba;
+            unsigned int texture;
+            unsigned long long handle;
+        };
+
+        std::vector<Layer> layers;
+        int iWidth;
+        int iHeight;
+
+        Texture_Mode mode;
+        unsigned int arrayTexture;
+
+        ///Textures of the last draw: on units 0 and 1, or in the layer
+        ///uniforms of the program
+        int boundBase;
+        int boundDetail;
+
+    public:
+
+        ///Constructor
+        TextureLibrary();
+
+        ///Loads an image, returns its index or -1. Every image must have the
+        ///size of the first one.
+        int addTexture(const char *path, bool flip);
+
+        ///Uploads the images, bindless falls back to an array if the backend
+        ///doesn't have it. Returns the mode used. Textures on units or
+        ///bindless start at firstMip, the array always has every level.
+        Texture_Mode build(Texture_Mode wanted, int firstMip = 0);
+
+        ///Puts another texture object in place of texture i and deletes the
+        ///old one, for the streaming of its levels
+        void replaceTexture(int i, unsigned int texture);
+
+        ///Defines the shader needs for the mode
+        void addDefines(ShaderDefines &defines);
+
+        ///Once per program, samplers and handles
+        void setupShader(Shader &s);
+
+        ///Once per frame and after changing programs, binds the array in
+        ///that mode
+        void bind();
+
+        ///Before every draw, base and detail are texture indices
+        void bindMaterial(Shader &s, int base, int detail);
+
+        ///Getters
+        Texture_Mode getMode();
+        int getLayerCount();
+        int getWidth();
+        int getHeight();
+        const std::string &getPath(int i);
+        bool getFlip(int i);
+        const std::vector<unsigned char> &getPixels(int i);
+        static const char *getModeName(Texture_Mode m);
+
+        ///Box filters an RGBA image to half its size, at least 1x1
+        static void halveImage(const std::vector<unsigned char> &src,
+                               int width, int height,
+                               std::vector<unsigned char> &dst);
+};
+
+///Constructor
+TextureLibrary::TextureLibrary()
+{
+    iWidth = 0;
+    iHeight = 0;
+    mode = TEXTURE_UNITS;
+    arrayTexture = 0;
+    boundBase = -1;
+    boundDetail = -1;
+}
+
+int TextureLibrary::addTexture(const char *path, bool flip)
+{
+    if((int)layers.size() >= MAX_TEXTURE_LAYERS)
+    {
+        std::cout << "Too many textures, " << path << " not loaded"
+        << std::endl;
+        return -1;
+    }
+
+    int width, height, nrChannels;
+
+    stbi_set_flip_vertically_on_load(flip);
+    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 4);
+    stbi_set_flip_vertically_on_load(false);
+
+    if(!data)
+    {
+        std::cout << "Failed to load texture data " << path << std::endl;
+        return -1;
+    }
+
+    if(!layers.empty() && (width != iWidth || height != iHeight))
+    {
+        std::cout << "Texture " << path << " is " << width << "x" << height
+        << ", the others are " << iWidth << "x" << iHeight << std::endl;
+        stbi_image_free(data);
+        return -1;
+    }
+
+    iWidth = width;
+    iHeight = height;
+
+    Layer layer;
+    layer.path = path;
+    layer.flip = flip;
+    layer.rgba.assign(data, data + width * height * 4);
+    layer.texture = 0;
+    layer.handle = 0;
+    layers.push_back(layer);
+
+    stbi_image_free(data);
+
+    return layers.size() - 1;
+}
+
+Texture_Mode TextureLibrary::build(Texture_Mode wanted, int firstMip)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    if(wanted == TEXTURE_BINDLESS && !backend->supportsBindless())
+    {
+        std::cout << "GL_ARB_bindless_texture not available, using a texture "
+        << "array" << std::endl;
+        wanted = TEXTURE_ARRAY;
+    }
+
+    mode = wanted;
+
+    if(mode == TEXTURE_ARRAY)
+    {
+        std::vector<unsigned char> data;
+        for(unsigned int i=0; i<layers.size(); i++)
+        {
+            data.insert(data.end(), layers[i].rgba.begin(),
+                        layers[i].rgba.end());
+        }
+
+        arrayTexture = backend->createTextureArray(iWidth, iHeight,
+                                                   layers.size(),
+                                                   data.empty() ? NULL :
+                                                   &data[0]);
+    }
+    else
+    {
+        for(unsigned int i=0; i<layers.size(); i++)
+        {
+            int width = iWidth;
+            int height = iHeight;
+
+            for(int m=0; m<firstMip; m++)
+            {
+                std::vector<unsigned char> half;
+                halveImage(layers[i].rgba, width, height, half);
+                layers[i].rgba.swap(half);
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+
+            layers[i].texture = backend->createTexture2D(width, height, 4,
+                                                         &layers[i].rgba[0]);
+
+            if(mode == TEXTURE_BINDLESS)
+            {
+                layers[i].handle =
+                    backend->getBindlessHandle(layers[i].texture);
+            }
+        }
+    }
+
+    std::cout << layers.size() << " textures of " << iWidth << "x" << iHeight
+    << " as " << getModeName(mode) << std::endl;
+
+    return mode;
+}
+
+void TextureLibrary::replaceTexture(int i, unsigned int texture)
+{
+    RenderBackend *backend = getRenderBackend();
+
+    backend->deleteTexture(layers[i].texture);
+    layers[i].texture = texture;
+
+    if(mode == TEXTURE_BINDLESS)
+    {
+        layers[i].handle = backend->getBindlessHandle(texture);
+    }
+
+    ///It may be the one on a unit now
+    boundBase = -1;
+    boundDetail = -1;
+}
+
+void TextureLibrary::addDefines(ShaderDefines &defines)
+{
+    if(mode == TEXTURE_ARRAY)
+    {
+        defines.push_back("TEXTURE_ARRAY");
+    }
+    else if(mode == TEXTURE_BINDLESS)
+    {
+        defines.push_back("BINDLESS_TEXTURES");
+    }
+}
+
+void TextureLibrary::setupShader(Shader &s)
+{
+    s.use();
+
+    if(mode == TEXTURE_UNITS)
+    {
+        s.setInt("myTexture", 0);
+        s.setInt("myTexture2", 1);
+    }
+    else if(mode == TEXTURE_ARRAY)
+    {
+        s.setInt("textureArray", 0);
+    }
+    else
+    {
+        ///Every handle as two 32 bit halves, low first
+        std::vector<unsigned int> handles;
+        for(unsigned int i=0; i<layers.size(); i++)
+        {
+            unsigned long long handle = layers[i].handle;
+            handles.push_back((unsigned int)(handle & 0xFFFFFFFFu));
+            handles.push_back((unsigned int)(handle >> 32));
+        }
+
+        if(!handles.empty())
+        {
+            s.setUInt2v("textureHandles", layers.size(), &handles[0]);
+        }
+    }
+}
+
+void TextureLibrary::bind()
+{
+    if(mode == TEXTURE_ARRAY)
+    {
+        getRenderBackend()->bindTextureArray(0, arrayTexture);
+    }
+
+    ///Another program may have been drawn with other textures
+    boundBase = -1;
+    boundDetail = -1;
+}
+
+void TextureLibrary::bindMaterial(Shader &s, int base, int detail)
+{
+    if(mode != TEXTURE_UNITS)
+    {
+        if(base != boundBase)
+        {
+            s.setInt("baseLayer", base);
+            boundBase = base;
+        }
+
+        if(detail != boundDetail)
+        {
+            s.setInt("detailLayer", detail);
+            boundDetail = detail;
+        }
+        return;
+    }
+
+    if(base != boundBase)
+    {
+        getRenderBackend()->bindTexture(0, layers[base].texture);
+        boundBase = base;
+    }
+
+    if(detail != boundDetail)
+    {
+        getRenderBackend()->bindTexture(1, layers[detail].texture);
+        boundDetail = detail;
+    }
+}
+
+Texture_Mode TextureLibrary::getMode()
+{
+    return mode;
+}
+
+int TextureLibrary::getLayerCount()
+{
+    return layers.size();
+}
+
+int TextureLibrary::getWidth()
+{
+    return iWidth;
+}
+
+int TextureLibrary::getHeight()
+{
+    return iHeight;
+}
+
+const std::string &TextureLibrary::getPath(int i)
+{
+    return layers[i].path;
+}
+
+bool TextureLibrary::getFlip(int i)
+{
+    return layers[i].flip;
+}
+
+const std::vector<unsigned char> &TextureLibrary::getPixels(int i)
+{
+    return layers[i].rgba;
+}
+
+const char *TextureLibrary::getModeName(Texture_Mode m)
+{
+    switch(m)
+    {
+        case TEXTURE_ARRAY:    return "a texture array";
+        case TEXTURE_BINDLESS: return "bindless textures";
+        default:               return "texture units";
+    }
+}
+
+void TextureLibrary::halveImage(const std::vector<unsigned char> &src,
+                                int width, int height,
+                                std::vector<unsigned char> &dst)
+{
+    int halfWidth = std::max(1, width / 2);
+    int halfHeight = std::max(1, height / 2);
+
+    dst.resize(halfWidth * halfHeight * 4);
+
+    for(int y=0; y<halfHeight; y++)
+    {
+        ///An odd last row or column is sampled twice
+        int y0 = std::min(y * 2, height - 1);
+        int y1 = std::min(y * 2 + 1, height - 1);
+
+        for(int x=0; x<halfWidth; x++)
+        {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+
+            for(int c=0; c<4; c++)
+            {
+                int sum = src[(y0 * width + x0) * 4 + c] +
+                          src[(y0 * width + x1) * 4 + c] +
+                          src[(y1 * width + x0) * 4 + c] +
+                          src[(y1 * width + x1) * 4 + c];
+
+                dst[(y * halfWidth + x) * 4 + c] =
+                    (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+#endif // TEXTURELIBRARY_H_INCLUDED
@@ -0,0 +1,599 @@
+#ifndef TEXTURESTREAMER_H_INCLUDED
+#define TEXTURESTREAMER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include <stb_image.h>
+
+#include "RenderBackend.h"
+#include "TextureLibrary.h"
+
+///Largest side of the coarsest level, every texture keeps at least that much
+///on the GPU so there is always something to draw with
+const int STREAM_MIN_SIZE = 32;
+
+///Loaded levels uploaded per frame at most, the rest wait for the next ones
+const int STREAM_UPLOADS_PER_FRAME = 2;
+
+///Keeps only the mip levels the camera needs of every texture of a
+///TextureLibrary on the GPU:
+///  - Draws tell it how many pixels a texture covers, which gives the finest
+///    level worth having.
+///  - Finer levels are read from the file and filtered down on a worker
+///    thread, then uploaded as a new texture that starts at that level.
+///  - Above the memory budget the least recently used textures lose their
+///    finest level first, down to the coarsest one.
+///Works with textures on units or bindless, a texture array has every level
+///of every layer.
+class TextureStreamer
+{
+    private:
+
+        typedef std::chrono::high_resolution_clock Clock;
+
+        struct StreamedTexture
+        {
+            ///Finest level on the GPU
+            int residentMip;
+            ///Finest level a draw asked for this frame, -1 if none did
+            int wantedMip;
+            ///Level the worker is loading, -1 if none, and the bytes it was
+            ///given room for
+            int loadingMip;
+            unsigned long long loadingBytes;
+            ///Frame it was last drawn in
+            unsigned int lastUsed;
+            ///The file couldn't be read, don't ask again
+            bool bBroken;
+            ///Resident level, a coarser one is filtered from it without
+            ///reading the GPU back
+            std::vector<unsigned char> pixels;
+        };
+
+        struct LoadJob
+        {
+            int texture;
+            int mip;
+            std::string path;
+            bool flip;
+            Clock::time_point requestTime;
+        };
+
+        struct LoadResult
+        {
+            int texture;
+            int mip;
+            int width;
+            int height;
+            std::vector<unsigned char> pixels;
+            Clock::time_point requestTime;
+        };
+
+        TextureLibrary *library;
+        std::vector<StreamedTexture> textures;
+        int iWidth;
+        int iHeight;
+        int iCoarsestMip;
+
+        unsigned long long budget;
+        unsigned long long residentBytes;
+        unsigned long long requestedBytes;
+        ///Room promised to the loads in flight
+        unsigned long long pendingBytes;
+        unsigned int frame;
+
+        ///Worker thread
+        std::thread worker;
+        std::mutex mtx;
+        std::condition_variable wakeUp;
+        std::deque<LoadJob> jobs;
+        std::deque<LoadResult> results;
+        bool bStop;
+
+        ///Since the last printStats()
+        int iLoads;
+        int iEvictions;
+        int iRejected;
+        float fLatencySum;
+        float fLatencyMax;
+
+        ///Private Functions
+        unsigned long long getChainBytes(int mip);
+        int getLevelWidth(int mip);
+        int getLevelHeight(int mip);
+        int getEvictTarget(int t);
+        unsigned long long getEvictableBytes(int keep);
+        bool makeRoom(unsigned long long bytes, int keep);
+        void dropLevel(int t);
+        void upload(int t, int mip, int width, int height,
+                    std::vector<unsigned char> &pixels);
+        void workerLoop();
+        static void loadLevel(const LoadJob &job, LoadResult &result);
+
+    public:
+
+        ///Constructor, library must have been built with getCoarsestMip()
+        ///as its first level. budget is in bytes.
+        TextureStreamer(TextureLibrary *library, unsigned long long budget);
+        ~TextureStreamer();
+
+        ///First level of a texture of that size that isn't streamed
+        static int getCoarsestMip(int width, int height);
+
+        ///A draw this frame covers that many pixels across with texture t
+        void requestSize(int t, float pixels);
+
+        ///Call once per frame after the draws: uploads what the worker
+        ///loaded, asks it for the levels now missing and keeps the budget.
+        ///True if a texture object changed, bindless handles must be set in
+        ///the programs again.
+        bool update();
+
+        ///True if the worker loaded a level the next update() uploads
+        bool hasLoaded();
+
+        ///Getters, of the last update()
+        unsigned long long getResidentBytes();
+        unsigned long long getRequestedBytes();
+        unsigned long long getBudget();
+
+        ///Prints the memory and the streaming latency since the last call
+        void printStats();
+};
+
+///Constructor
+TextureStreamer::TextureStreamer(TextureLibrary *library,
+                                 unsigned long long budget)
+{
+    this->library = library;
+    this->budget = budget;
+
+    iWidth = library->getWidth();
+    iHeight = library->getHeight();
+    iCoarsestMip = getCoarsestMip(iWidth, iHeight);
+
+    residentBytes = 0;
+    requestedBytes = 0;
+    pendingBytes = 0;
+    frame = 0;
+    bStop = false;
+
+    iLoads = 0;
+    iEvictions = 0;
+    iRejected = 0;
+    fLatencySum = 0.0f;
+    fLatencyMax = 0.0f;
+
+    textures.resize(library->getLayerCount());
+    for(unsigned int t=0; t<textures.size(); t++)
+    {
+        textures[t].residentMip = iCoarsestMip;
+        textures[t].wantedMip = -1;
+        textures[t].loadingMip = -1;
+        textures[t].loadingBytes = 0;
+        textures[t].lastUsed = 0;
+        textures[t].bBroken = false;
+        textures[t].pixels = library->getPixels(t);
+
+        residentBytes += getChainBytes(iCoarsestMip);
+    }
+
+    if(residentBytes > budget)
+    {
+        std::cout << "The texture budget is below the coarsest levels, "
+        << residentBytes / 1024 << " KB" << std::endl;
+    }
+
+    worker = std::thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bStop = true;
+    }
+    wakeUp.notify_one();
+    worker.join();
+}
+
+int TextureStreamer::getCoarsestMip(int width, int height)
+{
+    int mip = 0;
+    while(std::max(width >> mip, height >> mip) > STREAM_MIN_SIZE)
+    {
+        mip++;
+    }
+    return mip;
+}
+
+///\/////////////////////////////Mip levels/////////////////////////////////////
+
+int TextureStreamer::getLevelWidth(int mip)
+{
+    return std::max(1, iWidth >> mip);
+}
+
+int TextureStreamer::getLevelHeight(int mip)
+{
+    return std::max(1, iHeight >> mip);
+}
+
+///Bytes of a texture that starts at mip, with every coarser level
+unsigned long long TextureStreamer::getChainBytes(int mip)
+{
+    unsigned long long bytes = 0;
+
+    for(int l=mip; ; l++)
+    {
+        bytes += (unsigned long long)getLevelWidth(l) * getLevelHeight(l) * 4;
+
+        if(getLevelWidth(l) == 1 && getLevelHeight(l) == 1)
+        {
+            return bytes;
+        }
+    }
+}
+
+void TextureStreamer::requestSize(int t, float pixels)
+{
+    if(t < 0 || t >= (int)textures.size() || pixels <= 0.0f)
+    {
+        return;
+    }
+
+    ///Finest level with no more texels than pixels
+    float texels = std::max(iWidth, iHeight);
+    int mip = (int)floorf(log2f(texels / pixels));
+    mip = std::min(std::max(mip, 0), iCoarsestMip);
+
+    StreamedTexture &st = textures[t];
+
+    if(st.wantedMip < 0 || mip < st.wantedMip)
+    {
+        st.wantedMip = mip;
+    }
+    st.lastUsed = frame;
+}
+
+///\//////////////////////////////Eviction//////////////////////////////////////
+
+///Coarsest level texture t may go down to: the one it was asked for if it
+///was drawn this frame, the coarsest otherwise
+int TextureStreamer::getEvictTarget(int t)
+{
+    const StreamedTexture &st = textures[t];
+    return st.lastUsed == frame && st.wantedMip >= 0 ? st.wantedMip :
+                                                       iCoarsestMip;
+}
+
+unsigned long long TextureStreamer::getEvictableBytes(int keep)
+{
+    unsigned long long bytes = 0;
+
+    for(int t=0; t<(int)textures.size(); t++)
+    {
+        int target = getEvictTarget(t);
+        if(t != keep && textures[t].residentMip < target)
+        {
+            bytes += getChainBytes(textures[t].residentMip) -
+                     getChainBytes(target);
+        }
+    }
+
+    return bytes;
+}
+
+///Drops levels of the least recently used textures until bytes more fit in
+///the budget. Texture keep is left alone.
+bool TextureStreamer::makeRoom(unsigned long long bytes, int keep)
+{
+    while(residentBytes + bytes > budget)
+    {
+        int victim = -1;
+
+        for(int t=0; t<(int)textures.size(); t++)
+        {
+            if(t == keep || textures[t].residentMip >= getEvictTarget(t))
+            {
+                continue;
+            }
+
+            if(victim < 0 || textures[t].lastUsed < textures[victim].lastUsed)
+            {
+                victim = t;
+            }
+        }
+
+        if(victim < 0)
+        {
+            return false;
+        }
+
+        dropLevel(victim);
+    }
+
+    return true;
+}
+
+///The finest level goes, the next one is filtered from the CPU copy
+void TextureStreamer::dropLevel(int t)
+{
+    StreamedTexture &st = textures[t];
+
+    std::vector<unsigned char> half;
+    TextureLibrary::halveImage(st.pixels, getLevelWidth(st.residentMip),
+                               getLevelHeight(st.residentMip), half);
+
+    int mip = st.residentMip + 1;
+    upload(t, mip, getLevelWidth(mip), getLevelHeight(mip), half);
+
+    iEvictions++;
+}
+
+void TextureStreamer::upload(int t, int mip, int width, int height,
+                             std::vector<unsigned char> &pixels)
+{
+    StreamedTexture &st = textures[t];
+
+    unsigned int texture = getRenderBackend()->createTexture2D(width, height,
+                                                               4, &pixels[0]);
+    library->replaceTexture(t, texture);
+
+    residentBytes -= getChainBytes(st.residentMip);
+    residentBytes += getChainBytes(mip);
+
+    st.residentMip = mip;
+    st.pixels.swap(pixels);
+}
+
+///\////////////////////////////////Frame///////////////////////////////////////
+
+bool TextureStreamer::update()
+{
+    bool bChanged = false;
+    int evictionsBefore = iEvictions;
+
+    ///1. Upload what the worker finished
+    for(int u=0; u<STREAM_UPLOADS_PER_FRAME; u++)
+    {
+        LoadResult result;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if(results.empty())
+            {
+                break;
+            }
+            result = std::move(results.front());
+            results.pop_front();
+        }
+
+        StreamedTexture &st = textures[result.texture];
+        st.loadingMip = -1;
+        pendingBytes -= st.loadingBytes;
+        st.loadingBytes = 0;
+
+        if(result.pixels.empty())
+        {
+            st.bBroken = true;
+            continue;
+        }
+
+        ///Evicted textures may have made it finer than needed meanwhile
+        if(result.mip >= st.residentMip)
+        {
+            continue;
+        }
+
+        unsigned long long extra = getChainBytes(result.mip) -
+                                   getChainBytes(st.residentMip);
+        if(!makeRoom(extra, result.texture))
+        {
+            iRejected++;
+            continue;
+        }
+
+        upload(result.texture, result.mip, result.width, result.height,
+               result.pixels);
+        bChanged = true;
+
+        std::chrono::duration<float, std::milli> latency =
+            Clock::now() - result.requestTime;
+        iLoads++;
+        fLatencySum += latency.count();
+        fLatencyMax = std::max(fLatencyMax, latency.count());
+    }
+
+    ///2. Ask for the levels the draws need, as fine as the budget allows
+    requestedBytes = 0;
+
+    for(int t=0; t<(int)textures.size(); t++)
+    {
+        StreamedTexture &st = textures[t];
+
+        if(st.lastUsed != frame || st.wantedMip < 0)
+        {
+            continue;
+        }
+
+        requestedBytes += getChainBytes(st.wantedMip);
+
+        if(st.bBroken || st.loadingMip >= 0 || st.wantedMip >= st.residentMip)
+        {
+            continue;
+        }
+
+        unsigned long long room = budget > residentBytes ?
+                                  budget - residentBytes : 0;
+        room += getEvictableBytes(t);
+        room = room > pendingBytes ? room - pendingBytes : 0;
+
+        int mip = st.wantedMip;
+        while(mip < st.residentMip &&
+              getChainBytes(mip) - getChainBytes(st.residentMip) > room)
+        {
+            mip++;
+        }
+
+        if(mip >= st.residentMip)
+        {
+            continue;
+        }
+
+        LoadJob job;
+        job.texture = t;
+        job.mip = mip;
+        job.path = library->getPath(t);
+        job.flip = library->getFlip(t);
+        job.requestTime = Clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.push_back(job);
+        }
+        wakeUp.notify_one();
+
+        st.loadingMip = mip;
+        st.loadingBytes = getChainBytes(mip) - getChainBytes(st.residentMip);
+        pendingBytes += st.loadingBytes;
+    }
+
+    ///3. The budget may be exceeded by what the draws don't need anymore
+    makeRoom(0, -1);
+
+    bChanged = bChanged || iEvictions != evictionsBefore;
+
+    ///Next frame
+    for(unsigned int t=0; t<textures.size(); t++)
+    {
+        textures[t].wantedMip = -1;
+    }
+    frame++;
+
+    return bChanged;
+}
+
+///\////////////////////////////////Worker//////////////////////////////////////
+
+void TextureStreamer::workerLoop()
+{
+    while(true)
+    {
+        LoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            wakeUp.wait(lock, [this]{ return bStop || !jobs.empty(); });
+
+            if(bStop)
+            {
+                return;
+            }
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        LoadResult result;
+        loadLevel(job, result);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        results.push_back(std::move(result));
+    }
+}
+
+///Reads the file and filters it down to the level of the job. The flip is
+///done here, stbi's flag is global to every thread.
+void TextureStreamer::loadLevel(const LoadJob &job, LoadResult &result)
+{
+    result.texture = job.texture;
+    result.mip = job.mip;
+    result.requestTime = job.requestTime;
+
+    int width, height, nrChannels;
+    unsigned char *data = stbi_load(job.path.c_str(), &width, &height,
+                                    &nrChannels, 4);
+    if(!data)
+    {
+        std::cout << "Failed to stream texture data " << job.path
+        << std::endl;
+        return;
+    }
+
+    std::vector<unsigned char> pixels(width * height * 4);
+    for(int y=0; y<height; y++)
+    {
+        int row = job.flip ? height - 1 - y : y;
+        std::copy(data + row * width * 4, data + (row + 1) * width * 4,
+                  pixels.begin() + y * width * 4);
+    }
+    stbi_image_free(data);
+
+    for(int m=0; m<job.mip; m++)
+    {
+        std::vector<unsigned char> half;
+        TextureLibrary::halveImage(pixels, width, height, half);
+        pixels.swap(half);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    result.width = width;
+    result.height = height;
+    result.pixels.swap(pixels);
+}
+
+bool TextureStreamer::hasLoaded()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return !results.empty();
+}
+
+///\////////////////////////////////Stats///////////////////////////////////////
+
+unsigned long long TextureStreamer::getResidentBytes()
+{
+    return residentBytes;
+}
+
+unsigned long long TextureStreamer::getRequestedBytes()
+{
+    return requestedBytes;
+}
+
+unsigned long long TextureStreamer::getBudget()
+{
+    return budget;
+}
+
+void TextureStreamer::printStats()
+{
+    std::cout << "Texture streaming: " << residentBytes / 1024
+    << " KB resident of " << budget / 1024 << " KB, " << requestedBytes / 1024
+    << " KB requested, " << iLoads << " loads";
+
+    if(iLoads > 0)
+    {
+        std::cout << " in " << fLatencySum / iLoads << " ms (max "
+        << fLatencyMax << " ms)";
+    }
+
+    std::cout << ", " << iEvictions << " levels evicted, " << iRejected
+    << " loads over budget" << std::endl;
+
+    iLoads = 0;
+    iEvictions = 0;
+    iRejected = 0;
+    fLatencySum = 0.0f;
+    fLatencyMax = 0.0f;
+}
+
+#endif // TEXTURESTREAMER_H_INCLUDED
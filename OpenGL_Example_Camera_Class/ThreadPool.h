@@ -0,0 +1,165 @@
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+///A fixed set of worker threads that split a batch of jobs between them.
+///run() blocks until every job is done, the calling thread works too.
+class ThreadPool
+{
+    private:
+
+        std::vector<std::thread> workers;
+
+        std::mutex mtx;
+        std::condition_variable wakeUp;
+        std::condition_variable done;
+
+        ///Current batch
+        const std::function<void(int)> *task;
+        int jobCount;
+        std::atomic<int> nextJob;
+        int finishedWorkers;
+        unsigned int generation;
+        bool bStop;
+
+        ///Private Functions
+        void workerLoop();
+        void runJobs();
+
+    public:
+
+        ///Constructor, 0 threads means one per core
+        ThreadPool(int threads = 0);
+        ~ThreadPool();
+
+        ///Getters
+        int getThreadCount();
+
+        ///Runs fn(0) ... fn(count-1) across all the threads
+        void run(int count, const std::function<void(int)> &fn);
+};
+
+///Constructor
+ThreadPool::ThreadPool(int threads)
+{
+    if(threads <= 0)
+    {
+        threads = std::thread::hardware_concurrency();
+        if(threads <= 0)
+        {
+            threads = 1;
+        }
+    }
+
+    task = NULL;
+    jobCount = 0;
+    nextJob = 0;
+    finishedWorkers = 0;
+    generation = 0;
+    bStop = false;
+
+    ///The caller is one of the threads
+    for(int i=1; i<threads; i++)
+    {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bStop = true;
+    }
+    wakeUp.notify_all();
+
+    for(unsigned int i=0; i<workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::getThreadCount()
+{
+    return (int)workers.size() + 1;
+}
+
+///Takes jobs until the batch is empty
+void ThreadPool::runJobs()
+{
+    int job;
+    while((job = nextJob.fetch_add(1)) < jobCount)
+    {
+        (*task)(job);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned int lastGeneration = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            wakeUp.wait(lock, [&]{ return bStop ||
+                                          generation != lastGeneration; });
+            if(bStop)
+            {
+                return;
+            }
+            lastGeneration = generation;
+        }
+
+        runJobs();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            finishedWorkers++;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::run(int count, const std::function<void(int)> &fn)
+{
+    if(count <= 0)
+    {
+        return;
+    }
+
+    ///Not worth waking anyone up
+    if(count == 1 || workers.empty())
+    {
+        for(int i=0; i<count; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        task = &fn;
+        jobCount = count;
+        nextJob = 0;
+        finishedWorkers = 0;
+        generation++;
+    }
+    wakeUp.notify_all();
+
+    runJobs();
+
+    ///Every worker must be done with this batch before the next one starts
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [&]{ return finishedWorkers == (int)workers.size(); });
+    task = NULL;
+}
+
+#endif // THREADPOOL_H_INCLUDED
@@ -8,15 +8,26 @@ layout (location = 2) in vec2 aTexCoord;
 out vec3 myColor;
 out vec2 TexCoord;
 
-uniform mat4 localMat;
-uniform mat4 modelMat;
-uniform mat4 viewMat;
-uniform mat4 projMat;
+#include "transform.glsl"
+
+#ifdef GPU_CULLING
+//Base and detail texture of every instance
+uniform isamplerBuffer instanceMaterials;
+
+flat out int baseLayer;
+flat out int detailLayer;
+#endif
 
 void main()
 {
 
-    gl_Position = projMat * viewMat * modelMat * localMat * vec4(aPos, 1.0);
+    gl_Position = toClipSpace(aPos);
     myColor = aColor;
     TexCoord = aTexCoord;
+
+#ifdef GPU_CULLING
+    ivec2 material = texelFetch(instanceMaterials, int(instanceIndex)).xy;
+    baseLayer = material.x;
+    detailLayer = material.y;
+#endif
 }
@@ -16,7 +16,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 /// third-party libraries
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <GL/glew.h>
 #include <GL/glfw3.h>
 #include <glm/glm.hpp>
@@ -32,12 +34,40 @@
 
 
 #include <iostream>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 using namespace std;
 using namespace glm;
 
+#include "FrameArena.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "LOD.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "OcclusionCuller.h"
+#include "SoftwareRenderer.h"
+#include "ShaderReloader.h"
+#include "ShaderVariants.h"
+#include "TextureLibrary.h"
+#include "TextureStreamer.h"
+#include "InputLog.h"
+#include "MultiView.h"
+#include "Telemetry.h"
+#include "FrameCapture.h"
+#include "DynamicResolution.h"
+#include "MatrixBatch.h"
+#include "MeshOptimizer.h"
+#include "Animation.h"
+#include "ClusteredLighting.h"
+#include "GpuCuller.h"
+#include "CameraLatch.h"
+#include "LargeWorld.h"
+#include "SceneGenerator.h"
+#include "RenderOnDemand.h"
 
 ///\/////////////////Data for the square////////////////////////////////////////
 /*
@@ -67,8 +97,8 @@ unsigned int indices[] =
 
 ///\/////////////////////Data for the cube//////////////////////////////////////
 
-///THE CUBE ISN"T GENERATED IN THE LOCAL CENTER, WE'LL FIX THIS LATER WITH A
-///SELF DEFINE LOCAL MATRIX TRANSFORMATION
+///The cube goes from 0 to 1, buildCubeLODs bakes the -0.5 offset that
+///centers it into the meshes when they are loaded
 
 GLfloat vertices[] = {
 
@@ -103,19 +133,37 @@ GLFWwindow* window;
 float fScreenWidth = 800.0f;
 float fScreenHeight = 600.0f;
 
-///Declare VAO, VBO and EBO
+///--headless keeps the window hidden, the frames only go to the capture
+bool bHeadless = false;
+
+///Declare VAO, its VBO and EBO are owned by the render backend
 //VAO-Vertex Array Object
 //VBO-Vertex Buffer Object
 //EBO-Element Buffer Object
-unsigned int VBO;
 unsigned int VAO;
-unsigned int EBO;
 
-///Declare the Texture OpenGL Object
-unsigned int iTexture;
+///Every texture of the scene, in the order they are loaded
+enum Scene_Texture
+{
+    TEX_CONTAINER,
+    TEX_FACE,
+    TEX_WALL,
+    SCENE_TEXTURE_COUNT
+};
+
+const char *SCENE_TEXTURE_PATHS[SCENE_TEXTURE_COUNT] = {
+    "textures/container.jpg",
+    "textures/face.png",
+    "textures/wall.jpg"
+};
+
+///The face is the only one stored upside down
+const bool SCENE_TEXTURE_FLIP[SCENE_TEXTURE_COUNT] = {false, true, false};
 
-///Declare the Second Texture
-unsigned int  iTexture2;
+TextureLibrary textureLibrary;
+
+///Only the mip levels the camera needs, when given a budget
+TextureStreamer *textureStreamer = NULL;
 
 ///Camera Initial Values
 vec3 camPos = vec3(0.0f,0.0f,3.0f);
@@ -129,15 +177,66 @@ Camera camera(camPos,camFront,camUp,PERSPECTIVE);
 ///This camera is locked looking at the center of the world
 //Camera camera(camPos,vec3(0,0,0),camUp,PERSPECTIVE,0);
 
+///Background color
+const vec4 CLEAR_COLOR = vec4(0.2f, 0.3f, 0.3f, 1.0f);
+
 ///Time between current and last frame
 float deltaTime = 0.0f;
 ///TimeStamp of last Frame
 float lastFrame = 0.0f;
+///Time the scene is drawn at, the clock or the sum of the replayed frames
+float sceneTime = 0.0f;
 
-///\////////////////////////////////////////////////////////////////////////////
-///Declare the local matrix
-mat4 localMat;
+///\//////////////////////////////INPUT LOG////////////////////////////////////
+
+///GLFW key of every Camera_Movement
+const int MOVEMENT_KEYS[DOWN_SPIN + 1] = {
+    GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D,
+    GLFW_KEY_PAGE_UP, GLFW_KEY_PAGE_DOWN,
+    GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN
+};
+
+///Input of the current frame, from the keyboard or from a log
+InputFrame inputFrame;
+
+///--record-input saves every frame's input, --replay-input plays a log back
+///with its own clock
+InputRecorder *inputRecorder = NULL;
+InputPlayer *inputPlayer = NULL;
+
+///--capture file draws into an offscreen framebuffer and saves every frame,
+///--capture-frames N closes the window after N frames
+FrameCapture *frameCapture = NULL;
+int iCaptureFrames = 0;
+
+///--dynamic-resolution [ms] draws the scene at the size that keeps the GPU
+///time under the budget
+DynamicResolution *dynamicResolution = NULL;
+
+///--lights N lights the cubes with N moving point lights
+ClusteredLighting *clusteredLighting = NULL;
 
+///Center of the circle every light moves on, and where on it the light
+///starts
+vector<vec4> lightOrbits;
+
+///--late-latch reads the input right before the draws instead of after
+///them, the latency is measured either way
+CameraLatch cameraLatch;
+
+///--large-world [distance] puts the scene that far out and draws it relative
+///to the camera, whose position is kept in doubles
+LargeWorld largeWorld;
+
+///Where the scene is in the world, the cubes and the lights are around it
+dvec3 worldOrigin = dvec3(0.0);
+
+///Wall clock of the replay
+std::chrono::high_resolution_clock::time_point replayStart;
+std::chrono::high_resolution_clock::time_point replayFrameStart;
+float fSlowestReplayFrame = 0.0f;
+
+///\////////////////////////////////////////////////////////////////////////////
 ///Declare the model matrix
 mat4 modelMat;
 
@@ -163,6 +262,113 @@ vec3 cubePositions[] = {
   vec3(-1.3f,  1.0f, -1.5f)
 };
 
+///Number of cubes declared above
+const int CUBE_COUNT = sizeof(cubePositions) / sizeof(cubePositions[0]);
+
+///Position of every cube in the scene, the 10 above unless a benchmark
+///fills it with more
+vector<vec3> cubeInstances(cubePositions, cubePositions + CUBE_COUNT);
+
+///--scene file draws the instances of a generated scene instead, with their
+///own textures and animation, see --generate-scene
+SceneFile sceneFile;
+
+///\//////////////////////////LEVELS OF DETAIL/////////////////////////////////
+
+///Vertex and index data of every LOD of the cube, all in the same VBO/EBO
+vector<GLfloat> meshVertices;
+vector<unsigned int> meshIndices;
+
+///The cube with its levels of detail and the per-instance selection
+LODMesh cubeLOD;
+LODSelector lodSelector;
+
+///Radius of the sphere that holds the cube, whatever its rotation. From the
+///bounds of its meshes once they are built.
+float CUBE_RADIUS = 0.8660254f;
+
+///\//////////////////////////////CULLING/////////////////////////////////////
+
+///Model matrix and visibility of every cube in the current frame
+vector<mat4> cubeModelMats;
+
+///Base and detail texture of every cube
+vector<ivec2> cubeMaterials;
+vector<char> cubeVisible;
+
+///What moves the cubes, it writes cubeModelMats
+AnimationSystem animationSystem;
+
+///Clips of the animation system, in the order buildAnimationClips adds them
+const int CLIP_SPIN = 0;
+const int CLIP_BOB = 1;
+const int CLIP_PULSE = 2;
+
+///--animation mixed plays every clip on the cubes, at different offsets and
+///speeds, instead of spinning them all
+bool bMixedAnimation = false;
+
+///--animation still keeps every cube and light where it starts
+bool bStillAnimation = false;
+
+///--on-demand draws a frame only when something changed
+RenderOnDemand renderOnDemand;
+
+///Worker threads shared by the CPU side systems
+ThreadPool threadPool;
+
+///View volume of the camera
+Frustum frustum;
+
+///--views N draws N cameras in one pass, split across the window
+MultiView multiView;
+
+///CPU depth buffer the cubes are tested against
+OcclusionCuller occlusionCuller(OCCLUSION_WIDTH, OCCLUSION_HEIGHT, &threadPool);
+
+///Set to false to draw everything inside the frustum
+bool bOcclusionCulling = true;
+
+///--gpu-culling culls the cubes in a compute shader and draws them with
+///indirect multi-draws, GL 4.3. The CPU culling above is what runs without.
+GpuCuller *gpuCuller = NULL;
+
+///--transform mvp concatenates the matrices of every draw on the CPU, the
+///shader gets a single one
+bool bPrecomputedMVP = false;
+
+///F2 switches between the textured and the untextured shader variant
+bool bTextured = true;
+bool bTextureKeyHeld = false;
+
+///Cubes smaller than this (in pixels) are not worth rasterizing as occluders
+const float MIN_OCCLUDER_SIZE = 24.0f;
+
+///The cube as a triangle list, for the occlusion culler
+vector<vec3> occluderPositions;
+vector<unsigned int> occluderIndices;
+
+///Seconds between statistics reports
+const float REPORT_INTERVAL = 2.0f;
+float lastReport = 0.0f;
+
+///Heap allocations and frames since the last report
+unsigned long long lastReportHeap = 0;
+int framesSinceReport = 0;
+
+///Bind calls of the backend at the last report
+unsigned int lastReportBinds = 0;
+
+///--telemetry [socket] serves the counters of every frame
+Telemetry *telemetry = NULL;
+
+///Counted by drawScene for the telemetry
+unsigned long long frameTriangles = 0;
+unsigned int frameCulled = 0;
+
+///Backend counters at the end of the last frame, they are never reset
+BackendStats lastBackendStats = BackendStats();
+
 ///\////////////////////////////////////////////////////////////////////////////
 void print(vec2 v)
 {
@@ -243,11 +449,27 @@ void print(mat4 m)
 ///This is the callback function for when the window gets resized
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    ///The capture keeps its size, the window shows it scaled
+    if(frameCapture)
+    {
+        return;
+    }
+
     ///Just adjust the viewport to the new window size
     glViewport(0, 0, width, height);
 
     fScreenWidth = width;
     fScreenHeight = height;
+
+    ///Keep the aspect ratio of the camera
+    camera.SetViewportSize(width, height);
+
+    if(dynamicResolution)
+    {
+        dynamicResolution->resize(width, height);
+    }
+
+    renderOnDemand.markDirty(DIRTY_RESIZE);
 }
 
 ///This is the callback function for input data, keyboard, mouse etc
@@ -262,69 +484,53 @@ void processInput(GLFWwindow *window)
 
 ///\/////////////////////////CAMERA CONTROLS////////////////////////////////////
 
-    ///\//////////////////
-    ///CAMERA POSITION////
-    ///\//////////////////
-
-    ///Move front and back
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-    {
-        camera.MoveCamera(FORWARD,deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    {
-        camera.MoveCamera(BACKWARD,deltaTime);
-    }
-
-    ///Move left and right
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-    {
-        camera.MoveCamera(LEFT,deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-    {
-        camera.MoveCamera(RIGHT,deltaTime);
-    }
-
-    ///Move Up and Down
-    if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
+    ///W-A-S-D and page Up/Down move the camera, the arrows rotate it. A
+    ///replay already has the frame's keys.
+    if(!inputPlayer)
     {
-        camera.MoveCamera(UP,deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
-    {
-        camera.MoveCamera(DOWN,deltaTime);
-    }
+        inputFrame.deltaTime = deltaTime;
+        inputFrame.keys = 0;
+        inputFrame.commands.clear();
 
-///\////////////////////////////////////////////////////////////////////////////
+        for(int m=FORWARD; m<=DOWN_SPIN; m++)
+        {
+            if(glfwGetKey(window, MOVEMENT_KEYS[m]) == GLFW_PRESS)
+            {
+                inputFrame.keys |= INPUT_KEY(m);
+            }
+        }
 
-    ///\/////////////////
-    ///CAMERA ROTATION///
-    ///\/////////////////
+        if(glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS)
+        {
+            inputFrame.keys |= INPUT_TEXTURE_KEY;
+        }
 
-    ///Update new Yaw angle
-    if(glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-    {
-       camera.MoveCamera(RIGHT_SPIN,deltaTime);
+        if(inputRecorder)
+        {
+            inputRecorder->writeFrame(inputFrame);
+        }
     }
 
-    if(glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-    {
-        camera.MoveCamera(LEFT_SPIN,deltaTime);
-    }
+    applyInputFrame(camera, inputFrame);
+    cameraLatch.inputApplied();
 
-    ///Update new Pitch angle
-    if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-    {
-        camera.MoveCamera(UP_SPIN,deltaTime);
-    }
+///\////////////////////////////////////////////////////////////////////////////
 
-    if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+    ///Toggle the textures once per key press
+    bool bTextureKey = (inputFrame.keys & INPUT_TEXTURE_KEY) != 0;
+    if(bTextureKey && !bTextureKeyHeld)
     {
-
-        camera.MoveCamera(DOWN_SPIN,deltaTime);
+        bTextured = !bTextured;
     }
+    bTextureKeyHeld = bTextureKey;
+
+}
 
+///Window events and the keys, with the time they were read
+void pollInput()
+{
+    glfwPollEvents();
+    cameraLatch.inputPolled();
 }
 
 void mouse_callback(GLFWwindow* window, double xPos, double yPos)
@@ -355,6 +561,12 @@ void initialize()
     ///Uncomment this function for MAC-OS
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
+    ///Still needed for the context, just never shown
+    if(bHeadless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
     ///Create a window
     window = glfwCreateWindow(fScreenWidth, fScreenHeight, "ModernOpenGL", NULL,
                               NULL);
@@ -392,271 +604,2558 @@ void initialize()
 ///\////////////////////////////////////////////////////////////////////////////
 
 
-///\////////////////CREATION OF VAOs VBOs and EBOs//////////////////////////////
-void setBufferObjects()
+///\//////////////////////////CUBE LODs///////////////////////////////////////
+
+///Color of the cube at a point, blends the colors of the 8 corners
+vec3 cubeColorAt(vec3 p)
 {
-    ///Generate VBO
-    glGenBuffers(1, &VBO);
+    vec3 color = vec3(0.0f);
+
+    for(int i=0; i<8; i++)
+    {
+        GLfloat *v = &vertices[i * 8];
 
-    ///Generate VAO
-    glGenVertexArrays(1, &VAO);
+        ///Weight of this corner (trilinear)
+        float w = (v[0] > 0.5f ? p.x : 1.0f - p.x) *
+                  (v[1] > 0.5f ? p.y : 1.0f - p.y) *
+                  (v[2] > 0.5f ? p.z : 1.0f - p.z);
 
-    ///Generate EBO
-    glGenBuffers(1, &EBO);
+        color += vec3(v[3], v[4], v[5]) * w;
+    }
 
-    ///First Bind the VAO, so that all the configuration is saved in this VAO
-    glBindVertexArray(VAO);
+    return color;
+}
 
-    ///Bind the VBO to GL_ARRAY_BUFFER
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    ///Bind EBO to GL_ELEMENT_ARRAY_BUFFER
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+///A cube with every face split in n*n quads, it lives in the same [0,1] box
+///as the original cube
+MeshData makeSubdividedCube(int n)
+{
+    ///Corner, U and V axis of every face
+    const vec3 faces[6][3] = {
+        {vec3(0,0,1), vec3( 1,0,0), vec3(0,1,0)},   //Front
+        {vec3(1,0,0), vec3(-1,0,0), vec3(0,1,0)},   //Back
+        {vec3(0,0,0), vec3( 0,0,1), vec3(0,1,0)},   //Left
+        {vec3(1,0,1), vec3( 0,0,-1), vec3(0,1,0)},  //Right
+        {vec3(0,1,1), vec3( 1,0,0), vec3(0,0,-1)},  //Top
+        {vec3(0,0,0), vec3( 1,0,0), vec3(0,0,1)}    //Bottom
+    };
+
+    MeshData mesh;
+    mesh.stride = 8;
+    mesh.mode = GL_TRIANGLES;
+
+    for(int f=0; f<6; f++)
+    {
+        unsigned int faceStart = mesh.vertices.size() / 8;
 
-    ///Populate VBO with data
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
-                 GL_STATIC_DRAW);
+        for(int j=0; j<=n; j++)
+        {
+            for(int i=0; i<=n; i++)
+            {
+                float u = (float)i / n;
+                float v = (float)j / n;
+                vec3 p = faces[f][0] + faces[f][1] * u + faces[f][2] * v;
+                vec3 c = cubeColorAt(p);
+
+                GLfloat data[8] = {p.x, p.y, p.z, c.x, c.y, c.z, u, v};
+                mesh.vertices.insert(mesh.vertices.end(), data, data + 8);
+            }
+        }
 
-    ///Populate EBO with data
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-                 GL_STATIC_DRAW);
+        for(int j=0; j<n; j++)
+        {
+            for(int i=0; i<n; i++)
+            {
+                unsigned int a = faceStart + j * (n + 1) + i;
+                unsigned int b = a + 1;
+                unsigned int c = a + (n + 1);
+                unsigned int d = c + 1;
+
+                unsigned int quad[6] = {a, b, d, a, d, c};
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+    }
 
-    ///Set the info of how the VBO must be read
-    /// position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),(void*)0);
-    glEnableVertexAttribArray(0);
-    /// color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                          (void*)(3* sizeof(float)));
-    glEnableVertexAttribArray(1);
-    /// texture attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
-                          (void*)(6* sizeof(float)));
-    glEnableVertexAttribArray(2);
+    return mesh;
 }
-///\////////////////////////////////////////////////////////////////////////////
 
-void loadTextures(Shader s)
+///Appends a mesh to the data of the VBO/EBO, returns where it went
+void addMesh(const MeshData &mesh, unsigned int &first, unsigned int &count,
+             int &baseVertex)
 {
+    baseVertex = meshVertices.size() / 8;
+    first = meshIndices.size();
+    count = mesh.indices.size();
+
+    meshVertices.insert(meshVertices.end(), mesh.vertices.begin(),
+                        mesh.vertices.end());
+    meshIndices.insert(meshIndices.end(), mesh.indices.begin(),
+                       mesh.indices.end());
+}
 
-///\///////////////////////////FIRST TEXTURE////////////////////////////////////
+///Builds every level of detail of the cube, from the finest to the
+///original 8 vertex strip. The meshes are optimized on the way, with the
+///offset of the cube data baked in, so there's no local matrix left to apply.
+void buildCubeLODs()
+{
+    ///THE CUBE DATA ISN'T CENTERED, this translation moves it to the center
+    mat4 offset = translate(mat4(), vec3(-0.5f, -0.5f, -0.5f));
 
-    ///Generate the OpenGL texture object
-    glGenTextures(1, &iTexture);
+    MeshData meshes[3];
+    meshes[0] = makeSubdividedCube(16);
+    meshes[1] = makeSubdividedCube(4);
 
-    ///Active the texture unit before binding
-    glActiveTexture(GL_TEXTURE0);
+    meshes[2].stride = 8;
+    meshes[2].mode = GL_TRIANGLE_STRIP;
+    meshes[2].vertices.assign(vertices, vertices + sizeof(vertices) /
+                                                   sizeof(GLfloat));
+    meshes[2].indices.assign(indices, indices + sizeof(indices) /
+                                                sizeof(unsigned int));
 
-    ///Bind our texture
-    glBindTexture(GL_TEXTURE_2D, iTexture);
+    ///LOD 0 - 16x16 quads per face, LOD 1 - 4x4, LOD 2 - The original cube
+    const float minScreenSizes[3] = {300.0f, 80.0f, 0.0f};
 
-    ///Set the texture wrapping/filtering options
-    ///(on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    meshVertices.clear();
+    meshIndices.clear();
+    CUBE_RADIUS = 0.0f;
 
-     ///Load the texture data
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("textures/container.jpg", &width, &height,
-                                    &nrChannels, 0);
+    for(int i=0; i<3; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "Cube LOD %d", i);
+        MeshBounds bounds = MeshOptimizer::optimize(meshes[i], offset, name);
+
+        ///Around the origin of the cube, which is where it's placed
+        CUBE_RADIUS = std::max(CUBE_RADIUS, length(bounds.center) +
+                                            bounds.radius);
+
+        unsigned int first, count;
+        int baseVertex;
+        addMesh(meshes[i], first, count, baseVertex);
+        cubeLOD.addLevel(meshes[i].mode, first, count, baseVertex,
+                         minScreenSizes[i]);
+    }
+}
 
-    if(data)
+///The clips the cubes can play, keys every few tenths of a second
+void buildAnimationClips()
+{
+    const float TWO_PI = 6.2831853f;
+
+    ///Spin - -50 degrees a second around the axis, like calcModelMat
+    AnimationClip spin;
+    spin.interval = 0.2f;
+    spin.vectorMode = INTERPOLATE_LINEAR;
+    spin.rotationMode = INTERPOLATE_SLERP;
+    for(int k=0; k<36; k++)
     {
-        ///Populate the object with data and generate its MipMap
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        spin.addKey(vec3(0.0f),
+                    angleAxis(radians(-50.0f) * k * spin.interval,
+                              normalize(vec3(0.5f, 1.0f, 0.0f))),
+                    vec3(1.0f));
     }
-    else
+    animationSystem.addClip(spin);
+
+    ///Bob - up and down through smooth keys, rocking side to side
+    AnimationClip bob;
+    bob.interval = 0.25f;
+    bob.vectorMode = INTERPOLATE_CUBIC;
+    bob.rotationMode = INTERPOLATE_SLERP;
+    for(int k=0; k<8; k++)
     {
-        cout << "Failed to load texture data" << endl;
+        float wave = sinf(TWO_PI * k / 8);
+        bob.addKey(vec3(0.0f, 0.3f * wave, 0.0f),
+                   angleAxis(radians(15.0f) * wave, vec3(0.0f, 0.0f, 1.0f)),
+                   vec3(1.0f));
     }
+    animationSystem.addClip(bob);
+
+    ///Pulse - growing and shrinking while it turns, nlerp is enough for that
+    AnimationClip pulse;
+    pulse.interval = 0.2f;
+    pulse.vectorMode = INTERPOLATE_CUBIC;
+    pulse.rotationMode = INTERPOLATE_LINEAR;
+    for(int k=0; k<6; k++)
+    {
+        pulse.addKey(vec3(0.0f),
+                     angleAxis(radians(60.0f) * k, vec3(0.0f, 1.0f, 0.0f)),
+                     vec3(1.0f + 0.15f * sinf(TWO_PI * k / 6)));
+    }
+    animationSystem.addClip(pulse);
+}
 
+///Sizes the per cube data after cubeInstances changes
+void resizeCubeInstances()
+{
+    int n = cubeInstances.size();
 
-    ///Free resources
-    stbi_image_free(data);
-
-///\///////////////////////SECOND TEXTURE///////////////////////////////////////
-
-    ///Generate the second texture object
-    glGenTextures(1,&iTexture2);
-
-    ///Active the texture unit
-    glActiveTexture(GL_TEXTURE1);
-
-    ///Bind it
-    glBindTexture(GL_TEXTURE_2D, iTexture2);
+    cubeModelMats.resize(n);
+    cubeVisible.resize(n);
+    lodSelector.resize(n);
 
-    ///Set the texture wrapping/filtering options
-    ///(on the currently bound texture object)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    ///Every cube spins in place unless the animation is mixed
+    if(animationSystem.getClipCount() == 0)
+    {
+        buildAnimationClips();
+    }
 
-    ///Flip image
-    stbi_set_flip_vertically_on_load(true);
+    ///A scene has the textures and animation of every cube
+    const SceneInstance *scene = sceneFile.getCount() == n ?
+                                 sceneFile.getInstances() : NULL;
 
-    ///Load the texture data
-    data = stbi_load("textures/face.png", &width, &height, &nrChannels, 0);
+    animationSystem.resize(n);
+    for(int i=0; i<n; i++)
+    {
+        if(scene)
+        {
+            animationSystem.setInstance(i, scene[i].clip, cubeInstances[i],
+                                        scene[i].offset, scene[i].speed);
+        }
+        else if(bMixedAnimation)
+        {
+            animationSystem.setInstance(i, i % 3, cubeInstances[i],
+                                        i * 0.37f, 0.75f + (i % 5) * 0.125f);
+        }
+        else
+        {
+            animationSystem.setInstance(i, CLIP_SPIN, cubeInstances[i],
+                                        0.0f, 1.0f);
+        }
+    }
 
-    if(data)
+    ///Their world positions in doubles, the animation gets them relative to
+    ///the camera every frame
+    if(largeWorld.isActive())
     {
-        ///Populate the object with data and generate its MipMap
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        largeWorld.resize(n);
+        for(int i=0; i<n; i++)
+        {
+            largeWorld.setInstance(i, worldOrigin + dvec3(cubeInstances[i]));
+        }
     }
-    else
+
+    ///Every other cube is made of wall instead of wood
+    cubeMaterials.resize(n);
+    for(int i=0; i<n; i++)
     {
-        cout << "Failed to load texture data" << endl;
+        cubeMaterials[i] = ivec2(i % 2 == 0 ? TEX_CONTAINER : TEX_WALL,
+                                 TEX_FACE);
+        if(scene)
+        {
+            cubeMaterials[i] = ivec2(scene[i].baseTexture,
+                                     scene[i].detailTexture);
+        }
     }
+}
 
-    ///Free resources
-    stbi_image_free(data);
+///Turns the coarsest level of the cube into the triangle list used as
+///occluder
+void buildOccluderMesh()
+{
+    const LODLevel &level = cubeLOD.getLevel(cubeLOD.getLevelCount() - 1);
+
+    MeshData mesh;
+    mesh.stride = 8;
+    mesh.mode = level.mode;
+    mesh.indices.assign(meshIndices.begin() + level.firstIndex,
+                        meshIndices.begin() + level.firstIndex +
+                        level.indexCount);
+    MeshOptimizer::toTriangleList(mesh);
+
+    unsigned int vertexCount = 0;
+    for(unsigned int i=0; i<mesh.indices.size(); i++)
+    {
+        vertexCount = std::max(vertexCount, mesh.indices[i] + 1);
+    }
 
-    ///SET THE UNIFORM DATA FOR THE FRAGMENT SHADER
-    s.use();
-    s.setInt("myTexture", 0);
-    s.setInt("myTexture2", 1);
+    for(unsigned int i=0; i<vertexCount; i++)
+    {
+        const GLfloat *p = &meshVertices[(level.baseVertex + i) * 8];
+        occluderPositions.push_back(vec3(p[0], p[1], p[2]));
+    }
 
+    occluderIndices = mesh.indices;
 }
+///\////////////////////////////////////////////////////////////////////////////
 
-void setLocalMat(Shader s)
-{
-    ///Load Identity Matrix
-    localMat = mat4();
 
-    ///Set the local coordinates here:
+///\////////////////CREATION OF VAOs VBOs and EBOs//////////////////////////////
+void setBufferObjects()
+{
+    ///Set the info of how the VBO must be read
+    ///position, color and texture attributes
+    VertexAttribute attribs[3] = {
+        {0, 3, 8, 0},
+        {1, 3, 8, 3},
+        {2, 2, 8, 6}
+    };
+
+    ///Generate the VAO with its VBO and EBO and populate them with data
+    VAO = getRenderBackend()->createVertexArray(&meshVertices[0],
+                                  meshVertices.size() * sizeof(GLfloat),
+                                  &meshIndices[0],
+                                  meshIndices.size() * sizeof(unsigned int),
+                                  attribs, 3);
+}
+///\////////////////////////////////////////////////////////////////////////////
 
-    ///This is the translation to fix the generated offset in the cube data
-    ///comment this line if you are drawing the square
-    localMat = translate(localMat,vec3(-0.5f,-0.5f,-0.5f));
+///\/////////////////////////////SHADER VARIANTS//////////////////////////////
 
-    ///Set Shader
-    s.use();
+///The fragment shader lights the cubes when there are lights
+void addLightingDefines(ShaderDefines &defines)
+{
+    if(clusteredLighting)
+    {
+        defines.push_back("CLUSTERED_LIGHTING");
+    }
+}
 
-    ///Set uniform - For the Vertex Shader
-    s.setMatrix4fv("localMat",localMat);
+///The transform path of the vertex shader
+void addTransformDefines(ShaderDefines &defines)
+{
+    if(bPrecomputedMVP)
+    {
+        defines.push_back("PRECOMPUTED_MVP");
+    }
+    else if(gpuCuller)
+    {
+        defines.push_back("GPU_CULLING");
+    }
 
+    cameraLatch.addDefines(defines);
 }
 
-void setModelMat(Shader s, vec3 vc3Pos, int i)
+///Defines of the variant of the cube shader that is used now
+ShaderDefines getCubeDefines()
 {
-    ///Load Identity Matrix
-    modelMat = mat4();
+    ShaderDefines defines;
 
-    if(i == 0)
+    if(bTextured)
     {
-        ///Rotate in the x axis
-        modelMat = rotate(modelMat, radians(50.0f) * (float) glfwGetTime(),
-                      vec3(0.5f, 1.0f, 0.0f));
-
-        ///Translate to the corresponding position
-        modelMat = translate(modelMat, vc3Pos);
+        textureLibrary.addDefines(defines);
     }
     else
     {
-         ///Translate to the corresponding position
-        modelMat = translate(modelMat, vc3Pos);
-
-        ///Rotate in the x axis
-        modelMat = rotate(modelMat, radians(-50.0f) * (float) glfwGetTime(),
-                      vec3(0.5f, 1.0f, 0.0f));
+        defines.push_back("NO_TEXTURE");
     }
 
-    ///Set Shader
-    s.use();
+    multiView.addDefines(defines);
+    addTransformDefines(defines);
+    addLightingDefines(defines);
 
-    ///Set uniform - For the Vertex Shader
-    s.setMatrix4fv("modelMat",modelMat);
+    return defines;
 }
 
-void setViewMat (Shader s)
+///Every variant the render loop can ask for, compiled at load time
+vector<ShaderDefines> getCubeVariants()
 {
-    ///Load Identity Matrix
-    viewMat = mat4();
+    vector<ShaderDefines> list;
 
-    ///Populate the view Matrix
-    viewMat = camera.GetViewMatrix();
+    ShaderDefines textured;
+    textureLibrary.addDefines(textured);
+    multiView.addDefines(textured);
+    addTransformDefines(textured);
+    addLightingDefines(textured);
 
-    ///Set Shader
-    s.use();
+    ShaderDefines untextured(1, "NO_TEXTURE");
+    multiView.addDefines(untextured);
+    addTransformDefines(untextured);
+    addLightingDefines(untextured);
 
-    ///Set uniform - For the Vertex Shader
-    s.setMatrix4fv("viewMat", viewMat);
+    list.push_back(textured);
+    list.push_back(untextured);
+
+    return list;
 }
 
-void setProjMat (Shader s)
+///Tells the fragment shader which texture unit every texture is in, and the
+///vertex shader where the views are
+void setSamplers(Shader &s)
 {
-    ///Load Identity Matrix
-    projMat = mat4();
+    multiView.setupShader(s);
+    cameraLatch.setupShader(s);
 
-    ///Projection.
-    ///Type: Perspective
-    ///FOV: 45 degrees
-    ///Aspect Ratio: 800/600
-    ///Near Clipping Plane: 0.1
-    ///Far Clipping Plane: 100
-    projMat = camera.GetProjectionMatrix();
+    const ShaderDefines &defines = s.getDefines();
 
-    ///Set Shader
-    s.use();
+    if(clusteredLighting)
+    {
+        clusteredLighting->setupShader(s);
+    }
 
-    ///Set uniform - For the Vertex Shader
-    s.setMatrix4fv("projMat", projMat);
+    if(gpuCuller)
+    {
+        gpuCuller->setupShader(s);
+    }
+
+    if(find(defines.begin(), defines.end(), "NO_TEXTURE") != defines.end())
+    {
+        return;
+    }
+
+    ///SET THE UNIFORM DATA FOR THE FRAGMENT SHADER
+    textureLibrary.setupShader(s);
 
+    if(gpuCuller)
+    {
+        gpuCuller->setupMaterials(s);
+    }
 }
 
-void drawSquare(Shader s)
+///Loads every texture of the scene and uploads them the way mode says. With
+///a budget in bytes only their coarsest levels are uploaded, the rest is
+///streamed in as the camera gets close.
+void loadTextures(Texture_Mode mode, unsigned long long budget)
 {
-    ///Set the shader program
-    s.use();
+    for(int i=0; i<SCENE_TEXTURE_COUNT; i++)
+    {
+        textureLibrary.addTexture(SCENE_TEXTURE_PATHS[i],
+                                  SCENE_TEXTURE_FLIP[i]);
+    }
 
-    ///Set the VAO
-    glBindVertexArray(VAO);
+    if(budget == 0)
+    {
+        textureLibrary.build(mode);
+        return;
+    }
 
-    ///Draw
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    int firstMip = TextureStreamer::getCoarsestMip(textureLibrary.getWidth(),
+                                                   textureLibrary.getHeight());
+
+    if(textureLibrary.build(mode, firstMip) == TEXTURE_ARRAY)
+    {
+        cout << "Texture streaming needs units or bindless textures" << endl;
+        return;
+    }
 
+    textureStreamer = new TextureStreamer(&textureLibrary, budget);
 }
 
-void drawCube(Shader s)
+///--textures units|array|bindless, bindless unless told otherwise
+Texture_Mode getTextureMode(int argc, char *argv[])
 {
-    ///Set the shader program
-    s.use();
-
-    ///Set the VAO
-    glBindVertexArray(VAO);
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--textures") == 0)
+        {
+            if(strcmp(argv[i + 1], "units") == 0)
+            {
+                return TEXTURE_UNITS;
+            }
+            if(strcmp(argv[i + 1], "array") == 0)
+            {
+                return TEXTURE_ARRAY;
+            }
+        }
+    }
 
-    ///Draw
-    glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, 0);
+    return TEXTURE_BINDLESS;
 }
 
-void calcDeltaTime()
+///--views N, 1 unless told otherwise
+int getViewCount(int argc, char *argv[])
 {
-    float currentFrame = glfwGetTime();
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--views") == 0)
+        {
+            return atoi(argv[i + 1]);
+        }
+    }
+
+    return 1;
 }
 
-int main ()
+///--animation spin|mixed|still, every cube spinning unless told otherwise
+bool getMixedAnimation(int argc, char *argv[])
 {
-    ///Initialize all the frameworks
-    initialize();
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--animation") == 0)
+        {
+            return strcmp(argv[i + 1], "mixed") == 0;
+        }
+    }
 
-    ///Compile and Link Shaders into Shader Program
-    Shader shader("shaders/vShader.vs","shaders/fShader.fs");
+    return false;
+}
+
+bool getStillAnimation(int argc, char *argv[])
+{
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--animation") == 0)
+        {
+            return strcmp(argv[i + 1], "still") == 0;
+        }
+    }
+
+    return false;
+}
+
+///--transform full|mvp, the full matrix chain in the shader unless told
+///otherwise
+bool getPrecomputedMVP(int argc, char *argv[])
+{
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--transform") == 0)
+        {
+            return strcmp(argv[i + 1], "mvp") == 0;
+        }
+    }
+
+    return false;
+}
+
+///--texture-budget MB streams the textures in that much memory, 0 if absent
+unsigned long long getTextureBudget(int argc, char *argv[])
+{
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--texture-budget") == 0)
+        {
+            return (unsigned long long)(atof(argv[i + 1]) * 1024.0 * 1024.0);
+        }
+    }
+
+    return 0;
+}
+
+///Tells the streamer how big every visible cube's textures are on screen
+void requestTextureSizes()
+{
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(!cubeVisible[i])
+        {
+            continue;
+        }
+
+        ///The screen size is the diameter of the bounding sphere, a face
+        ///spans 1/sqrt(3) of it
+        float facePixels = lodSelector.getScreenSize(i) * 0.57735027f;
+
+        textureStreamer->requestSize(cubeMaterials[i].x, facePixels);
+        textureStreamer->requestSize(cubeMaterials[i].y, facePixels);
+    }
+}
+
+
+///This function returns the model matrix of a cube at the given position
+mat4 calcModelMat(vec3 vc3Pos, int i, float time)
+{
+    ///Load Identity Matrix
+    mat4 modelMat = mat4();
+
+    if(i == 0)
+    {
+        ///Rotate in the x axis
+        modelMat = rotate(modelMat, radians(50.0f) * time,
+                      vec3(0.5f, 1.0f, 0.0f));
+
+        ///Translate to the corresponding position
+        modelMat = translate(modelMat, vc3Pos);
+    }
+    else
+    {
+         ///Translate to the corresponding position
+        modelMat = translate(modelMat, vc3Pos);
+
+        ///Rotate in the x axis
+        modelMat = rotate(modelMat, radians(-50.0f) * time,
+                      vec3(0.5f, 1.0f, 0.0f));
+    }
+
+    return modelMat;
+}
+
+void setModelMat(Shader &s, const mat4 &m)
+{
+    modelMat = m;
+
+    ///Set Shader
+    s.use();
+
+    ///Set uniform - For the Vertex Shader
+    s.setMatrix4fv("modelMat",modelMat);
+}
+
+void setMVPMat(Shader &s, const mat4 &m)
+{
+    ///Set Shader
+    s.use();
+
+    ///Set uniform - For the Vertex Shader
+    s.setMatrix4fv("mvpMat", m);
+}
+
+///Projection * view * model of every visible cube, in the order they are
+///drawn. With several views it stops at the model, the views have their
+///own matrices.
+void calcMVPMats(FrameVector<mat4> &mvps)
+{
+    FrameVector<int> visible;
+    visible.reserve(cubeInstances.size());
+
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(cubeVisible[i])
+        {
+            visible.push_back(i);
+        }
+    }
+
+    mat4 viewProj = mat4();
+    if(!multiView.isActive())
+    {
+        viewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+    }
+
+    mvps.resize(visible.size());
+
+    if(!visible.empty())
+    {
+        multiplyMatrixBatch(viewProj, &cubeModelMats[0], &visible[0],
+                            &mvps[0], visible.size());
+    }
+}
+
+void setViewMat (Shader &s)
+{
+    ///Load Identity Matrix
+    viewMat = mat4();
+
+    ///Populate the view Matrix
+    viewMat = camera.GetViewMatrix();
+
+    ///Set Shader
+    s.use();
+
+    ///Set uniform - For the Vertex Shader
+    s.setMatrix4fv("viewMat", viewMat);
+}
+
+void setProjMat (Shader &s)
+{
+    ///Load Identity Matrix
+    projMat = mat4();
+
+    ///Projection.
+    ///Type: Perspective
+    ///FOV: 45 degrees
+    ///Aspect Ratio: 800/600
+    ///Near Clipping Plane: 0.1
+    ///Far Clipping Plane: 100
+    projMat = camera.GetProjectionMatrix();
+
+    ///Set Shader
+    s.use();
+
+    ///Set uniform - For the Vertex Shader
+    s.setMatrix4fv("projMat", projMat);
+
+}
+
+void drawSquare(Shader &s)
+{
+    ///Set the shader program
+    s.use();
+
+    ///Set the VAO
+    getRenderBackend()->bindVertexArray(VAO);
+
+    ///Draw
+    getRenderBackend()->drawElements(GL_TRIANGLES, 6, 0, 0);
+
+}
+
+void drawCube(Shader &s, int lod)
+{
+    const LODLevel &level = cubeLOD.getLevel(lod);
+
+    ///Set the shader program
+    s.use();
+
+    ///Set the VAO
+    getRenderBackend()->bindVertexArray(VAO);
+
+    ///Draw, once per view
+    if(multiView.isActive())
+    {
+        getRenderBackend()->drawElementsInstanced(level.mode,
+                                                  level.indexCount,
+                                                  level.firstIndex,
+                                                  level.baseVertex,
+                                                  multiView.getViewCount());
+        return;
+    }
+
+    getRenderBackend()->drawElements(level.mode, level.indexCount,
+                                     level.firstIndex, level.baseVertex);
+}
+
+///Places every cube in the world for this frame, all of them at the same time
+void updateModelMats(float time)
+{
+    ///The camera goes back to the origin, every cube where it is from it
+    if(largeWorld.isActive())
+    {
+        largeWorld.update(camera);
+        animationSystem.setBases(largeWorld.getRelativeX(),
+                                 largeWorld.getRelativeY(),
+                                 largeWorld.getRelativeZ());
+    }
+
+    ///Every cube at the same time, straight into the model matrices
+    animationSystem.evaluate(time, &cubeModelMats[0], &threadPool);
+
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        ///The meshes are centered on the origin, so the translation of the
+        ///model matrix is the center of the cube
+        lodSelector.setInstance(i, vec3(cubeModelMats[i][3]), CUBE_RADIUS);
+    }
+}
+
+///The frustum the cubes are culled against. A late latch moves the camera
+///after the culling, then it holds every view the camera can reach by the
+///time of the draws.
+void updateCullFrustum()
+{
+    if(!cameraLatch.isActive())
+    {
+        frustum.update(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+        return;
+    }
+
+    frustum.update(camera.GetProjectionMatrix(
+                       camera.GetMaxRotation(deltaTime)) *
+                   camera.GetViewMatrix());
+    frustum.grow(camera.GetMaxMovement(deltaTime));
+}
+
+///Frustum culling, then occlusion culling against the biggest cubes
+void cullCubes()
+{
+    mat4 viewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+
+    updateCullFrustum();
+
+    ///Several views draw what any of them sees. What hides a cube from
+    ///one camera doesn't from the others, no occlusion culling then.
+    if(multiView.isActive())
+    {
+        for(int i=0; i<(int)cubeInstances.size(); i++)
+        {
+            cubeVisible[i] = multiView.sphereVisible(
+                vec3(cubeModelMats[i][3]), CUBE_RADIUS);
+        }
+        return;
+    }
+
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        cubeVisible[i] = frustum.sphereVisible(vec3(cubeModelMats[i][3]),
+                                               CUBE_RADIUS);
+    }
+
+    ///What hides a cube now may not once a late latch moves the camera
+    if(!bOcclusionCulling || cameraLatch.isActive())
+    {
+        return;
+    }
+
+    ///1. Rasterize the occluders
+    occlusionCuller.beginFrame(viewProj);
+
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(cubeVisible[i] && lodSelector.getScreenSize(i) >= MIN_OCCLUDER_SIZE)
+        {
+            occlusionCuller.addOccluder(occluderPositions, occluderIndices,
+                                        cubeModelMats[i]);
+        }
+    }
+
+    occlusionCuller.rasterizeOccluders();
+
+    ///2. Test the bounds of the cubes against them
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(cubeVisible[i])
+        {
+            vec3 center = vec3(cubeModelMats[i][3]);
+            vec3 extent = vec3(CUBE_RADIUS);
+
+            cubeVisible[i] = !occlusionCuller.isOccluded(center - extent,
+                                                         center + extent);
+        }
+    }
+}
+
+///Culls the frame the compute shader just culled again on the CPU, frustum
+///only as on the GPU, and checks both kept the same number of cubes. The
+///visible and triangle counters come from the same read back. It waits for
+///the GPU, so it is done once per report, or every frame when the telemetry
+///needs the counters of every frame.
+void checkGpuCulling()
+{
+    int cpuVisible = 0;
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        cpuVisible += frustum.sphereVisible(vec3(cubeModelMats[i][3]),
+                                            CUBE_RADIUS);
+    }
+
+    int gpuVisible = gpuCuller->checkParity(cpuVisible);
+
+    frameCulled = cubeInstances.size() - gpuVisible;
+    frameTriangles = 0;
+    for(int l=0; l<cubeLOD.getLevelCount(); l++)
+    {
+        frameTriangles += (unsigned long long)cubeLOD.getLevel(l)
+                          .triangleCount * gpuCuller->getVisibleCount(l);
+    }
+}
+
+///The survivors of the compute shader, a multi-draw per primitive type
+///whatever the number of cubes
+void drawCubesIndirect(Shader &shader)
+{
+    getRenderBackend()->bindVertexArray(VAO);
+    gpuCuller->draw();
+}
+
+///Checks that the camera ended where the recording did and closes the window
+void finishReplay()
+{
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - replayStart;
+    int frames = inputPlayer->getFrameCount();
+
+    cout << "Replayed " << frames << " frames in " << elapsed.count()
+    << " ms, " << elapsed.count() / std::max(frames, 1) << " ms/frame, "
+    << "slowest " << fSlowestReplayFrame << " ms" << endl;
+
+    CameraSnapshot state = takeCameraSnapshot(camera);
+    if(isSameCameraState(state, inputPlayer->getExpectedState()))
+    {
+        cout << "Camera state is bit-identical to the recording" << endl;
+    }
+    else
+    {
+        cout << "ERROR::INPUT_LOG::CAMERA_DIFFERS, at (" << state.position.x
+        << ", " << state.position.y << ", " << state.position.z
+        << ") instead of (" << inputPlayer->getExpectedState().position.x
+        << ", " << inputPlayer->getExpectedState().position.y << ", "
+        << inputPlayer->getExpectedState().position.z << ")" << endl;
+    }
+
+    glfwSetWindowShouldClose(window, true);
+}
+
+///The next frame of the log, its deltaTime replaces the clock
+void nextReplayFrame()
+{
+    std::chrono::high_resolution_clock::time_point now =
+        std::chrono::high_resolution_clock::now();
+
+    if(replayFrameStart != std::chrono::high_resolution_clock::time_point())
+    {
+        std::chrono::duration<float, std::milli> frameTime =
+            now - replayFrameStart;
+        fSlowestReplayFrame = std::max(fSlowestReplayFrame,
+                                       frameTime.count());
+    }
+    else
+    {
+        replayStart = now;
+    }
+    replayFrameStart = now;
+
+    if(!inputPlayer->nextFrame(inputFrame))
+    {
+        ///The last frame is drawn again with nothing held
+        inputFrame.deltaTime = 0.0f;
+        inputFrame.keys = 0;
+        inputFrame.commands.clear();
+
+        if(!glfwWindowShouldClose(window))
+        {
+            finishReplay();
+        }
+    }
+
+    deltaTime = inputFrame.deltaTime;
+    sceneTime += deltaTime;
+}
+
+///Control points of a loop around the scene that starts at the camera
+vector<vec3> getFlyThroughPoints()
+{
+    vec3 center = vec3(0.0f);
+    for(unsigned int i=0; i<cubeInstances.size(); i++)
+    {
+        center += cubeInstances[i] / (float)cubeInstances.size();
+    }
+
+    vec3 start = camera.GetPosition();
+    vec3 offset = start - center;
+    float fRadius = std::max(length(vec2(offset.x, offset.z)), 1.0f);
+    float fStartAngle = atan2f(offset.z, offset.x);
+
+    vector<vec3> points;
+    points.push_back(start);
+
+    const int POINT_COUNT = 8;
+    for(int i=1; i<POINT_COUNT; i++)
+    {
+        float fAngle = fStartAngle + i * 2.0f * 3.14159265f / POINT_COUNT;
+
+        ///Closer in and up and down on the way, through the cubes
+        float fScale = i % 2 ? 0.6f : 1.0f;
+        points.push_back(center + vec3(cosf(fAngle) * fRadius * fScale,
+                                       sinf(fAngle * 2.0f) * 2.0f,
+                                       sinf(fAngle) * fRadius * fScale));
+    }
+
+    return points;
+}
+
+///--generate-path file [--path-seconds S] writes a fly-through input log
+int runPathGenerator(int argc, char *argv[])
+{
+    const char *path = NULL;
+    float seconds = 20.0f;
+
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--generate-path") == 0)
+        {
+            path = argv[i + 1];
+        }
+        else if(strcmp(argv[i], "--path-seconds") == 0)
+        {
+            seconds = atof(argv[i + 1]);
+        }
+    }
+
+    if(!path)
+    {
+        cout << "--generate-path needs a file" << endl;
+        return 1;
+    }
+
+    resizeCubeInstances();
+
+    if(!writeFlyThrough(path, getFlyThroughPoints(), seconds, 1.0f / 60.0f,
+                        camera))
+    {
+        return 1;
+    }
+
+    cout << "Wrote a " << seconds << " s fly-through to " << path << endl;
+    return 0;
+}
+
+///Prints the LOD and culling statistics every few seconds
+void reportStats()
+{
+    float currentTime = glfwGetTime();
+    framesSinceReport++;
+
+    if(currentTime - lastReport >= REPORT_INTERVAL)
+    {
+        ///The compute shader reports its levels itself
+        if(!gpuCuller)
+        {
+            lodSelector.printStats();
+        }
+
+        unsigned long long heap = getHeapAllocations();
+        cout << "Heap: " << (double)(heap - lastReportHeap) / framesSinceReport
+        << " allocations/frame, frame arena peak " << FrameArena::get().getPeak()
+        << " bytes" << endl;
+        lastReportHeap = heap;
+
+        unsigned int binds = getRenderBackend()->getStats().bindCalls;
+        cout << "GL binds: " << (double)(binds - lastReportBinds) /
+                                framesSinceReport << "/frame"
+        << (getRenderBackend()->usesDirectStateAccess() ?
+            " (direct state access)" : "") << endl;
+        lastReportBinds = binds;
+        framesSinceReport = 0;
+
+        if(bOcclusionCulling && !multiView.isActive() && !gpuCuller)
+        {
+            occlusionCuller.printStats();
+        }
+
+        if(gpuCuller)
+        {
+            ///The telemetry already read this frame back
+            if(!telemetry)
+            {
+                checkGpuCulling();
+            }
+            gpuCuller->printStats();
+        }
+
+        if(textureStreamer)
+        {
+            textureStreamer->printStats();
+        }
+
+        if(dynamicResolution)
+        {
+            dynamicResolution->printStats();
+        }
+
+        if(clusteredLighting)
+        {
+            clusteredLighting->printStats();
+        }
+
+        cameraLatch.printStats();
+        renderOnDemand.printStats();
+
+        if(telemetry)
+        {
+            cout << "Telemetry takes " << telemetry->getOverheadPercent()
+            << "% of the frame time" << endl;
+        }
+
+        lastReport = currentTime;
+    }
+}
+
+///Texture memory in use: what the streamer keeps resident, or every layer
+///with its mipmaps
+unsigned long long getTextureBytes()
+{
+    if(textureStreamer)
+    {
+        return textureStreamer->getResidentBytes();
+    }
+
+    unsigned long long bytes = 0;
+    for(int i=0; i<textureLibrary.getLayerCount(); i++)
+    {
+        bytes += textureLibrary.getPixels(i).size() * 4 / 3;
+    }
+
+    return bytes;
+}
+
+///Hands the counters of the frame drawScene just drew to the telemetry
+void recordTelemetry()
+{
+    if(gpuCuller)
+    {
+        checkGpuCulling();
+    }
+
+    BackendStats stats = getRenderBackend()->getStats();
+
+    telemetry->record(deltaTime,
+                      stats.drawCalls - lastBackendStats.drawCalls,
+                      frameTriangles,
+                      stats.uniformSets - lastBackendStats.uniformSets,
+                      getTextureBytes(), frameCulled,
+                      cameraLatch.getLastLatency());
+
+    lastBackendStats = stats;
+}
+
+void calcDeltaTime()
+{
+    if(inputPlayer)
+    {
+        nextReplayFrame();
+        return;
+    }
+
+    ///A video has its own clock, however long the frames take to draw
+    if(frameCapture)
+    {
+        deltaTime = 1.0f / CAPTURE_FPS;
+        sceneTime += deltaTime;
+        return;
+    }
+
+    float currentFrame = glfwGetTime();
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+    sceneTime = currentFrame;
+}
+
+///--dynamic-resolution [ms] [--dynamic-resolution-log file.csv], a budget of
+///16.6 ms of GPU time unless told otherwise
+void startDynamicResolution(int argc, char *argv[])
+{
+    bool bEnabled = false;
+    float budget = 16.6f;
+    const char *logPath = NULL;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--dynamic-resolution") == 0)
+        {
+            bEnabled = true;
+            if(i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                budget = atof(argv[++i]);
+            }
+        }
+        else if(strcmp(argv[i], "--dynamic-resolution-log") == 0 &&
+                i + 1 < argc)
+        {
+            logPath = argv[++i];
+        }
+    }
+
+    if(!bEnabled)
+    {
+        return;
+    }
+
+    if(budget <= 0.0f)
+    {
+        cout << "The GPU time budget has to be above 0 ms" << endl;
+        return;
+    }
+
+    dynamicResolution = new DynamicResolution();
+    dynamicResolution->create(fScreenWidth, fScreenHeight, budget, logPath,
+                              GLEW_ARB_timer_query);
+}
+
+///--lights [N], 256 point lights unless told otherwise, spread around the
+///cubes. Every view would need its own clusters, so not with --views.
+void startClusteredLighting(int argc, char *argv[])
+{
+    int count = 0;
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--lights") == 0)
+        {
+            count = 256;
+            if(i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                count = atoi(argv[++i]);
+            }
+        }
+    }
+
+    if(count <= 0)
+    {
+        return;
+    }
+
+    if(multiView.isActive())
+    {
+        cout << "No clustered lighting with several views" << endl;
+        return;
+    }
+
+    clusteredLighting = new ClusteredLighting();
+
+    unsigned int seed = 54321;
+    for(int i=0; i<count; i++)
+    {
+        float v[8];
+        for(int j=0; j<8; j++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            v[j] = (seed >> 8) / 16777216.0f;
+        }
+
+        ///Around and between the cubes
+        vec3 center((v[0] - 0.5f) * 10.0f, (v[1] - 0.5f) * 7.0f,
+                    1.0f - v[2] * 17.0f);
+        lightOrbits.push_back(vec4(center, v[3] * 6.2831853f));
+
+        clusteredLighting->addLight(center, 1.5f + v[4] * 2.0f,
+                                    vec3(v[5], v[6], v[7]) * 1.5f);
+    }
+
+    clusteredLighting->create(&threadPool);
+}
+
+///--gpu-culling, with GL 4.3 and the per instance data in buffers. The
+///paths that need the visible cubes on the CPU, or that draw one call per
+///cube, keep the CPU culling.
+void startGpuCulling(int argc, char *argv[])
+{
+    bool bWanted = false;
+    bool bRecording = false;
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--gpu-culling") == 0)
+        {
+            bWanted = true;
+        }
+        else if(strcmp(argv[i], "--record") == 0)
+        {
+            bRecording = true;
+        }
+    }
+
+    if(!bWanted)
+    {
+        return;
+    }
+
+    if(!GpuCuller::isSupported())
+    {
+        cout << "GPU culling needs GL 4.3, culling on the CPU" << endl;
+        return;
+    }
+
+    if(multiView.isActive() || bPrecomputedMVP || bRecording ||
+       textureStreamer || textureLibrary.getMode() == TEXTURE_UNITS)
+    {
+        cout << "No GPU culling with several views, --transform mvp, "
+        << "--record, a texture budget or --textures units" << endl;
+        return;
+    }
+
+    ///The scene is open already, the shaders aren't compiled yet
+    int count = sceneFile.isOpen() ? sceneFile.getCount() :
+                                     (int)cubeInstances.size();
+    if(!GpuCuller::canHold(count))
+    {
+        cout << "Too many instances for GPU culling, culling on the CPU"
+        << endl;
+        return;
+    }
+
+    gpuCuller = new GpuCuller();
+    if(!gpuCuller->create("shaders/cull.comp"))
+    {
+        delete gpuCuller;
+        gpuCuller = NULL;
+    }
+}
+
+///--late-latch, one camera drawn through the view and projection of the
+///vertex shader. Several views and the MVPs take the camera before the
+///culling.
+void startLateLatch(int argc, char *argv[])
+{
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--late-latch") != 0)
+        {
+            continue;
+        }
+
+        if(multiView.isActive() || bPrecomputedMVP)
+        {
+            cout << "No late latch with several views or --transform mvp"
+            << endl;
+            return;
+        }
+
+        cameraLatch.create();
+        return;
+    }
+}
+
+///--large-world [distance], LARGE_WORLD_DISTANCE out along every axis
+///unless told otherwise. The camera starts where it would, next to the
+///scene.
+void startLargeWorld(int argc, char *argv[])
+{
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--large-world") != 0)
+        {
+            continue;
+        }
+
+        double distance = LARGE_WORLD_DISTANCE;
+        if(i + 1 < argc && argv[i + 1][0] != '-')
+        {
+            distance = atof(argv[i + 1]);
+        }
+
+        worldOrigin = dvec3(distance);
+        largeWorld.create(worldOrigin + dvec3(camera.GetPosition()));
+        camera.SetPosition(vec3(0.0f));
+        return;
+    }
+}
+
+///Direct state access unless --no-dsa or the context doesn't have it, then
+///the resources are bound to be created and edited like before GL 4.5
+void startDirectStateAccess(int argc, char *argv[])
+{
+    bool bEnable = true;
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--no-dsa") == 0)
+        {
+            bEnable = false;
+        }
+    }
+
+    if(getRenderBackend()->setDirectStateAccess(bEnable))
+    {
+        cout << "Resources: direct state access" << endl;
+    }
+    else
+    {
+        cout << "Resources: bound to edit" << endl;
+    }
+}
+
+///--on-demand, mostly for scenes that stand still (--animation still). A
+///capture or a replay needs every frame.
+void startRenderOnDemand(int argc, char *argv[])
+{
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--on-demand") != 0)
+        {
+            continue;
+        }
+
+        if(frameCapture || inputPlayer)
+        {
+            cout << "No render on demand with --capture or --replay-input"
+            << endl;
+            return;
+        }
+
+        renderOnDemand.create(camera);
+        return;
+    }
+}
+
+///Moves every light along its circle, a turn every 12 seconds
+void updateLights(float time)
+{
+    for(int i=0; i<clusteredLighting->getLightCount(); i++)
+    {
+        float angle = lightOrbits[i].w + time * 0.5f;
+        vec3 circle(cosf(angle), 0.5f * sinf(angle * 2.0f), sinf(angle));
+        vec3 position = vec3(lightOrbits[i]) + circle;
+
+        if(largeWorld.isActive())
+        {
+            position = largeWorld.toCameraRelative(worldOrigin +
+                                                   dvec3(position));
+        }
+
+        clusteredLighting->setLightPosition(i, position);
+    }
+}
+
+///--capture file [--capture-format raw|y4m|ppm] [--capture-size W H]
+///[--capture-frames N], the format comes from the extension if not given
+void startCapture(int argc, char *argv[])
+{
+    const char *path = NULL;
+    const char *format = NULL;
+    int width = fScreenWidth;
+    int height = fScreenHeight;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc)
+        {
+            format = argv[++i];
+        }
+        else if(strcmp(argv[i], "--capture-size") == 0 && i + 2 < argc)
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+        {
+            iCaptureFrames = atoi(argv[++i]);
+        }
+    }
+
+    if(!path)
+    {
+        return;
+    }
+
+    if(dynamicResolution)
+    {
+        cout << "The capture is drawn at a fixed size, no dynamic resolution"
+        << endl;
+        delete dynamicResolution;
+        dynamicResolution = NULL;
+    }
+
+    frameCapture = new FrameCapture();
+    if(!frameCapture->create(width, height, path,
+                             FrameCapture::getFormat(format, path)))
+    {
+        delete frameCapture;
+        frameCapture = NULL;
+        return;
+    }
+
+    ///Everything is drawn at the size of the video
+    fScreenWidth = width;
+    fScreenHeight = height;
+    camera.SetViewportSize(width, height);
+
+    ///As fast as the frames can be drawn and saved
+    glfwSwapInterval(0);
+}
+
+///Renders one frame of the scene through the current render backend
+void drawScene(Shader &shader, float time)
+{
+    ///What the frame before last left in the arenas is free again
+    FrameArena::nextFrame();
+
+    ///Set background color and refresh Color Bit and Z-Buffer
+    getRenderBackend()->clear(CLEAR_COLOR.x, CLEAR_COLOR.y, CLEAR_COLOR.z,
+                              CLEAR_COLOR.w);
+
+    ///Set up the Model Matrices (World coordinates)
+    updateModelMats(time);
+
+    ///Choose the level of detail of every cube, the compute shader does
+    ///it with the culling
+    if(!gpuCuller)
+    {
+        lodSelector.selectLevels(cubeLOD, camera);
+    }
+
+    ///The matrices of every view, before culling against them
+    if(multiView.isActive())
+    {
+        ///Split what is drawn, a share of the window with dynamic resolution
+        if(dynamicResolution)
+        {
+            multiView.update(camera, dynamicResolution->getWidth(),
+                             dynamicResolution->getHeight());
+        }
+        else
+        {
+            multiView.update(camera, fScreenWidth, fScreenHeight);
+        }
+        multiView.bind();
+    }
+
+    ///Throw away the cubes that can't be seen
+    if(gpuCuller)
+    {
+        updateCullFrustum();
+        gpuCuller->cull(&cubeModelMats[0], frustum, camera, CUBE_RADIUS);
+    }
+    else
+    {
+        cullCubes();
+    }
+
+    if(bTextured)
+    {
+        textureLibrary.bind();
+
+        if(textureStreamer)
+        {
+            requestTextureSizes();
+        }
+    }
+
+    ///All the matrices of the frame in a few batches
+    FrameVector<mat4> mvps;
+    if(bPrecomputedMVP)
+    {
+        calcMVPMats(mvps);
+    }
+
+    ///The newest input moves the camera now, after everything that can do
+    ///without it
+    if(cameraLatch.isActive())
+    {
+        pollInput();
+        processInput(window);
+    }
+    cameraLatch.latch(camera);
+
+    ///Every uniform of the draws below goes to this program
+    shader.use();
+
+    ///The views have theirs in the uniform buffer, the MVPs have them
+    ///already and the late latch has them in the camera block
+    if(!multiView.isActive() && !bPrecomputedMVP && !cameraLatch.isActive())
+    {
+        ///Set the View Matrix (Camera Coordinates)
+        setViewMat(shader);
+
+        ///Set the Projection Matrix (the perspective of the camera)
+        setProjMat(shader);
+    }
+
+    ///The lights of every cluster of the camera
+    if(clusteredLighting)
+    {
+        updateLights(time);
+        clusteredLighting->update(camera);
+        clusteredLighting->bind(shader, camera);
+    }
+
+    if(gpuCuller)
+    {
+        drawCubesIndirect(shader);
+        getRenderBackend()->endFrame();
+        cameraLatch.submitted();
+        return;
+    }
+
+    frameTriangles = 0;
+    frameCulled = 0;
+    int drawn = 0;
+
+    ///Draw the cubes in different positions
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(!cubeVisible[i])
+        {
+            frameCulled++;
+            continue;
+        }
+
+        frameTriangles += cubeLOD.getLevel(lodSelector.getLevel(i))
+                          .triangleCount * multiView.getViewCount();
+
+        ///Only a uniform unless the textures are on units
+        if(bTextured)
+        {
+            textureLibrary.bindMaterial(shader, cubeMaterials[i].x,
+                                        cubeMaterials[i].y);
+        }
+
+        if(bPrecomputedMVP)
+        {
+            setMVPMat(shader, mvps[drawn]);
+        }
+        else
+        {
+            setModelMat(shader, cubeModelMats[i]);
+        }
+        drawn++;
+
+        ///Draw
+        drawCube(shader, lodSelector.getLevel(i));
+    }
+
+    getRenderBackend()->endFrame();
+    cameraLatch.submitted();
+}
+
+///\///////////////////////////////SCENES///////////////////////////////////////
+
+///Bytes the CPU keeps for every cube, all the per cube arrays together
+double getBytesPerInstance()
+{
+    unsigned long long bytes =
+        cubeInstances.capacity() * sizeof(vec3) +
+        cubeModelMats.capacity() * sizeof(mat4) +
+        cubeMaterials.capacity() * sizeof(ivec2) +
+        cubeVisible.capacity() * sizeof(char) +
+        lodSelector.getInstanceBytes() + animationSystem.getInstanceBytes();
+
+    return (double)bytes / std::max((size_t)1, cubeInstances.size());
+}
+
+///--generate-scene file [--scene-count N] [--scene-layout L] [--scene-seed S]
+///writes a scene for --scene. N goes from 1 to 10M (10000), L is uniform,
+///clustered, grid or walls (uniform) and the same S gives the same file.
+int runSceneGenerator(int argc, char *argv[])
+{
+    const char *path = NULL;
+
+    SceneDesc desc;
+    desc.count = 10000;
+    desc.layout = SCENE_UNIFORM;
+    desc.seed = 1;
+    desc.textureCount = SCENE_TEXTURE_COUNT;
+    desc.clipCount = CLIP_PULSE + 1;
+
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--generate-scene") == 0)
+        {
+            path = argv[i + 1];
+        }
+        else if(strcmp(argv[i], "--scene-count") == 0)
+        {
+            desc.count = atoi(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "--scene-layout") == 0)
+        {
+            desc.layout = getSceneLayout(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "--scene-seed") == 0)
+        {
+            desc.seed = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+
+    if(!path)
+    {
+        cout << "--generate-scene needs a file" << endl;
+        return 1;
+    }
+
+    if(desc.layout == SCENE_LAYOUT_COUNT)
+    {
+        cout << "--scene-layout is uniform, clustered, grid or walls" << endl;
+        return 1;
+    }
+
+    desc.count = std::min(std::max(desc.count, SCENE_MIN_INSTANCES),
+                          SCENE_MAX_INSTANCES);
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    SceneGenerator generator;
+    vector<SceneInstance> instances;
+    generator.generate(desc, instances);
+
+    if(!SceneGenerator::write(path, desc, instances))
+    {
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    cout << "Wrote " << desc.count << " instances ("
+    << SCENE_LAYOUT_NAMES[desc.layout] << ", seed " << desc.seed << ") to "
+    << path << ", "
+    << (sizeof(SceneHeader) + instances.size() * sizeof(SceneInstance)) /
+       1048576.0 << " MB in " << elapsed.count() * 1000.0 << " ms" << endl;
+    return 0;
+}
+
+///--scene file maps a scene made by --generate-scene. The ten cubes stay if
+///it can't be used.
+void openScene(int argc, char *argv[])
+{
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--scene") != 0)
+        {
+            continue;
+        }
+
+        if(!sceneFile.open(argv[i + 1]))
+        {
+            return;
+        }
+
+        const SceneHeader &header = sceneFile.getHeader();
+        if(header.textureCount > (unsigned int)SCENE_TEXTURE_COUNT ||
+           header.clipCount > (unsigned int)CLIP_PULSE + 1)
+        {
+            cout << "ERROR::SCENE::UNKNOWN_TEXTURES_OR_CLIPS "
+            << header.textureCount << " textures, " << header.clipCount
+            << " clips" << endl;
+            sceneFile.close();
+            return;
+        }
+
+        cout << "Scene: " << header.count << " instances ("
+        << SCENE_LAYOUT_NAMES[header.layout] << ", seed " << header.seed
+        << "), " << sceneFile.getSize() / 1048576.0
+        << " MB mapped" << endl;
+        return;
+    }
+}
+
+///Makes the instances of the scene the cubes, straight from the mapping
+void loadSceneInstances()
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    const SceneInstance *instances = sceneFile.getInstances();
+    int count = sceneFile.getCount();
+
+    cubeInstances.resize(count);
+    for(int i=0; i<count; i++)
+    {
+        cubeInstances[i] = vec3(instances[i].position[0],
+                                instances[i].position[1],
+                                instances[i].position[2]);
+    }
+
+    resizeCubeInstances();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    cout << "Loaded " << count << " instances in "
+    << elapsed.count() * 1000.0 << " ms, " << getBytesPerInstance()
+    << " bytes per instance on the CPU" << endl;
+}
+
+///\////////////////////////////NULL BACKEND///////////////////////////////////
+
+///Fills the scene with cubes spread in a box around the camera, the same
+///cubes for the same count
+void generateCubeInstances(int count)
+{
+    cubeInstances.clear();
+
+    unsigned int seed = 12345;
+    float side = std::max(10.0f, std::cbrt((float)count) * 3.0f);
+
+    for(int i=0; i<count; i++)
+    {
+        float v[3];
+        for(int j=0; j<3; j++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            v[j] = ((seed >> 8) / 16777216.0f - 0.5f) * side;
+        }
+
+        ///Keep them in front of the camera
+        cubeInstances.push_back(vec3(v[0], v[1], v[2] - side * 0.5f));
+    }
+
+    resizeCubeInstances();
+}
+
+///CPU cost of a frame without the driver, every draw goes to the null backend
+///Returns the heap allocations the frames made, after the warm up
+unsigned long long benchmarkNullBackend(Shader &shader, int count, int frames)
+{
+    if(sceneFile.isOpen())
+    {
+        loadSceneInstances();
+        count = cubeInstances.size();
+    }
+    else
+    {
+        generateCubeInstances(count);
+    }
+
+    ///Warm up, the containers and both buffers of the frame arena grow to
+    ///their steady size
+    for(int f=0; f<4; f++)
+    {
+        drawScene(shader, 0.0f);
+    }
+    getRenderBackend()->resetStats();
+
+    unsigned long long heapStart = getHeapAllocations();
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    for(int f=0; f<frames; f++)
+    {
+        drawScene(shader, f / 60.0f);
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    unsigned long long heapAllocs = getHeapAllocations() - heapStart;
+
+    BackendStats stats = getRenderBackend()->getStats();
+    double msPerFrame = elapsed.count() * 1000.0 / frames;
+
+    cout << count << " instances, " << multiView.getViewCount() << " views: "
+    << msPerFrame << " ms/frame, "
+    << msPerFrame * 1000000.0 / count << " ns/instance, "
+    << stats.drawCalls / frames << " draws/frame, "
+    << stats.uniformSets / frames << " uniforms/frame, "
+    << stats.textureBinds / frames << " texture binds/frame, "
+    << (double)heapAllocs / frames << " heap allocations/frame, "
+    << getBytesPerInstance() << " bytes/instance" << endl;
+
+    return heapAllocs;
+}
+
+///Runs the scene against the null backend, no window or OpenGL context.
+///  --null-backend N         instance count, 0 runs 1k, 10k and 100k
+///  --frames F               frames per instance count (60)
+///  --textures M             units, array or bindless (bindless)
+///  --views V                cameras drawn in one pass (1)
+///  --transform T            full or mvp, see getPrecomputedMVP (full)
+///  --scene file             the instances of a generated scene instead
+///  --replay file.rlog       replay a recorded log instead, see --record
+///  --zero-alloc             fail if a frame allocates from the heap
+int runNullBackend(int argc, char *argv[])
+{
+    int count = 0;
+    int frames = 60;
+    const char *replayPath = NULL;
+    bool bZeroAlloc = false;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--null-backend") == 0 && i + 1 < argc)
+        {
+            count = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = std::max(1, atoi(argv[++i]));
+        }
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--zero-alloc") == 0)
+        {
+            bZeroAlloc = true;
+        }
+    }
+
+    NullBackend backend;
+    setRenderBackend(&backend);
+
+    if(replayPath)
+    {
+        std::chrono::high_resolution_clock::time_point start =
+            std::chrono::high_resolution_clock::now();
+
+        int replayed = replayRenderLog(replayPath, backend);
+        if(replayed < 0)
+        {
+            return 1;
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+
+        BackendStats stats = backend.getStats();
+        cout << "Replayed " << replayed << " frames in "
+        << elapsed.count() * 1000.0 << " ms, " << stats.drawCalls
+        << " draws, " << stats.uniformSets << " uniforms" << endl;
+        return 0;
+    }
+
+    ///Same setup the OpenGL path does
+    loadTextures(getTextureMode(argc, argv), 0);
+    bPrecomputedMVP = getPrecomputedMVP(argc, argv);
+    bMixedAnimation = getMixedAnimation(argc, argv);
+    multiView.create(getViewCount(argc, argv));
+    openScene(argc, argv);
+    ShaderVariants cubeShaders("shaders/vShader.vs", "shaders/fShader.fs",
+                               setSamplers);
+    Shader *shader = cubeShaders.get(getCubeDefines());
+    buildCubeLODs();
+    buildOccluderMesh();
+    setBufferObjects();
+
+    unsigned long long heapAllocs = 0;
+
+    if(count > 0 || sceneFile.isOpen())
+    {
+        heapAllocs += benchmarkNullBackend(*shader, count, frames);
+    }
+    else
+    {
+        heapAllocs += benchmarkNullBackend(*shader, 1000, frames);
+        heapAllocs += benchmarkNullBackend(*shader, 10000, frames);
+        heapAllocs += benchmarkNullBackend(*shader, 100000, frames);
+    }
+
+    FrameArena &arena = FrameArena::get();
+    cout << "Frame arena: " << arena.getPeak() << " of "
+    << arena.getCapacity() << " bytes at most" << endl;
+
+    if(bZeroAlloc && heapAllocs > 0)
+    {
+        cout << "The frames made " << heapAllocs << " heap allocations"
+        << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+///\//////////////////////////VERTEX BENCHMARK/////////////////////////////////
+
+///Quads per face edge of the meshes the vertex benchmark draws
+const int VERTEX_BENCH_SUBDIVISIONS[] = {64, 256};
+
+///Matrices the CPU side of the benchmark concatenates
+const int MATRIX_BENCH_COUNT = 100000;
+
+///Seconds it takes to draw the mesh draws times. The rasterizer discards
+///everything, only the vertex shader is timed.
+double timeVertexShader(Shader &shader, unsigned int vao, unsigned int first,
+                        unsigned int count, int baseVertex, int draws)
+{
+    mat4 model = calcModelMat(vec3(0.0f, 0.0f, -3.0f), 1, 1.0f);
+    mat4 view = camera.GetViewMatrix();
+    mat4 proj = camera.GetProjectionMatrix();
+
+    shader.use();
+    if(bPrecomputedMVP)
+    {
+        shader.setMatrix4fv("mvpMat", proj * view * model);
+    }
+    else
+    {
+        shader.setMatrix4fv("modelMat", model);
+        shader.setMatrix4fv("viewMat", view);
+        shader.setMatrix4fv("projMat", proj);
+    }
+
+    getRenderBackend()->bindVertexArray(vao);
+
+    ///Warm up, the first draw may still be compiling
+    getRenderBackend()->drawElements(GL_TRIANGLES, count, first, baseVertex);
+    glFinish();
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    for(int d=0; d<draws; d++)
+    {
+        getRenderBackend()->drawElements(GL_TRIANGLES, count, first,
+                                         baseVertex);
+    }
+    glFinish();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count();
+}
+
+///Nanoseconds per matrix of view-projection * model, batched or
+///one product at a time
+void benchmarkMatrixBatch()
+{
+    vector<mat4> models(MATRIX_BENCH_COUNT);
+    for(int i=0; i<MATRIX_BENCH_COUNT; i++)
+    {
+        models[i] = calcModelMat(vec3(i % 100, i / 100 % 100, i / 10000),
+                                 1, i * 0.01f);
+    }
+
+    mat4 viewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+    vector<mat4> mvps(MATRIX_BENCH_COUNT);
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    for(int i=0; i<MATRIX_BENCH_COUNT; i++)
+    {
+        mvps[i] = viewProj * models[i];
+    }
+
+    std::chrono::high_resolution_clock::time_point middle =
+        std::chrono::high_resolution_clock::now();
+
+    multiplyMatrixBatch(viewProj, &models[0], NULL, &mvps[0],
+                        MATRIX_BENCH_COUNT);
+
+    std::chrono::duration<double, std::nano> one = middle - start;
+    std::chrono::duration<double, std::nano> batch =
+        std::chrono::high_resolution_clock::now() - middle;
+
+    cout << "MVP of " << MATRIX_BENCH_COUNT << " instances: "
+    << one.count() / MATRIX_BENCH_COUNT << " ns each one by one, "
+    << batch.count() / MATRIX_BENCH_COUNT << " ns each batched" << endl;
+}
+
+///Vertices per second of both transform paths of the vertex shader on meshes
+///of a few hundred thousand vertices, and the CPU cost of the MVPs
+///  --vertex-bench D         draws per mesh and path (20)
+int runVertexBenchmark(int argc, char *argv[])
+{
+    int draws = 20;
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--vertex-bench") == 0)
+        {
+            draws = std::max(1, atoi(argv[i + 1]));
+        }
+    }
+
+    ///Untextured, so the fragment shader needs nothing
+    bTextured = false;
+    ShaderVariants shaders("shaders/vShader.vs", "shaders/fShader.fs");
+    bPrecomputedMVP = false;
+    Shader *full = shaders.get(getCubeDefines());
+    bPrecomputedMVP = true;
+    Shader *mvp = shaders.get(getCubeDefines());
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    int meshes = sizeof(VERTEX_BENCH_SUBDIVISIONS) / sizeof(int);
+    for(int m=0; m<meshes; m++)
+    {
+        int n = VERTEX_BENCH_SUBDIVISIONS[m];
+        unsigned int first, count;
+        int baseVertex;
+
+        meshVertices.clear();
+        meshIndices.clear();
+        addMesh(makeSubdividedCube(n), first, count, baseVertex);
+        setBufferObjects();
+
+        unsigned int vertices = meshVertices.size() / 8;
+
+        for(int path=0; path<2; path++)
+        {
+            bPrecomputedMVP = path == 1;
+            double seconds = timeVertexShader(bPrecomputedMVP ? *mvp : *full,
+                                              VAO, first, count, baseVertex,
+                                              draws);
+
+            cout << vertices << " vertices, " << count << " indices, "
+            << (bPrecomputedMVP ? "mvp " : "full") << ": "
+            << seconds * 1000.0 / draws << " ms/draw, "
+            << vertices * (double)draws / seconds / 1000000.0
+            << " Mvertices/s" << endl;
+        }
+    }
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    benchmarkMatrixBatch();
+
+    return 0;
+}
+
+///\////////////////////////////ANIMATION BENCHMARK////////////////////////////
+
+///Frames every path of the benchmark evaluates
+const int ANIMATION_BENCH_FRAMES = 20;
+
+///--animation-bench [N] plays the mixed clips on N cubes (100000) one at a
+///time, 4 at a time and 4 at a time across the threads
+int runAnimationBenchmark(int argc, char *argv[])
+{
+    int count = MATRIX_BENCH_COUNT;
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--animation-bench") == 0)
+        {
+            count = std::max(1, atoi(argv[i + 1]));
+        }
+    }
+
+    cubeInstances.clear();
+    for(int i=0; i<count; i++)
+    {
+        cubeInstances.push_back(vec3(i % 100, i / 100 % 100, i / 10000));
+    }
+
+    bMixedAnimation = true;
+    resizeCubeInstances();
+
+    vector<mat4> reference(count);
+    const char *names[3] = {"one by one", "batched", "batched threaded"};
+    double nanoseconds[3];
+
+    for(int path=0; path<3; path++)
+    {
+        mat4 *out = path == 0 ? &reference[0] : &cubeModelMats[0];
+        ThreadPool *pool = path == 2 ? &threadPool : NULL;
+
+        ///Warm up, then the frames of a second at 20 fps
+        animationSystem.evaluate(0.0f, out, pool, path > 0);
+
+        std::chrono::high_resolution_clock::time_point start =
+            std::chrono::high_resolution_clock::now();
+
+        for(int f=1; f<=ANIMATION_BENCH_FRAMES; f++)
+        {
+            animationSystem.evaluate(f * 0.05f, out, pool, path > 0);
+        }
+
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+        nanoseconds[path] = elapsed.count() /
+                            ((double)count * ANIMATION_BENCH_FRAMES);
+    }
+
+    ///Both paths ended on the same time, they should agree
+    float difference = 0.0f;
+    for(int i=0; i<count; i++)
+    {
+        const float *a = value_ptr(reference[i]);
+        const float *b = value_ptr(cubeModelMats[i]);
+        for(int j=0; j<16; j++)
+        {
+            difference = std::max(difference, fabsf(a[j] - b[j]));
+        }
+    }
+
+    cout << "Animation of " << count << " instances:" << endl;
+    for(int path=0; path<3; path++)
+    {
+        cout << "  " << names[path] << ": " << nanoseconds[path]
+        << " ns each, " << 1000.0 / nanoseconds[path] << " Minstances/s"
+        << endl;
+    }
+    cout << "  " << threadPool.getThreadCount() << " threads, batched "
+    << "at most " << difference << " off one by one" << endl;
+
+    return 0;
+}
+
+///\/////////////////////////////CAMERA BENCHMARK/////////////////////////////
+
+///Calls every camera of the benchmark makes by default
+const int CAMERA_BENCH_CALLS = 1000000;
+
+///Moves the camera the way of every key in turn and makes its matrices
+///count times. Returns the nanoseconds per call, the matrices add up into
+///checksum.
+template<class CameraType>
+double timeCamera(CameraType &camera, int count, float &checksum)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+
+    for(int i=0; i<count; i++)
+    {
+        camera.MoveCamera((Camera_Movement)(i % (DOWN_SPIN + 1)), 0.001f);
+        mat4 viewProj = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+        checksum += viewProj[3][0] + viewProj[3][1] + viewProj[3][2];
+    }
+
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+///--camera-bench [N] moves the camera and makes its matrices N times
+///(1000000), through Camera and through the BasicCamera it wraps
+int runCameraBenchmark(int argc, char *argv[])
+{
+    int count = CAMERA_BENCH_CALLS;
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--camera-bench") == 0)
+        {
+            count = std::max(1, atoi(argv[i + 1]));
+        }
+    }
+
+    vec3 start(0.0f, 0.0f, 3.0f);
+    vec3 dir(0.0f, 0.0f, -1.0f);
+    vec3 up(0.0f, 1.0f, 0.0f);
+
+    Camera wrapped(start, dir, up, PERSPECTIVE);
+    BasicCamera<PerspectiveProjection, FreeRoamTarget> direct(start, dir, up);
+
+    ///Warm up on copies, so both start from the same camera
+    float warmUp = 0.0f;
+    Camera wrappedCopy = wrapped;
+    BasicCamera<PerspectiveProjection, FreeRoamTarget> directCopy = direct;
+    timeCamera(wrappedCopy, count / 10 + 1, warmUp);
+    timeCamera(directCopy, count / 10 + 1, warmUp);
+
+    float wrappedSum = 0.0f;
+    float directSum = 0.0f;
+    double wrappedTime = timeCamera(wrapped, count, wrappedSum);
+    double directTime = timeCamera(direct, count, directSum);
+
+    ///The same moves, they should end in the same place
+    bool bSame = wrappedSum == directSum &&
+                 wrapped.GetPosition() == direct.GetPosition() &&
+                 wrapped.GetFront() == direct.GetFront();
+
+    cout << "Camera, " << count << " moves with their matrices:" << endl;
+    cout << "  Camera: " << wrappedTime << " ns each" << endl;
+    cout << "  BasicCamera<PerspectiveProjection, FreeRoamTarget>: "
+    << directTime << " ns each" << endl;
+    cout << "  " << (bSame ? "same" : "different") << " results, checksum "
+    << directSum << endl;
+
+    return bSame ? 0 : 1;
+}
+
+///\//////////////////////////SOFTWARE RENDERER////////////////////////////////
+
+///The scene textures, loaded by runSoftwareRenderer
+SoftwareTexture softwareTextures[SCENE_TEXTURE_COUNT];
+
+///Renders the same frame as the OpenGL loop, without OpenGL
+void renderSoftwareFrame(SoftwareRenderer &renderer, SoftwareFramebuffer &fb,
+                         float time)
+{
+    camera.SetViewportSize(fb.getWidth(), fb.getHeight());
+
+    updateModelMats(time);
+    lodSelector.selectLevels(cubeLOD, camera);
+    cullCubes();
+
+    renderer.beginFrame(&fb, CLEAR_COLOR);
+    renderer.setViewMat(camera.GetViewMatrix());
+    renderer.setProjMat(camera.GetProjectionMatrix());
+
+    for(int i=0; i<(int)cubeInstances.size(); i++)
+    {
+        if(cubeVisible[i])
+        {
+            const LODLevel &level = cubeLOD.getLevel(lodSelector.getLevel(i));
+            renderer.setTextures(&softwareTextures[cubeMaterials[i].x],
+                                 &softwareTextures[cubeMaterials[i].y]);
+            renderer.draw(cubeModelMats[i], level.mode, level.firstIndex,
+                          level.indexCount, level.baseVertex);
+        }
+    }
+
+    renderer.endFrame();
+}
+
+///Frames per second of the software renderer for every thread count
+void benchmarkSoftwareRenderer(SoftwareRenderer &renderer, int width,
+                               int height, int frames)
+{
+    SoftwareFramebuffer fb(width, height);
+
+    int maxThreads = std::thread::hardware_concurrency();
+    if(maxThreads <= 0)
+    {
+        maxThreads = 1;
+    }
+
+    for(int threads=1; ; threads*=2)
+    {
+        threads = std::min(threads, maxThreads);
+
+        ThreadPool pool(threads);
+        renderer.setThreadPool(&pool);
+
+        ///Warm up
+        renderSoftwareFrame(renderer, fb, 0.0f);
+
+        std::chrono::high_resolution_clock::time_point start =
+            std::chrono::high_resolution_clock::now();
+
+        for(int f=0; f<frames; f++)
+        {
+            renderSoftwareFrame(renderer, fb, f / 60.0f);
+        }
+
+        std::chrono::duration<float> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+
+        cout << "Software " << width << "x" << height << ", " << threads
+        << " threads: " << frames / elapsed.count() << " fps" << endl;
+
+        if(threads == maxThreads)
+        {
+            break;
+        }
+    }
+
+    renderer.setThreadPool(&threadPool);
+}
+
+///Runs the scene on the CPU, no window or OpenGL context needed.
+///  --software               render one frame
+///  --size W H               framebuffer size (800x600)
+///  --time T                 scene time in seconds (1)
+///  --out file.ppm           save the frame
+///  --reference file.ppm     compare the frame with a reference image
+///  --tolerance N            allowed difference per channel (2)
+///  --max-different F        allowed fraction of different pixels (0.001)
+///  --software-bench         frames per second at 800x600 and 1920x1080
+int runSoftwareRenderer(int argc, char *argv[])
+{
+    int width = 800;
+    int height = 600;
+    float time = 1.0f;
+    int tolerance = 2;
+    float fMaxDifferent = 0.001f;
+    const char *outPath = NULL;
+    const char *referencePath = NULL;
+    bool bBenchmark = false;
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+        {
+            time = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+        {
+            referencePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--max-different") == 0 && i + 1 < argc)
+        {
+            fMaxDifferent = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--software-bench") == 0)
+        {
+            bBenchmark = true;
+        }
+    }
+
+    ///Same data the OpenGL path uploads
+    bMixedAnimation = getMixedAnimation(argc, argv);
+    buildCubeLODs();
+    resizeCubeInstances();
+    buildOccluderMesh();
+
+    ///The face is flipped, like in loadTextures
+    for(int i=0; i<SCENE_TEXTURE_COUNT; i++)
+    {
+        softwareTextures[i].load(SCENE_TEXTURE_PATHS[i],
+                                 SCENE_TEXTURE_FLIP[i]);
+    }
+
+    SoftwareRenderer renderer(&threadPool);
+    renderer.setMesh(&meshVertices[0], meshVertices.size() / 8,
+                     &meshIndices[0]);
+
+    if(bBenchmark)
+    {
+        benchmarkSoftwareRenderer(renderer, 800, 600, 60);
+        benchmarkSoftwareRenderer(renderer, 1920, 1080, 60);
+        return 0;
+    }
+
+    SoftwareFramebuffer fb(width, height);
+    renderSoftwareFrame(renderer, fb, time);
+
+    if(outPath)
+    {
+        fb.savePPM(outPath);
+        cout << "Frame saved to " << outPath << endl;
+    }
+
+    if(referencePath)
+    {
+        SoftwareFramebuffer reference;
+        if(!reference.loadPPM(referencePath))
+        {
+            return 1;
+        }
+
+        float fDifferent = fb.compare(reference, tolerance);
+        cout << "Pixels different from the reference: " << fDifferent * 100.0f
+        << "%" << endl;
+
+        ///Edges may land on different pixels than on the GPU
+        return fDifferent > fMaxDifferent ? 1 : 0;
+    }
+
+    return 0;
+}
+///\////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char *argv[])
+{
+    ///The software renderer runs without a window
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--software") == 0 ||
+           strcmp(argv[i], "--software-bench") == 0)
+        {
+            return runSoftwareRenderer(argc, argv);
+        }
+
+        if(strcmp(argv[i], "--null-backend") == 0 ||
+           strcmp(argv[i], "--replay") == 0)
+        {
+            return runNullBackend(argc, argv);
+        }
+
+        if(strcmp(argv[i], "--generate-path") == 0)
+        {
+            return runPathGenerator(argc, argv);
+        }
+
+        if(strcmp(argv[i], "--generate-scene") == 0)
+        {
+            return runSceneGenerator(argc, argv);
+        }
+
+        if(strcmp(argv[i], "--animation-bench") == 0)
+        {
+            return runAnimationBenchmark(argc, argv);
+        }
+
+        if(strcmp(argv[i], "--camera-bench") == 0)
+        {
+            return runCameraBenchmark(argc, argv);
+        }
+
+        ///--mesh-report optimizes the meshes of the cube and prints the
+        ///vertex cache stats, no context needed
+        if(strcmp(argv[i], "--mesh-report") == 0)
+        {
+            buildCubeLODs();
+            return 0;
+        }
+
+        ///--telemetry-client [socket] [lines|prometheus]
+        if(strcmp(argv[i], "--telemetry-client") == 0)
+        {
+            return runTelemetryClient(
+                i + 1 < argc ? argv[i + 1] : TELEMETRY_SOCKET_PATH,
+                i + 2 < argc ? argv[i + 2] : "lines");
+        }
+    }
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--headless") == 0 ||
+           strcmp(argv[i], "--vertex-bench") == 0)
+        {
+            bHeadless = true;
+        }
+    }
+
+    ///Initialize all the frameworks
+    initialize();
+
+    ///Needs the context, not the scene
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--vertex-bench") == 0)
+        {
+            int result = runVertexBenchmark(argc, argv);
+            glfwTerminate();
+            return result;
+        }
+    }
+
+    ///Before the first resource is created
+    startDirectStateAccess(argc, argv);
+
+    ///Need the context, before anything looks at the screen size
+    startDynamicResolution(argc, argv);
+    startCapture(argc, argv);
+
+    ///Every call of the session can be saved and replayed later
+    RecordingBackend *recorder = NULL;
+    for(int i=1; i+1<argc; i++)
+    {
+        if(strcmp(argv[i], "--record") == 0)
+        {
+            recorder = new RecordingBackend(argv[i + 1], getRenderBackend());
+            setRenderBackend(recorder);
+        }
+        else if(strcmp(argv[i], "--record-input") == 0)
+        {
+            inputRecorder = new InputRecorder(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "--replay-input") == 0)
+        {
+            inputPlayer = new InputPlayer();
+            if(!inputPlayer->open(argv[i + 1]))
+            {
+                delete inputPlayer;
+                inputPlayer = NULL;
+            }
+        }
+    }
+
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--telemetry") == 0)
+        {
+            bool bPath = i + 1 < argc && argv[i + 1][0] != '-';
+            telemetry = new Telemetry();
+            if(!telemetry->start(bPath ? argv[i + 1] : TELEMETRY_SOCKET_PATH))
+            {
+                delete telemetry;
+                telemetry = NULL;
+            }
+        }
+    }
+
+    ///Load Texture, the shaders depend on how they are stored
+    loadTextures(getTextureMode(argc, argv), getTextureBudget(argc, argv));
+    bPrecomputedMVP = getPrecomputedMVP(argc, argv);
+    bMixedAnimation = getMixedAnimation(argc, argv);
+    bStillAnimation = getStillAnimation(argc, argv);
+    openScene(argc, argv);
+
+    ///The views are drawn by their own shader variants
+    multiView.create(getViewCount(argc, argv));
+    startClusteredLighting(argc, argv);
+    startGpuCulling(argc, argv);
+    startLateLatch(argc, argv);
+    startLargeWorld(argc, argv);
+    startRenderOnDemand(argc, argv);
+
+    ///Compile and Link every variant of the shaders into Shader Programs
+    ShaderVariants cubeShaders("shaders/vShader.vs", "shaders/fShader.fs",
+                               setSamplers);
+    cubeShaders.precompile(getCubeVariants());
+    Shader *shader = cubeShaders.get(getCubeDefines());
+    bool bShaderTextured = bTextured;
+
+    ///Build the levels of detail of the cube, then the ten cubes or the
+    ///instances of the scene
+    buildCubeLODs();
+    if(sceneFile.isOpen())
+    {
+        loadSceneInstances();
+    }
+    else
+    {
+        resizeCubeInstances();
+    }
+
+    if(largeWorld.isActive())
+    {
+        largeWorld.update(camera);
+        largeWorld.printPrecision();
+    }
+
+    ///Build the occluder version of the cube
+    buildOccluderMesh();
 
     ///Set all the info regarding buffer Objects
     setBufferObjects();
 
-    ///Load Texture
-    loadTextures(shader);
+    if(gpuCuller)
+    {
+        gpuCuller->setMesh(cubeLOD, VAO);
+
+        ///Back to the CPU culling and its shader variant
+        if(!gpuCuller->resize(cubeInstances.size(), &cubeMaterials[0]))
+        {
+            delete gpuCuller;
+            gpuCuller = NULL;
+            shader = cubeShaders.get(getCubeDefines());
+        }
+    }
+
+    cout << "Creating the resources took "
+    << getRenderBackend()->getStats().bindCalls << " binds" << endl;
+    lastReportBinds = getRenderBackend()->getStats().bindCalls;
 
     ///Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    getRenderBackend()->enableDepthTest();
 
     ///Draw in Wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -664,11 +3163,25 @@ int main ()
     ///Draw in Fillmode, this is default.
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+    ///Build the shaders again when their files are saved, not while the
+    ///calls are being recorded since the log wouldn't know the new program
+    ShaderReloader *shaderReloader = NULL;
+    if(!recorder)
+    {
+        shaderReloader = new ShaderReloader(window);
+
+        for(int i=0; i<cubeShaders.getVariantCount(); i++)
+        {
+            shaderReloader->watch(cubeShaders.getVariant(i));
+        }
+    }
+
     ///Tell the user to use the arrow to move
     cout << "\n-----------------------------------" << endl;
     cout << "W-A-S-D to move the camera" << endl;
     cout << "page Up and page Down to change camera elevation" << endl;
     cout << "Arrow Keys to rotate the camera" << endl;
+    cout << "F2 to turn the textures on and off" << endl;
     cout << "-----------------------------------" << endl;
 
     ///This is the render loop *While the window is open*
@@ -677,48 +3190,147 @@ int main ()
         ///Get time in between frames for camera transformations
         calcDeltaTime();
 
-        ///Set background color
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        ///Refresh Color Bit and Z-Buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        ///Pick the variant of the shader when F2 switched it, compiled
+        ///already unless it wasn't declared in getCubeVariants()
+        if(bTextured != bShaderTextured)
+        {
+            shader = cubeShaders.get(getCubeDefines());
+            bShaderTextured = bTextured;
+            renderOnDemand.markDirty(DIRTY_RESOURCE);
+        }
+
+        ///Swap in the shaders saved since the last frame, a variant
+        ///compiled on first use is watched from now on
+        if(shaderReloader)
+        {
+            shaderReloader->watch(shader);
+
+            Shader *reloaded = shaderReloader->update(deltaTime);
+            if(reloaded)
+            {
+                setSamplers(*reloaded);
+                renderOnDemand.markDirty(DIRTY_RESOURCE);
+            }
+        }
+
+        ///A level the worker loaded while nothing was drawn
+        if(textureStreamer && textureStreamer->hasLoaded())
+        {
+            renderOnDemand.markDirty(DIRTY_RESOURCE);
+        }
 
-        ///Set the local view Matrix (Local Coordinates)
-        setLocalMat(shader);
+        ///With --on-demand, nothing changed: no frame, no swap, sleep until
+        ///an event or the timeout. The time asleep doesn't move the camera.
+        if(!renderOnDemand.beginFrame(camera, !bStillAnimation))
+        {
+            ///The other stats wait for a frame, the time idle doesn't
+            if(glfwGetTime() - lastReport >= REPORT_INTERVAL)
+            {
+                renderOnDemand.printStats();
+                lastReport = glfwGetTime();
+            }
+
+            processInput(window);
+            lastFrame += renderOnDemand.waitEvents();
+            cameraLatch.inputPolled();
+            continue;
+        }
 
-        ///Draw 10 cubes in different positions
-        for(int i=0; i<10; i++)
+        ///Draw the cubes, into the capture or the scaled target if there is
+        ///one
+        if(frameCapture)
+        {
+            frameCapture->bind();
+        }
+        else if(dynamicResolution)
         {
-            ///Set up the Model Matrix (World coordinates)
-            vec3 pos = cubePositions[i];
+            dynamicResolution->beginFrame(camera, deltaTime);
+        }
 
-            ///Rotate Around Origin
-            //setModelMat(shader,pos,0);
+        drawScene(*shader, bStillAnimation ? 0.0f : sceneTime);
 
-            ///Rotate Around Itself
-            setModelMat(shader,pos,1);
+        if(dynamicResolution)
+        {
+            dynamicResolution->endFrame();
+        }
 
-            ///Draw
-            drawCube(shader);
+        if(frameCapture)
+        {
+            frameCapture->capture();
+
+            if(!bHeadless)
+            {
+                int width, height;
+                glfwGetFramebufferSize(window, &width, &height);
+                frameCapture->blitToWindow(width, height);
+            }
+
+            if(iCaptureFrames > 0 &&
+               frameCapture->getFrameCount() >= (unsigned)iCaptureFrames)
+            {
+                glfwSetWindowShouldClose(window, true);
+            }
         }
 
-        ///Set the View Matrix (Camera Coordinates)
-        setViewMat(shader);
+        ///Load the texture levels the frame was missing, the programs get the
+        ///new bindless handles
+        if(textureStreamer && textureStreamer->update())
+        {
+            for(int i=0; i<cubeShaders.getVariantCount(); i++)
+            {
+                setSamplers(*cubeShaders.getVariant(i));
+            }
 
-        ///Set the Projection Matrix (the perspective of the camera)
-        setProjMat(shader);
+            renderOnDemand.markDirty(DIRTY_RESOURCE);
+        }
+
+        if(telemetry)
+        {
+            recordTelemetry();
+        }
+
+        ///Report the triangles saved by the LOD and the culling
+        reportStats();
 
         ///Process user input, in this case if the user presses the 'esc' key
-        ///to close the application
-        processInput(window);
+        ///to close the application. Latched late it was the frame's own.
+        if(!cameraLatch.isActive())
+        {
+            processInput(window);
+        }
 
         ///Swap the Front and Back buffer.
         glfwSwapBuffers(window);
 
         ///Poll CallBack Events
-        glfwPollEvents();
+        pollInput();
 
     }
 
+    delete shaderReloader;
+    delete textureStreamer;
+    delete telemetry;
+
+    ///Saves the frames still in flight
+    delete frameCapture;
+    delete dynamicResolution;
+    delete clusteredLighting;
+    delete gpuCuller;
+
+    if(inputRecorder)
+    {
+        inputRecorder->finish(camera);
+        delete inputRecorder;
+    }
+    delete inputPlayer;
+
+    ///Close the log before the context goes away
+    if(recorder)
+    {
+        setRenderBackend(NULL);
+        delete recorder;
+    }
+
     ///Free resources when application ends.
     glfwTerminate();
     return 0;
@@ -1,17 +1,84 @@
 //FRAGMENT SHADER
 #version 330 core
 
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
+
 in vec3 myColor;
 in vec2 TexCoord;
 
 out vec4 FragColor;
 
+#ifndef MAX_TEXTURE_LAYERS
+#define MAX_TEXTURE_LAYERS 16
+#endif
+
+#if defined(GPU_CULLING)
+//Per instance, from the vertex shader
+flat in int baseLayer;
+flat in int detailLayer;
+#elif defined(BINDLESS_TEXTURES) || defined(TEXTURE_ARRAY)
+uniform int baseLayer;
+uniform int detailLayer;
+#endif
+
+#if defined(BINDLESS_TEXTURES)
+//Handles of every texture, picked per draw by baseLayer and detailLayer
+uniform uvec2 textureHandles[MAX_TEXTURE_LAYERS];
+
+vec4 sampleBase(vec2 uv)
+{
+    return texture(sampler2D(textureHandles[baseLayer]), uv);
+}
+
+vec4 sampleDetail(vec2 uv)
+{
+    return texture(sampler2D(textureHandles[detailLayer]), uv);
+}
+#elif defined(TEXTURE_ARRAY)
+//Every texture is a layer, picked per draw by baseLayer and detailLayer
+uniform sampler2DArray textureArray;
+
+vec4 sampleBase(vec2 uv)
+{
+    return texture(textureArray, vec3(uv, baseLayer));
+}
+
+vec4 sampleDetail(vec2 uv)
+{
+    return texture(textureArray, vec3(uv, detailLayer));
+}
+#elif !defined(NO_TEXTURE)
 //This is the texture object
 uniform sampler2D myTexture;
 uniform sampler2D myTexture2;
 
+vec4 sampleBase(vec2 uv)
+{
+    return texture(myTexture, uv);
+}
+
+vec4 sampleDetail(vec2 uv)
+{
+    return texture(myTexture2, uv);
+}
+#endif
+
+#ifdef CLUSTERED_LIGHTING
+#include "lighting.glsl"
+#endif
+
 void main()
 {
-    FragColor = mix(texture(myTexture, TexCoord), texture(myTexture2, TexCoord),
-    0.2) * vec4(myColor, 1.0);
+#ifdef NO_TEXTURE
+    FragColor = vec4(myColor, 1.0);
+#else
+    FragColor = mix(sampleBase(TexCoord), sampleDetail(TexCoord), 0.2) *
+    vec4(myColor, 1.0);
+#endif
+
+#ifdef CLUSTERED_LIGHTING
+    FragColor.rgb *= clusteredLighting();
+#endif
 }
@@ -0,0 +1,75 @@
+//CLUSTERED LIGHTING
+//Included by the fragment shader, lights the fragment with the point lights
+//of the cluster it is in
+
+//Clusters across, down and in depth, the same as in ClusteredLighting.h
+#ifndef CLUSTER_X
+#define CLUSTER_X 16
+#endif
+#ifndef CLUSTER_Y
+#define CLUSTER_Y 9
+#endif
+#ifndef CLUSTER_Z
+#define CLUSTER_Z 24
+#endif
+
+//Light that reaches every face, so the scene is never black
+const float AMBIENT_LIGHT = 0.25;
+
+//Every light as two texels, view space position and radius, then color
+uniform samplerBuffer clusterLights;
+//Offset and count of the lights of every cluster in clusterIndices
+uniform usamplerBuffer clusterGrid;
+//The lights of every cluster one after another
+uniform usamplerBuffer clusterIndices;
+
+//To go from the fragment back to view space
+uniform mat4 invProjMat;
+uniform float viewportWidth;
+uniform float viewportHeight;
+
+//Slice of a view depth: log(depth) * clusterScale + clusterBias
+uniform float clusterScale;
+uniform float clusterBias;
+
+vec3 clusteredLighting()
+{
+    vec2 screen = gl_FragCoord.xy / vec2(viewportWidth, viewportHeight);
+
+    //The position the depth test saw, so every transform path agrees
+    vec4 ndc = vec4(vec3(screen, gl_FragCoord.z) * 2.0 - 1.0, 1.0);
+    vec4 view = invProjMat * ndc;
+    vec3 position = view.xyz / view.w;
+
+    //The cubes are flat, the normal of the face is as good as any
+    vec3 normal = normalize(cross(dFdx(position), dFdy(position)));
+
+    ivec3 cell = ivec3(ivec2(screen * vec2(CLUSTER_X, CLUSTER_Y)),
+                       int(log(-position.z) * clusterScale + clusterBias));
+    cell = clamp(cell, ivec3(0), ivec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z) - 1);
+
+    int cluster = (cell.z * CLUSTER_Y + cell.y) * CLUSTER_X + cell.x;
+    uvec2 range = texelFetch(clusterGrid, cluster).xy;
+
+    vec3 light = vec3(AMBIENT_LIGHT);
+    for(uint i=0u; i<range.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(clusterLights, index * 2);
+        vec3 color = texelFetch(clusterLights, index * 2 + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - position;
+        float distance2 = dot(toLight, toLight);
+
+        //Smoothly down to nothing at the radius
+        float falloff = clamp(1.0 - distance2 /
+                        (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        falloff *= falloff;
+
+        float lambert = max(dot(normal, toLight * inversesqrt(distance2)),
+                            0.0);
+        light += color * falloff * lambert;
+    }
+
+    return light;
+}
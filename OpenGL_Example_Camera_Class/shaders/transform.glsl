@@ -0,0 +1,87 @@
+//TRANSFORM
+//Included by the vertex shaders, takes a vertex from local space to clip space
+
+#ifdef PRECOMPUTED_MVP
+//projMat * viewMat * modelMat made once per draw on the CPU, the
+//vertex only pays one matrix times vector. With several views it stops at
+//the model, the views are below.
+uniform mat4 mvpMat;
+#elif defined(GPU_CULLING)
+//Index of the instance, read from the list the cull shader compacted
+layout (location = 3) in uint instanceIndex;
+
+//Model matrix of every instance as four texels
+uniform samplerBuffer instanceModels;
+
+mat4 getModelMat()
+{
+    int texel = int(instanceIndex) * 4;
+    return mat4(texelFetch(instanceModels, texel),
+                texelFetch(instanceModels, texel + 1),
+                texelFetch(instanceModels, texel + 2),
+                texelFetch(instanceModels, texel + 3));
+}
+#else
+uniform mat4 modelMat;
+
+mat4 getModelMat()
+{
+    return modelMat;
+}
+#endif
+
+#ifdef MULTI_VIEW
+#ifndef MAX_VIEWS
+#define MAX_VIEWS 8
+#endif
+
+//Every camera of the frame, the draw has one instance per camera
+layout (std140) uniform ViewBlock
+{
+    mat4 viewProj[MAX_VIEWS];
+    //NDC center (xy) and scale (zw) of the tile of the screen of every view
+    vec4 viewTiles[MAX_VIEWS];
+};
+
+vec4 toClipSpace(vec3 position)
+{
+#ifdef PRECOMPUTED_MVP
+    vec4 clip = viewProj[gl_InstanceID] * (mvpMat * vec4(position, 1.0));
+#else
+    vec4 clip = viewProj[gl_InstanceID] * getModelMat() * vec4(position, 1.0);
+#endif
+
+    //Clipped against the edges of the view before it is moved to its tile
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+
+    vec4 tile = viewTiles[gl_InstanceID];
+    clip.xy = clip.xy * tile.zw + tile.xy * clip.w;
+
+    return clip;
+}
+#elif defined(PRECOMPUTED_MVP)
+vec4 toClipSpace(vec3 position)
+{
+    return mvpMat * vec4(position, 1.0);
+}
+#else
+#ifdef LATE_LATCH
+//Written right before the draws, with the newest input
+layout (std140) uniform CameraBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+};
+#else
+uniform mat4 viewMat;
+uniform mat4 projMat;
+#endif
+
+vec4 toClipSpace(vec3 position)
+{
+    return projMat * viewMat * getModelMat() * vec4(position, 1.0);
+}
+#endif